@@ -38,10 +38,14 @@
 #define MOVEIT_BACKGROUND_PROCESSING_
 
 #include <deque>
+#include <list>
+#include <map>
 #include <string>
+#include <vector>
 #include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include <boost/function.hpp>
-#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 
 namespace moveit
@@ -55,7 +59,15 @@ namespace tools
 
 /** \brief This class provides simple API for executing background
     jobs. A queue of jobs is created and the specified jobs are
-    executed in order, one at a time. */
+    executed by a set of worker threads. With the default single
+    worker, jobs are executed in order, one at a time.
+
+    Jobs can be given a priority: a waiting job of a higher priority is
+    always started before one of a lower priority, and jobs of the same
+    priority are started in the order they were added. Jobs can also be
+    given a key: adding a job with the key of a job that is still waiting
+    replaces the waiting job, so only the most recent of a series of
+    updates is executed. */
 class BackgroundProcessing : private boost::noncopyable
 {
 public:
@@ -71,27 +83,190 @@ public:
       COMPLETE
     };
 
+  /** \brief Priority classes for jobs */
+  enum JobPriority
+    {
+      LOW_PRIORITY,
+      NORMAL_PRIORITY,
+      HIGH_PRIORITY
+    };
+
+  /** \brief The state of a job */
+  enum JobStatus
+    {
+      /// The job is waiting to be executed
+      QUEUED,
+      /// The job is being executed
+      RUNNING,
+      /// The job was executed
+      DONE,
+      /// The job was executed and threw an exception
+      FAILED,
+      /// The job was removed from the queue, or was canceled while it was executing
+      CANCELED
+    };
+
+  /** \brief A job added to the queue. It can be used to wait for the job
+      to finish, and, from within the job, to check whether cancellation
+      of the job was requested. */
+  class Job : private boost::noncopyable
+  {
+  public:
+
+    Job(const std::string &name, JobPriority priority, const std::string &key);
+
+    /** \brief The name of the job */
+    const std::string& getName() const
+    {
+      return name_;
+    }
+
+    /** \brief The priority the job was added with */
+    JobPriority getPriority() const
+    {
+      return priority_;
+    }
+
+    /** \brief The key the job was added with (empty if the job is not coalesced with other jobs) */
+    const std::string& getKey() const
+    {
+      return key_;
+    }
+
+    /** \brief The current state of the job */
+    JobStatus getStatus() const;
+
+    /** \brief Check if cancellation of the job was requested. Long running jobs should check this periodically and return early if it is true. */
+    bool isCanceled() const;
+
+    /** \brief Return true once the job was executed or removed from the queue */
+    bool isFinished() const;
+
+    /** \brief Wait until the job was executed or removed from the queue */
+    void wait() const;
+
+    /** \brief Wait at most \e timeout seconds for the job to be executed or removed from the queue. Return true if the job is finished */
+    bool wait(double timeout) const;
+
+    /** \brief If the job failed, the message of the exception it threw */
+    std::string getError() const;
+
+  private:
+
+    friend class BackgroundProcessing;
+
+    /** \brief Request cancellation; return the status the job had */
+    JobStatus requestCancel();
+
+    void setStatus(JobStatus status, const std::string &error = std::string());
+
+    std::string name_;
+    JobPriority priority_;
+    std::string key_;
+
+    mutable boost::mutex lock_;
+    mutable boost::condition_variable finished_condition_;
+    JobStatus status_;
+    bool cancel_requested_;
+    std::string error_;
+  };
+  typedef boost::shared_ptr<Job> JobPtr;
+
+  /** \brief The result of a job that computes a value. The value is available once the job is DONE. */
+  template<typename T>
+  class JobResult
+  {
+  public:
+
+    JobResult()
+    {
+    }
+
+    JobResult(const JobPtr &job, const boost::shared_ptr<T> &value) : job_(job), value_(value)
+    {
+    }
+
+    /** \brief The job computing the value */
+    const JobPtr& getJob() const
+    {
+      return job_;
+    }
+
+    /** \brief Wait for the job to finish. Return true if the value was computed (the job is DONE) */
+    bool wait() const
+    {
+      if (!job_)
+        return false;
+      job_->wait();
+      return job_->getStatus() == DONE;
+    }
+
+    /** \brief Wait for the job to finish and return the computed value. If the job failed or was canceled, a default constructed value is returned */
+    const T& get() const
+    {
+      wait();
+      return *value_;
+    }
+
+  private:
+
+    JobPtr job_;
+    boost::shared_ptr<T> value_;
+  };
+
   /** \brief The signature for callback triggered when job events take place: the event that took place and the name of the job */
   typedef boost::function<void(JobEvent, const std::string&)> JobUpdateCallback;
 
   /** \brief The signature for job callbacks */
   typedef boost::function<void()> JobCallback;
 
-  /** \brief Constructor. The background thread is activated automatically. */
-  BackgroundProcessing();
+  /** \brief The signature for callbacks of jobs that check for cancellation; the argument is the job being executed */
+  typedef boost::function<void(const Job&)> CancelableJobCallback;
+
+  /** \brief Constructor. \e worker_count threads (at least one) are started to execute the jobs. */
+  BackgroundProcessing(unsigned int worker_count = 1);
 
-  /** \brief Finishes currently executing job, clears the remaining queue. */
+  /** \brief Finishes currently executing jobs, clears the remaining queue. */
   ~BackgroundProcessing();
 
-  /** \brief Add a job to the queue of jobs to execute. A name is also specifies for the job */
-  void addJob(const JobCallback &job, const std::string &name);
+  /** \brief Get the number of threads executing jobs */
+  unsigned int getWorkerCount() const
+  {
+    return workers_.size();
+  }
 
-  /** \brief Get the size of the queue of jobs (includes currently processed job). */
+  /** \brief Add a job to the queue of jobs to execute. A name is also specifies for the job.
+      If \e key is not empty, a job with the same key that is still waiting in the queue is replaced by this one. */
+  JobPtr addJob(const JobCallback &job, const std::string &name,
+                JobPriority priority = NORMAL_PRIORITY, const std::string &key = std::string());
+
+  /** \brief Add a job that is passed the Job it is executed for, so that it can check for cancellation requests (Job::isCanceled()) */
+  JobPtr addCancelableJob(const CancelableJobCallback &job, const std::string &name,
+                          JobPriority priority = NORMAL_PRIORITY, const std::string &key = std::string());
+
+  /** \brief Add a job that computes a value of type \e T (which must be default constructible and assignable) */
+  template<typename T>
+  JobResult<T> addJobWithResult(const boost::function<T()> &job, const std::string &name,
+                                JobPriority priority = NORMAL_PRIORITY, const std::string &key = std::string())
+  {
+    boost::shared_ptr<T> value(new T());
+    JobPtr j = addJob(boost::bind(&BackgroundProcessing::storeResult<T>, job, value), name, priority, key);
+    return JobResult<T>(j, value);
+  }
+
+  /** \brief Cancel a job: if it is waiting in the queue, it is removed; if it is being executed, cancellation is requested
+      and it is up to the job to stop early. Return false if the job was already finished. */
+  bool cancelJob(const JobPtr &job);
+
+  /** \brief Get the size of the queue of jobs (includes currently processed jobs). */
   std::size_t getJobCount() const;
 
   /** \brief Clear the queue of jobs */
   void clear();
 
+  /** \brief Wait until the queue is empty and no job is being executed */
+  void waitForAllJobs() const;
+
   /** \brief Set the callback to be triggered when events in JobEvent take place */
   void setJobUpdateEvent(const JobUpdateCallback &event);
 
@@ -100,17 +275,47 @@ public:
 
 private:
 
-  boost::scoped_ptr<boost::thread> processing_thread_;
+  struct QueuedJob
+  {
+    CancelableJobCallback fn_;
+    JobPtr job_;
+  };
+
+  template<typename T>
+  static void storeResult(const boost::function<T()> &job, const boost::shared_ptr<T> &value)
+  {
+    *value = job();
+  }
+
+  static void callJob(const JobCallback &job, const Job&)
+  {
+    job();
+  }
+
+  JobPtr enqueue(const CancelableJobCallback &job, const std::string &name, JobPriority priority, const std::string &key);
+
+  /** \brief Remove \e job from the queue; action_lock_ must be held. Return false if the job was not queued */
+  bool removeQueued(const JobPtr &job);
+
+  void notify(JobEvent event, const std::string &name);
+
+  std::vector<boost::shared_ptr<boost::thread> > workers_;
   bool run_processing_thread_;
 
   mutable boost::mutex action_lock_;
   boost::condition_variable new_action_condition_;
-  std::deque<JobCallback> actions_;
-  std::deque<std::string> action_names_;
+  mutable boost::condition_variable idle_condition_;
+
+  /** \brief The queued jobs, one queue per priority class (indexed by JobPriority) */
+  std::list<QueuedJob> queues_[HIGH_PRIORITY + 1];
+
+  /** \brief The queued jobs that have a key */
+  std::map<std::string, JobPtr> keyed_jobs_;
 
   JobUpdateCallback queue_change_event_;
 
-  bool processing_;
+  /** \brief The number of jobs being executed */
+  std::size_t processing_;
 
   void processingThread();
 };
@@ -0,0 +1,264 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_BACKGROUND_PROCESSING_TASK_SCHEDULER_
+#define MOVEIT_BACKGROUND_PROCESSING_TASK_SCHEDULER_
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace moveit
+{
+namespace tools
+{
+
+/** \brief A pool of worker threads that execute short tasks, meant to be
+    shared by all the parallel computations in a process (batches of
+    collision checks or forward kinematics, sampling loops, etc.), so that
+    they do not each start their own threads.
+
+    Every worker keeps its own queue of tasks. Tasks submitted by a worker
+    (e.g., by a task that itself runs a parallelFor()) go to the back of
+    that worker's queue and are taken from the back, so nested work stays
+    on the worker that created it; idle workers steal from the front of
+    the queues of the others. Tasks submitted by other threads are placed
+    in a shared queue. A thread that waits for a TaskGroup executes
+    pending tasks while it waits, so nested parallelism does not deadlock
+    and the calling thread contributes to the computation. */
+class TaskScheduler : private boost::noncopyable
+{
+public:
+
+  /** \brief The signature of tasks */
+  typedef boost::function<void()> Task;
+
+  /** \brief A set of tasks that can be waited for as a whole */
+  class TaskGroup : private boost::noncopyable
+  {
+  public:
+
+    /** \brief Create a group of tasks executed by \e scheduler */
+    TaskGroup(TaskScheduler &scheduler = TaskScheduler::Instance());
+
+    /** \brief Wait for the tasks of the group to finish */
+    ~TaskGroup();
+
+    /** \brief Submit \e task for execution as part of this group */
+    void run(const Task &task);
+
+    /** \brief Wait for all the tasks submitted so far to finish, executing pending tasks in the meantime.
+        If any of the tasks threw an exception, a std::runtime_error with the message of the first one is thrown. */
+    void wait();
+
+    /** \brief The scheduler executing the tasks */
+    TaskScheduler& getScheduler() const
+    {
+      return scheduler_;
+    }
+
+  private:
+
+    friend class TaskScheduler;
+
+    /** \brief Called by the scheduler when a task of the group finished */
+    void taskDone(const std::string *error);
+
+    TaskScheduler &scheduler_;
+    boost::mutex lock_;
+    boost::condition_variable done_condition_;
+    std::size_t pending_;
+    bool failed_;
+    std::string error_;
+  };
+
+  /** \brief Return the scheduler shared by the components of a process. It uses one worker per hardware thread. */
+  static TaskScheduler& Instance();
+
+  /** \brief Start \e thread_count workers; 0 means one per hardware thread */
+  TaskScheduler(unsigned int thread_count = 0);
+
+  /** \brief Finish the pending tasks and stop the workers */
+  ~TaskScheduler();
+
+  /** \brief Get the number of workers */
+  unsigned int getThreadCount() const
+  {
+    return workers_.size();
+  }
+
+  /** \brief Return the index of the calling thread among the workers of this scheduler, or -1 if the calling thread is not one of them */
+  int getWorkerIndex() const;
+
+  /** \brief Pin worker \e i to core \e cores[i % cores.size()]. Return false if this is not supported on this platform or fails. */
+  bool setCoreAffinity(const std::vector<unsigned int> &cores);
+
+  /** \brief Call \e function on consecutive ranges [b, e) that partition [\e begin, \e end), in parallel, and wait for all of them.
+      The ranges contain \e grain elements (except possibly the last one); if \e grain is 0, the range is split into a few
+      ranges per worker. */
+  void parallelFor(std::size_t begin, std::size_t end, const boost::function<void(std::size_t, std::size_t)> &function, std::size_t grain = 0);
+
+  /** \brief Compute \e map on consecutive ranges [b, e) that partition [\e begin, \e end), in parallel, and combine the results
+      with \e combine, starting from \e identity. The results of the ranges are combined in the order of the ranges, so for a
+      given \e grain the result does not depend on the number of workers. See parallelFor() for the meaning of \e grain. */
+  template<typename T>
+  T parallelReduce(std::size_t begin, std::size_t end, const T &identity,
+                   const boost::function<T(std::size_t, std::size_t)> &map,
+                   const boost::function<T(const T&, const T&)> &combine,
+                   std::size_t grain = 0)
+  {
+    if (end <= begin)
+      return identity;
+    grain = getGrain(end - begin, grain);
+    std::vector<T> partial((end - begin + grain - 1) / grain, identity);
+    if (partial.size() == 1)
+      partial[0] = map(begin, end);
+    else
+    {
+      TaskGroup group(*this);
+      for (std::size_t i = 0 ; i < partial.size() ; ++i)
+        group.run(boost::bind(&TaskScheduler::reduceRange<T>, map, begin + i * grain, std::min(end, begin + (i + 1) * grain), &partial[i]));
+      group.wait();
+    }
+    T result = identity;
+    for (std::size_t i = 0 ; i < partial.size() ; ++i)
+      result = combine(result, partial[i]);
+    return result;
+  }
+
+private:
+
+  struct QueuedTask
+  {
+    Task task_;
+    TaskGroup *group_;
+  };
+
+  /** \brief The queue of a worker */
+  struct WorkerQueue
+  {
+    boost::mutex lock_;
+    std::deque<QueuedTask> tasks_;
+  };
+
+  template<typename T>
+  static void reduceRange(const boost::function<T(std::size_t, std::size_t)> &map, std::size_t begin, std::size_t end, T *result)
+  {
+    *result = map(begin, end);
+  }
+
+  std::size_t getGrain(std::size_t count, std::size_t grain) const;
+
+  void submit(const Task &task, TaskGroup *group);
+
+  /** \brief Take a pending task, preferring the queue of \e worker (-1 for threads that are not workers); return false if there is none */
+  bool takeTask(int worker, QueuedTask &task);
+
+  /** \brief Execute one pending task; return false if there was none */
+  bool runPendingTask(int worker);
+
+  void workerThread(int index);
+
+  std::vector<boost::shared_ptr<boost::thread> > workers_;
+  std::vector<boost::shared_ptr<WorkerQueue> > queues_;
+
+  /** \brief Protects the shared queue and the sleeping of workers; submitting to and taking from the own queue of a worker do not lock it */
+  boost::mutex lock_;
+  boost::condition_variable task_condition_;
+  std::deque<QueuedTask> shared_tasks_;
+
+  /** \brief The number of tasks submitted but not yet taken */
+  boost::atomic<long int> pending_;
+
+  /** \brief The number of workers that are going to sleep or sleeping, waiting for tasks */
+  boost::atomic<int> idle_;
+  bool running_;
+};
+
+/** \brief Storage of one instance of \e T per thread executing tasks of a TaskScheduler, for state that is expensive
+    to construct and cannot be shared between threads (collision managers, IK solver instances, scratch buffers).
+    Instances are constructed on first use by the thread that uses them, and are kept for as long as this object exists. */
+template<typename T>
+class WorkerLocal : private boost::noncopyable
+{
+public:
+
+  /** \brief The signature of functions that construct the per-thread instances */
+  typedef boost::function<boost::shared_ptr<T>()> Factory;
+
+  WorkerLocal(const TaskScheduler &scheduler, const Factory &factory) :
+    scheduler_(scheduler),
+    factory_(factory),
+    worker_instances_(scheduler.getThreadCount())
+  {
+  }
+
+  /** \brief Return the instance for the calling thread */
+  T& local()
+  {
+    int index = scheduler_.getWorkerIndex();
+    if (index >= 0)
+    {
+      // each worker only accesses its own entry, which is allocated in the constructor
+      if (!worker_instances_[index])
+        worker_instances_[index] = factory_();
+      return *worker_instances_[index];
+    }
+    boost::mutex::scoped_lock _(lock_);
+    boost::shared_ptr<T> &instance = other_instances_[boost::this_thread::get_id()];
+    if (!instance)
+      instance = factory_();
+    return *instance;
+  }
+
+private:
+
+  const TaskScheduler &scheduler_;
+  Factory factory_;
+  std::vector<boost::shared_ptr<T> > worker_instances_;
+  boost::mutex lock_;
+  std::map<boost::thread::id, boost::shared_ptr<T> > other_instances_;
+};
+
+}
+}
+
+#endif
@@ -37,19 +37,93 @@
 #include <moveit/background_processing/background_processing.h>
 #include <console_bridge/console.h>
 
-moveit::tools::BackgroundProcessing::BackgroundProcessing()
+moveit::tools::BackgroundProcessing::Job::Job(const std::string &name, JobPriority priority, const std::string &key) :
+  name_(name),
+  priority_(priority),
+  key_(key),
+  status_(QUEUED),
+  cancel_requested_(false)
 {
-  // spin a thread that will process user events
+}
+
+moveit::tools::BackgroundProcessing::JobStatus moveit::tools::BackgroundProcessing::Job::getStatus() const
+{
+  boost::mutex::scoped_lock _(lock_);
+  return status_;
+}
+
+bool moveit::tools::BackgroundProcessing::Job::isCanceled() const
+{
+  boost::mutex::scoped_lock _(lock_);
+  return cancel_requested_;
+}
+
+bool moveit::tools::BackgroundProcessing::Job::isFinished() const
+{
+  boost::mutex::scoped_lock _(lock_);
+  return status_ != QUEUED && status_ != RUNNING;
+}
+
+void moveit::tools::BackgroundProcessing::Job::wait() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  while (status_ == QUEUED || status_ == RUNNING)
+    finished_condition_.wait(slock);
+}
+
+bool moveit::tools::BackgroundProcessing::Job::wait(double timeout) const
+{
+  boost::system_time end = boost::get_system_time() + boost::posix_time::microseconds((boost::int64_t)(timeout * 1000000.0));
+  boost::mutex::scoped_lock slock(lock_);
+  while (status_ == QUEUED || status_ == RUNNING)
+    if (!finished_condition_.timed_wait(slock, end))
+      break;
+  return status_ != QUEUED && status_ != RUNNING;
+}
+
+std::string moveit::tools::BackgroundProcessing::Job::getError() const
+{
+  boost::mutex::scoped_lock _(lock_);
+  return error_;
+}
+
+moveit::tools::BackgroundProcessing::JobStatus moveit::tools::BackgroundProcessing::Job::requestCancel()
+{
+  boost::mutex::scoped_lock _(lock_);
+  cancel_requested_ = true;
+  return status_;
+}
+
+void moveit::tools::BackgroundProcessing::Job::setStatus(JobStatus status, const std::string &error)
+{
+  boost::mutex::scoped_lock _(lock_);
+  status_ = status;
+  error_ = error;
+  if (status != QUEUED && status != RUNNING)
+    finished_condition_.notify_all();
+}
+
+moveit::tools::BackgroundProcessing::BackgroundProcessing(unsigned int worker_count)
+{
+  // spin the threads that will process user events
   run_processing_thread_ = true;
-  processing_ = false;
-  processing_thread_.reset(new boost::thread(boost::bind(&BackgroundProcessing::processingThread, this)));
+  processing_ = 0;
+  if (worker_count == 0)
+    worker_count = 1;
+  for (unsigned int i = 0 ; i < worker_count ; ++i)
+    workers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&BackgroundProcessing::processingThread, this))));
 }
 
 moveit::tools::BackgroundProcessing::~BackgroundProcessing()
 {
-  run_processing_thread_ = false;
-  new_action_condition_.notify_all();
-  processing_thread_->join();
+  clear();
+  {
+    boost::mutex::scoped_lock _(action_lock_);
+    run_processing_thread_ = false;
+    new_action_condition_.notify_all();
+  }
+  for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+    workers_[i]->join();
 }
 
 void moveit::tools::BackgroundProcessing::processingThread()
@@ -58,72 +132,202 @@ void moveit::tools::BackgroundProcessing::processingThread()
 
   while (run_processing_thread_)
   {
-    while (actions_.empty() && run_processing_thread_)
+    // take the oldest job of the highest priority class
+    int p = HIGH_PRIORITY;
+    while (p >= LOW_PRIORITY && queues_[p].empty())
+      --p;
+    if (p < LOW_PRIORITY)
+    {
       new_action_condition_.wait(ulock);
+      continue;
+    }
 
-    while (!actions_.empty())
+    QueuedJob next = queues_[p].front();
+    queues_[p].pop_front();
+    if (!next.job_->getKey().empty())
+      keyed_jobs_.erase(next.job_->getKey());
+    processing_++;
+    const std::string &action_name = next.job_->getName();
+    next.job_->setStatus(RUNNING);
+
+    // make sure we are unlocked while we process the event
+    ulock.unlock();
+    JobStatus status = DONE;
+    std::string error;
+    try
     {
-      JobCallback fn = actions_.front();
-      std::string action_name = action_names_.front();
-      actions_.pop_front();
-      action_names_.pop_front();
-      processing_ = true;
-
-      // make sure we are unlocked while we process the event
-      action_lock_.unlock();
-      try
-      {
-        logDebug("moveit.background: Begin executing '%s'", action_name.c_str());
-        fn();
-        logDebug("moveit.background: Done executing '%s'", action_name.c_str());
-      }
-      catch(std::runtime_error &ex)
-      {
-        logError("Exception caught while processing action '%s': %s", action_name.c_str(), ex.what());
-      }
-      catch(...)
+      logDebug("moveit.background: Begin executing '%s'", action_name.c_str());
+      next.fn_(*next.job_);
+      logDebug("moveit.background: Done executing '%s'", action_name.c_str());
+    }
+    catch(std::exception &ex)
+    {
+      logError("Exception caught while processing action '%s': %s", action_name.c_str(), ex.what());
+      status = FAILED;
+      error = ex.what();
+    }
+    catch(...)
+    {
+      logError("Exception caught while processing action '%s'", action_name.c_str());
+      status = FAILED;
+      error = "unknown exception";
+    }
+    if (status == DONE && next.job_->isCanceled())
+      status = CANCELED;
+    next.job_->setStatus(status, error);
+    ulock.lock();
+    processing_--;
+    idle_condition_.notify_all();
+    ulock.unlock();
+    notify(COMPLETE, action_name);
+    ulock.lock();
+  }
+}
+
+moveit::tools::BackgroundProcessing::JobPtr moveit::tools::BackgroundProcessing::enqueue(const CancelableJobCallback &job, const std::string &name,
+                                                                                        JobPriority priority, const std::string &key)
+{
+  QueuedJob q;
+  q.fn_ = job;
+  q.job_.reset(new Job(name, priority, key));
+
+  JobPtr replaced;
+  {
+    boost::mutex::scoped_lock _(action_lock_);
+    if (!key.empty())
+    {
+      std::map<std::string, JobPtr>::iterator it = keyed_jobs_.find(key);
+      if (it != keyed_jobs_.end())
       {
-        logError("Exception caught while processing action '%s'", action_name.c_str());
+        replaced = it->second;
+        // a replacement of the same priority takes the place of the stale job, so a frequently updated job is not postponed indefinitely
+        if (replaced->getPriority() == priority)
+        {
+          for (std::list<QueuedJob>::iterator jt = queues_[priority].begin() ; jt != queues_[priority].end() ; ++jt)
+            if (jt->job_ == replaced)
+            {
+              *jt = q;
+              break;
+            }
+        }
+        else
+        {
+          removeQueued(replaced);
+          queues_[priority].push_back(q);
+        }
+        replaced->requestCancel();
+        replaced->setStatus(CANCELED);
       }
-      processing_ = false;
-      if (queue_change_event_)
-        queue_change_event_(COMPLETE, action_name);
-      action_lock_.lock();
+      else
+        queues_[priority].push_back(q);
+      keyed_jobs_[key] = q.job_;
     }
+    else
+      queues_[priority].push_back(q);
+    new_action_condition_.notify_one();
   }
+  if (replaced)
+    notify(REMOVE, replaced->getName());
+  notify(ADD, name);
+  return q.job_;
+}
+
+moveit::tools::BackgroundProcessing::JobPtr moveit::tools::BackgroundProcessing::addJob(const JobCallback &job, const std::string &name,
+                                                                                       JobPriority priority, const std::string &key)
+{
+  return enqueue(boost::bind(&BackgroundProcessing::callJob, job, _1), name, priority, key);
 }
 
-void moveit::tools::BackgroundProcessing::addJob(const boost::function<void()> &job, const std::string &name)
+moveit::tools::BackgroundProcessing::JobPtr moveit::tools::BackgroundProcessing::addCancelableJob(const CancelableJobCallback &job, const std::string &name,
+                                                                                                 JobPriority priority, const std::string &key)
 {
+  return enqueue(job, name, priority, key);
+}
+
+bool moveit::tools::BackgroundProcessing::removeQueued(const JobPtr &job)
+{
+  std::list<QueuedJob> &q = queues_[job->getPriority()];
+  for (std::list<QueuedJob>::iterator it = q.begin() ; it != q.end() ; ++it)
+    if (it->job_ == job)
+    {
+      q.erase(it);
+      if (!job->getKey().empty())
+        keyed_jobs_.erase(job->getKey());
+      return true;
+    }
+  return false;
+}
+
+bool moveit::tools::BackgroundProcessing::cancelJob(const JobPtr &job)
+{
+  bool removed = false;
   {
     boost::mutex::scoped_lock _(action_lock_);
-    actions_.push_back(job);
-    action_names_.push_back(name);
-    new_action_condition_.notify_all();
+    JobStatus status = job->requestCancel();
+    if (status == QUEUED)
+      removed = removeQueued(job);
+    else
+      if (status != RUNNING)
+        return false;
+    if (removed)
+    {
+      job->setStatus(CANCELED);
+      idle_condition_.notify_all();
+    }
   }
-  if (queue_change_event_)
-    queue_change_event_(ADD, name);
+  if (removed)
+    notify(REMOVE, job->getName());
+  return true;
 }
 
 void moveit::tools::BackgroundProcessing::clear()
 {
-  bool update = false;
-  std::deque<std::string> removed;
+  std::vector<JobPtr> removed;
   {
     boost::mutex::scoped_lock _(action_lock_);
-    update = !actions_.empty();
-    actions_.clear();
-    action_names_.swap(removed);
+    for (int p = LOW_PRIORITY ; p <= HIGH_PRIORITY ; ++p)
+    {
+      for (std::list<QueuedJob>::iterator it = queues_[p].begin() ; it != queues_[p].end() ; ++it)
+        removed.push_back(it->job_);
+      queues_[p].clear();
+    }
+    keyed_jobs_.clear();
+    for (std::size_t i = 0 ; i < removed.size() ; ++i)
+    {
+      removed[i]->requestCancel();
+      removed[i]->setStatus(CANCELED);
+    }
+    idle_condition_.notify_all();
   }
-  if (update && queue_change_event_)
-    for (std::deque<std::string>::iterator it = removed.begin() ; it != removed.end() ; ++it)
-      queue_change_event_(REMOVE, *it);
+  for (std::size_t i = 0 ; i < removed.size() ; ++i)
+    notify(REMOVE, removed[i]->getName());
 }
 
 std::size_t moveit::tools::BackgroundProcessing::getJobCount() const
 {
   boost::mutex::scoped_lock _(action_lock_);
-  return actions_.size() + (processing_ ? 1 : 0);
+  std::size_t count = processing_;
+  for (int p = LOW_PRIORITY ; p <= HIGH_PRIORITY ; ++p)
+    count += queues_[p].size();
+  return count;
+}
+
+void moveit::tools::BackgroundProcessing::waitForAllJobs() const
+{
+  boost::mutex::scoped_lock slock(action_lock_);
+  while (processing_ > 0 || !queues_[LOW_PRIORITY].empty() || !queues_[NORMAL_PRIORITY].empty() || !queues_[HIGH_PRIORITY].empty())
+    idle_condition_.wait(slock);
+}
+
+void moveit::tools::BackgroundProcessing::notify(JobEvent event, const std::string &name)
+{
+  JobUpdateCallback callback;
+  {
+    boost::mutex::scoped_lock _(action_lock_);
+    callback = queue_change_event_;
+  }
+  if (callback)
+    callback(event, name);
 }
 
 void moveit::tools::BackgroundProcessing::setJobUpdateEvent(const JobUpdateCallback &event)
@@ -0,0 +1,342 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/background_processing/task_scheduler.h>
+#include <console_bridge/console.h>
+#include <algorithm>
+#include <stdexcept>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace
+{
+
+/* The scheduler a worker thread belongs to, and its index */
+struct WorkerId
+{
+  const moveit::tools::TaskScheduler *scheduler_;
+  int index_;
+};
+
+boost::thread_specific_ptr<WorkerId>& getWorkerId()
+{
+  static boost::thread_specific_ptr<WorkerId> id;
+  return id;
+}
+
+}
+
+moveit::tools::TaskScheduler::TaskGroup::TaskGroup(TaskScheduler &scheduler) :
+  scheduler_(scheduler),
+  pending_(0),
+  failed_(false)
+{
+}
+
+moveit::tools::TaskScheduler::TaskGroup::~TaskGroup()
+{
+  try
+  {
+    wait();
+  }
+  catch(std::exception &ex)
+  {
+    logError("moveit.task_scheduler: Task failed: %s", ex.what());
+  }
+}
+
+void moveit::tools::TaskScheduler::TaskGroup::run(const Task &task)
+{
+  {
+    boost::mutex::scoped_lock _(lock_);
+    pending_++;
+  }
+  scheduler_.submit(task, this);
+}
+
+void moveit::tools::TaskScheduler::TaskGroup::taskDone(const std::string *error)
+{
+  boost::mutex::scoped_lock _(lock_);
+  if (error && !failed_)
+  {
+    failed_ = true;
+    error_ = *error;
+  }
+  if (--pending_ == 0)
+    done_condition_.notify_all();
+}
+
+void moveit::tools::TaskScheduler::TaskGroup::wait()
+{
+  int worker = scheduler_.getWorkerIndex();
+  while (true)
+  {
+    {
+      boost::mutex::scoped_lock _(lock_);
+      if (pending_ == 0)
+        break;
+    }
+    // help with the pending work; if there is none, the remaining tasks of this group are being executed by others
+    if (!scheduler_.runPendingTask(worker))
+    {
+      boost::mutex::scoped_lock slock(lock_);
+      if (pending_ > 0)
+        done_condition_.timed_wait(slock, boost::posix_time::milliseconds(1));
+    }
+  }
+
+  boost::mutex::scoped_lock _(lock_);
+  if (failed_)
+  {
+    failed_ = false;
+    std::string error;
+    error.swap(error_);
+    throw std::runtime_error(error);
+  }
+}
+
+moveit::tools::TaskScheduler& moveit::tools::TaskScheduler::Instance()
+{
+  static TaskScheduler scheduler;
+  return scheduler;
+}
+
+moveit::tools::TaskScheduler::TaskScheduler(unsigned int thread_count) :
+  pending_(0),
+  idle_(0),
+  running_(true)
+{
+  if (thread_count == 0)
+    thread_count = std::max(1u, boost::thread::hardware_concurrency());
+  for (unsigned int i = 0 ; i < thread_count ; ++i)
+    queues_.push_back(boost::shared_ptr<WorkerQueue>(new WorkerQueue()));
+  for (unsigned int i = 0 ; i < thread_count ; ++i)
+    workers_.push_back(boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&TaskScheduler::workerThread, this, (int)i))));
+}
+
+moveit::tools::TaskScheduler::~TaskScheduler()
+{
+  {
+    boost::mutex::scoped_lock _(lock_);
+    running_ = false;
+    task_condition_.notify_all();
+  }
+  for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+    workers_[i]->join();
+}
+
+int moveit::tools::TaskScheduler::getWorkerIndex() const
+{
+  WorkerId *id = getWorkerId().get();
+  return id && id->scheduler_ == this ? id->index_ : -1;
+}
+
+bool moveit::tools::TaskScheduler::setCoreAffinity(const std::vector<unsigned int> &cores)
+{
+  if (cores.empty())
+    return false;
+#ifdef __linux__
+  bool result = true;
+  for (std::size_t i = 0 ; i < workers_.size() ; ++i)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cores[i % cores.size()], &set);
+    if (pthread_setaffinity_np(workers_[i]->native_handle(), sizeof(cpu_set_t), &set) != 0)
+    {
+      logWarn("moveit.task_scheduler: Unable to pin worker %u to core %u", (unsigned int)i, cores[i % cores.size()]);
+      result = false;
+    }
+  }
+  return result;
+#else
+  logWarn("moveit.task_scheduler: Setting the core affinity of workers is not supported on this platform");
+  return false;
+#endif
+}
+
+std::size_t moveit::tools::TaskScheduler::getGrain(std::size_t count, std::size_t grain) const
+{
+  if (grain > 0)
+    return grain;
+  // a few ranges per worker, so that workers that finish early can steal the remaining ones
+  std::size_t ranges = 4 * workers_.size();
+  return std::max((std::size_t)1, (count + ranges - 1) / ranges);
+}
+
+void moveit::tools::TaskScheduler::parallelFor(std::size_t begin, std::size_t end, const boost::function<void(std::size_t, std::size_t)> &function, std::size_t grain)
+{
+  if (end <= begin)
+    return;
+  grain = getGrain(end - begin, grain);
+  if (end - begin <= grain)
+  {
+    function(begin, end);
+    return;
+  }
+  TaskGroup group(*this);
+  for (std::size_t b = begin ; b < end ; b += grain)
+    group.run(boost::bind(function, b, std::min(end, b + grain)));
+  group.wait();
+}
+
+void moveit::tools::TaskScheduler::submit(const Task &task, TaskGroup *group)
+{
+  QueuedTask q;
+  q.task_ = task;
+  q.group_ = group;
+
+  // count the task before it becomes visible, so a worker that takes it never sees a negative count
+  ++pending_;
+
+  int worker = getWorkerIndex();
+  if (worker >= 0)
+  {
+    {
+      boost::mutex::scoped_lock _(queues_[worker]->lock_);
+      queues_[worker]->tasks_.push_back(q);
+    }
+    // a worker counts itself as idle before it checks for pending tasks, so either it sees this task
+    // or it is seen here; only then the shared lock is needed to wake it up
+    if (idle_ > 0)
+    {
+      boost::mutex::scoped_lock _(lock_);
+      task_condition_.notify_one();
+    }
+  }
+  else
+  {
+    boost::mutex::scoped_lock _(lock_);
+    shared_tasks_.push_back(q);
+    task_condition_.notify_one();
+  }
+}
+
+bool moveit::tools::TaskScheduler::takeTask(int worker, QueuedTask &task)
+{
+  // the most recent task of the own queue first
+  if (worker >= 0)
+  {
+    boost::mutex::scoped_lock _(queues_[worker]->lock_);
+    if (!queues_[worker]->tasks_.empty())
+    {
+      task = queues_[worker]->tasks_.back();
+      queues_[worker]->tasks_.pop_back();
+      return true;
+    }
+  }
+
+  // then the tasks submitted from outside the scheduler
+  {
+    boost::mutex::scoped_lock _(lock_);
+    if (!shared_tasks_.empty())
+    {
+      task = shared_tasks_.front();
+      shared_tasks_.pop_front();
+      return true;
+    }
+  }
+
+  // then steal the oldest task of another worker
+  std::size_t n = queues_.size();
+  std::size_t start = worker >= 0 ? worker + 1 : 0;
+  for (std::size_t k = 0 ; k < n ; ++k)
+  {
+    std::size_t v = (start + k) % n;
+    if ((int)v == worker)
+      continue;
+    boost::mutex::scoped_lock _(queues_[v]->lock_);
+    if (!queues_[v]->tasks_.empty())
+    {
+      task = queues_[v]->tasks_.front();
+      queues_[v]->tasks_.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+bool moveit::tools::TaskScheduler::runPendingTask(int worker)
+{
+  QueuedTask task;
+  if (!takeTask(worker, task))
+    return false;
+  --pending_;
+
+  std::string error;
+  bool failed = false;
+  try
+  {
+    task.task_();
+  }
+  catch(std::exception &ex)
+  {
+    failed = true;
+    error = ex.what();
+  }
+  catch(...)
+  {
+    failed = true;
+    error = "unknown exception";
+  }
+  if (task.group_)
+    task.group_->taskDone(failed ? &error : NULL);
+  else
+    if (failed)
+      logError("moveit.task_scheduler: Task failed: %s", error.c_str());
+  return true;
+}
+
+void moveit::tools::TaskScheduler::workerThread(int index)
+{
+  WorkerId *id = new WorkerId();
+  id->scheduler_ = this;
+  id->index_ = index;
+  getWorkerId().reset(id);
+
+  while (true)
+  {
+    if (runPendingTask(index))
+      continue;
+    boost::mutex::scoped_lock slock(lock_);
+    ++idle_;
+    while (pending_ <= 0 && running_)
+      task_condition_.wait(slock);
+    --idle_;
+    if (!running_ && pending_ <= 0)
+      break;
+  }
+}
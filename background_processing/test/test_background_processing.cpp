@@ -0,0 +1,294 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/background_processing/background_processing.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+
+using moveit::tools::BackgroundProcessing;
+
+// keeps the worker busy until it is opened, so that jobs can be queued behind it
+class Gate
+{
+public:
+
+  Gate() : entered_(false), open_(false)
+  {
+  }
+
+  void pass()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    entered_ = true;
+    condition_.notify_all();
+    while (!open_)
+      condition_.wait(slock);
+  }
+
+  void waitUntilEntered()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    while (!entered_)
+      condition_.wait(slock);
+  }
+
+  void open()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    open_ = true;
+    condition_.notify_all();
+  }
+
+private:
+
+  boost::mutex lock_;
+  boost::condition_variable condition_;
+  bool entered_;
+  bool open_;
+};
+
+// records the order in which jobs are executed
+class Recorder
+{
+public:
+
+  void record(const std::string &name)
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    names_.push_back(name);
+  }
+
+  void event(BackgroundProcessing::JobEvent event, const std::string &name)
+  {
+    if (event == BackgroundProcessing::REMOVE)
+      record("removed " + name);
+  }
+
+  std::vector<std::string> get()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    return names_;
+  }
+
+private:
+
+  boost::mutex lock_;
+  std::vector<std::string> names_;
+};
+
+static void waitForCancel(Gate *started, const BackgroundProcessing::Job &job)
+{
+  started->pass();
+  while (!job.isCanceled())
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+}
+
+static void fail()
+{
+  throw std::runtime_error("job failed");
+}
+
+static int answer()
+{
+  return 42;
+}
+
+static void meet(boost::barrier *barrier, Recorder *recorder)
+{
+  barrier->wait();
+  recorder->record("met");
+}
+
+class BackgroundProcessingTest : public testing::Test
+{
+protected:
+
+  BackgroundProcessing::JobPtr addRecorded(BackgroundProcessing &processing, const std::string &name,
+                                           BackgroundProcessing::JobPriority priority = BackgroundProcessing::NORMAL_PRIORITY,
+                                           const std::string &key = std::string())
+  {
+    return processing.addJob(boost::bind(&Recorder::record, &recorder_, name), name, priority, key);
+  }
+
+  void block(BackgroundProcessing &processing)
+  {
+    processing.addJob(boost::bind(&Gate::pass, &gate_), "gate");
+    gate_.waitUntilEntered();
+  }
+
+  Gate gate_;
+  Recorder recorder_;
+};
+
+TEST_F(BackgroundProcessingTest, PriorityOrder)
+{
+  BackgroundProcessing processing;
+  block(processing);
+  addRecorded(processing, "low1", BackgroundProcessing::LOW_PRIORITY);
+  addRecorded(processing, "normal1", BackgroundProcessing::NORMAL_PRIORITY);
+  addRecorded(processing, "high1", BackgroundProcessing::HIGH_PRIORITY);
+  addRecorded(processing, "normal2", BackgroundProcessing::NORMAL_PRIORITY);
+  addRecorded(processing, "low2", BackgroundProcessing::LOW_PRIORITY);
+  addRecorded(processing, "high2", BackgroundProcessing::HIGH_PRIORITY);
+  EXPECT_EQ(7u, processing.getJobCount());
+  gate_.open();
+  processing.waitForAllJobs();
+  EXPECT_EQ(0u, processing.getJobCount());
+
+  const char *expected[] = { "high1", "high2", "normal1", "normal2", "low1", "low2" };
+  EXPECT_EQ(std::vector<std::string>(expected, expected + 6), recorder_.get());
+}
+
+TEST_F(BackgroundProcessingTest, CoalescingKeepsTheLatestJob)
+{
+  BackgroundProcessing processing;
+  processing.setJobUpdateEvent(boost::bind(&Recorder::event, &recorder_, _1, _2));
+  block(processing);
+  BackgroundProcessing::JobPtr first = addRecorded(processing, "update1", BackgroundProcessing::NORMAL_PRIORITY, "update");
+  addRecorded(processing, "other");
+  BackgroundProcessing::JobPtr second = addRecorded(processing, "update2", BackgroundProcessing::NORMAL_PRIORITY, "update");
+  BackgroundProcessing::JobPtr third = addRecorded(processing, "update3", BackgroundProcessing::NORMAL_PRIORITY, "update");
+  EXPECT_EQ(3u, processing.getJobCount());
+  EXPECT_EQ(BackgroundProcessing::CANCELED, first->getStatus());
+  EXPECT_EQ(BackgroundProcessing::CANCELED, second->getStatus());
+  EXPECT_EQ(BackgroundProcessing::QUEUED, third->getStatus());
+
+  // a replacement of a different priority moves to the queue of its priority
+  addRecorded(processing, "moved1", BackgroundProcessing::LOW_PRIORITY, "moved");
+  addRecorded(processing, "moved2", BackgroundProcessing::HIGH_PRIORITY, "moved");
+
+  gate_.open();
+  processing.waitForAllJobs();
+  EXPECT_EQ(BackgroundProcessing::DONE, third->getStatus());
+
+  // the latest update keeps the place of the first one, ahead of jobs added after it
+  const char *expected[] = { "removed update1", "removed update2", "removed moved1", "moved2", "update3", "other" };
+  EXPECT_EQ(std::vector<std::string>(expected, expected + 6), recorder_.get());
+
+  // once a keyed job has started, a new job with the same key is queued again
+  BackgroundProcessing::JobPtr again = addRecorded(processing, "update4", BackgroundProcessing::NORMAL_PRIORITY, "update");
+  again->wait();
+  EXPECT_EQ(BackgroundProcessing::DONE, again->getStatus());
+}
+
+TEST_F(BackgroundProcessingTest, CancelQueuedJob)
+{
+  BackgroundProcessing processing;
+  block(processing);
+  BackgroundProcessing::JobPtr canceled = addRecorded(processing, "canceled", BackgroundProcessing::NORMAL_PRIORITY, "key");
+  BackgroundProcessing::JobPtr kept = addRecorded(processing, "kept");
+  EXPECT_TRUE(processing.cancelJob(canceled));
+  EXPECT_EQ(BackgroundProcessing::CANCELED, canceled->getStatus());
+  EXPECT_TRUE(canceled->isFinished());
+  EXPECT_TRUE(canceled->wait(0.0));
+  EXPECT_EQ(2u, processing.getJobCount());
+
+  // finished jobs cannot be canceled
+  EXPECT_FALSE(processing.cancelJob(canceled));
+
+  // the key of the canceled job is free again
+  BackgroundProcessing::JobPtr keyed = addRecorded(processing, "keyed", BackgroundProcessing::NORMAL_PRIORITY, "key");
+  gate_.open();
+  processing.waitForAllJobs();
+  EXPECT_EQ(BackgroundProcessing::DONE, kept->getStatus());
+  EXPECT_EQ(BackgroundProcessing::DONE, keyed->getStatus());
+  EXPECT_FALSE(processing.cancelJob(kept));
+
+  const char *expected[] = { "kept", "keyed" };
+  EXPECT_EQ(std::vector<std::string>(expected, expected + 2), recorder_.get());
+}
+
+TEST_F(BackgroundProcessingTest, CancelRunningJob)
+{
+  BackgroundProcessing processing;
+  // the job only signals that it started; it does not wait for the gate
+  Gate started;
+  started.open();
+  BackgroundProcessing::JobPtr job = processing.addCancelableJob(boost::bind(&waitForCancel, &started, _1), "cancelable");
+  started.waitUntilEntered();
+  EXPECT_EQ(BackgroundProcessing::RUNNING, job->getStatus());
+  EXPECT_FALSE(job->wait(0.01));
+
+  EXPECT_TRUE(processing.cancelJob(job));
+  job->wait();
+  EXPECT_EQ(BackgroundProcessing::CANCELED, job->getStatus());
+  EXPECT_TRUE(job->isCanceled());
+}
+
+TEST_F(BackgroundProcessingTest, ClearCancelsQueuedJobs)
+{
+  BackgroundProcessing processing;
+  block(processing);
+  std::vector<BackgroundProcessing::JobPtr> jobs;
+  for (int i = 0 ; i < 5 ; ++i)
+    jobs.push_back(addRecorded(processing, "cleared", (BackgroundProcessing::JobPriority)(i % 3)));
+  processing.clear();
+  EXPECT_EQ(1u, processing.getJobCount());
+  for (std::size_t i = 0 ; i < jobs.size() ; ++i)
+    EXPECT_EQ(BackgroundProcessing::CANCELED, jobs[i]->getStatus());
+  gate_.open();
+  processing.waitForAllJobs();
+  EXPECT_TRUE(recorder_.get().empty());
+}
+
+TEST_F(BackgroundProcessingTest, ResultsAndFailures)
+{
+  BackgroundProcessing processing;
+  BackgroundProcessing::JobPtr failed = processing.addJob(&fail, "failing");
+  BackgroundProcessing::JobResult<int> result = processing.addJobWithResult<int>(&answer, "answer");
+  EXPECT_TRUE(result.wait());
+  EXPECT_EQ(42, result.get());
+  failed->wait();
+  EXPECT_EQ(BackgroundProcessing::FAILED, failed->getStatus());
+  EXPECT_EQ("job failed", failed->getError());
+}
+
+TEST_F(BackgroundProcessingTest, WorkersRunJobsConcurrently)
+{
+  BackgroundProcessing processing(4);
+  EXPECT_EQ(4u, processing.getWorkerCount());
+
+  // the jobs can only finish if all of them run at the same time
+  boost::barrier barrier(4);
+  for (int i = 0 ; i < 4 ; ++i)
+    processing.addJob(boost::bind(&meet, &barrier, &recorder_), "meet");
+  processing.waitForAllJobs();
+  EXPECT_EQ(4u, recorder_.get().size());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,270 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/background_processing/task_scheduler.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+using moveit::tools::TaskScheduler;
+
+typedef std::pair<std::size_t, std::size_t> Range;
+
+// remembers the ranges a function was called for, and counts how often each element was visited
+class RangeRecorder
+{
+public:
+
+  RangeRecorder(std::size_t size) : visits_(size, 0)
+  {
+  }
+
+  void visit(std::size_t begin, std::size_t end)
+  {
+    for (std::size_t i = begin ; i < end ; ++i)
+      visits_[i]++;
+    boost::mutex::scoped_lock slock(lock_);
+    ranges_.push_back(Range(begin, end));
+  }
+
+  std::vector<Range> getRanges()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    std::vector<Range> ranges = ranges_;
+    std::sort(ranges.begin(), ranges.end());
+    return ranges;
+  }
+
+  std::vector<int> visits_;
+
+private:
+
+  boost::mutex lock_;
+  std::vector<Range> ranges_;
+};
+
+static double sumInverse(std::size_t begin, std::size_t end)
+{
+  double sum = 0.0;
+  for (std::size_t i = begin ; i < end ; ++i)
+    sum += 1.0 / (double)(i + 1);
+  return sum;
+}
+
+static double add(const double &a, const double &b)
+{
+  return a + b;
+}
+
+static std::string rangeName(std::size_t begin, std::size_t end)
+{
+  std::stringstream ss;
+  ss << '[' << begin << ',' << end << ')';
+  return ss.str();
+}
+
+static std::string concatenate(const std::string &a, const std::string &b)
+{
+  return a + b;
+}
+
+static double innerReduce(TaskScheduler *scheduler, std::size_t begin, std::size_t end)
+{
+  double sum = 0.0;
+  for (std::size_t i = begin ; i < end ; ++i)
+    sum += scheduler->parallelReduce<double>(0, 1000, 0.0, &sumInverse, &add, 50);
+  return sum;
+}
+
+static void innerFor(TaskScheduler *scheduler, std::vector<int> *visits, std::size_t begin, std::size_t end)
+{
+  for (std::size_t i = begin ; i < end ; ++i)
+  {
+    RangeRecorder inner(100);
+    scheduler->parallelFor(0, 100, boost::bind(&RangeRecorder::visit, &inner, _1, _2), 10);
+    (*visits)[i] = std::count(inner.visits_.begin(), inner.visits_.end(), 1);
+  }
+}
+
+static void failOn(std::size_t bad, std::size_t begin, std::size_t end)
+{
+  if (bad >= begin && bad < end)
+    throw std::runtime_error("bad element");
+}
+
+static boost::mutex creations_lock;
+static std::size_t creations = 0;
+
+static boost::shared_ptr<std::size_t> makeCounter()
+{
+  boost::mutex::scoped_lock slock(creations_lock);
+  creations++;
+  return boost::shared_ptr<std::size_t>(new std::size_t(0));
+}
+
+static void countLocally(moveit::tools::WorkerLocal<std::size_t> *counters, std::size_t begin, std::size_t end)
+{
+  counters->local() += end - begin;
+}
+
+static void recordWorkerIndex(const TaskScheduler *scheduler, std::vector<int> *indices, std::size_t begin, std::size_t end)
+{
+  for (std::size_t i = begin ; i < end ; ++i)
+    (*indices)[i] = scheduler->getWorkerIndex();
+}
+
+TEST(TaskScheduler, ParallelForPartitionsTheRange)
+{
+  TaskScheduler scheduler(4);
+  EXPECT_EQ(4u, scheduler.getThreadCount());
+
+  const std::size_t grains[] = { 0, 1, 7, 1000, 100000 };
+  for (std::size_t g = 0 ; g < sizeof(grains) / sizeof(grains[0]) ; ++g)
+  {
+    RangeRecorder recorder(10007);
+    scheduler.parallelFor(3, 10007, boost::bind(&RangeRecorder::visit, &recorder, _1, _2), grains[g]);
+    for (std::size_t i = 0 ; i < recorder.visits_.size() ; ++i)
+      ASSERT_EQ(i < 3 ? 0 : 1, recorder.visits_[i]) << "element " << i << ", grain " << grains[g];
+
+    // consecutive ranges of the grain size, except possibly the last one
+    std::vector<Range> ranges = recorder.getRanges();
+    ASSERT_FALSE(ranges.empty());
+    EXPECT_EQ(3u, ranges.front().first);
+    EXPECT_EQ(10007u, ranges.back().second);
+    for (std::size_t i = 0 ; i + 1 < ranges.size() ; ++i)
+    {
+      EXPECT_EQ(ranges[i].second, ranges[i + 1].first);
+      if (grains[g] > 0)
+      {
+        EXPECT_EQ(grains[g], ranges[i].second - ranges[i].first);
+      }
+    }
+    if (grains[g] == 0)
+    {
+      EXPECT_LE(ranges.size(), 4 * scheduler.getThreadCount());
+    }
+  }
+
+  // empty ranges do not call the function
+  RangeRecorder empty(10);
+  scheduler.parallelFor(5, 5, boost::bind(&RangeRecorder::visit, &empty, _1, _2));
+  scheduler.parallelFor(6, 5, boost::bind(&RangeRecorder::visit, &empty, _1, _2));
+  EXPECT_TRUE(empty.getRanges().empty());
+}
+
+TEST(TaskScheduler, ParallelReduceCombinesInOrder)
+{
+  TaskScheduler scheduler(4);
+  EXPECT_EQ(0.0, scheduler.parallelReduce<double>(10, 10, 0.0, &sumInverse, &add));
+
+  // a non-commutative combination shows the order of the ranges
+  std::string expected;
+  for (std::size_t b = 0 ; b < 1000 ; b += 10)
+    expected += rangeName(b, std::min<std::size_t>(1000, b + 10));
+  EXPECT_EQ(expected, scheduler.parallelReduce<std::string>(0, 1000, std::string(), &rangeName, &concatenate, 10));
+
+  // for a given grain, the result does not depend on the number of workers
+  TaskScheduler single(1);
+  double sum = sumInverse(0, 100000);
+  double reduced = scheduler.parallelReduce<double>(0, 100000, 0.0, &sumInverse, &add, 100);
+  EXPECT_NEAR(sum, reduced, 1e-9);
+  EXPECT_EQ(reduced, single.parallelReduce<double>(0, 100000, 0.0, &sumInverse, &add, 100));
+}
+
+TEST(TaskScheduler, NestedParallelism)
+{
+  // with fewer workers than outer ranges, waiting threads must execute the inner tasks themselves
+  const unsigned int thread_counts[] = { 1, 2, 4 };
+  for (std::size_t t = 0 ; t < sizeof(thread_counts) / sizeof(thread_counts[0]) ; ++t)
+  {
+    TaskScheduler scheduler(thread_counts[t]);
+
+    std::vector<int> visits(32, 0);
+    scheduler.parallelFor(0, visits.size(), boost::bind(&innerFor, &scheduler, &visits, _1, _2), 1);
+    for (std::size_t i = 0 ; i < visits.size() ; ++i)
+      EXPECT_EQ(100, visits[i]);
+
+    double inner = sumInverse(0, 1000);
+    double nested = scheduler.parallelReduce<double>(0, 16, 0.0, boost::bind(&innerReduce, &scheduler, _1, _2), &add, 1);
+    EXPECT_NEAR(16.0 * inner, nested, 1e-9);
+  }
+}
+
+TEST(TaskScheduler, ExceptionsArePropagated)
+{
+  TaskScheduler scheduler(2);
+  try
+  {
+    scheduler.parallelFor(0, 1000, boost::bind(&failOn, 500, _1, _2), 10);
+    FAIL() << "parallelFor did not throw";
+  }
+  catch(std::runtime_error &ex)
+  {
+    EXPECT_EQ(std::string("bad element"), ex.what());
+  }
+
+  // the scheduler is still usable afterwards
+  RangeRecorder recorder(100);
+  scheduler.parallelFor(0, 100, boost::bind(&RangeRecorder::visit, &recorder, _1, _2), 10);
+  EXPECT_EQ(100, std::count(recorder.visits_.begin(), recorder.visits_.end(), 1));
+}
+
+TEST(TaskScheduler, WorkerIndexAndWorkerLocal)
+{
+  TaskScheduler scheduler(3);
+  EXPECT_EQ(-1, scheduler.getWorkerIndex());
+
+  std::vector<int> indices(3000, -2);
+  scheduler.parallelFor(0, indices.size(), boost::bind(&recordWorkerIndex, &scheduler, &indices, _1, _2), 10);
+  for (std::size_t i = 0 ; i < indices.size() ; ++i)
+  {
+    // the calling thread helps while it waits, and is not a worker
+    EXPECT_GE(indices[i], -1);
+    EXPECT_LT(indices[i], 3);
+  }
+
+  creations = 0;
+  moveit::tools::WorkerLocal<std::size_t> counters(scheduler, &makeCounter);
+  scheduler.parallelFor(0, 10000, boost::bind(&countLocally, &counters, _1, _2), 10);
+  // at most one instance per worker and one for the calling thread
+  EXPECT_GE(creations, 1u);
+  EXPECT_LE(creations, 4u);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -38,16 +38,29 @@
 #include <fcl/BVH/BVH_model.h>
 #include <fcl/shape/geometric_shapes.h>
 #include <fcl/octree.h>
+#include <moveit/profiler/profiler.h>
 #include <boost/thread/mutex.hpp>
 
 namespace collision_detection
 {
 
+namespace
+{
+// counters reported by the profiler when enabled (see moveit::tools::Profiler::Count())
+const moveit::tools::Profiler::Key COUNT_BROADPHASE_PAIRS("CollisionFCL: broadphase pairs");
+const moveit::tools::Profiler::Key COUNT_ACM_FILTERED_PAIRS("CollisionFCL: pairs allowed by the ACM");
+const moveit::tools::Profiler::Key COUNT_NARROWPHASE_CALLS("CollisionFCL: narrow-phase collision calls");
+const moveit::tools::Profiler::Key COUNT_DISTANCE_BROADPHASE_PAIRS("CollisionFCL: distance broadphase pairs");
+const moveit::tools::Profiler::Key COUNT_DISTANCE_ACM_FILTERED_PAIRS("CollisionFCL: distance pairs allowed by the ACM");
+const moveit::tools::Profiler::Key COUNT_DISTANCE_NARROWPHASE_CALLS("CollisionFCL: narrow-phase distance calls");
+}
+
 bool collisionCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void *data)
 {
   CollisionData *cdata = reinterpret_cast<CollisionData*>(data);
   if (cdata->done_)
     return true;
+  moveit::tools::Profiler::Count(COUNT_BROADPHASE_PAIRS);
   const CollisionGeometryData *cd1 = static_cast<const CollisionGeometryData*>(o1->collisionGeometry()->getUserData());
   const CollisionGeometryData *cd2 = static_cast<const CollisionGeometryData*>(o2->collisionGeometry()->getUserData());
 
@@ -80,6 +93,7 @@ bool collisionCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void
       if (type == AllowedCollision::ALWAYS)
       {
         always_allow_collision = true;
+        moveit::tools::Profiler::Count(COUNT_ACM_FILTERED_PAIRS);
         if (cdata->req_->verbose)
           logDebug("Collision between '%s' (type '%s') and '%s' (type '%s') is always allowed. No contacts are computed.",
                    cd1->getID().c_str(),
@@ -135,6 +149,9 @@ bool collisionCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void
   if (cdata->req_->verbose)
     logDebug("Actually checking collisions between %s and %s", cd1->getID().c_str(), cd2->getID().c_str());
 
+  // each of the cases below makes exactly one narrow-phase call
+  moveit::tools::Profiler::Count(COUNT_NARROWPHASE_CALLS);
+
   // see if we need to compute a contact
   std::size_t want_contact_count = 0;
   if (cdata->req_->contacts)
@@ -363,6 +380,7 @@ bool distanceCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void*
 
   const CollisionGeometryData* cd1 = static_cast<const CollisionGeometryData*>(o1->collisionGeometry()->getUserData());
   const CollisionGeometryData* cd2 = static_cast<const CollisionGeometryData*>(o2->collisionGeometry()->getUserData());
+  moveit::tools::Profiler::Count(COUNT_DISTANCE_BROADPHASE_PAIRS);
 
   // do not perform distance calculation for geoms part of the same object / link / attached body
   if (cd1->sameObject(*cd2))
@@ -396,6 +414,7 @@ bool distanceCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void*
       if (type == AllowedCollision::ALWAYS)
       {
         always_allow_collision = true;
+        moveit::tools::Profiler::Count(COUNT_DISTANCE_ACM_FILTERED_PAIRS);
         if (cdata->req_->verbose)
           logDebug("Collision between '%s' and '%s' is always allowed. No contacts are computed.",
                    cd1->getID().c_str(), cd2->getID().c_str());
@@ -439,6 +458,7 @@ bool distanceCallback(fcl::CollisionObject* o1, fcl::CollisionObject* o2, void*
   if (cdata->req_->verbose)
     logDebug("Actually checking collisions between %s and %s", cd1->getID().c_str(), cd2->getID().c_str());
 
+  moveit::tools::Profiler::Count(COUNT_DISTANCE_NARROWPHASE_CALLS);
   fcl::DistanceResult dist_result;
   dist_result.update(cdata->res_->distance, NULL, NULL, fcl::DistanceResult::NONE, fcl::DistanceResult::NONE); // can be faster
   double d = fcl::distance(o1, o2, fcl::DistanceRequest(), dist_result);
@@ -35,6 +35,14 @@
 /* Author: Ioan Sucan */
 
 #include <moveit/collision_detection_fcl/collision_robot_fcl.h>
+#include <moveit/profiler/profiler.h>
+
+namespace
+{
+// counters reported by the profiler when enabled (see moveit::tools::Profiler::Count())
+const moveit::tools::Profiler::Key COUNT_SELF_CHECKS("CollisionRobotFCL: self collision checks");
+const moveit::tools::Profiler::Key COUNT_OTHER_CHECKS("CollisionRobotFCL: other robot collision checks");
+}
 
 collision_detection::CollisionRobotFCL::CollisionRobotFCL(const robot_model::RobotModelConstPtr &model, double padding, double scale) 
   : CollisionRobot(model, padding, scale)
@@ -135,6 +143,7 @@ void collision_detection::CollisionRobotFCL::checkSelfCollision(const CollisionR
 void collision_detection::CollisionRobotFCL::checkSelfCollisionHelper(const CollisionRequest &req, CollisionResult &res, const robot_state::RobotState &state,
                                                                       const AllowedCollisionMatrix *acm) const
 {
+  moveit::tools::Profiler::Count(COUNT_SELF_CHECKS);
   FCLManager manager;
   allocSelfCollisionBroadPhase(state, manager);
   CollisionData cd(&req, &res, acm);
@@ -174,6 +183,7 @@ void collision_detection::CollisionRobotFCL::checkOtherCollisionHelper(const Col
                                                                        const CollisionRobot &other_robot, const robot_state::RobotState &other_state,
                                                                        const AllowedCollisionMatrix *acm) const
 {
+  moveit::tools::Profiler::Count(COUNT_OTHER_CHECKS);
   FCLManager manager;
   allocSelfCollisionBroadPhase(state, manager);
 
@@ -39,6 +39,14 @@
 #include <fcl/traversal/traversal_node_bvhs.h>
 #include <fcl/traversal/traversal_node_setup.h>
 #include <fcl/collision_node.h>
+#include <moveit/profiler/profiler.h>
+
+namespace
+{
+// counters reported by the profiler when enabled (see moveit::tools::Profiler::Count())
+const moveit::tools::Profiler::Key COUNT_ROBOT_CHECKS("CollisionWorldFCL: robot collision checks");
+const moveit::tools::Profiler::Key COUNT_WORLD_CHECKS("CollisionWorldFCL: world collision checks");
+}
 
 collision_detection::CollisionWorldFCL::CollisionWorldFCL() :
   CollisionWorld()
@@ -106,6 +114,7 @@ void collision_detection::CollisionWorldFCL::checkRobotCollision(const Collision
 
 void collision_detection::CollisionWorldFCL::checkRobotCollisionHelper(const CollisionRequest &req, CollisionResult &res, const CollisionRobot &robot, const robot_state::RobotState &state, const AllowedCollisionMatrix *acm) const
 {
+  moveit::tools::Profiler::Count(COUNT_ROBOT_CHECKS);
   const CollisionRobotFCL &robot_fcl = dynamic_cast<const CollisionRobotFCL&>(robot);
   FCLObject fcl_obj;
   robot_fcl.constructFCLObject(state, fcl_obj);
@@ -131,6 +140,7 @@ void collision_detection::CollisionWorldFCL::checkWorldCollision(const Collision
 
 void collision_detection::CollisionWorldFCL::checkWorldCollisionHelper(const CollisionRequest &req, CollisionResult &res, const CollisionWorld &other_world, const AllowedCollisionMatrix *acm) const
 {
+  moveit::tools::Profiler::Count(COUNT_WORLD_CHECKS);
   const CollisionWorldFCL &other_fcl_world = dynamic_cast<const CollisionWorldFCL&>(other_world);
   CollisionData cd(&req, &res, acm);
   manager_->collide(other_fcl_world.manager_.get(), &cd, &collisionCallback);
@@ -125,6 +125,42 @@ public:
   /** \brief Return the execution status of the last trajectory sent to the controller. */
   virtual ExecutionStatus getLastExecutionStatus() = 0;
 
+  /** \brief Return true if the controller supports streaming execution (openStream(), appendToStream(), spliceStream() and closeStream()).
+      When streaming, execution starts as soon as the first segment is appended, before the complete trajectory is known. */
+  virtual bool supportsStreaming() const
+  {
+    return false;
+  }
+
+  /** \brief Start a streamed execution for the joints \e joints. The time_from_start of the points appended to the stream is measured
+      from the moment the stream is opened. Any execution in progress is preempted. Return false if streaming is not supported. */
+  virtual bool openStream(const std::vector<std::string> &joints)
+  {
+    return false;
+  }
+
+  /** \brief Append the points of \e segment to the open stream. The segment needs to be for the joints the stream was opened with,
+      and its points need to come after the points already in the stream. If the controller reaches the end of the stream before more
+      points are appended, it holds the last position; the next segment then starts moving from the time it is appended, and the points
+      of that segment and of all later ones are delayed by the time the stream was dry. */
+  virtual bool appendToStream(const trajectory_msgs::JointTrajectory &segment)
+  {
+    return false;
+  }
+
+  /** \brief Replace the points of the open stream from the time of the first point of \e suffix on by the points of \e suffix.
+      Return false if that time has already been reached by the controller, in which case the stream is not modified. */
+  virtual bool spliceStream(const trajectory_msgs::JointTrajectory &suffix)
+  {
+    return false;
+  }
+
+  /** \brief Declare that no more points will be appended; the execution completes when the end of the stream is reached */
+  virtual bool closeStream()
+  {
+    return false;
+  }
+
 protected:
 
   std::string name_;
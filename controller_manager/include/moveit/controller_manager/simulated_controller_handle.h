@@ -0,0 +1,178 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_CONTROLLER_MANAGER_SIMULATED_CONTROLLER_HANDLE_
+#define MOVEIT_CONTROLLER_MANAGER_SIMULATED_CONTROLLER_HANDLE_
+
+#include <moveit/controller_manager/controller_manager.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace moveit_controller_manager
+{
+
+/** \brief A controller that executes trajectories in simulated time, in process.
+    Time only advances when advance() is called, so execution is
+    deterministic and can run faster (or slower) than real time. The
+    joints follow the commanded trajectory, interpolated linearly
+    between points, optionally with a delay and a constant position
+    offset, which makes it possible to test code that monitors
+    execution. Streaming execution is supported. Multi-DOF trajectories
+    are not supported. */
+class SimulatedControllerHandle : public MoveItControllerHandle
+{
+public:
+
+  /** \brief Construct a controller for the joints \e joints */
+  SimulatedControllerHandle(const std::string &name, const std::vector<std::string> &joints);
+
+  virtual ~SimulatedControllerHandle();
+
+  /** \brief Start executing \e trajectory at the current simulated time. The trajectory may only refer to joints of this controller;
+      joints it does not mention keep their position. Any execution in progress is preempted */
+  virtual bool sendTrajectory(const moveit_msgs::RobotTrajectory &trajectory);
+
+  virtual bool cancelExecution();
+
+  /** \brief Wait (in wall time) for the simulated execution to complete. Simulated time needs to be advanced by another thread meanwhile */
+  virtual bool waitForExecution(const ros::Duration &timeout = ros::Duration(0));
+
+  virtual ExecutionStatus getLastExecutionStatus();
+
+  virtual bool supportsStreaming() const
+  {
+    return true;
+  }
+
+  virtual bool openStream(const std::vector<std::string> &joints);
+
+  virtual bool appendToStream(const trajectory_msgs::JointTrajectory &segment);
+
+  virtual bool spliceStream(const trajectory_msgs::JointTrajectory &suffix);
+
+  virtual bool closeStream();
+
+  /** \brief Advance the simulated time by \e dt seconds */
+  void advance(double dt);
+
+  /** \brief Get the simulated time, in seconds since the controller was constructed */
+  double getTime() const;
+
+  /** \brief Get the time since the current (or last) trajectory started */
+  double getTimeFromStart() const;
+
+  /** \brief Make the joints lag behind the commanded trajectory by \e delay seconds */
+  void setTrackingDelay(double delay);
+
+  /** \brief Add a constant offset to the position of each joint (in the order of getJoints()) */
+  void setPositionOffsets(const std::vector<double> &offsets);
+
+  /** \brief Set the positions of the joints directly (e.g., the initial state); ignored while executing */
+  void setJointPositions(const std::vector<double> &positions);
+
+  /** \brief Get the positions of the joints, in the order of getJoints(). \e positions is only resized if needed */
+  void getJointPositions(std::vector<double> &positions) const;
+
+  /** \brief Get the velocities of the joints, in the order of getJoints(). \e velocities is only resized if needed */
+  void getJointVelocities(std::vector<double> &velocities) const;
+
+  const std::vector<std::string>& getJoints() const
+  {
+    return joints_;
+  }
+
+protected:
+
+  /** \brief Find the index of each of \e names among the joints of this controller */
+  bool mapJoints(const std::vector<std::string> &names, std::vector<std::size_t> &joint_map) const;
+
+  /** \brief Start executing \e points for the joints \e joint_map at the current time; called with the lock held */
+  void startExecution(std::vector<std::size_t> &joint_map, const std::vector<trajectory_msgs::JointTrajectoryPoint> &points);
+
+  /** \brief Check that \e segment is for the joints of the open stream; called with the lock held */
+  bool checkStreamSegment(const trajectory_msgs::JointTrajectory &segment) const;
+
+  /** \brief If the joints are past the last point of the stream, add a point that holds their current positions at the current time,
+      so the next points are reached from there. Return the time the joints are past the last point (0 if they are not); called with the lock held */
+  double holdStream();
+
+  /** \brief Bring the positions and velocities up to date with the simulated time; called with the lock held */
+  void updateJointStates();
+
+  /** \brief Get the time from start of point \e index of the active trajectory */
+  double getPointTime(std::size_t index) const
+  {
+    return points_[index].time_from_start.toSec();
+  }
+
+  std::vector<std::string> joints_;
+
+  /** \brief For each joint of the active trajectory, the index of the controller joint */
+  std::vector<std::size_t> joint_map_;
+
+  /** \brief The points of the active trajectory */
+  std::vector<trajectory_msgs::JointTrajectoryPoint> points_;
+
+  /** \brief The positions of the joints of the active trajectory when it started */
+  std::vector<double> start_positions_;
+
+  /** \brief The segment of the active trajectory the joints are in; only moves forward */
+  std::size_t segment_;
+
+  double time_;
+  double start_time_;
+  double delay_;
+  bool executing_;
+
+  /** \brief True while a stream is open: reaching the last point does not complete the execution */
+  bool streaming_;
+
+  /** \brief Added to the time_from_start of the points streamed, for the time the stream ran dry */
+  double stream_delay_;
+  ExecutionStatus status_;
+
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+  std::vector<double> offsets_;
+
+  mutable boost::mutex lock_;
+  boost::condition_variable execution_complete_;
+};
+
+typedef boost::shared_ptr<SimulatedControllerHandle> SimulatedControllerHandlePtr;
+typedef boost::shared_ptr<const SimulatedControllerHandle> SimulatedControllerHandleConstPtr;
+
+}
+
+#endif
@@ -0,0 +1,369 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/controller_manager/simulated_controller_handle.h>
+#include <console_bridge/console.h>
+#include <boost/thread/locks.hpp>
+#include <algorithm>
+
+namespace moveit_controller_manager
+{
+
+SimulatedControllerHandle::SimulatedControllerHandle(const std::string &name, const std::vector<std::string> &joints)
+  : MoveItControllerHandle(name)
+  , joints_(joints)
+  , segment_(0)
+  , time_(0.0)
+  , start_time_(0.0)
+  , delay_(0.0)
+  , executing_(false)
+  , streaming_(false)
+  , stream_delay_(0.0)
+  , positions_(joints.size(), 0.0)
+  , velocities_(joints.size(), 0.0)
+  , offsets_(joints.size(), 0.0)
+{
+}
+
+SimulatedControllerHandle::~SimulatedControllerHandle()
+{
+}
+
+bool SimulatedControllerHandle::mapJoints(const std::vector<std::string> &names, std::vector<std::size_t> &joint_map) const
+{
+  joint_map.resize(names.size());
+  for (std::size_t j = 0 ; j < names.size() ; ++j)
+  {
+    joint_map[j] = std::find(joints_.begin(), joints_.end(), names[j]) - joints_.begin();
+    if (joint_map[j] == joints_.size())
+    {
+      logError("Simulated controller '%s' does not control joint '%s'", name_.c_str(), names[j].c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+void SimulatedControllerHandle::startExecution(std::vector<std::size_t> &joint_map,
+                                               const std::vector<trajectory_msgs::JointTrajectoryPoint> &points)
+{
+  joint_map_.swap(joint_map);
+  points_ = points;
+  start_positions_.resize(joint_map_.size());
+  for (std::size_t j = 0 ; j < joint_map_.size() ; ++j)
+    start_positions_[j] = positions_[joint_map_[j]];
+  segment_ = 0;
+  stream_delay_ = 0.0;
+  start_time_ = time_;
+  executing_ = true;
+  status_ = ExecutionStatus::RUNNING;
+  updateJointStates();
+  execution_complete_.notify_all();
+}
+
+bool SimulatedControllerHandle::sendTrajectory(const moveit_msgs::RobotTrajectory &trajectory)
+{
+  if (!trajectory.multi_dof_joint_trajectory.points.empty())
+  {
+    logError("Simulated controller '%s' does not support multi-DOF trajectories", name_.c_str());
+    return false;
+  }
+  std::vector<std::size_t> joint_map;
+  if (!mapJoints(trajectory.joint_trajectory.joint_names, joint_map))
+    return false;
+
+  boost::mutex::scoped_lock slock(lock_);
+  streaming_ = false;
+  startExecution(joint_map, trajectory.joint_trajectory.points);
+  return true;
+}
+
+bool SimulatedControllerHandle::openStream(const std::vector<std::string> &joints)
+{
+  std::vector<std::size_t> joint_map;
+  if (!mapJoints(joints, joint_map))
+    return false;
+
+  boost::mutex::scoped_lock slock(lock_);
+  streaming_ = true;
+  startExecution(joint_map, std::vector<trajectory_msgs::JointTrajectoryPoint>());
+  return true;
+}
+
+bool SimulatedControllerHandle::checkStreamSegment(const trajectory_msgs::JointTrajectory &segment) const
+{
+  if (!streaming_ || !executing_)
+  {
+    logError("Simulated controller '%s' has no open stream", name_.c_str());
+    return false;
+  }
+  if (segment.joint_names.size() != joint_map_.size())
+  {
+    logError("Segment streamed to simulated controller '%s' is not for the joints of the stream", name_.c_str());
+    return false;
+  }
+  for (std::size_t j = 0 ; j < joint_map_.size() ; ++j)
+    if (segment.joint_names[j] != joints_[joint_map_[j]])
+    {
+      logError("Segment streamed to simulated controller '%s' is not for the joints of the stream", name_.c_str());
+      return false;
+    }
+  for (std::size_t i = 0 ; i < segment.points.size() ; ++i)
+    if (segment.points[i].positions.size() != joint_map_.size() ||
+        (i > 0 && segment.points[i].time_from_start <= segment.points[i - 1].time_from_start))
+    {
+      logError("Segment streamed to simulated controller '%s' has invalid points", name_.c_str());
+      return false;
+    }
+  return true;
+}
+
+double SimulatedControllerHandle::holdStream()
+{
+  const double t = time_ - start_time_ - delay_;
+  const double end_time = points_.empty() ? 0.0 : getPointTime(points_.size() - 1);
+  if (t <= end_time)
+    return 0.0;
+  trajectory_msgs::JointTrajectoryPoint hold;
+  hold.positions.resize(joint_map_.size());
+  for (std::size_t j = 0 ; j < joint_map_.size() ; ++j)
+    hold.positions[j] = positions_[joint_map_[j]];
+  hold.time_from_start = ros::Duration(t);
+  points_.push_back(hold);
+  return t - end_time;
+}
+
+bool SimulatedControllerHandle::appendToStream(const trajectory_msgs::JointTrajectory &segment)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (!checkStreamSegment(segment))
+    return false;
+  if (segment.points.empty())
+    return true;
+  if (!points_.empty() && segment.points.front().time_from_start.toSec() + stream_delay_ <= getPointTime(points_.size() - 1))
+  {
+    logError("Segment streamed to simulated controller '%s' starts before the end of the stream", name_.c_str());
+    return false;
+  }
+
+  // if the stream ran dry, the segment starts from where the joints are now instead of jumping ahead
+  updateJointStates();
+  stream_delay_ += holdStream();
+  const std::size_t first = points_.size();
+  points_.insert(points_.end(), segment.points.begin(), segment.points.end());
+  for (std::size_t i = first ; i < points_.size() ; ++i)
+    points_[i].time_from_start += ros::Duration(stream_delay_);
+  updateJointStates();
+  return true;
+}
+
+bool SimulatedControllerHandle::spliceStream(const trajectory_msgs::JointTrajectory &suffix)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (!checkStreamSegment(suffix))
+    return false;
+  if (suffix.points.empty())
+    return true;
+
+  // the points the joints are moving towards may be replaced, but not the ones already reached
+  updateJointStates();
+  const double splice_time = suffix.points.front().time_from_start.toSec() + stream_delay_;
+  if (splice_time <= time_ - start_time_ - delay_)
+  {
+    logError("Simulated controller '%s' cannot splice the stream at time %lf, which has already passed", name_.c_str(), splice_time);
+    return false;
+  }
+  std::size_t keep = segment_;
+  while (keep < points_.size() && getPointTime(keep) < splice_time)
+    ++keep;
+  points_.erase(points_.begin() + keep, points_.end());
+
+  // if the point the joints were moving towards was removed (or the stream ran dry), they move to the suffix from where they are now
+  holdStream();
+  const std::size_t first = points_.size();
+  points_.insert(points_.end(), suffix.points.begin(), suffix.points.end());
+  for (std::size_t i = first ; i < points_.size() ; ++i)
+    points_[i].time_from_start += ros::Duration(stream_delay_);
+  updateJointStates();
+  return true;
+}
+
+bool SimulatedControllerHandle::closeStream()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (!streaming_)
+    return false;
+  streaming_ = false;
+  updateJointStates();
+  return true;
+}
+
+bool SimulatedControllerHandle::cancelExecution()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  streaming_ = false;
+  if (executing_)
+  {
+    executing_ = false;
+    status_ = ExecutionStatus::PREEMPTED;
+    std::fill(velocities_.begin(), velocities_.end(), 0.0);
+    execution_complete_.notify_all();
+  }
+  return true;
+}
+
+bool SimulatedControllerHandle::waitForExecution(const ros::Duration &timeout)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (timeout.toSec() <= 0.0)
+  {
+    while (executing_)
+      execution_complete_.wait(slock);
+    return true;
+  }
+  const boost::system_time deadline = boost::get_system_time() + boost::posix_time::microseconds((boost::int64_t)(timeout.toSec() * 1e6));
+  while (executing_)
+    if (!execution_complete_.timed_wait(slock, deadline))
+      break;
+  return !executing_;
+}
+
+ExecutionStatus SimulatedControllerHandle::getLastExecutionStatus()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return status_;
+}
+
+void SimulatedControllerHandle::advance(double dt)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  if (dt > 0.0)
+    time_ += dt;
+  updateJointStates();
+}
+
+double SimulatedControllerHandle::getTime() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return time_;
+}
+
+double SimulatedControllerHandle::getTimeFromStart() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return time_ - start_time_;
+}
+
+void SimulatedControllerHandle::setTrackingDelay(double delay)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  delay_ = std::max(0.0, delay);
+}
+
+void SimulatedControllerHandle::setPositionOffsets(const std::vector<double> &offsets)
+{
+  if (offsets.size() != joints_.size())
+  {
+    logError("Simulated controller '%s' expects %u position offsets", name_.c_str(), (unsigned int)joints_.size());
+    return;
+  }
+  boost::mutex::scoped_lock slock(lock_);
+  offsets_ = offsets;
+}
+
+void SimulatedControllerHandle::setJointPositions(const std::vector<double> &positions)
+{
+  if (positions.size() != joints_.size())
+  {
+    logError("Simulated controller '%s' expects %u joint positions", name_.c_str(), (unsigned int)joints_.size());
+    return;
+  }
+  boost::mutex::scoped_lock slock(lock_);
+  if (!executing_)
+    positions_ = positions;
+}
+
+void SimulatedControllerHandle::getJointPositions(std::vector<double> &positions) const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  positions.resize(joints_.size());
+  for (std::size_t j = 0 ; j < joints_.size() ; ++j)
+    positions[j] = positions_[j] + offsets_[j];
+}
+
+void SimulatedControllerHandle::getJointVelocities(std::vector<double> &velocities) const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  velocities = velocities_;
+}
+
+void SimulatedControllerHandle::updateJointStates()
+{
+  if (!executing_)
+    return;
+
+  // the time the joints are at along the trajectory
+  const double t = time_ - start_time_ - delay_;
+  while (segment_ < points_.size() && getPointTime(segment_) <= t)
+    ++segment_;
+
+  if (segment_ == points_.size())
+  {
+    if (!points_.empty())
+      for (std::size_t j = 0 ; j < joint_map_.size() ; ++j)
+        positions_[joint_map_[j]] = points_.back().positions[j];
+    std::fill(velocities_.begin(), velocities_.end(), 0.0);
+    // an open stream holds the last position until more points are appended
+    if (streaming_)
+      return;
+    executing_ = false;
+    status_ = ExecutionStatus::SUCCEEDED;
+    execution_complete_.notify_all();
+    return;
+  }
+
+  // interpolate linearly from the previous point (or the start positions) to the next one
+  const std::vector<double> &next = points_[segment_].positions;
+  const std::vector<double> &previous = segment_ > 0 ? points_[segment_ - 1].positions : start_positions_;
+  const double previous_time = segment_ > 0 ? getPointTime(segment_ - 1) : 0.0;
+  const double dt = getPointTime(segment_) - previous_time;
+  const double alpha = dt > 0.0 ? std::max(0.0, t - previous_time) / dt : 1.0;
+  for (std::size_t j = 0 ; j < joint_map_.size() ; ++j)
+  {
+    positions_[joint_map_[j]] = previous[j] + alpha * (next[j] - previous[j]);
+    velocities_[joint_map_[j]] = t >= 0.0 && dt > 0.0 ? (next[j] - previous[j]) / dt : 0.0;
+  }
+}
+
+}
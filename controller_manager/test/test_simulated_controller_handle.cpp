@@ -0,0 +1,198 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/controller_manager/simulated_controller_handle.h>
+#include <gtest/gtest.h>
+
+using moveit_controller_manager::ExecutionStatus;
+using moveit_controller_manager::SimulatedControllerHandle;
+
+class SimulatedControllerHandleTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    joints_.push_back("joint1");
+    handle_.reset(new SimulatedControllerHandle("controller", joints_));
+  }
+
+  // a segment for the single joint, with points at \e times and \e positions; times are stored with a resolution
+  // of 1ns, so positions are only checked to 1e-6
+  trajectory_msgs::JointTrajectory makeSegment(const double *times, const double *positions, std::size_t count) const
+  {
+    trajectory_msgs::JointTrajectory segment;
+    segment.joint_names = joints_;
+    segment.points.resize(count);
+    for (std::size_t i = 0 ; i < count ; ++i)
+    {
+      segment.points[i].positions.push_back(positions[i]);
+      segment.points[i].time_from_start = ros::Duration(times[i]);
+    }
+    return segment;
+  }
+
+  double getPosition() const
+  {
+    std::vector<double> positions;
+    handle_->getJointPositions(positions);
+    return positions[0];
+  }
+
+  double getVelocity() const
+  {
+    std::vector<double> velocities;
+    handle_->getJointVelocities(velocities);
+    return velocities[0];
+  }
+
+  ExecutionStatus::Value getStatus() const
+  {
+    return handle_->getLastExecutionStatus();
+  }
+
+  std::vector<std::string> joints_;
+  moveit_controller_manager::SimulatedControllerHandlePtr handle_;
+};
+
+TEST_F(SimulatedControllerHandleTest, AppendAfterStreamRanDry)
+{
+  ASSERT_TRUE(handle_->openStream(joints_));
+
+  // the first segment arrives 0.5s after the stream is opened: the joint starts moving when it is appended,
+  // from the start position, and reaches the first point 0.2s later
+  handle_->advance(0.5);
+  const double t1[] = { 0.2, 1.0 }, q1[] = { 0.4, 2.0 };
+  ASSERT_TRUE(handle_->appendToStream(makeSegment(t1, q1, 2)));
+  EXPECT_NEAR(0.0, getPosition(), 1e-6);
+  handle_->advance(0.1);
+  EXPECT_NEAR(0.2, getPosition(), 1e-6);
+  EXPECT_NEAR(2.0, getVelocity(), 1e-6);
+  handle_->advance(0.1);
+  EXPECT_NEAR(0.4, getPosition(), 1e-6);
+
+  // the end of the stream is reached (at 1.5s) and the joint holds its position
+  handle_->advance(1.0);
+  EXPECT_NEAR(2.0, getPosition(), 1e-6);
+  EXPECT_NEAR(0.0, getVelocity(), 1e-6);
+  EXPECT_EQ(ExecutionStatus::RUNNING, getStatus());
+
+  // the next segment is appended at 2s: it starts from the held position instead of from the last point at 1.5s,
+  // so all the following points are delayed by another 0.5s
+  handle_->advance(0.3);
+  const double t2[] = { 1.5 }, q2[] = { 3.0 };
+  ASSERT_TRUE(handle_->appendToStream(makeSegment(t2, q2, 1)));
+  EXPECT_NEAR(2.0, getPosition(), 1e-6);
+  handle_->advance(0.25);
+  EXPECT_NEAR(2.5, getPosition(), 1e-6);
+  EXPECT_NEAR(2.0, getVelocity(), 1e-6);
+
+  // segments appended before the stream runs dry follow on without a pause
+  const double t3[] = { 2.0 }, q3[] = { 4.0 };
+  ASSERT_TRUE(handle_->appendToStream(makeSegment(t3, q3, 1)));
+  handle_->advance(0.5);
+  EXPECT_NEAR(3.5, getPosition(), 1e-6);
+
+  // points still have to come after the end of the stream, in the time of the caller
+  const double t4[] = { 1.9 }, q4[] = { 5.0 };
+  EXPECT_FALSE(handle_->appendToStream(makeSegment(t4, q4, 1)));
+
+  ASSERT_TRUE(handle_->closeStream());
+  handle_->advance(0.5);
+  EXPECT_NEAR(4.0, getPosition(), 1e-6);
+  EXPECT_TRUE(handle_->waitForExecution(ros::Duration(1.0)));
+  EXPECT_EQ(ExecutionStatus::SUCCEEDED, getStatus());
+}
+
+TEST_F(SimulatedControllerHandleTest, SpliceStream)
+{
+  ASSERT_TRUE(handle_->openStream(joints_));
+  const double t1[] = { 1.0, 2.0, 3.0 }, q1[] = { 1.0, 2.0, 3.0 };
+  ASSERT_TRUE(handle_->appendToStream(makeSegment(t1, q1, 3)));
+  handle_->advance(1.5);
+  EXPECT_NEAR(1.5, getPosition(), 1e-6);
+
+  // a suffix that starts in the past is rejected and the stream is left as it is
+  const double t2[] = { 1.0 }, q2[] = { -1.0 };
+  EXPECT_FALSE(handle_->spliceStream(makeSegment(t2, q2, 1)));
+  handle_->advance(0.0);
+  EXPECT_NEAR(1.5, getPosition(), 1e-6);
+
+  // the points from 2.5s on are replaced; the point at 2s is kept
+  const double t3[] = { 2.5, 3.5 }, q3[] = { 0.0, -1.0 };
+  ASSERT_TRUE(handle_->spliceStream(makeSegment(t3, q3, 2)));
+  EXPECT_NEAR(1.5, getPosition(), 1e-6);
+  handle_->advance(0.5);
+  EXPECT_NEAR(2.0, getPosition(), 1e-6);
+  handle_->advance(0.25);
+  EXPECT_NEAR(1.0, getPosition(), 1e-6);
+  EXPECT_NEAR(-4.0, getVelocity(), 1e-6);
+  handle_->advance(0.5);
+  EXPECT_NEAR(-0.25, getPosition(), 1e-6);
+
+  // replacing the point the joint is moving towards makes it move to the suffix from where it is
+  const double t4[] = { 3.25 }, q4[] = { 1.0 };
+  ASSERT_TRUE(handle_->spliceStream(makeSegment(t4, q4, 1)));
+  EXPECT_NEAR(-0.25, getPosition(), 1e-6);
+  handle_->advance(0.25);
+  EXPECT_NEAR(0.375, getPosition(), 1e-6);
+  EXPECT_NEAR(2.5, getVelocity(), 1e-6);
+
+  // a suffix that starts after the end of the stream is appended
+  const double t5[] = { 4.25 }, q5[] = { 2.0 };
+  ASSERT_TRUE(handle_->spliceStream(makeSegment(t5, q5, 1)));
+  handle_->advance(0.25);
+  EXPECT_NEAR(1.0, getPosition(), 1e-6);
+  handle_->advance(0.5);
+  EXPECT_NEAR(1.5, getPosition(), 1e-6);
+
+  // suffixes for other joints are rejected
+  trajectory_msgs::JointTrajectory other = makeSegment(t5, q5, 1);
+  other.joint_names[0] = "joint2";
+  EXPECT_FALSE(handle_->spliceStream(other));
+
+  ASSERT_TRUE(handle_->closeStream());
+  handle_->advance(1.0);
+  EXPECT_NEAR(2.0, getPosition(), 1e-6);
+  EXPECT_EQ(ExecutionStatus::SUCCEEDED, getStatus());
+
+  // without an open stream, nothing can be spliced
+  EXPECT_FALSE(handle_->spliceStream(makeSegment(t5, q5, 1)));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -39,20 +39,60 @@
 
 // KDL
 #include <kdl/chain.hpp>
+#include <kdl/jntarray.hpp>
 #include <kdl/chainidsolver_recursive_newton_euler.hpp>
 
 #include <moveit/robot_state/robot_state.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
 #include <geometry_msgs/Vector3.h>
 #include <geometry_msgs/Wrench.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/function.hpp>
 
 /** \brief This namespace includes the dynamics_solver library */
 namespace dynamics_solver
 {
 
+MOVEIT_CLASS_FORWARD(DynamicsSolverWorkspace);
+
+/** \brief Scratch memory needed by a DynamicsSolver to compute
+    torques. All buffers are allocated once, by
+    DynamicsSolver::createWorkspace(). A workspace must not be shared
+    between threads that call into the solver at the same time; each
+    thread should own one. */
+struct DynamicsSolverWorkspace
+{
+  KDL::JntArray q_;
+  KDL::JntArray q_dot_;
+  KDL::JntArray q_dotdot_;
+  KDL::JntArray torques_;
+
+  /** \brief Torques needed to hold the group against gravity, used when computing payloads */
+  KDL::JntArray gravity_torques_;
+
+  /** \brief External wrenches, one for each segment of the chain. These are always zero
+      unless set by the solver while computing payload torques */
+  KDL::Wrenches wrenches_;
+
+  /** \brief External wrenches converted from the messages passed to the getTorques() overload that takes vectors */
+  KDL::Wrenches external_wrenches_;
+
+  /** \brief The KDL solver keeps internal state, so each workspace has its own instance */
+  boost::shared_ptr<KDL::ChainIdSolver_RNE> chain_id_solver_;
+
+  /** \brief State used to compute the frames needed for payload computations */
+  robot_state::RobotStatePtr state_;
+};
+
 /**
  * This solver currently computes the required torques given a
  * joint configuration, velocities, accelerations and external wrenches
- * acting on the links of a robot
+ * acting on the links of a robot.
+ *
+ * The functions that take a DynamicsSolverWorkspace argument do not
+ * allocate memory and are safe to call concurrently, as long as each
+ * thread uses its own workspace. The remaining functions share one
+ * internal workspace and are serialized by a mutex.
  */
 class DynamicsSolver
 {
@@ -119,6 +159,82 @@ public:
                          double payload,
                          std::vector<double> &joint_torques) const;
 
+  /**
+   * @brief Allocate the scratch memory needed by the reentrant versions of
+   * getTorques(), getMaxPayload() and getPayloadTorques()
+   * @return The workspace, or an empty pointer if the solver was not constructed properly
+   */
+  DynamicsSolverWorkspacePtr createWorkspace() const;
+
+  /**
+   * @brief Get the torques without allocating memory. All arrays have
+   * size = number of joints in the group, in the order of the joints in the RobotModel
+   * @param joint_angles The joint angles (desired joint configuration)
+   * @param joint_velocities The desired joint velocities
+   * @param joint_accelerations The desired joint accelerations
+   * @param wrenches External wrenches acting on the segments of the chain (size = number of links
+   * in the group); if NULL, no external wrenches are applied
+   * @param torques Computed set of torques are filled in here
+   * @param workspace Scratch memory obtained from createWorkspace(); must not be used by other threads concurrently
+   * @return False if the torques could not be computed
+   */
+  bool getTorques(const double *joint_angles,
+                  const double *joint_velocities,
+                  const double *joint_accelerations,
+                  const KDL::Wrenches *wrenches,
+                  double *torques,
+                  DynamicsSolverWorkspace &workspace) const;
+
+  /**
+   * @brief Same as getMaxPayload() above, but uses the caller-owned \e workspace instead of shared state.
+   * \e joint_angles must have size = number of joints in the group
+   */
+  bool getMaxPayload(const double *joint_angles,
+                     double &payload,
+                     unsigned int &joint_saturated,
+                     DynamicsSolverWorkspace &workspace) const;
+
+  /**
+   * @brief Same as getPayloadTorques() above, but uses the caller-owned \e workspace instead of shared state.
+   * \e joint_angles and \e joint_torques must have size = number of joints in the group
+   */
+  bool getPayloadTorques(const double *joint_angles,
+                         double payload,
+                         double *joint_torques,
+                         DynamicsSolverWorkspace &workspace) const;
+
+  /**
+   * @brief Compute the torques needed at every waypoint of a trajectory. Positions,
+   * velocities and accelerations of the group are read from each waypoint (missing velocities or
+   * accelerations are taken to be zero). Waypoints are split in \e thread_count parts,
+   * each with its own workspace.
+   * @param trajectory The trajectory to evaluate; it must include the joints of this group
+   * @param torques The torques, stored row by row: the torque for joint j at waypoint i is
+   * torques[i * number of joints + j]
+   * @param thread_count The number of parts the work is split into; the parts are executed by the shared
+   * moveit::tools::TaskScheduler. 0 means one per worker of the scheduler
+   * @return False if any of the torques could not be computed
+   */
+  bool getTrajectoryTorques(const robot_trajectory::RobotTrajectory &trajectory,
+                            std::vector<double> &torques,
+                            unsigned int thread_count = 0) const;
+
+  /**
+   * @brief Compute the maximum payload for a batch of configurations (see getMaxPayload()).
+   * Configurations are split in \e thread_count parts, each with its own workspace.
+   * @param joint_angles The configurations, stored one after the other (size = number of configurations
+   * times number of joints in the group)
+   * @param payloads The computed maximum payload for each configuration (in kg)
+   * @param joints_saturated The first saturated joint for each configuration
+   * @param thread_count The number of parts the work is split into; the parts are executed by the shared
+   * moveit::tools::TaskScheduler. 0 means one per worker of the scheduler
+   * @return False if the input is of the wrong size or if any of the payloads could not be computed
+   */
+  bool getMaxPayloads(const std::vector<double> &joint_angles,
+                      std::vector<double> &payloads,
+                      std::vector<unsigned int> &joints_saturated,
+                      unsigned int thread_count = 0) const;
+
   /**
    * @brief Get maximum torques for this group
    * @return Vector of max torques
@@ -141,13 +257,37 @@ public:
   
 private:
 
-  boost::shared_ptr<KDL::ChainIdSolver_RNE> chain_id_solver_; // KDL chain inverse dynamics
+  /** \brief Run the inverse dynamics for the values already stored in \e workspace; the result is in workspace.torques_ */
+  bool solve(DynamicsSolverWorkspace &workspace, const KDL::Wrenches &wrenches) const;
+
+  bool checkWorkspace(const DynamicsSolverWorkspace &workspace) const;
+
+  /** \brief Set the last wrench in \e workspace to the weight of a payload: a force of magnitude \e force along the gravity
+      vector (the -z axis of the base frame if there is no gravity), expressed in the tip frame */
+  void setPayloadWrench(const double *joint_angles, double force, DynamicsSolverWorkspace &workspace) const;
+
+  /** \brief Call \e range_function on ranges [begin, end) that split [0, \e count) into \e thread_count parts, executed by the
+      shared moveit::tools::TaskScheduler.
+      Return true if all calls reported success */
+  bool runInParallel(std::size_t count, unsigned int thread_count,
+                     const boost::function<void(std::size_t, std::size_t, bool*)> &range_function) const;
+
+  /** \brief Compute the payloads for configurations [begin, end) using a workspace local to this call */
+  void computeMaxPayloads(const double *joint_angles, std::size_t begin, std::size_t end,
+                          double *payloads, unsigned int *joints_saturated, bool *success) const;
+
+  /** \brief Compute the torques for waypoints [begin, end) of \e trajectory using a workspace local to this call */
+  void computeTrajectoryTorques(const robot_trajectory::RobotTrajectory *trajectory,
+                                std::size_t begin, std::size_t end, double *torques, bool *success) const;
+
   KDL::Chain kdl_chain_; // KDL chain
+  KDL::Vector gravity_vector_; // gravity vector passed to the KDL solvers
 
   robot_model::RobotModelConstPtr robot_model_; 
   const robot_model::JointModelGroup* joint_model_group_; 
-  
-  robot_state::RobotStatePtr state_; //robot state
+
+  DynamicsSolverWorkspacePtr workspace_; // workspace used by the functions that do not take one as argument
+  mutable boost::mutex workspace_lock_; // serializes access to workspace_
 
   std::string base_name_, tip_name_; // base name, tip name
   unsigned int num_joints_, num_segments_; // number of joints in group, number of segments in group
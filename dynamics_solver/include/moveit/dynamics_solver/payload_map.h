@@ -0,0 +1,152 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_DYNAMICS_SOLVER_PAYLOAD_MAP_
+#define MOVEIT_DYNAMICS_SOLVER_PAYLOAD_MAP_
+
+#include <moveit/dynamics_solver/dynamics_solver.h>
+#include <boost/unordered_map.hpp>
+#include <boost/cstdint.hpp>
+
+namespace dynamics_solver
+{
+
+/**
+ * A cache of maximum payload values over the joint space of a group.
+ * The joint space (within the position bounds of the group variables)
+ * is split into cells of fixed size. The maximum payload of a cell is
+ * the one computed at its center, along with an estimate of how much
+ * the payload varies within the cell: the sum, over all joints, of the
+ * largest change in payload when moving from the center to either edge
+ * of the cell along that joint. All samples are taken within the joint
+ * bounds. This is an estimate, not a bound: the payload is not smooth
+ * where the saturated joint changes, so it can vary more than estimated
+ * inside a cell. Cells are computed the first time they are queried, or
+ * in batch by precompute(). Lookups are constant time.
+ */
+class PayloadMap
+{
+public:
+
+  /**
+   * @brief Construct a map with cells of the same size (\e resolution, in radians or meters) along all joints
+   * @param solver The solver used to compute payloads
+   * @param resolution The size of a cell along each joint
+   */
+  PayloadMap(const DynamicsSolverConstPtr &solver, double resolution);
+
+  /**
+   * @brief Construct a map with cells of the specified size along each joint (the order of joints in the group)
+   */
+  PayloadMap(const DynamicsSolverConstPtr &solver, const std::vector<double> &resolutions);
+
+  /** \brief Return false if the map could not be constructed (e.g., the grid has too many cells to be indexed) */
+  bool isValid() const
+  {
+    return valid_;
+  }
+
+  /**
+   * @brief Get the approximate maximum payload (in kg) at a configuration, computing the containing cell if needed.
+   * Configurations outside the joint bounds are mapped to the closest cell.
+   * @param joint_angles The configuration; size = number of joints in the group
+   * @param payload The maximum payload of the containing cell
+   * @param error_estimate The estimated maximum difference between \e payload and the payload anywhere in the cell (see the class description)
+   * @return False if the payload could not be computed
+   */
+  bool getMaxPayload(const double *joint_angles, double &payload, double &error_estimate);
+
+  /** \brief Same as above, for joint angles specified as a vector */
+  bool getMaxPayload(const std::vector<double> &joint_angles, double &payload, double &error_estimate);
+
+  /** \brief Same as getMaxPayload(), but only look at cells already computed. Return false if the containing cell is not known */
+  bool findMaxPayload(const double *joint_angles, double &payload, double &error_estimate) const;
+
+  /**
+   * @brief Compute the cells that contain a batch of configurations and are not yet known, in parallel.
+   * @param joint_angles The configurations, stored one after the other
+   * @param thread_count The number of threads to use; 0 means one per hardware thread
+   * @return False if any of the payloads could not be computed
+   */
+  bool precompute(const std::vector<double> &joint_angles, unsigned int thread_count = 0);
+
+  /** \brief Get the number of cells computed so far */
+  std::size_t getCellCount() const;
+
+  /** \brief Forget all computed cells */
+  void clear();
+
+  const DynamicsSolverConstPtr& getDynamicsSolver() const
+  {
+    return solver_;
+  }
+
+private:
+
+  struct Cell
+  {
+    double payload_;
+    double error_estimate_;
+  };
+
+  typedef boost::unordered_map<boost::uint64_t, Cell> CellMap;
+
+  void initialize(const std::vector<double> &resolutions);
+
+  boost::uint64_t getCellKey(const double *joint_angles) const;
+
+  /** \brief Compute the cells for \e keys. The payload is evaluated at the center of each cell and
+      at the two edges of the cell along each joint, clamped to the joint bounds */
+  bool computeCells(const std::vector<boost::uint64_t> &keys, unsigned int thread_count);
+
+  DynamicsSolverConstPtr solver_;
+  bool valid_;
+  unsigned int joint_count_;
+
+  std::vector<double> lower_bounds_;
+  std::vector<double> upper_bounds_;
+  std::vector<double> resolutions_;
+  std::vector<boost::uint64_t> cell_counts_;
+
+  /** \brief Multiplier for the index along each joint when computing the key of a cell */
+  std::vector<boost::uint64_t> strides_;
+
+  CellMap cells_;
+  mutable boost::mutex cells_lock_;
+};
+
+MOVEIT_CLASS_FORWARD(PayloadMap);
+
+}
+#endif
@@ -0,0 +1,229 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_DYNAMICS_SOLVER_TREE_DYNAMICS_SOLVER_
+#define MOVEIT_DYNAMICS_SOLVER_TREE_DYNAMICS_SOLVER_
+
+#include <moveit/robot_state/robot_state.h>
+#include <geometry_msgs/Vector3.h>
+#include <Eigen/Core>
+#include <map>
+
+namespace dynamics_solver
+{
+
+MOVEIT_CLASS_FORWARD(TreeDynamicsSolverWorkspace);
+
+/** \brief Scratch memory used by TreeDynamicsSolver. It is allocated
+    once, by TreeDynamicsSolver::createWorkspace(), and must not be used
+    by more than one thread at a time. All spatial quantities are
+    expressed in the model frame, with angular components first. */
+struct TreeDynamicsSolverWorkspace
+{
+  /** \brief Mass of each body (link plus payloads attached to it) */
+  Eigen::VectorXd mass_;
+
+  /** \brief First moment of mass (mass times center of mass) of each body, one column per body */
+  Eigen::Matrix<double, 3, Eigen::Dynamic> first_moment_;
+
+  /** \brief Rotational inertia of each body about the model frame origin, one 3x3 block per body */
+  Eigen::Matrix<double, 3, Eigen::Dynamic> rotational_inertia_;
+
+  /** \brief Motion subspace of each moving joint, one column per joint */
+  Eigen::Matrix<double, 6, Eigen::Dynamic> motion_;
+
+  /** \brief Spatial velocity, acceleration and force of each body, one column per body */
+  Eigen::Matrix<double, 6, Eigen::Dynamic> velocity_;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> acceleration_;
+  Eigen::Matrix<double, 6, Eigen::Dynamic> force_;
+
+  /** \brief Composite spatial inertia of each subtree, one 6x6 block per body */
+  Eigen::Matrix<double, 6, Eigen::Dynamic> composite_inertia_;
+
+  /** \brief Attached bodies of the state being evaluated */
+  std::vector<const robot_state::AttachedBody*> attached_bodies_;
+};
+
+/**
+ * Inverse dynamics (recursive Newton-Euler) and joint space inertia
+ * matrix (composite rigid body algorithm) computed directly on the
+ * RobotModel. Unlike DynamicsSolver, the group does not need to be a
+ * chain: every link that descends from the group is included, joints
+ * that are not part of the group are considered rigid at their value
+ * in the state, and bodies attached to the state can carry mass.
+ * Link transforms are taken from the RobotState passed in, so no
+ * forward kinematics is computed here.
+ *
+ * Inertial properties are read from the URDF. Only revolute and
+ * prismatic joints are supported in the group; mimic joints are
+ * driven by the joint they mimic and their effort is accounted to it.
+ */
+class TreeDynamicsSolver
+{
+public:
+
+  /**
+   * @brief Initialize the dynamics solver
+   * @param robot_model The kinematic model of the robot
+   * @param group_name The name of the group to compute dynamics for
+   * @param gravity_vector The gravitational acceleration, in the model frame
+   */
+  TreeDynamicsSolver(const robot_model::RobotModelConstPtr &robot_model,
+                     const std::string &group_name,
+                     const geometry_msgs::Vector3 &gravity_vector);
+
+  /** \brief Return false if the solver could not be initialized for the requested group */
+  bool isValid() const
+  {
+    return joint_model_group_ != NULL;
+  }
+
+  /** \brief Allocate the scratch memory needed by the solver */
+  TreeDynamicsSolverWorkspacePtr createWorkspace() const;
+
+  /** \brief Set the mass of the attached body \e id. The mass is assumed to be located at the mean of the
+      origins of the shapes that make up the body. Attached bodies without a specified mass are ignored */
+  void setAttachedBodyMass(const std::string &id, double mass);
+
+  /** \brief Forget the mass of the attached body \e id */
+  void clearAttachedBodyMass(const std::string &id);
+
+  /**
+   * @brief Compute the joint torques (or forces) needed to obtain the specified accelerations.
+   * @param state The state of the robot; its link transforms need to be up to date (see RobotState::updateLinkTransforms())
+   * @param joint_velocities The velocities of the group variables, in group order; if NULL, zero velocities are used
+   * @param joint_accelerations The accelerations of the group variables, in group order; if NULL, zero accelerations are used
+   * @param torques The computed torques, one per group variable (the entries corresponding to mimic joints are set to 0)
+   * @param workspace Scratch memory obtained from createWorkspace()
+   * @return False if the solver is not valid
+   */
+  bool getTorques(const robot_state::RobotState &state,
+                  const double *joint_velocities,
+                  const double *joint_accelerations,
+                  double *torques,
+                  TreeDynamicsSolverWorkspace &workspace) const;
+
+  /**
+   * @brief Compute the joint space inertia matrix for the group variables.
+   * @param state The state of the robot; its link transforms need to be up to date
+   * @param mass_matrix The computed (symmetric) matrix, of size number of group variables squared
+   * @param workspace Scratch memory obtained from createWorkspace()
+   * @return False if the solver is not valid
+   */
+  bool getMassMatrix(const robot_state::RobotState &state,
+                     Eigen::MatrixXd &mass_matrix,
+                     TreeDynamicsSolverWorkspace &workspace) const;
+
+  /**
+   * @brief Get the effort limits for the group variables, as specified in the URDF
+   */
+  const std::vector<double>& getMaxTorques() const
+  {
+    return max_torques_;
+  }
+
+  const robot_model::RobotModelConstPtr& getRobotModel() const
+  {
+    return robot_model_;
+  }
+
+  const robot_model::JointModelGroup* getGroup() const
+  {
+    return joint_model_group_;
+  }
+
+private:
+
+  /** \brief A link that moves when the group moves */
+  struct Body
+  {
+    const robot_model::LinkModel *link_;
+
+    /** \brief Index of the parent body; -1 if the parent link does not move with the group */
+    int parent_;
+
+    /** \brief Index of the joint connecting this body to its parent; -1 if that joint is rigid */
+    int joint_;
+
+    double mass_;
+
+    /** \brief Center of mass, in the link frame */
+    Eigen::Vector3d center_of_mass_;
+
+    /** \brief Rotational inertia about the center of mass, in the link frame */
+    Eigen::Matrix3d inertia_;
+  };
+
+  /** \brief A joint of the group that moves a body */
+  struct Joint
+  {
+    const robot_model::JointModel *joint_model_;
+    int body_;
+    bool revolute_;
+
+    /** \brief The axis of the joint, in the frame of the child link */
+    Eigen::Vector3d axis_;
+
+    /** \brief Index of the group variable that drives this joint */
+    int variable_;
+
+    /** \brief Factor applied to the driving variable (different from 1 for mimic joints) */
+    double factor_;
+  };
+
+  /** \brief Fill in the inertias of the bodies and the motion subspaces of the joints, in the model frame */
+  void computeWorldQuantities(const robot_state::RobotState &state, TreeDynamicsSolverWorkspace &workspace) const;
+
+  bool checkWorkspace(const TreeDynamicsSolverWorkspace &workspace) const;
+
+  robot_model::RobotModelConstPtr robot_model_;
+  const robot_model::JointModelGroup* joint_model_group_;
+
+  /** \brief Bodies in topological order (parents before children) */
+  std::vector<Body> bodies_;
+  std::vector<Joint> joints_;
+
+  /** \brief For each link in the model (by link index), the index of its body or -1 */
+  std::vector<int> link_to_body_;
+
+  std::map<std::string, double> attached_body_masses_;
+
+  std::vector<double> max_torques_;
+  Eigen::Vector3d gravity_;
+};
+
+MOVEIT_CLASS_FORWARD(TreeDynamicsSolver);
+
+}
+#endif
@@ -45,26 +45,11 @@
 #include <kdl/chainjnttojacsolver.hpp>
 #include <kdl/tree.hpp>
 
-namespace dynamics_solver
-{
+#include <moveit/background_processing/task_scheduler.h>
+#include <boost/scoped_array.hpp>
 
-namespace
-{
-inline geometry_msgs::Vector3 transformVector(const Eigen::Affine3d &transform,
-                                              const geometry_msgs::Vector3 &vector)
+namespace dynamics_solver
 {
-  Eigen::Vector3d p;
-  p = Eigen::Vector3d(vector.x, vector.y, vector.z);
-  p = transform.rotation()*p;
-
-  geometry_msgs::Vector3 result;
-  result.x = p.x();
-  result.y = p.y();
-  result.z = p.z();
-
-  return result;
-}
-}
 
 DynamicsSolver::DynamicsSolver(const robot_model::RobotModelConstPtr &robot_model,
                                const std::string &group_name,
@@ -121,9 +106,6 @@ DynamicsSolver::DynamicsSolver(const robot_model::RobotModelConstPtr &robot_mode
   num_joints_ = kdl_chain_.getNrOfJoints();
   num_segments_ = kdl_chain_.getNrOfSegments();
 
-  state_.reset(new robot_state::RobotState(robot_model_));
-  state_->setToDefaultValues();
-  
   const std::vector<std::string> &joint_model_names = joint_model_group_->getJointModelNames();
   for (std::size_t i = 0; i < joint_model_names.size(); ++i)
   {
@@ -134,11 +116,59 @@ DynamicsSolver::DynamicsSolver(const robot_model::RobotModelConstPtr &robot_mode
       max_torques_.push_back(0.0);
   }
 
-  KDL::Vector gravity(gravity_vector.x, gravity_vector.y, gravity_vector.z); // \todo Not sure if KDL expects the negative of this (Sachin)
-  gravity_ = gravity.Norm();
+  gravity_vector_ = KDL::Vector(gravity_vector.x, gravity_vector.y, gravity_vector.z); // \todo Not sure if KDL expects the negative of this (Sachin)
+  gravity_ = gravity_vector_.Norm();
   logDebug("moveit.dynamics_solver: Gravity norm set to %f", gravity_);
-  
-  chain_id_solver_.reset(new KDL::ChainIdSolver_RNE(kdl_chain_, gravity));
+
+  workspace_ = createWorkspace();
+}
+
+DynamicsSolverWorkspacePtr DynamicsSolver::createWorkspace() const
+{
+  DynamicsSolverWorkspacePtr workspace;
+  if (!joint_model_group_)
+  {
+    logDebug("moveit.dynamics_solver: Did not construct DynamicsSolver object properly. Check error logs.");
+    return workspace;
+  }
+
+  workspace.reset(new DynamicsSolverWorkspace());
+  workspace->q_.resize(num_joints_);
+  workspace->q_dot_.resize(num_joints_);
+  workspace->q_dotdot_.resize(num_joints_);
+  workspace->torques_.resize(num_joints_);
+  workspace->gravity_torques_.resize(num_joints_);
+  workspace->wrenches_.resize(num_segments_, KDL::Wrench::Zero());
+  workspace->external_wrenches_.resize(num_segments_, KDL::Wrench::Zero());
+  workspace->chain_id_solver_.reset(new KDL::ChainIdSolver_RNE(kdl_chain_, gravity_vector_));
+  workspace->state_.reset(new robot_state::RobotState(robot_model_));
+  workspace->state_->setToDefaultValues();
+  return workspace;
+}
+
+bool DynamicsSolver::solve(DynamicsSolverWorkspace &workspace, const KDL::Wrenches &wrenches) const
+{
+  if (workspace.chain_id_solver_->CartToJnt(workspace.q_, workspace.q_dot_, workspace.q_dotdot_, wrenches, workspace.torques_) < 0)
+  {
+    logError("moveit.dynamics_solver: Something went wrong computing torques");
+    return false;
+  }
+  return true;
+}
+
+bool DynamicsSolver::checkWorkspace(const DynamicsSolverWorkspace &workspace) const
+{
+  if (!joint_model_group_)
+  {
+    logDebug("moveit.dynamics_solver: Did not construct DynamicsSolver object properly. Check error logs.");
+    return false;
+  }
+  if (workspace.q_.rows() != num_joints_ || workspace.wrenches_.size() != num_segments_ || !workspace.chain_id_solver_)
+  {
+    logError("moveit.dynamics_solver: Workspace was not created by this solver");
+    return false;
+  }
+  return true;
 }
 
 bool DynamicsSolver::getTorques(const std::vector<double> &joint_angles,
@@ -178,16 +208,8 @@ bool DynamicsSolver::getTorques(const std::vector<double> &joint_angles,
     return false;
   }
 
-  KDL::JntArray kdl_angles(num_joints_), kdl_velocities(num_joints_), kdl_accelerations(num_joints_), kdl_torques(num_joints_);
-  KDL::Wrenches kdl_wrenches(num_segments_);
-
-  for (unsigned int i = 0; i < num_joints_; ++i)
-  {
-    kdl_angles(i) = joint_angles[i];
-    kdl_velocities(i) = joint_velocities[i];
-    kdl_accelerations(i) = joint_accelerations[i];
-  }
-
+  boost::mutex::scoped_lock slock(workspace_lock_);
+  KDL::Wrenches &kdl_wrenches = workspace_->external_wrenches_;
   for (unsigned int i = 0; i < num_segments_; ++i)
   {
     kdl_wrenches[i](0) = wrenches[i].force.x;
@@ -199,14 +221,31 @@ bool DynamicsSolver::getTorques(const std::vector<double> &joint_angles,
     kdl_wrenches[i](5) = wrenches[i].torque.z;
   }
 
-  if (chain_id_solver_->CartToJnt(kdl_angles, kdl_velocities, kdl_accelerations, kdl_wrenches, kdl_torques) < 0)
-  {
-    logError("moveit.dynamics_solver: Something went wrong computing torques");
+  return getTorques(&joint_angles[0], &joint_velocities[0], &joint_accelerations[0], &kdl_wrenches, &torques[0], *workspace_);
+}
+
+bool DynamicsSolver::getTorques(const double *joint_angles,
+                                const double *joint_velocities,
+                                const double *joint_accelerations,
+                                const KDL::Wrenches *wrenches,
+                                double *torques,
+                                DynamicsSolverWorkspace &workspace) const
+{
+  if (!checkWorkspace(workspace))
     return false;
+
+  for (unsigned int i = 0; i < num_joints_; ++i)
+  {
+    workspace.q_(i) = joint_angles[i];
+    workspace.q_dot_(i) = joint_velocities[i];
+    workspace.q_dotdot_(i) = joint_accelerations[i];
   }
 
+  if (!solve(workspace, wrenches ? *wrenches : workspace.wrenches_))
+    return false;
+
   for (unsigned int i = 0; i < num_joints_; ++i)
-    torques[i] = kdl_torques(i);
+    torques[i] = workspace.torques_(i);
 
   return true;
 }
@@ -225,16 +264,31 @@ bool DynamicsSolver::getMaxPayload(const std::vector<double> &joint_angles,
     logError("moveit.dynamics_solver: Joint angles vector should be size %d", num_joints_);
     return false;
   }
-  std::vector<double> joint_velocities(num_joints_, 0.0), joint_accelerations(num_joints_, 0.0);
-  std::vector<double> torques(num_joints_, 0.0), zero_torques(num_joints_, 0.0);
 
-  std::vector<geometry_msgs::Wrench> wrenches(num_segments_);
-  if (!getTorques(joint_angles, joint_velocities, joint_accelerations, wrenches, zero_torques))
+  boost::mutex::scoped_lock slock(workspace_lock_);
+  return getMaxPayload(&joint_angles[0], payload, joint_saturated, *workspace_);
+}
+
+bool DynamicsSolver::getMaxPayload(const double *joint_angles,
+                                   double &payload,
+                                   unsigned int &joint_saturated,
+                                   DynamicsSolverWorkspace &workspace) const
+{
+  if (!checkWorkspace(workspace))
     return false;
 
+  for (unsigned int i = 0; i < num_joints_; ++i)
+    workspace.q_(i) = joint_angles[i];
+  KDL::SetToZero(workspace.q_dot_);
+  KDL::SetToZero(workspace.q_dotdot_);
+
+  if (!solve(workspace, workspace.wrenches_))
+    return false;
+  workspace.gravity_torques_ = workspace.torques_;
+
   for (unsigned int i = 0; i < num_joints_; ++i)
   {
-    if (fabs(zero_torques[i]) >= max_torques_[i])
+    if (fabs(workspace.gravity_torques_(i)) >= max_torques_[i])
     {
       payload = 0.0;
       joint_saturated = i;
@@ -242,24 +296,20 @@ bool DynamicsSolver::getMaxPayload(const std::vector<double> &joint_angles,
     }
   }
 
-  state_->setJointGroupPositions(joint_model_group_, joint_angles);
-  const Eigen::Affine3d &base_frame = state_->getFrameTransform(base_name_);
-  const Eigen::Affine3d &tip_frame = state_->getFrameTransform(tip_name_);
-  Eigen::Affine3d transform = tip_frame.inverse() * base_frame;
-  wrenches.back().force.z = 1.0;
-  wrenches.back().force = transformVector(transform, wrenches.back().force);
-  wrenches.back().torque = transformVector(transform, wrenches.back().torque);
-
-  logDebug("moveit.dynamics_solver: New wrench (local frame): %f %f %f", wrenches.back().force.x, wrenches.back().force.y, wrenches.back().force.z);
-
-  if (!getTorques(joint_angles, joint_velocities, joint_accelerations, wrenches, torques))
+  // because we set the payload to 1.0, the difference in torques is the torque per unit of force
+  setPayloadWrench(joint_angles, 1.0, workspace);
+  bool result = solve(workspace, workspace.wrenches_);
+  workspace.wrenches_.back() = KDL::Wrench::Zero();
+  if (!result)
     return false;
 
   double min_payload = std::numeric_limits<double>::max();
   for (unsigned int i = 0; i < num_joints_; ++i)
   {
-    double payload_joint = std::max<double>((max_torques_[i]-zero_torques[i])/(torques[i]-zero_torques[i]),(-max_torques_[i]-zero_torques[i])/(torques[i]-zero_torques[i]));//because we set the payload to 1.0
-    logDebug("moveit.dynamics_solver: Joint: %d, Actual Torque: %f, Max Allowed: %f, Gravity: %f", i, torques[i], max_torques_[i], zero_torques[i]);
+    const double zero_torque = workspace.gravity_torques_(i);
+    const double torque = workspace.torques_(i);
+    double payload_joint = std::max<double>((max_torques_[i]-zero_torque)/(torque-zero_torque),(-max_torques_[i]-zero_torque)/(torque-zero_torque));
+    logDebug("moveit.dynamics_solver: Joint: %d, Actual Torque: %f, Max Allowed: %f, Gravity: %f", i, torque, max_torques_[i], zero_torque);
     logDebug("moveit.dynamics_solver: Joint: %d, Payload Allowed (N): %f", i, payload_joint);
     if (payload_joint < min_payload)
     {
@@ -291,24 +341,168 @@ bool DynamicsSolver::getPayloadTorques(const std::vector<double> &joint_angles,
     logError("moveit.dynamics_solver: Joint torques vector should be size %d", num_joints_);
     return false;
   }
-  std::vector<double> joint_velocities(num_joints_, 0.0), joint_accelerations(num_joints_, 0.0);
-  std::vector<geometry_msgs::Wrench> wrenches(num_segments_);
-  state_->setJointGroupPositions(joint_model_group_, joint_angles);
 
-  const Eigen::Affine3d &base_frame = state_->getFrameTransform(base_name_);
-  const Eigen::Affine3d &tip_frame = state_->getFrameTransform(tip_name_);
-  Eigen::Affine3d transform = tip_frame.inverse()* base_frame;
-  wrenches.back().force.z = payload * gravity_;
-  wrenches.back().force = transformVector(transform, wrenches.back().force);
-  wrenches.back().torque = transformVector(transform, wrenches.back().torque);
+  boost::mutex::scoped_lock slock(workspace_lock_);
+  return getPayloadTorques(&joint_angles[0], payload, &joint_torques[0], *workspace_);
+}
+
+bool DynamicsSolver::getPayloadTorques(const double *joint_angles,
+                                       double payload,
+                                       double *joint_torques,
+                                       DynamicsSolverWorkspace &workspace) const
+{
+  if (!checkWorkspace(workspace))
+    return false;
+
+  for (unsigned int i = 0; i < num_joints_; ++i)
+    workspace.q_(i) = joint_angles[i];
+  KDL::SetToZero(workspace.q_dot_);
+  KDL::SetToZero(workspace.q_dotdot_);
+
+  setPayloadWrench(joint_angles, payload * gravity_, workspace);
+  bool result = solve(workspace, workspace.wrenches_);
+  workspace.wrenches_.back() = KDL::Wrench::Zero();
+  if (!result)
+    return false;
+
+  for (unsigned int i = 0; i < num_joints_; ++i)
+    joint_torques[i] = workspace.torques_(i);
+  return true;
+}
+
+void DynamicsSolver::setPayloadWrench(const double *joint_angles, double force, DynamicsSolverWorkspace &workspace) const
+{
+  workspace.state_->setJointGroupPositions(joint_model_group_, joint_angles);
+  const Eigen::Affine3d &base_frame = workspace.state_->getFrameTransform(base_name_);
+  const Eigen::Affine3d &tip_frame = workspace.state_->getFrameTransform(tip_name_);
+  // KDL subtracts the external wrenches from the forces the joints have to provide, so the weight of the
+  // payload pulls along the gravity vector
+  const Eigen::Vector3d direction = gravity_ > 0.0 ?
+    Eigen::Vector3d(gravity_vector_.x(), gravity_vector_.y(), gravity_vector_.z()) / gravity_ : Eigen::Vector3d(0.0, 0.0, -1.0);
+  Eigen::Vector3d local_force = (tip_frame.inverse() * base_frame).rotation() * (force * direction);
+  workspace.wrenches_.back() = KDL::Wrench(KDL::Vector(local_force.x(), local_force.y(), local_force.z()), KDL::Vector::Zero());
+
+  logDebug("moveit.dynamics_solver: New wrench (local frame): %f %f %f", local_force.x(), local_force.y(), local_force.z());
+}
+
+bool DynamicsSolver::getTrajectoryTorques(const robot_trajectory::RobotTrajectory &trajectory,
+                                          std::vector<double> &torques,
+                                          unsigned int thread_count) const
+{
+  if (!joint_model_group_)
+  {
+    logDebug("moveit.dynamics_solver: Did not construct DynamicsSolver object properly. Check error logs.");
+    return false;
+  }
+  if (joint_model_group_->getVariableCount() != num_joints_)
+  {
+    logError("moveit.dynamics_solver: Group '%s' has %u variables but the chain has %u joints",
+             joint_model_group_->getName().c_str(), joint_model_group_->getVariableCount(), num_joints_);
+    return false;
+  }
+
+  const std::size_t count = trajectory.getWayPointCount();
+  torques.resize(count * num_joints_);
+  if (count == 0)
+    return true;
 
-  logDebug("moveit.dynamics_solver: New wrench (local frame): %f %f %f", wrenches.back().force.x, wrenches.back().force.y, wrenches.back().force.z);
+  return runInParallel(count, thread_count, boost::bind(&DynamicsSolver::computeTrajectoryTorques, this, &trajectory, _1, _2, &torques[0], _3));
+}
 
-  if (!getTorques(joint_angles, joint_velocities, joint_accelerations, wrenches, joint_torques))
+bool DynamicsSolver::getMaxPayloads(const std::vector<double> &joint_angles,
+                                    std::vector<double> &payloads,
+                                    std::vector<unsigned int> &joints_saturated,
+                                    unsigned int thread_count) const
+{
+  if (!joint_model_group_)
+  {
+    logDebug("moveit.dynamics_solver: Did not construct DynamicsSolver object properly. Check error logs.");
     return false;
+  }
+  if (joint_angles.size() % num_joints_ != 0)
+  {
+    logError("moveit.dynamics_solver: Joint angles vector should have a size that is a multiple of %d", num_joints_);
+    return false;
+  }
+
+  const std::size_t count = joint_angles.size() / num_joints_;
+  payloads.resize(count);
+  joints_saturated.resize(count);
+  if (count == 0)
+    return true;
+
+  return runInParallel(count, thread_count, boost::bind(&DynamicsSolver::computeMaxPayloads, this, &joint_angles[0], _1, _2,
+                                                        &payloads[0], &joints_saturated[0], _3));
+}
+
+bool DynamicsSolver::runInParallel(std::size_t count, unsigned int thread_count,
+                                   const boost::function<void(std::size_t, std::size_t, bool*)> &range_function) const
+{
+  moveit::tools::TaskScheduler &scheduler = moveit::tools::TaskScheduler::Instance();
+  if (thread_count == 0)
+    thread_count = scheduler.getThreadCount();
+  if (thread_count > count)
+    thread_count = count;
+
+  const std::size_t chunk = (count + thread_count - 1) / thread_count;
+  const std::size_t ranges = (count + chunk - 1) / chunk;
+  boost::scoped_array<bool> success(new bool[ranges]);
+  moveit::tools::TaskScheduler::TaskGroup group(scheduler);
+  for (std::size_t r = 1; r < ranges; ++r)
+    group.run(boost::bind(range_function, r * chunk, std::min(count, (r + 1) * chunk), &success[r]));
+  // the calling thread processes the first range
+  range_function(0, std::min(count, chunk), &success[0]);
+  group.wait();
+
+  for (std::size_t r = 0; r < ranges; ++r)
+    if (!success[r])
+      return false;
   return true;
 }
 
+void DynamicsSolver::computeMaxPayloads(const double *joint_angles, std::size_t begin, std::size_t end,
+                                        double *payloads, unsigned int *joints_saturated, bool *success) const
+{
+  *success = false;
+  DynamicsSolverWorkspacePtr workspace = createWorkspace();
+  if (!workspace)
+    return;
+  for (std::size_t i = begin; i < end; ++i)
+    if (!getMaxPayload(joint_angles + i * num_joints_, payloads[i], joints_saturated[i], *workspace))
+      return;
+  *success = true;
+}
+
+void DynamicsSolver::computeTrajectoryTorques(const robot_trajectory::RobotTrajectory *trajectory,
+                                              std::size_t begin, std::size_t end, double *torques, bool *success) const
+{
+  *success = false;
+  DynamicsSolverWorkspacePtr workspace = createWorkspace();
+  if (!workspace)
+    return;
+
+  const std::vector<int> &index = joint_model_group_->getVariableIndexList();
+  for (std::size_t i = begin; i < end; ++i)
+  {
+    const robot_state::RobotState &waypoint = trajectory->getWayPoint(i);
+    const double *positions = waypoint.getVariablePositions();
+    const double *velocities = waypoint.hasVelocities() ? waypoint.getVariableVelocities() : NULL;
+    const double *accelerations = waypoint.hasAccelerations() ? waypoint.getVariableAccelerations() : NULL;
+    for (unsigned int j = 0; j < num_joints_; ++j)
+    {
+      workspace->q_(j) = positions[index[j]];
+      workspace->q_dot_(j) = velocities ? velocities[index[j]] : 0.0;
+      workspace->q_dotdot_(j) = accelerations ? accelerations[index[j]] : 0.0;
+    }
+    if (!solve(*workspace, workspace->wrenches_))
+      return;
+    double *row = torques + i * num_joints_;
+    for (unsigned int j = 0; j < num_joints_; ++j)
+      row[j] = workspace->torques_(j);
+  }
+  *success = true;
+}
+
 const std::vector<double>& DynamicsSolver::getMaxTorques() const
 {
   return max_torques_;
@@ -0,0 +1,243 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/dynamics_solver/payload_map.h>
+#include <algorithm>
+#include <cmath>
+
+namespace dynamics_solver
+{
+
+PayloadMap::PayloadMap(const DynamicsSolverConstPtr &solver, double resolution)
+  : solver_(solver)
+  , valid_(false)
+  , joint_count_(0)
+{
+  if (solver_ && solver_->getGroup())
+    initialize(std::vector<double>(solver_->getGroup()->getVariableCount(), resolution));
+  else
+    logError("moveit.dynamics_solver: Cannot construct payload map without a valid dynamics solver");
+}
+
+PayloadMap::PayloadMap(const DynamicsSolverConstPtr &solver, const std::vector<double> &resolutions)
+  : solver_(solver)
+  , valid_(false)
+  , joint_count_(0)
+{
+  if (solver_ && solver_->getGroup())
+    initialize(resolutions);
+  else
+    logError("moveit.dynamics_solver: Cannot construct payload map without a valid dynamics solver");
+}
+
+void PayloadMap::initialize(const std::vector<double> &resolutions)
+{
+  const robot_model::JointModelGroup *group = solver_->getGroup();
+  const std::vector<std::string> &variable_names = group->getVariableNames();
+  joint_count_ = variable_names.size();
+  if (resolutions.size() != joint_count_)
+  {
+    logError("moveit.dynamics_solver: Payload map for group '%s' needs %u resolutions", group->getName().c_str(), joint_count_);
+    return;
+  }
+
+  lower_bounds_.resize(joint_count_);
+  upper_bounds_.resize(joint_count_);
+  resolutions_ = resolutions;
+  cell_counts_.resize(joint_count_);
+  strides_.resize(joint_count_);
+
+  // the product of the cell counts needs to fit in the key
+  double total = 1.0;
+  boost::uint64_t stride = 1;
+  for (unsigned int i = 0 ; i < joint_count_ ; ++i)
+  {
+    if (resolutions_[i] <= 0.0)
+    {
+      logError("moveit.dynamics_solver: Payload map resolution must be positive");
+      return;
+    }
+    const robot_model::VariableBounds &bounds = solver_->getRobotModel()->getVariableBounds(variable_names[i]);
+    lower_bounds_[i] = bounds.min_position_;
+    upper_bounds_[i] = bounds.max_position_;
+    cell_counts_[i] = std::max<boost::uint64_t>(1, (boost::uint64_t)ceil((bounds.max_position_ - bounds.min_position_) / resolutions_[i]));
+    strides_[i] = stride;
+    stride *= cell_counts_[i];
+    total *= (double)cell_counts_[i];
+  }
+  if (total >= 9.2e18)
+  {
+    logError("moveit.dynamics_solver: Payload map for group '%s' would have too many cells (%g). Use a coarser resolution.",
+             group->getName().c_str(), total);
+    return;
+  }
+  valid_ = true;
+}
+
+boost::uint64_t PayloadMap::getCellKey(const double *joint_angles) const
+{
+  boost::uint64_t key = 0;
+  for (unsigned int i = 0 ; i < joint_count_ ; ++i)
+  {
+    double cell = floor((joint_angles[i] - lower_bounds_[i]) / resolutions_[i]);
+    boost::uint64_t index = cell <= 0.0 ? 0 : std::min<boost::uint64_t>((boost::uint64_t)cell, cell_counts_[i] - 1);
+    key += index * strides_[i];
+  }
+  return key;
+}
+
+bool PayloadMap::findMaxPayload(const double *joint_angles, double &payload, double &error_estimate) const
+{
+  if (!valid_)
+    return false;
+  const boost::uint64_t key = getCellKey(joint_angles);
+  boost::mutex::scoped_lock slock(cells_lock_);
+  CellMap::const_iterator it = cells_.find(key);
+  if (it == cells_.end())
+    return false;
+  payload = it->second.payload_;
+  error_estimate = it->second.error_estimate_;
+  return true;
+}
+
+bool PayloadMap::getMaxPayload(const double *joint_angles, double &payload, double &error_estimate)
+{
+  if (findMaxPayload(joint_angles, payload, error_estimate))
+    return true;
+  if (!valid_ || !computeCells(std::vector<boost::uint64_t>(1, getCellKey(joint_angles)), 1))
+    return false;
+  return findMaxPayload(joint_angles, payload, error_estimate);
+}
+
+bool PayloadMap::getMaxPayload(const std::vector<double> &joint_angles, double &payload, double &error_estimate)
+{
+  if (joint_angles.size() != joint_count_)
+  {
+    logError("moveit.dynamics_solver: Joint angles vector should be size %u", joint_count_);
+    return false;
+  }
+  return getMaxPayload(&joint_angles[0], payload, error_estimate);
+}
+
+bool PayloadMap::precompute(const std::vector<double> &joint_angles, unsigned int thread_count)
+{
+  if (!valid_)
+    return false;
+  if (joint_angles.size() % joint_count_ != 0)
+  {
+    logError("moveit.dynamics_solver: Joint angles vector should have a size that is a multiple of %u", joint_count_);
+    return false;
+  }
+
+  const std::size_t count = joint_angles.size() / joint_count_;
+  std::vector<boost::uint64_t> keys;
+  keys.reserve(count);
+  {
+    boost::mutex::scoped_lock slock(cells_lock_);
+    for (std::size_t i = 0 ; i < count ; ++i)
+    {
+      boost::uint64_t key = getCellKey(&joint_angles[i * joint_count_]);
+      if (cells_.find(key) == cells_.end())
+        keys.push_back(key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  if (keys.empty())
+    return true;
+  return computeCells(keys, thread_count);
+}
+
+bool PayloadMap::computeCells(const std::vector<boost::uint64_t> &keys, unsigned int thread_count)
+{
+  // for every cell, evaluate the center and then the lower and upper edges of the cell along each joint;
+  // the last cell along a joint can extend past the joint bounds, so cells are clamped to them
+  const std::size_t samples_per_cell = 2 * joint_count_ + 1;
+  std::vector<double> configurations(keys.size() * samples_per_cell * joint_count_);
+  std::vector<double> lower(joint_count_), upper(joint_count_);
+  for (std::size_t k = 0 ; k < keys.size() ; ++k)
+  {
+    double *center = &configurations[k * samples_per_cell * joint_count_];
+    boost::uint64_t key = keys[k];
+    for (unsigned int i = joint_count_ ; i > 0 ; --i)
+    {
+      const boost::uint64_t index = key / strides_[i - 1];
+      key -= index * strides_[i - 1];
+      lower[i - 1] = lower_bounds_[i - 1] + (double)index * resolutions_[i - 1];
+      upper[i - 1] = std::min(lower[i - 1] + resolutions_[i - 1], upper_bounds_[i - 1]);
+      center[i - 1] = 0.5 * (lower[i - 1] + upper[i - 1]);
+    }
+    for (unsigned int j = 0 ; j < joint_count_ ; ++j)
+    {
+      double *lower_edge = center + (2 * j + 1) * joint_count_;
+      double *upper_edge = lower_edge + joint_count_;
+      std::copy(center, center + joint_count_, lower_edge);
+      std::copy(center, center + joint_count_, upper_edge);
+      lower_edge[j] = lower[j];
+      upper_edge[j] = upper[j];
+    }
+  }
+
+  std::vector<double> payloads;
+  std::vector<unsigned int> joints_saturated;
+  if (!solver_->getMaxPayloads(configurations, payloads, joints_saturated, thread_count))
+    return false;
+
+  boost::mutex::scoped_lock slock(cells_lock_);
+  for (std::size_t k = 0 ; k < keys.size() ; ++k)
+  {
+    const double *values = &payloads[k * samples_per_cell];
+    Cell cell;
+    cell.payload_ = values[0];
+    cell.error_estimate_ = 0.0;
+    for (unsigned int j = 0 ; j < joint_count_ ; ++j)
+      cell.error_estimate_ += std::max(fabs(values[2 * j + 1] - values[0]), fabs(values[2 * j + 2] - values[0]));
+    cells_[keys[k]] = cell;
+  }
+  return true;
+}
+
+std::size_t PayloadMap::getCellCount() const
+{
+  boost::mutex::scoped_lock slock(cells_lock_);
+  return cells_.size();
+}
+
+void PayloadMap::clear()
+{
+  boost::mutex::scoped_lock slock(cells_lock_);
+  cells_.clear();
+}
+
+}
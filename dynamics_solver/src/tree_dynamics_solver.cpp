@@ -0,0 +1,409 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/dynamics_solver/tree_dynamics_solver.h>
+#include <deque>
+
+namespace dynamics_solver
+{
+
+namespace
+{
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+
+inline Eigen::Matrix3d skew(const Eigen::Vector3d &v)
+{
+  Eigen::Matrix3d m;
+  m <<  0.0, -v.z(),  v.y(),
+        v.z(),  0.0, -v.x(),
+       -v.y(),  v.x(),  0.0;
+  return m;
+}
+
+// spatial cross product for motion vectors: v x m
+inline Vector6d crossMotion(const Vector6d &v, const Vector6d &m)
+{
+  Vector6d r;
+  r.head<3>() = v.head<3>().cross(m.head<3>());
+  r.tail<3>() = v.head<3>().cross(m.tail<3>()) + v.tail<3>().cross(m.head<3>());
+  return r;
+}
+
+// spatial cross product for force vectors: v x* f
+inline Vector6d crossForce(const Vector6d &v, const Vector6d &f)
+{
+  Vector6d r;
+  r.head<3>() = v.head<3>().cross(f.head<3>()) + v.tail<3>().cross(f.tail<3>());
+  r.tail<3>() = v.head<3>().cross(f.tail<3>());
+  return r;
+}
+
+// multiply a motion vector by the spatial inertia described by its mass, first moment of mass
+// and rotational inertia about the origin
+inline Vector6d applyInertia(double mass, const Eigen::Vector3d &first_moment, const Eigen::Matrix3d &rotational_inertia, const Vector6d &v)
+{
+  Vector6d f;
+  f.head<3>() = rotational_inertia * v.head<3>() + first_moment.cross(v.tail<3>());
+  f.tail<3>() = mass * v.tail<3>() - first_moment.cross(v.head<3>());
+  return f;
+}
+
+inline void addPointMass(double mass, const Eigen::Vector3d &position, TreeDynamicsSolverWorkspace &workspace, int body)
+{
+  workspace.mass_(body) += mass;
+  workspace.first_moment_.col(body) += mass * position;
+  workspace.rotational_inertia_.block<3, 3>(0, 3 * body) +=
+    mass * (position.squaredNorm() * Eigen::Matrix3d::Identity() - position * position.transpose());
+}
+}
+
+TreeDynamicsSolver::TreeDynamicsSolver(const robot_model::RobotModelConstPtr &robot_model,
+                                       const std::string &group_name,
+                                       const geometry_msgs::Vector3 &gravity_vector)
+  : robot_model_(robot_model)
+  , gravity_(gravity_vector.x, gravity_vector.y, gravity_vector.z)
+{
+  joint_model_group_ = robot_model_->getJointModelGroup(group_name);
+  if (!joint_model_group_)
+    return;
+
+  const std::vector<const robot_model::JointModel*> &joint_models = joint_model_group_->getJointModels();
+  for (std::size_t i = 0 ; i < joint_models.size() ; ++i)
+    if (joint_models[i]->getVariableCount() > 0 &&
+        joint_models[i]->getType() != robot_model::JointModel::REVOLUTE &&
+        joint_models[i]->getType() != robot_model::JointModel::PRISMATIC)
+    {
+      logError("moveit.dynamics_solver: Joint '%s' in group '%s' is of type %s. Only revolute and prismatic joints are supported.",
+               joint_models[i]->getName().c_str(), group_name.c_str(), joint_models[i]->getTypeName().c_str());
+      joint_model_group_ = NULL;
+      return;
+    }
+
+  const boost::shared_ptr<const urdf::ModelInterface> &urdf_model = robot_model_->getURDF();
+  link_to_body_.resize(robot_model_->getLinkModelCount(), -1);
+
+  // traverse the links that descend from the group, parents first
+  std::deque<std::pair<const robot_model::JointModel*, int> > queue;
+  const std::vector<const robot_model::JointModel*> &roots = joint_model_group_->getJointRoots();
+  for (std::size_t i = 0 ; i < roots.size() ; ++i)
+    queue.push_back(std::make_pair(roots[i], -1));
+
+  while (!queue.empty())
+  {
+    const robot_model::JointModel *joint_model = queue.front().first;
+    const int parent = queue.front().second;
+    queue.pop_front();
+
+    const robot_model::LinkModel *link = joint_model->getChildLinkModel();
+    if (link_to_body_[link->getLinkIndex()] >= 0)
+      continue;
+    const int index = bodies_.size();
+    link_to_body_[link->getLinkIndex()] = index;
+
+    Body body;
+    body.link_ = link;
+    body.parent_ = parent;
+    body.joint_ = -1;
+    body.mass_ = 0.0;
+    body.center_of_mass_.setZero();
+    body.inertia_.setZero();
+
+    if (joint_model->getVariableCount() > 0 && joint_model_group_->hasJointModel(joint_model->getName()))
+    {
+      const robot_model::JointModel *driver = joint_model->getMimic() ? joint_model->getMimic() : joint_model;
+      const int variable = joint_model_group_->getVariableGroupIndex(driver->getName());
+      if (variable >= 0)
+      {
+        Joint joint;
+        joint.joint_model_ = joint_model;
+        joint.body_ = index;
+        joint.variable_ = variable;
+        joint.factor_ = joint_model->getMimic() ? joint_model->getMimicFactor() : 1.0;
+        joint.revolute_ = joint_model->getType() == robot_model::JointModel::REVOLUTE;
+        joint.axis_ = joint.revolute_ ?
+          static_cast<const robot_model::RevoluteJointModel*>(joint_model)->getAxis() :
+          static_cast<const robot_model::PrismaticJointModel*>(joint_model)->getAxis();
+        body.joint_ = joints_.size();
+        joints_.push_back(joint);
+      }
+    }
+
+    const urdf::Link *ulink = urdf_model->getLink(link->getName()).get();
+    if (ulink && ulink->inertial)
+    {
+      const urdf::Inertial &inertial = *ulink->inertial;
+      Eigen::Matrix3d rotation = Eigen::Quaterniond(inertial.origin.rotation.w, inertial.origin.rotation.x,
+                                                    inertial.origin.rotation.y, inertial.origin.rotation.z).toRotationMatrix();
+      Eigen::Matrix3d inertia;
+      inertia << inertial.ixx, inertial.ixy, inertial.ixz,
+                 inertial.ixy, inertial.iyy, inertial.iyz,
+                 inertial.ixz, inertial.iyz, inertial.izz;
+      body.mass_ = inertial.mass;
+      body.center_of_mass_ = Eigen::Vector3d(inertial.origin.position.x, inertial.origin.position.y, inertial.origin.position.z);
+      body.inertia_ = rotation * inertia * rotation.transpose();
+    }
+    else
+      logDebug("moveit.dynamics_solver: Link '%s' has no inertial properties", link->getName().c_str());
+    bodies_.push_back(body);
+
+    const std::vector<const robot_model::JointModel*> &children = link->getChildJointModels();
+    for (std::size_t i = 0 ; i < children.size() ; ++i)
+      queue.push_back(std::make_pair(children[i], index));
+  }
+
+  const std::vector<std::string> &variable_names = joint_model_group_->getVariableNames();
+  for (std::size_t i = 0 ; i < variable_names.size() ; ++i)
+  {
+    const urdf::Joint* ujoint = urdf_model->getJoint(variable_names[i]).get();
+    if (ujoint && ujoint->limits)
+      max_torques_.push_back(ujoint->limits->effort);
+    else
+      max_torques_.push_back(0.0);
+  }
+
+  logDebug("moveit.dynamics_solver: Group '%s' moves %u bodies through %u joints", group_name.c_str(),
+           (unsigned int)bodies_.size(), (unsigned int)joints_.size());
+}
+
+TreeDynamicsSolverWorkspacePtr TreeDynamicsSolver::createWorkspace() const
+{
+  TreeDynamicsSolverWorkspacePtr workspace(new TreeDynamicsSolverWorkspace());
+  const int n = bodies_.size();
+  workspace->mass_.resize(n);
+  workspace->first_moment_.resize(3, n);
+  workspace->rotational_inertia_.resize(3, 3 * n);
+  workspace->motion_.resize(6, joints_.size());
+  workspace->velocity_.resize(6, n);
+  workspace->acceleration_.resize(6, n);
+  workspace->force_.resize(6, n);
+  workspace->composite_inertia_.resize(6, 6 * n);
+  return workspace;
+}
+
+void TreeDynamicsSolver::setAttachedBodyMass(const std::string &id, double mass)
+{
+  attached_body_masses_[id] = mass;
+}
+
+void TreeDynamicsSolver::clearAttachedBodyMass(const std::string &id)
+{
+  attached_body_masses_.erase(id);
+}
+
+bool TreeDynamicsSolver::checkWorkspace(const TreeDynamicsSolverWorkspace &workspace) const
+{
+  if (!joint_model_group_)
+  {
+    logDebug("moveit.dynamics_solver: Did not construct TreeDynamicsSolver object properly. Check error logs.");
+    return false;
+  }
+  if (workspace.mass_.size() != (int)bodies_.size() || workspace.motion_.cols() != (int)joints_.size())
+  {
+    logError("moveit.dynamics_solver: Workspace was not created by this solver");
+    return false;
+  }
+  return true;
+}
+
+void TreeDynamicsSolver::computeWorldQuantities(const robot_state::RobotState &state, TreeDynamicsSolverWorkspace &workspace) const
+{
+  for (std::size_t b = 0 ; b < bodies_.size() ; ++b)
+  {
+    const Body &body = bodies_[b];
+    const Eigen::Affine3d &transform = state.getGlobalLinkTransform(body.link_);
+    const Eigen::Matrix3d rotation = transform.linear();
+    const Eigen::Vector3d center = transform * body.center_of_mass_;
+
+    workspace.mass_(b) = 0.0;
+    workspace.first_moment_.col(b).setZero();
+    workspace.rotational_inertia_.block<3, 3>(0, 3 * b) = rotation * body.inertia_ * rotation.transpose();
+    addPointMass(body.mass_, center, workspace, b);
+
+    if (body.joint_ >= 0)
+    {
+      const Joint &joint = joints_[body.joint_];
+      const Eigen::Vector3d axis = rotation * joint.axis_;
+      if (joint.revolute_)
+      {
+        workspace.motion_.col(body.joint_).head<3>() = axis;
+        workspace.motion_.col(body.joint_).tail<3>() = transform.translation().cross(axis);
+      }
+      else
+      {
+        workspace.motion_.col(body.joint_).head<3>().setZero();
+        workspace.motion_.col(body.joint_).tail<3>() = axis;
+      }
+    }
+  }
+
+  if (attached_body_masses_.empty())
+    return;
+  state.getAttachedBodies(workspace.attached_bodies_);
+  for (std::size_t i = 0 ; i < workspace.attached_bodies_.size() ; ++i)
+  {
+    const robot_state::AttachedBody *attached_body = workspace.attached_bodies_[i];
+    std::map<std::string, double>::const_iterator it = attached_body_masses_.find(attached_body->getName());
+    if (it == attached_body_masses_.end())
+      continue;
+    const int b = link_to_body_[attached_body->getAttachedLink()->getLinkIndex()];
+    const EigenSTL::vector_Affine3d &fixed_transforms = attached_body->getFixedTransforms();
+    if (b < 0 || fixed_transforms.empty())
+      continue;
+    Eigen::Vector3d position = Eigen::Vector3d::Zero();
+    for (std::size_t k = 0 ; k < fixed_transforms.size() ; ++k)
+      position += fixed_transforms[k].translation();
+    position = state.getGlobalLinkTransform(bodies_[b].link_) * (position / (double)fixed_transforms.size());
+    addPointMass(it->second, position, workspace, b);
+  }
+}
+
+bool TreeDynamicsSolver::getTorques(const robot_state::RobotState &state,
+                                    const double *joint_velocities,
+                                    const double *joint_accelerations,
+                                    double *torques,
+                                    TreeDynamicsSolverWorkspace &workspace) const
+{
+  if (!checkWorkspace(workspace))
+    return false;
+  computeWorldQuantities(state, workspace);
+
+  const unsigned int variable_count = joint_model_group_->getVariableCount();
+  for (unsigned int i = 0 ; i < variable_count ; ++i)
+    torques[i] = 0.0;
+
+  // the bodies the group is attached to are fixed; gravity is modelled as an upward acceleration of the base
+  Vector6d base_acceleration;
+  base_acceleration.head<3>().setZero();
+  base_acceleration.tail<3>() = -gravity_;
+
+  // forward pass: velocities, accelerations and the forces needed to produce them
+  for (std::size_t b = 0 ; b < bodies_.size() ; ++b)
+  {
+    const Body &body = bodies_[b];
+    Vector6d v, a;
+    if (body.parent_ < 0)
+    {
+      v.setZero();
+      a = base_acceleration;
+    }
+    else
+    {
+      v = workspace.velocity_.col(body.parent_);
+      a = workspace.acceleration_.col(body.parent_);
+    }
+    if (body.joint_ >= 0)
+    {
+      const Joint &joint = joints_[body.joint_];
+      const Vector6d s = workspace.motion_.col(body.joint_);
+      const double qd = joint_velocities ? joint.factor_ * joint_velocities[joint.variable_] : 0.0;
+      const double qdd = joint_accelerations ? joint.factor_ * joint_accelerations[joint.variable_] : 0.0;
+      v += s * qd;
+      a += s * qdd + crossMotion(v, s) * qd;
+    }
+    workspace.velocity_.col(b) = v;
+    workspace.acceleration_.col(b) = a;
+
+    const Eigen::Vector3d first_moment = workspace.first_moment_.col(b);
+    const Eigen::Matrix3d rotational_inertia = workspace.rotational_inertia_.block<3, 3>(0, 3 * b);
+    workspace.force_.col(b) = applyInertia(workspace.mass_(b), first_moment, rotational_inertia, a) +
+      crossForce(v, applyInertia(workspace.mass_(b), first_moment, rotational_inertia, v));
+  }
+
+  // backward pass: accumulate forces towards the base and project them on the joint axes
+  for (std::size_t i = bodies_.size() ; i > 0 ; --i)
+  {
+    const std::size_t b = i - 1;
+    const Body &body = bodies_[b];
+    if (body.joint_ >= 0)
+    {
+      const Joint &joint = joints_[body.joint_];
+      torques[joint.variable_] += joint.factor_ * workspace.motion_.col(body.joint_).dot(workspace.force_.col(b));
+    }
+    if (body.parent_ >= 0)
+      workspace.force_.col(body.parent_) += workspace.force_.col(b);
+  }
+  return true;
+}
+
+bool TreeDynamicsSolver::getMassMatrix(const robot_state::RobotState &state,
+                                       Eigen::MatrixXd &mass_matrix,
+                                       TreeDynamicsSolverWorkspace &workspace) const
+{
+  if (!checkWorkspace(workspace))
+    return false;
+  computeWorldQuantities(state, workspace);
+
+  const unsigned int variable_count = joint_model_group_->getVariableCount();
+  mass_matrix.setZero(variable_count, variable_count);
+
+  for (std::size_t b = 0 ; b < bodies_.size() ; ++b)
+  {
+    const Eigen::Vector3d first_moment = workspace.first_moment_.col(b);
+    Matrix6d inertia;
+    inertia.topLeftCorner<3, 3>() = workspace.rotational_inertia_.block<3, 3>(0, 3 * b);
+    inertia.topRightCorner<3, 3>() = skew(first_moment);
+    inertia.bottomLeftCorner<3, 3>() = skew(first_moment).transpose();
+    inertia.bottomRightCorner<3, 3>() = workspace.mass_(b) * Eigen::Matrix3d::Identity();
+    workspace.composite_inertia_.block<6, 6>(0, 6 * b) = inertia;
+  }
+
+  // composite inertias of the subtrees
+  for (std::size_t i = bodies_.size() ; i > 0 ; --i)
+  {
+    const std::size_t b = i - 1;
+    if (bodies_[b].parent_ >= 0)
+      workspace.composite_inertia_.block<6, 6>(0, 6 * bodies_[b].parent_) += workspace.composite_inertia_.block<6, 6>(0, 6 * b);
+  }
+
+  for (std::size_t i = 0 ; i < joints_.size() ; ++i)
+  {
+    const Joint &joint = joints_[i];
+    const Vector6d f = workspace.composite_inertia_.block<6, 6>(0, 6 * joint.body_) * workspace.motion_.col(i);
+    for (int b = joint.body_ ; b >= 0 ; b = bodies_[b].parent_)
+    {
+      const int j = bodies_[b].joint_;
+      if (j < 0)
+        continue;
+      const Joint &other = joints_[j];
+      const double value = joint.factor_ * other.factor_ * workspace.motion_.col(j).dot(f);
+      mass_matrix(joint.variable_, other.variable_) += value;
+      if (j != (int)i)
+        mass_matrix(other.variable_, joint.variable_) += value;
+    }
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,373 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/dynamics_solver/dynamics_solver.h>
+#include <moveit/dynamics_solver/tree_dynamics_solver.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <kdl_parser/kdl_parser.hpp>
+#include <kdl/tree.hpp>
+#include <kdl/chaindynparam.hpp>
+#include <geometric_shapes/shapes.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+class DynamicsSolverTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    // a chain that mixes revolute and prismatic joints, with inertial frames that are offset and rotated
+    urdf_model_ = moveit::core::loadTestingURDF("dynamics_arm");
+    ASSERT_TRUE(urdf_model_);
+    srdf_model_ = moveit::core::loadTestingSRDF("dynamics_arm", *urdf_model_);
+    ASSERT_TRUE(srdf_model_);
+    robot_model_.reset(new moveit::core::RobotModel(urdf_model_, srdf_model_));
+    gravity_.x = 0.0;
+    gravity_.y = 0.0;
+    gravity_.z = -9.81;
+  }
+
+  // a deterministic set of positions, velocities and accelerations that covers the joint ranges
+  static void getSample(unsigned int i, std::vector<double> &q, std::vector<double> &q_dot, std::vector<double> &q_dotdot)
+  {
+    for (std::size_t j = 0 ; j < q.size() ; ++j)
+    {
+      q[j] = sin(1.3 * i + 0.7 * j) * (j == 2 ? 0.1 : 1.5) + (j == 2 ? 0.1 : 0.0);
+      q_dot[j] = cos(0.9 * i + 1.1 * j);
+      q_dotdot[j] = sin(2.1 * i - 0.3 * j) * 2.0;
+    }
+  }
+
+  // the torques KDL computes for a chain without external wrenches
+  static void getChainTorques(const KDL::Chain &chain, const KDL::Vector &gravity, const double *q, const double *q_dot,
+                              const double *q_dotdot, KDL::JntArray &torques)
+  {
+    const unsigned int n = chain.getNrOfJoints();
+    KDL::JntArray kdl_q(n), kdl_q_dot(n), kdl_q_dotdot(n);
+    for (unsigned int j = 0 ; j < n ; ++j)
+    {
+      kdl_q(j) = q[j];
+      kdl_q_dot(j) = q_dot[j];
+      kdl_q_dotdot(j) = q_dotdot[j];
+    }
+    torques.resize(n);
+    KDL::Wrenches kdl_wrenches(chain.getNrOfSegments(), KDL::Wrench::Zero());
+    KDL::ChainIdSolver_RNE kdl_solver(chain, gravity);
+    EXPECT_GE(kdl_solver.CartToJnt(kdl_q, kdl_q_dot, kdl_q_dotdot, kdl_wrenches, torques), 0);
+  }
+
+  // the mass matrix KDL computes for a chain
+  static void getChainMassMatrix(const KDL::Chain &chain, const double *q, KDL::JntSpaceInertiaMatrix &mass_matrix)
+  {
+    const unsigned int n = chain.getNrOfJoints();
+    KDL::JntArray kdl_q(n);
+    for (unsigned int j = 0 ; j < n ; ++j)
+      kdl_q(j) = q[j];
+    mass_matrix.resize(n);
+    KDL::ChainDynParam kdl_solver(chain, KDL::Vector::Zero());
+    EXPECT_GE(kdl_solver.JntToMass(kdl_q, mass_matrix), 0);
+  }
+
+  boost::shared_ptr<urdf::ModelInterface> urdf_model_;
+  boost::shared_ptr<srdf::Model> srdf_model_;
+  moveit::core::RobotModelConstPtr robot_model_;
+  geometry_msgs::Vector3 gravity_;
+};
+
+TEST_F(DynamicsSolverTest, TreeSolverMatchesKDL)
+{
+  KDL::Tree tree;
+  ASSERT_TRUE(kdl_parser::treeFromUrdfModel(*urdf_model_, tree));
+  KDL::Chain chain;
+  ASSERT_TRUE(tree.getChain("base_link", "link3", chain));
+  ASSERT_EQ(3u, chain.getNrOfJoints());
+  KDL::ChainIdSolver_RNE kdl_solver(chain, KDL::Vector(gravity_.x, gravity_.y, gravity_.z));
+
+  dynamics_solver::TreeDynamicsSolver tree_solver(robot_model_, "arm", gravity_);
+  ASSERT_TRUE(tree_solver.isValid());
+  dynamics_solver::TreeDynamicsSolverWorkspacePtr workspace = tree_solver.createWorkspace();
+
+  const robot_model::JointModelGroup *group = robot_model_->getJointModelGroup("arm");
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+
+  std::vector<double> q(3), q_dot(3), q_dotdot(3), torques(3);
+  KDL::JntArray kdl_q(3), kdl_q_dot(3), kdl_q_dotdot(3), kdl_torques(3);
+  KDL::Wrenches kdl_wrenches(chain.getNrOfSegments(), KDL::Wrench::Zero());
+  for (unsigned int i = 0 ; i < 50 ; ++i)
+  {
+    getSample(i, q, q_dot, q_dotdot);
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+    {
+      kdl_q(j) = q[j];
+      kdl_q_dot(j) = q_dot[j];
+      kdl_q_dotdot(j) = q_dotdot[j];
+    }
+    ASSERT_GE(kdl_solver.CartToJnt(kdl_q, kdl_q_dot, kdl_q_dotdot, kdl_wrenches, kdl_torques), 0);
+
+    state.setJointGroupPositions(group, q);
+    state.updateLinkTransforms();
+    ASSERT_TRUE(tree_solver.getTorques(state, &q_dot[0], &q_dotdot[0], &torques[0], *workspace));
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+      EXPECT_NEAR(kdl_torques(j), torques[j], 1e-9);
+  }
+}
+
+TEST_F(DynamicsSolverTest, MassMatrixMatchesInverseDynamics)
+{
+  // without gravity and velocities, the torques for a unit acceleration of joint j are column j of the mass matrix
+  geometry_msgs::Vector3 no_gravity;
+  dynamics_solver::TreeDynamicsSolver tree_solver(robot_model_, "arm", no_gravity);
+  ASSERT_TRUE(tree_solver.isValid());
+  dynamics_solver::TreeDynamicsSolverWorkspacePtr workspace = tree_solver.createWorkspace();
+
+  const robot_model::JointModelGroup *group = robot_model_->getJointModelGroup("arm");
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+
+  std::vector<double> q(3), q_dot(3), q_dotdot(3), torques(3);
+  Eigen::MatrixXd mass_matrix;
+  for (unsigned int i = 0 ; i < 10 ; ++i)
+  {
+    getSample(i, q, q_dot, q_dotdot);
+    state.setJointGroupPositions(group, q);
+    state.updateLinkTransforms();
+    ASSERT_TRUE(tree_solver.getMassMatrix(state, mass_matrix, *workspace));
+    ASSERT_EQ(3, mass_matrix.rows());
+    ASSERT_EQ(3, mass_matrix.cols());
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+    {
+      std::vector<double> unit(3, 0.0);
+      unit[j] = 1.0;
+      ASSERT_TRUE(tree_solver.getTorques(state, NULL, &unit[0], &torques[0], *workspace));
+      for (std::size_t k = 0 ; k < 3 ; ++k)
+        EXPECT_NEAR(mass_matrix(k, j), torques[k], 1e-9);
+    }
+  }
+}
+
+TEST_F(DynamicsSolverTest, ReentrantTorquesMatchKDL)
+{
+  dynamics_solver::DynamicsSolver solver(robot_model_, "arm", gravity_);
+  dynamics_solver::TreeDynamicsSolver tree_solver(robot_model_, "arm", gravity_);
+  dynamics_solver::DynamicsSolverWorkspacePtr workspace = solver.createWorkspace();
+  ASSERT_TRUE(workspace);
+  dynamics_solver::TreeDynamicsSolverWorkspacePtr tree_workspace = tree_solver.createWorkspace();
+
+  const robot_model::JointModelGroup *group = robot_model_->getJointModelGroup("arm");
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+
+  std::vector<double> q(3), q_dot(3), q_dotdot(3), torques(3), tree_torques(3);
+  std::vector<geometry_msgs::Wrench> wrenches(3);
+  for (unsigned int i = 0 ; i < 10 ; ++i)
+  {
+    getSample(i, q, q_dot, q_dotdot);
+    ASSERT_TRUE(solver.getTorques(&q[0], &q_dot[0], &q_dotdot[0], NULL, &torques[0], *workspace));
+    state.setJointGroupPositions(group, q);
+    state.updateLinkTransforms();
+    ASSERT_TRUE(tree_solver.getTorques(state, &q_dot[0], &q_dotdot[0], &tree_torques[0], *tree_workspace));
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+      EXPECT_NEAR(tree_torques[j], torques[j], 1e-9);
+
+    // the overload that takes messages uses the shared workspace and must give the same result
+    std::vector<double> shared_torques(3);
+    ASSERT_TRUE(solver.getTorques(q, q_dot, q_dotdot, wrenches, shared_torques));
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+      EXPECT_NEAR(torques[j], shared_torques[j], 1e-12);
+  }
+}
+
+TEST_F(DynamicsSolverTest, BranchedTreeMatchesKDLChains)
+{
+  // each branch is checked against the KDL chain that leads to it; the joint the branches share carries both of
+  // them, so its torque is the sum of the torques of the two chains minus that of the trunk they have in common.
+  // KDL ignores the mimic tag, so the mimic joint is given the motion of its driver and its torque is accounted to
+  // the driver
+  boost::shared_ptr<urdf::ModelInterface> urdf_model = moveit::core::loadTestingURDF("branched_arm");
+  ASSERT_TRUE(urdf_model);
+  moveit::core::RobotModelConstPtr robot_model = moveit::core::loadTestingRobotModel("branched_arm");
+  ASSERT_TRUE(robot_model);
+
+  KDL::Tree tree;
+  ASSERT_TRUE(kdl_parser::treeFromUrdfModel(*urdf_model, tree));
+  KDL::Chain trunk, left, right;
+  ASSERT_TRUE(tree.getChain("base_link", "trunk", trunk));
+  ASSERT_TRUE(tree.getChain("base_link", "left_finger", left));
+  ASSERT_TRUE(tree.getChain("base_link", "right_link", right));
+  ASSERT_EQ(1u, trunk.getNrOfJoints());
+  ASSERT_EQ(3u, left.getNrOfJoints());
+  ASSERT_EQ(2u, right.getNrOfJoints());
+  const KDL::Vector gravity(gravity_.x, gravity_.y, gravity_.z);
+
+  dynamics_solver::TreeDynamicsSolver tree_solver(robot_model, "arm", gravity_);
+  ASSERT_TRUE(tree_solver.isValid());
+  dynamics_solver::TreeDynamicsSolverWorkspacePtr workspace = tree_solver.createWorkspace();
+
+  const robot_model::JointModelGroup *group = robot_model->getJointModelGroup("arm");
+  ASSERT_EQ(4u, group->getVariableCount());
+  const int shared = group->getVariableGroupIndex("joint1");
+  const int driver = group->getVariableGroupIndex("left_joint");
+  const int mimic = group->getVariableGroupIndex("left_finger_joint");
+  const int prismatic = group->getVariableGroupIndex("right_joint");
+  const double factor = -0.5;
+  const double offset = 0.1;
+
+  robot_state::RobotState state(robot_model);
+  state.setToDefaultValues();
+
+  std::vector<double> q(3), q_dot(3), q_dotdot(3);
+  std::vector<double> velocities(4), accelerations(4), torques(4);
+  Eigen::MatrixXd mass_matrix;
+  KDL::JntArray trunk_torques, left_torques, right_torques;
+  KDL::JntSpaceInertiaMatrix trunk_mass_matrix, left_mass_matrix, right_mass_matrix;
+  for (unsigned int i = 0 ; i < 50 ; ++i)
+  {
+    // the samples of the third variable stay within the range of the prismatic joint
+    getSample(i, q, q_dot, q_dotdot);
+    state.setVariablePosition("joint1", q[0]);
+    state.setVariablePosition("left_joint", q[1]);
+    state.setVariablePosition("right_joint", q[2]);
+    state.updateLinkTransforms();
+    ASSERT_NEAR(factor * q[1] + offset, state.getVariablePosition("left_finger_joint"), 1e-12);
+
+    velocities[shared] = q_dot[0];
+    velocities[driver] = q_dot[1];
+    velocities[mimic] = factor * q_dot[1];
+    velocities[prismatic] = q_dot[2];
+    accelerations[shared] = q_dotdot[0];
+    accelerations[driver] = q_dotdot[1];
+    accelerations[mimic] = factor * q_dotdot[1];
+    accelerations[prismatic] = q_dotdot[2];
+    ASSERT_TRUE(tree_solver.getTorques(state, &velocities[0], &accelerations[0], &torques[0], *workspace));
+    ASSERT_TRUE(tree_solver.getMassMatrix(state, mass_matrix, *workspace));
+    ASSERT_EQ(4, mass_matrix.rows());
+    ASSERT_EQ(4, mass_matrix.cols());
+
+    const double left_q[3] = { q[0], q[1], factor * q[1] + offset };
+    const double left_q_dot[3] = { q_dot[0], q_dot[1], factor * q_dot[1] };
+    const double left_q_dotdot[3] = { q_dotdot[0], q_dotdot[1], factor * q_dotdot[1] };
+    const double right_q[2] = { q[0], q[2] };
+    const double right_q_dot[2] = { q_dot[0], q_dot[2] };
+    const double right_q_dotdot[2] = { q_dotdot[0], q_dotdot[2] };
+    getChainTorques(trunk, gravity, &q[0], &q_dot[0], &q_dotdot[0], trunk_torques);
+    getChainTorques(left, gravity, left_q, left_q_dot, left_q_dotdot, left_torques);
+    getChainTorques(right, gravity, right_q, right_q_dot, right_q_dotdot, right_torques);
+    getChainMassMatrix(trunk, &q[0], trunk_mass_matrix);
+    getChainMassMatrix(left, left_q, left_mass_matrix);
+    getChainMassMatrix(right, right_q, right_mass_matrix);
+
+    EXPECT_NEAR(left_torques(0) + right_torques(0) - trunk_torques(0), torques[shared], 1e-9);
+    EXPECT_NEAR(left_torques(1) + factor * left_torques(2), torques[driver], 1e-9);
+    EXPECT_NEAR(right_torques(1), torques[prismatic], 1e-9);
+    EXPECT_EQ(0.0, torques[mimic]);
+
+    EXPECT_NEAR(left_mass_matrix(0, 0) + right_mass_matrix(0, 0) - trunk_mass_matrix(0, 0), mass_matrix(shared, shared), 1e-9);
+    EXPECT_NEAR(left_mass_matrix(0, 1) + factor * left_mass_matrix(0, 2), mass_matrix(shared, driver), 1e-9);
+    EXPECT_NEAR(right_mass_matrix(0, 1), mass_matrix(shared, prismatic), 1e-9);
+    EXPECT_NEAR(left_mass_matrix(1, 1) + 2.0 * factor * left_mass_matrix(1, 2) + factor * factor * left_mass_matrix(2, 2),
+                mass_matrix(driver, driver), 1e-9);
+    EXPECT_NEAR(right_mass_matrix(1, 1), mass_matrix(prismatic, prismatic), 1e-9);
+    // the branches do not couple, and the mimic joint has no rows or columns of its own
+    EXPECT_NEAR(0.0, mass_matrix(driver, prismatic), 1e-12);
+    for (int j = 0 ; j < 4 ; ++j)
+    {
+      EXPECT_EQ(0.0, mass_matrix(mimic, j));
+      EXPECT_EQ(0.0, mass_matrix(j, mimic));
+      for (int k = 0 ; k < 4 ; ++k)
+        EXPECT_NEAR(mass_matrix(j, k), mass_matrix(k, j), 1e-12);
+    }
+  }
+}
+
+TEST_F(DynamicsSolverTest, AttachedBodyMass)
+{
+  // a point mass m at p adds -m J^T g to the static torques and m J^T J to the mass matrix, where J is the
+  // Jacobian of the linear velocity of p
+  const double mass = 0.7;
+  dynamics_solver::TreeDynamicsSolver tree_solver(robot_model_, "arm", gravity_);
+  ASSERT_TRUE(tree_solver.isValid());
+  dynamics_solver::TreeDynamicsSolverWorkspacePtr workspace = tree_solver.createWorkspace();
+
+  const robot_model::JointModelGroup *group = robot_model_->getJointModelGroup("arm");
+  const robot_model::LinkModel *link = robot_model_->getLinkModel("link3");
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+
+  // the mass sits at the mean of the origins of the shapes
+  std::vector<shapes::ShapeConstPtr> body_shapes(2, shapes::ShapeConstPtr(new shapes::Sphere(0.05)));
+  EigenSTL::vector_Affine3d poses(2, Eigen::Affine3d::Identity());
+  poses[0].translation() = Eigen::Vector3d(0.1, 0.08, -0.02);
+  poses[1].translation() = Eigen::Vector3d(0.2, 0.02, 0.0);
+  const Eigen::Vector3d center(0.15, 0.05, -0.01);
+  state.attachBody("payload", body_shapes, poses, std::vector<std::string>(), "link3");
+
+  const Eigen::Vector3d gravity(gravity_.x, gravity_.y, gravity_.z);
+  std::vector<double> q(3), q_dot(3), q_dotdot(3), torques(3), loaded_torques(3), cleared_torques(3);
+  Eigen::MatrixXd mass_matrix, loaded_mass_matrix, jacobian;
+  for (unsigned int i = 0 ; i < 10 ; ++i)
+  {
+    getSample(i, q, q_dot, q_dotdot);
+    state.setJointGroupPositions(group, q);
+    state.updateLinkTransforms();
+
+    // the body has no effect until its mass is known
+    ASSERT_TRUE(tree_solver.getTorques(state, NULL, NULL, &torques[0], *workspace));
+    ASSERT_TRUE(tree_solver.getMassMatrix(state, mass_matrix, *workspace));
+    tree_solver.setAttachedBodyMass("payload", mass);
+    ASSERT_TRUE(tree_solver.getTorques(state, NULL, NULL, &loaded_torques[0], *workspace));
+    ASSERT_TRUE(tree_solver.getMassMatrix(state, loaded_mass_matrix, *workspace));
+    tree_solver.clearAttachedBodyMass("payload");
+    ASSERT_TRUE(tree_solver.getTorques(state, NULL, NULL, &cleared_torques[0], *workspace));
+
+    ASSERT_TRUE(state.getJacobian(group, link, center, jacobian));
+    const Eigen::MatrixXd linear = jacobian.topRows(3);
+    const Eigen::VectorXd expected_torques = -mass * linear.transpose() * gravity;
+    const Eigen::MatrixXd expected_mass_matrix = mass * linear.transpose() * linear;
+    for (std::size_t j = 0 ; j < 3 ; ++j)
+    {
+      EXPECT_NEAR(expected_torques(j), loaded_torques[j] - torques[j], 1e-9);
+      EXPECT_EQ(torques[j], cleared_torques[j]);
+      for (std::size_t k = 0 ; k < 3 ; ++k)
+        EXPECT_NEAR(expected_mass_matrix(j, k), loaded_mass_matrix(j, k) - mass_matrix(j, k), 1e-9);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
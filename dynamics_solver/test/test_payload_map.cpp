@@ -0,0 +1,222 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/dynamics_solver/payload_map.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+static const double G = 9.81;
+
+class PayloadTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("payload_arm");
+    ASSERT_TRUE(robot_model_);
+    geometry_msgs::Vector3 gravity;
+    gravity.z = -G;
+    solver_.reset(new dynamics_solver::DynamicsSolver(robot_model_, "arm", gravity));
+    ASSERT_TRUE(solver_->getGroup());
+  }
+
+  // The maximum payload at the tool, from the statics of the arm: for each joint, the torque needed to hold the
+  // links and the torque per kg of payload come from the horizontal distances to the masses and to the tool.
+  static double computeMaxPayload(double q1, double q2, unsigned int &joint_saturated)
+  {
+    // a rotation q about the y axis takes the x axis to (cos q, 0, -sin q)
+    const double c1 = cos(q1), c12 = cos(q1 + q2);
+    const double hold[2] = { -G * (2.0 * 0.25 * c1 + 1.0 * (0.5 * c1 + 0.2 * c12)), -G * 1.0 * 0.2 * c12 };
+    const double per_kg[2] = { -G * (0.5 * c1 + 0.4 * c12), -G * 0.4 * c12 };
+    const double limit[2] = { 20.0, 5.0 };
+    double payload = 0.0;
+    for (unsigned int j = 0 ; j < 2 ; ++j)
+    {
+      // the largest m >= 0 with |hold + m * per_kg| <= limit
+      const double m = per_kg[j] < 0.0 ? (limit[j] + hold[j]) / -per_kg[j] : (limit[j] - hold[j]) / per_kg[j];
+      if (j == 0 || m < payload)
+      {
+        payload = m;
+        joint_saturated = j;
+      }
+    }
+    return payload;
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  dynamics_solver::DynamicsSolverPtr solver_;
+};
+
+TEST_F(PayloadTest, MaxPayloadMatchesStatics)
+{
+  // horizontal arm: link2 holds 1 * 0.2 * g and the payload adds 0.4 * g per kg, so joint2 saturates at 3.038 / 3.924 kg
+  unsigned int joint_saturated = 0;
+  double payload = 0.0;
+  ASSERT_TRUE(solver_->getMaxPayload(std::vector<double>(2, 0.0), payload, joint_saturated));
+  EXPECT_NEAR((5.0 - 0.2 * G) / (0.4 * G), payload, 1e-9);
+  EXPECT_EQ(1u, joint_saturated);
+
+  // the payload torques at that payload reach the limit of joint2
+  std::vector<double> torques(2);
+  ASSERT_TRUE(solver_->getPayloadTorques(std::vector<double>(2, 0.0), payload, torques));
+  EXPECT_NEAR(-5.0, torques[1], 1e-9);
+  EXPECT_NEAR(-G * (0.5 + 0.7 + 0.9 * payload), torques[0], 1e-9);
+
+  // a batch over the workspace
+  std::vector<double> configurations;
+  for (int i = -2 ; i <= 2 ; ++i)
+    for (int k = -1 ; k <= 1 ; ++k)
+    {
+      configurations.push_back(0.5 * i);
+      configurations.push_back(0.5 * k);
+    }
+  std::vector<double> payloads;
+  std::vector<unsigned int> joints_saturated;
+  ASSERT_TRUE(solver_->getMaxPayloads(configurations, payloads, joints_saturated, 3));
+  ASSERT_EQ(configurations.size() / 2, payloads.size());
+  for (std::size_t c = 0 ; c < payloads.size() ; ++c)
+  {
+    const double expected = computeMaxPayload(configurations[2 * c], configurations[2 * c + 1], joint_saturated);
+    EXPECT_NEAR(expected, payloads[c], 1e-9 * std::max(1.0, expected));
+    EXPECT_EQ(joint_saturated, joints_saturated[c]);
+  }
+
+  // with the second link pointing down, only the first joint carries the payload
+  std::vector<double> down(2, 0.0);
+  down[1] = M_PI / 2.0;
+  ASSERT_TRUE(solver_->getMaxPayload(down, payload, joint_saturated));
+  EXPECT_NEAR((20.0 - G) / (0.5 * G), payload, 1e-9);
+  EXPECT_EQ(0u, joint_saturated);
+}
+
+TEST_F(PayloadTest, PayloadMapLookups)
+{
+  dynamics_solver::PayloadMap map(solver_, 0.5);
+  ASSERT_TRUE(map.isValid());
+  EXPECT_EQ(0u, map.getCellCount());
+
+  // nothing is known until the cell is computed
+  std::vector<double> q(2);
+  q[0] = 0.1;
+  q[1] = 0.2;
+  double payload = 0.0, error_estimate = 0.0;
+  EXPECT_FALSE(map.findMaxPayload(&q[0], payload, error_estimate));
+  ASSERT_TRUE(map.getMaxPayload(q, payload, error_estimate));
+  EXPECT_EQ(1u, map.getCellCount());
+
+  // the cell is [0, 0.5] x [0, 0.5] and the payload is the one at its center
+  unsigned int joint_saturated;
+  EXPECT_NEAR(computeMaxPayload(0.25, 0.25, joint_saturated), payload, 1e-9);
+  EXPECT_GE(error_estimate, 0.0);
+  // moving from the center to an edge along one joint changes the payload by at most the estimate
+  EXPECT_LE(fabs(computeMaxPayload(0.0, 0.25, joint_saturated) - payload), error_estimate + 1e-9);
+  EXPECT_LE(fabs(computeMaxPayload(0.25, 0.5, joint_saturated) - payload), error_estimate + 1e-9);
+
+  // other configurations in the same cell are found without computing anything
+  double same_payload, same_error_estimate;
+  q[0] = 0.45;
+  q[1] = 0.01;
+  ASSERT_TRUE(map.findMaxPayload(&q[0], same_payload, same_error_estimate));
+  EXPECT_EQ(payload, same_payload);
+  EXPECT_EQ(error_estimate, same_error_estimate);
+  ASSERT_TRUE(map.getMaxPayload(q, same_payload, same_error_estimate));
+  EXPECT_EQ(1u, map.getCellCount());
+
+  // configurations outside the bounds map to the closest cell, [2.5, 3] x [-3, -2.5]
+  q[0] = 10.0;
+  q[1] = -10.0;
+  ASSERT_TRUE(map.getMaxPayload(q, payload, error_estimate));
+  EXPECT_NEAR(computeMaxPayload(2.75, -2.75, joint_saturated), payload, 1e-9);
+  q[0] = 2.9;
+  q[1] = -2.9;
+  ASSERT_TRUE(map.findMaxPayload(&q[0], same_payload, same_error_estimate));
+  EXPECT_EQ(payload, same_payload);
+  EXPECT_EQ(2u, map.getCellCount());
+
+  // a batch adds each missing cell once: the first four configurations share [-1, -0.5] x [1, 1.5]
+  // and the last one is in the first cell
+  std::vector<double> batch;
+  for (int i = 0 ; i < 4 ; ++i)
+  {
+    batch.push_back(-1.0 + 0.1 * i);
+    batch.push_back(1.2);
+  }
+  batch.push_back(0.3);
+  batch.push_back(0.3);
+  ASSERT_TRUE(map.precompute(batch, 2));
+  EXPECT_EQ(3u, map.getCellCount());
+  q[0] = -0.6;
+  q[1] = 1.4;
+  ASSERT_TRUE(map.findMaxPayload(&q[0], payload, error_estimate));
+  EXPECT_NEAR(computeMaxPayload(-0.75, 1.25, joint_saturated), payload, 1e-9);
+  EXPECT_FALSE(map.precompute(std::vector<double>(3, 0.0)));
+
+  // the wrong number of joint values is rejected
+  EXPECT_FALSE(map.getMaxPayload(std::vector<double>(3, 0.0), payload, error_estimate));
+
+  map.clear();
+  EXPECT_EQ(0u, map.getCellCount());
+  EXPECT_FALSE(map.findMaxPayload(&q[0], payload, error_estimate));
+}
+
+TEST_F(PayloadTest, PayloadMapDefaults)
+{
+  // the resolution applies to every joint unless given per joint, and must be positive
+  EXPECT_TRUE(dynamics_solver::PayloadMap(solver_, 0.1).isValid());
+  EXPECT_FALSE(dynamics_solver::PayloadMap(solver_, 0.0).isValid());
+  EXPECT_FALSE(dynamics_solver::PayloadMap(solver_, -0.1).isValid());
+  std::vector<double> resolutions(2, 0.2);
+  EXPECT_TRUE(dynamics_solver::PayloadMap(solver_, resolutions).isValid());
+  resolutions.push_back(0.2);
+  EXPECT_FALSE(dynamics_solver::PayloadMap(solver_, resolutions).isValid());
+  EXPECT_FALSE(dynamics_solver::PayloadMap(dynamics_solver::DynamicsSolverConstPtr(), 0.1).isValid());
+  // too many cells to be indexed
+  EXPECT_FALSE(dynamics_solver::PayloadMap(solver_, 1e-12).isValid());
+
+  // an invalid map answers nothing
+  dynamics_solver::PayloadMap invalid(solver_, 0.0);
+  std::vector<double> q(2, 0.0);
+  double payload, error_estimate;
+  EXPECT_FALSE(invalid.getMaxPayload(q, payload, error_estimate));
+  EXPECT_FALSE(invalid.precompute(q));
+  EXPECT_EQ(0u, invalid.getCellCount());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
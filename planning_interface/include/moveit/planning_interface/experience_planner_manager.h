@@ -0,0 +1,145 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PLANNING_INTERFACE_EXPERIENCE_PLANNER_MANAGER_
+#define MOVEIT_PLANNING_INTERFACE_EXPERIENCE_PLANNER_MANAGER_
+
+#include <moveit/planning_interface/planning_interface.h>
+#include <moveit/planning_interface/path_library.h>
+
+namespace planning_interface
+{
+
+/** \brief A planner manager that reuses previously computed paths, on top of another planner manager.
+
+    Successful paths are stored in a PathLibrary. For a new request whose goal is given as joint constraints
+    for all variables of the group, the paths whose start and goal configurations are closest to the request are
+    retrieved. Each retrieved path is attached to the start state and goal configuration of the request, sampled
+    at the configured resolution and checked against the current planning scene. Only the invalid parts of the
+    path are planned again, with the underlying planner, between the closest valid waypoints around them. At the
+    same time, unless racing is disabled, the underlying planner solves the request from scratch; whichever
+    solution is available first is returned and the other computation is terminated. */
+class ExperiencePlannerManager : public PlannerManager
+{
+public:
+
+  /** \brief Wrap \e planner. If \e library is empty, a new library is constructed. Several managers can share a library. */
+  ExperiencePlannerManager(const PlannerManagerPtr &planner, const PathLibraryPtr &library = PathLibraryPtr());
+
+  virtual bool initialize(const robot_model::RobotModelConstPtr& model, const std::string &ns);
+
+  virtual std::string getDescription() const;
+
+  virtual void getPlanningAlgorithms(std::vector<std::string> &algs) const;
+
+  virtual PlanningContextPtr getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                const MotionPlanRequest &req,
+                                                moveit_msgs::MoveItErrorCodes &error_code) const;
+
+  using PlannerManager::getPlanningContext;
+
+  virtual bool canServiceRequest(const MotionPlanRequest &req) const;
+
+  virtual void setPlannerConfigurations(const PlannerConfigurationMap &pcs);
+
+  const PlannerManagerPtr& getPlannerManager() const
+  {
+    return planner_;
+  }
+
+  const PathLibraryPtr& getPathLibrary() const
+  {
+    return library_;
+  }
+
+  /** \brief Set the number of library paths tried for a request (default 3) */
+  void setCandidateCount(unsigned int count)
+  {
+    candidate_count_ = count;
+  }
+
+  unsigned int getCandidateCount() const
+  {
+    return candidate_count_;
+  }
+
+  /** \brief Set the largest joint space distance between the states at which a retrieved path is checked (default 0.05) */
+  void setResolution(double resolution)
+  {
+    resolution_ = resolution;
+  }
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  /** \brief Enable or disable solving from scratch while library paths are repaired (enabled by default).
+      If disabled, the request is solved from scratch only when no library path can be repaired. */
+  void setRaceFromScratch(bool race)
+  {
+    race_ = race;
+  }
+
+  bool getRaceFromScratch() const
+  {
+    return race_;
+  }
+
+  /** \brief Enable or disable adding the solutions of this manager to the library (enabled by default) */
+  void setRecordSolutions(bool record)
+  {
+    record_ = record;
+  }
+
+  bool getRecordSolutions() const
+  {
+    return record_;
+  }
+
+private:
+
+  PlannerManagerPtr planner_;
+  PathLibraryPtr library_;
+  unsigned int candidate_count_;
+  double resolution_;
+  bool race_;
+  bool record_;
+};
+
+MOVEIT_CLASS_FORWARD(ExperiencePlannerManager);
+
+}
+
+#endif
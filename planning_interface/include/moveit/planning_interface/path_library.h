@@ -0,0 +1,140 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PLANNING_INTERFACE_PATH_LIBRARY_
+#define MOVEIT_PLANNING_INTERFACE_PATH_LIBRARY_
+
+#include <moveit/macros/class_forward.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <map>
+
+namespace planning_interface
+{
+
+/** \brief A bounded collection of previously computed paths, indexed by their start and goal configurations.
+
+    Paths are stored per group, as the sequence of group variable values of their waypoints. For each group
+    a kd-tree over the concatenated start and goal configurations answers nearest neighbor queries; distances
+    are Euclidean in joint space. The tree is rebuilt lazily, at the first query after the library changed.
+    When the capacity is reached, the oldest path is removed. All functions are thread safe. */
+class PathLibrary
+{
+public:
+
+  /** \brief A stored path */
+  struct Path
+  {
+    /// The group the path is for
+    std::string group_;
+
+    /// The values of the group variables for each waypoint of the path
+    std::vector<std::vector<double> > waypoints_;
+  };
+
+  typedef boost::shared_ptr<const Path> PathConstPtr;
+
+  /** \brief Construct a library holding at most \e capacity paths for each group */
+  PathLibrary(std::size_t capacity = 1000);
+
+  void setCapacity(std::size_t capacity);
+
+  std::size_t getCapacity() const;
+
+  /** \brief Add the group variable values of the waypoints of \e trajectory. Trajectories without a group or with
+      fewer than two waypoints are ignored. */
+  void addPath(const robot_trajectory::RobotTrajectory &trajectory);
+
+  /** \brief Add a path given directly as a sequence of values for the variables of \e group */
+  void addPath(const std::string &group, const std::vector<std::vector<double> > &waypoints);
+
+  /** \brief Find at most \e count paths for \e group whose start and goal configurations are closest to \e start and \e goal.
+      The paths are sorted by increasing distance; \e distances, if not NULL, receives the corresponding distances. */
+  void getNearestPaths(const std::string &group, const std::vector<double> &start, const std::vector<double> &goal, std::size_t count,
+                       std::vector<PathConstPtr> &paths, std::vector<double> *distances = NULL) const;
+
+  /** \brief Get the number of paths stored for \e group */
+  std::size_t getPathCount(const std::string &group) const;
+
+  /** \brief Get the number of paths stored for all groups */
+  std::size_t getPathCount() const;
+
+  void clear();
+
+private:
+
+  struct KdNode
+  {
+    std::size_t path_;
+    std::size_t axis_;
+    double split_;
+    int left_;
+    int right_;
+  };
+
+  struct GroupPaths
+  {
+    GroupPaths() : dirty_(false)
+    {
+    }
+
+    std::deque<PathConstPtr> paths_;
+
+    /// The concatenated start and goal configuration of each path, in the same order as paths_
+    std::deque<std::vector<double> > keys_;
+
+    std::vector<KdNode> tree_;
+    bool dirty_;
+  };
+
+  /// Build the subtree for the paths index[begin, end) and return the index of its root node, or -1 if the range is empty
+  static int buildTree(GroupPaths &group, std::vector<std::size_t> &index, std::size_t begin, std::size_t end);
+
+  /// Add the paths of the subtree rooted at \e node to \e best, a max-heap of (squared distance, path index) with at most \e count elements
+  static void searchTree(const GroupPaths &group, int node, const std::vector<double> &query, std::size_t count,
+                         std::vector<std::pair<double, std::size_t> > &best);
+
+  std::size_t capacity_;
+
+  /// The paths of each group; mutable because queries rebuild the index
+  mutable std::map<std::string, GroupPaths> groups_;
+  mutable boost::mutex lock_;
+};
+
+MOVEIT_CLASS_FORWARD(PathLibrary);
+
+}
+
+#endif
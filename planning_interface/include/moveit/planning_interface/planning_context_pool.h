@@ -0,0 +1,161 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PLANNING_INTERFACE_PLANNING_CONTEXT_POOL_
+#define MOVEIT_PLANNING_INTERFACE_PLANNING_CONTEXT_POOL_
+
+#include <moveit/planning_interface/planning_interface.h>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace planning_interface
+{
+
+/** \brief Keep planning contexts around between requests so that their data structures are reused.
+
+    Contexts are identified by the group and the planner_id of the request they were constructed for. A context
+    is taken out of the pool with checkout() and given back with checkin(), which clears it so that the next
+    request starts with a clean planner. A context is only kept if it can be reconfigured for the next request
+    (PlanningContext::canReconfigure()). If no idle context is available, a new one is constructed by the planner
+    manager. All functions of the pool are thread safe. */
+class PlanningContextPool
+{
+public:
+
+  /** \brief Counters describing how well the pool is used */
+  struct Statistics
+  {
+    Statistics() :
+      checkouts_(0),
+      hits_(0),
+      misses_(0),
+      failures_(0),
+      evictions_(0),
+      discarded_(0)
+    {
+    }
+
+    /** \brief The fraction of checkouts that reused an existing context */
+    double getHitRate() const
+    {
+      return checkouts_ > 0 ? (double)hits_ / (double)checkouts_ : 0.0;
+    }
+
+    /// The number of calls to checkout()
+    std::size_t checkouts_;
+
+    /// The number of checkouts that reused an idle context
+    std::size_t hits_;
+
+    /// The number of checkouts that constructed a new context
+    std::size_t misses_;
+
+    /// The number of checkouts for which a context could not be constructed
+    std::size_t failures_;
+
+    /// The number of contexts given back to the pool that were discarded because the pool was full
+    std::size_t evictions_;
+
+    /// The number of contexts given back to the pool that were discarded because they cannot be reconfigured
+    std::size_t discarded_;
+  };
+
+  /** \brief Construct a pool for contexts from \e planner. At most \e max_idle_contexts idle contexts are kept
+      for every combination of group and planner_id. */
+  PlanningContextPool(const PlannerManagerPtr &planner, std::size_t max_idle_contexts = 2);
+
+  const PlannerManagerPtr& getPlannerManager() const
+  {
+    return planner_;
+  }
+
+  void setMaxIdleContexts(std::size_t max_idle_contexts);
+
+  std::size_t getMaxIdleContexts() const
+  {
+    return max_idle_contexts_;
+  }
+
+  /** \brief Get a context for \e req in \e planning_scene. An idle context for the same group and planner_id is reused
+      if there is one, and reconfigured for \e planning_scene and \e req. Otherwise (or if reconfiguring fails) a context
+      is constructed by the planner manager. If that fails, \e error_code is set and an empty pointer is returned. The context is not used by the
+      pool until it is given back with checkin(). */
+  PlanningContextPtr checkout(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req,
+                              moveit_msgs::MoveItErrorCodes &error_code);
+
+  /** \brief Give back a context obtained from checkout(). The context is cleared and kept for later requests,
+      unless it cannot be reconfigured or the pool already holds the maximum number of idle contexts for it. The caller must not use the context
+      afterwards. Contexts that were not obtained from this pool are ignored. */
+  void checkin(const PlanningContextPtr &context);
+
+  /** \brief Check out a context for \e req, solve it and check it back in. Returns the result of PlanningContext::solve() */
+  bool solve(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req, MotionPlanResponse &res);
+
+  /** \brief Discard all idle contexts. Contexts that are checked out are not affected. */
+  void clear();
+
+  /** \brief Get the number of idle contexts held by the pool */
+  std::size_t getIdleContextCount() const;
+
+  /** \brief Get the number of contexts currently checked out */
+  std::size_t getCheckedOutContextCount() const;
+
+  Statistics getStatistics() const;
+
+  void resetStatistics();
+
+private:
+
+  static std::string getKey(const MotionPlanRequest &req);
+
+  PlannerManagerPtr planner_;
+  std::size_t max_idle_contexts_;
+
+  /// Idle contexts, by the key computed from the request
+  std::map<std::string, std::vector<PlanningContextPtr> > idle_;
+
+  /// The keys of the contexts that are checked out
+  std::map<PlanningContext*, std::string> checked_out_;
+
+  Statistics statistics_;
+  mutable boost::mutex lock_;
+};
+
+MOVEIT_CLASS_FORWARD(PlanningContextPool);
+
+}
+
+#endif
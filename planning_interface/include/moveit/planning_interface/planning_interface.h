@@ -114,6 +114,21 @@ public:
   /** \brief Set the planning request for this context */
   void setMotionPlanRequest(const MotionPlanRequest &request);
 
+  /** \brief Return true if reconfigure() can prepare this context for a new request, so that the context can be
+      reused (e.g., by PlanningContextPool) instead of constructing a new one. The default is false. */
+  virtual bool canReconfigure() const
+  {
+    return false;
+  }
+
+  /** \brief Prepare a cleared context to solve \e req in \e planning_scene, with the same result as constructing a new
+      context for them with PlannerManager::getPlanningContext(). The default implementation only sets the planning
+      scene and the request; contexts that set up the start state, goals or constraints when they are constructed need
+      to do that here as well, before reporting canReconfigure(). If a problem is encountered, \e error_code is set
+      and false is returned. */
+  virtual bool reconfigure(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req,
+                           moveit_msgs::MoveItErrorCodes &error_code);
+
   /** \brief Solve the motion planning problem and store the result in \e res. This function should not clear data structures before computing. The constructor and clear() do that. */
   virtual bool solve(MotionPlanResponse &res) = 0;
 
@@ -169,6 +184,7 @@ public:
 
   /// \brief Construct a planning context given the current scene and a planning request. If a problem is encountered, error code is set and empty ptr is returned.
   /// The returned motion planner context is clean -- the motion planner will start from scratch every time a context is constructed.
+  /// To reuse contexts across similar requests, see PlanningContextPool.
   /// \param planning_scene A const planning scene to use for planning
   /// \param req The representation of the planning request
   /// \param error_code This is where the error is set if constructing the planning context fails
@@ -0,0 +1,165 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PLANNING_INTERFACE_PLANNING_PORTFOLIO_
+#define MOVEIT_PLANNING_INTERFACE_PLANNING_PORTFOLIO_
+
+#include <moveit/planning_interface/planning_interface.h>
+#include <string>
+#include <vector>
+
+namespace planning_interface
+{
+
+/** \brief Solve a motion planning request with several planning contexts at the same time.
+
+    Each member of the portfolio is a planner_id (usually the name of an entry in the PlannerConfigurationMap
+    of the planner manager) that is substituted into the request before a context is constructed for it.
+    The same planner_id can be added more than once, so that a randomized planner is run with different seeds.
+    The contexts are solved by tasks of the TaskScheduler shared by the process, so no more of them run at the
+    same time than the scheduler has idle workers; contexts that are no longer needed are stopped through
+    PlanningContext::terminate(). */
+class PlanningPortfolio
+{
+public:
+
+  /** \brief How the solution of the portfolio is selected */
+  enum Mode
+  {
+    /** \brief Keep the first valid solution and terminate the other contexts */
+    FIRST_SOLUTION,
+
+    /** \brief Let all contexts run (up to the allowed planning time of the request) and keep the shortest solution */
+    BEST_SOLUTION
+  };
+
+  /** \brief The outcome of one member of the portfolio */
+  struct MemberResult
+  {
+    MemberResult() :
+      solved_(false),
+      terminated_(false),
+      planning_time_(0.0),
+      path_length_(0.0)
+    {
+    }
+
+    /// The planner_id used for this member
+    std::string planner_id_;
+
+    /// The name of the context that was constructed for this member (empty if construction failed)
+    std::string context_name_;
+
+    /// True if the context found a solution
+    bool solved_;
+
+    /// True if the context was terminated, or never started, because the portfolio no longer needed it
+    bool terminated_;
+
+    /// Wall-clock time spent in PlanningContext::solve() for this member
+    double planning_time_;
+
+    /// The length of the solution in joint space (0 if there is no solution)
+    double path_length_;
+
+    /// The error code reported by the context
+    moveit_msgs::MoveItErrorCodes error_code_;
+  };
+
+  PlanningPortfolio(const PlannerManagerPtr &planner, Mode mode = FIRST_SOLUTION);
+
+  const PlannerManagerPtr& getPlannerManager() const
+  {
+    return planner_;
+  }
+
+  Mode getMode() const
+  {
+    return mode_;
+  }
+
+  void setMode(Mode mode)
+  {
+    mode_ = mode;
+  }
+
+  /** \brief Set the maximum number of contexts solved at the same time. 0 (the default) means one task per member. */
+  void setMaxThreads(unsigned int threads)
+  {
+    max_threads_ = threads;
+  }
+
+  unsigned int getMaxThreads() const
+  {
+    return max_threads_;
+  }
+
+  /** \brief Add a member using \e planner_id. If \e replicas is larger than 1, that many independent contexts are run for it. */
+  void addPlanner(const std::string &planner_id, unsigned int replicas = 1);
+
+  /** \brief Add one member for each planner configuration of the planner manager that is meant for \e group */
+  void addPlannerConfigurations(const std::string &group, unsigned int replicas = 1);
+
+  /** \brief Remove all members */
+  void clearPlanners();
+
+  /** \brief Get the planner_id values of the members, including replicas */
+  const std::vector<std::string>& getPlanners() const
+  {
+    return planner_ids_;
+  }
+
+  /** \brief Solve \e req in \e planning_scene using all members of the portfolio. If the portfolio has no members,
+      the request is solved as is, by a single context. The planning time of \e res is the wall-clock time from the
+      start of this call. If \e member_results is not NULL, the outcome of every member is stored there, in the
+      order in which the members were added. Returns true if a solution was found. */
+  bool solve(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req,
+             MotionPlanResponse &res, std::vector<MemberResult> *member_results = NULL) const;
+
+  /** \brief Compute the length of \e trajectory as the sum of the joint space distances between consecutive waypoints */
+  static double getPathLength(const robot_trajectory::RobotTrajectory &trajectory);
+
+private:
+
+  PlannerManagerPtr planner_;
+  Mode mode_;
+  unsigned int max_threads_;
+  std::vector<std::string> planner_ids_;
+};
+
+MOVEIT_CLASS_FORWARD(PlanningPortfolio);
+
+}
+
+#endif
@@ -0,0 +1,490 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/experience_planner_manager.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit/background_processing/task_scheduler.h>
+#include <console_bridge/console.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#include <ros/time.h>
+#include <cmath>
+
+namespace planning_interface
+{
+
+namespace
+{
+
+// tolerance of the joint space goals used when parts of a retrieved path are planned again
+static const double REPAIR_GOAL_TOLERANCE = 1e-3;
+
+class ExperiencePlanningContext : public PlanningContext
+{
+public:
+
+  ExperiencePlanningContext(const PlannerManagerPtr &planner, const PathLibraryPtr &library, const PlanningContextPtr &scratch,
+                            unsigned int candidate_count, double resolution, bool race, bool record) :
+    PlanningContext(scratch->getName(), scratch->getGroupName()),
+    planner_(planner),
+    library_(library),
+    scratch_(scratch),
+    candidate_count_(candidate_count),
+    resolution_(resolution > 0.0 ? resolution : 0.05),
+    race_(race),
+    record_(record),
+    scratch_started_(false),
+    scratch_cancelled_(false),
+    scratch_done_(false),
+    scratch_solved_(false),
+    terminated_(false)
+  {
+  }
+
+  virtual bool solve(MotionPlanResponse &res);
+
+  virtual bool solve(MotionPlanDetailedResponse &res)
+  {
+    MotionPlanResponse single;
+    bool result = solve(single);
+    res.trajectory_.clear();
+    res.description_.clear();
+    res.processing_time_.clear();
+    if (result)
+    {
+      res.trajectory_.push_back(single.trajectory_);
+      res.description_.push_back("plan");
+      res.processing_time_.push_back(single.planning_time_);
+    }
+    res.error_code_ = single.error_code_;
+    return result;
+  }
+
+  virtual bool terminate()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    terminated_ = true;
+    bool result = scratch_->terminate();
+    if (repair_context_)
+      result = repair_context_->terminate() && result;
+    return result;
+  }
+
+  virtual void clear()
+  {
+    scratch_->clear();
+  }
+
+private:
+
+  void solveFromScratch();
+
+  /// Solve from scratch as a task of the scheduler, unless the result is no longer needed when the task starts
+  void raceFromScratch();
+
+  /// True if the computation on library paths is no longer needed
+  bool shouldStop()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    return terminated_ || scratch_solved_;
+  }
+
+  /// Get the goal configuration of the request, if a goal specifies all variables of \e group with joint constraints
+  bool getGoalConfiguration(const robot_model::JointModelGroup *group, std::vector<double> &goal) const;
+
+  /// Find a library path for the request and repair it if needed; \e repaired is set to true if parts of the path were planned again
+  robot_trajectory::RobotTrajectoryPtr retrieveAndRepair(const ros::WallTime &deadline, bool &repaired);
+
+  robot_trajectory::RobotTrajectoryPtr repairPath(const PathLibrary::Path &path, const robot_state::RobotState &start_state,
+                                                  const robot_state::RobotState &goal_state, const robot_model::JointModelGroup *group,
+                                                  const ros::WallTime &deadline, bool &repaired);
+
+  robot_trajectory::RobotTrajectoryPtr planSegment(const robot_state::RobotState &from, const robot_state::RobotState &to,
+                                                   const robot_model::JointModelGroup *group, const ros::WallTime &deadline);
+
+  /// Append states to \e trajectory that lead from its last waypoint to \e to, at most resolution_ apart
+  void appendInterpolated(robot_trajectory::RobotTrajectory &trajectory, const robot_state::RobotState &to,
+                          const robot_model::JointModelGroup *group) const;
+
+  PlannerManagerPtr planner_;
+  PathLibraryPtr library_;
+  PlanningContextPtr scratch_;
+  unsigned int candidate_count_;
+  double resolution_;
+  bool race_;
+  bool record_;
+
+  // the members below are protected by lock_
+  boost::mutex lock_;
+  boost::condition_variable condition_;
+  PlanningContextPtr repair_context_;
+  MotionPlanResponse scratch_res_;
+  bool scratch_started_;
+  bool scratch_cancelled_;
+  bool scratch_done_;
+  bool scratch_solved_;
+  bool terminated_;
+};
+
+void ExperiencePlanningContext::solveFromScratch()
+{
+  MotionPlanResponse res;
+  bool solved = scratch_->solve(res) && res.trajectory_ && !res.trajectory_->empty();
+
+  boost::mutex::scoped_lock slock(lock_);
+  scratch_res_ = res;
+  scratch_done_ = true;
+  scratch_solved_ = solved;
+  if (solved && repair_context_)
+    repair_context_->terminate();
+  condition_.notify_all();
+}
+
+void ExperiencePlanningContext::raceFromScratch()
+{
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    if (scratch_cancelled_ || terminated_)
+    {
+      scratch_done_ = true;
+      condition_.notify_all();
+      return;
+    }
+    scratch_started_ = true;
+  }
+  solveFromScratch();
+}
+
+bool ExperiencePlanningContext::solve(MotionPlanResponse &res)
+{
+  ros::WallTime start = ros::WallTime::now();
+  ros::WallTime deadline = start + ros::WallDuration(request_.allowed_planning_time);
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    scratch_res_ = MotionPlanResponse();
+    scratch_started_ = false;
+    scratch_cancelled_ = false;
+    scratch_done_ = false;
+    scratch_solved_ = false;
+    terminated_ = false;
+  }
+
+  // solving from scratch can take as long as the library search, so it runs on the scheduler shared by the process
+  moveit::tools::TaskScheduler::TaskGroup scratch_group;
+  if (race_)
+    scratch_group.run(boost::bind(&ExperiencePlanningContext::raceFromScratch, this));
+
+  bool modified = false;
+  robot_trajectory::RobotTrajectoryPtr reused = retrieveAndRepair(deadline, modified);
+
+  bool from_library = false;
+  if (race_)
+  {
+    {
+      boost::mutex::scoped_lock slock(lock_);
+      from_library = reused && !scratch_solved_;
+      // a scratch task that has not started does not solve any more; one that has is terminated, repeatedly,
+      // in case the context had not entered solve() yet when it was first called
+      scratch_cancelled_ = from_library;
+      while (scratch_started_ && !scratch_done_)
+      {
+        if (from_library || terminated_)
+          scratch_->terminate();
+        condition_.timed_wait(slock, boost::posix_time::milliseconds(10));
+      }
+    }
+    // if no worker took the task yet, it is executed here
+    scratch_group.wait();
+  }
+  else
+  {
+    from_library = reused;
+    if (!from_library && !shouldStop())
+      solveFromScratch();
+  }
+
+  if (from_library)
+  {
+    logDebug("Solved the request for group '%s' by reusing a path from the library", request_.group_name.c_str());
+    res.trajectory_ = reused;
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+  else
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    res.trajectory_ = scratch_solved_ ? scratch_res_.trajectory_ : robot_trajectory::RobotTrajectoryPtr();
+    res.error_code_ = scratch_res_.error_code_;
+    if (!scratch_solved_ && res.error_code_.val == moveit_msgs::MoveItErrorCodes::SUCCESS)
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+  }
+  res.planning_time_ = (ros::WallTime::now() - start).toSec();
+
+  // paths reused without changes are already in the library
+  bool solved = res.trajectory_ && !res.trajectory_->empty();
+  if (solved && record_ && (!from_library || modified))
+    library_->addPath(*res.trajectory_);
+  return solved;
+}
+
+bool ExperiencePlanningContext::getGoalConfiguration(const robot_model::JointModelGroup *group, std::vector<double> &goal) const
+{
+  const std::vector<std::string> &names = group->getVariableNames();
+  for (std::size_t i = 0 ; i < request_.goal_constraints.size() ; ++i)
+  {
+    const std::vector<moveit_msgs::JointConstraint> &jc = request_.goal_constraints[i].joint_constraints;
+    std::map<std::string, double> values;
+    for (std::size_t j = 0 ; j < jc.size() ; ++j)
+      values[jc[j].joint_name] = jc[j].position;
+
+    goal.resize(names.size());
+    bool complete = true;
+    for (std::size_t j = 0 ; j < names.size() && complete ; ++j)
+    {
+      std::map<std::string, double>::const_iterator it = values.find(names[j]);
+      if (it == values.end())
+        complete = false;
+      else
+        goal[j] = it->second;
+    }
+    if (complete)
+      return true;
+  }
+  return false;
+}
+
+robot_trajectory::RobotTrajectoryPtr ExperiencePlanningContext::retrieveAndRepair(const ros::WallTime &deadline, bool &repaired)
+{
+  repaired = false;
+  const robot_model::RobotModelConstPtr &robot_model = planning_scene_->getRobotModel();
+  if (candidate_count_ == 0 || !robot_model->hasJointModelGroup(request_.group_name))
+    return robot_trajectory::RobotTrajectoryPtr();
+  const robot_model::JointModelGroup *group = robot_model->getJointModelGroup(request_.group_name);
+
+  std::vector<double> goal;
+  if (!getGoalConfiguration(group, goal))
+  {
+    logDebug("The goal of the request for group '%s' is not a joint space goal; the path library is not used", request_.group_name.c_str());
+    return robot_trajectory::RobotTrajectoryPtr();
+  }
+
+  robot_state::RobotStatePtr start_state = planning_scene_->getCurrentStateUpdated(request_.start_state);
+  std::vector<double> start;
+  start_state->copyJointGroupPositions(group, start);
+  robot_state::RobotState goal_state(*start_state);
+  goal_state.setJointGroupPositions(group, goal);
+  goal_state.update();
+
+  std::vector<PathLibrary::PathConstPtr> paths;
+  library_->getNearestPaths(request_.group_name, start, goal, candidate_count_, paths);
+  for (std::size_t i = 0 ; i < paths.size() ; ++i)
+  {
+    if (shouldStop() || ros::WallTime::now() >= deadline)
+      break;
+    robot_trajectory::RobotTrajectoryPtr trajectory = repairPath(*paths[i], *start_state, goal_state, group, deadline, repaired);
+    if (trajectory)
+      return trajectory;
+  }
+  return robot_trajectory::RobotTrajectoryPtr();
+}
+
+void ExperiencePlanningContext::appendInterpolated(robot_trajectory::RobotTrajectory &trajectory, const robot_state::RobotState &to,
+                                                   const robot_model::JointModelGroup *group) const
+{
+  const robot_state::RobotState &from = trajectory.getLastWayPoint();
+  std::size_t steps = std::max<std::size_t>(1, (std::size_t)ceil(from.distance(to, group) / resolution_));
+  robot_state::RobotStatePtr previous = trajectory.getLastWayPointPtr();
+  for (std::size_t s = 1 ; s < steps ; ++s)
+  {
+    robot_state::RobotStatePtr state(new robot_state::RobotState(*previous));
+    previous->interpolate(to, (double)s / (double)steps, *state, group);
+    trajectory.addSuffixWayPoint(state, 0.0);
+  }
+  trajectory.addSuffixWayPoint(to, 0.0);
+}
+
+robot_trajectory::RobotTrajectoryPtr ExperiencePlanningContext::repairPath(const PathLibrary::Path &path, const robot_state::RobotState &start_state,
+                                                                           const robot_state::RobotState &goal_state, const robot_model::JointModelGroup *group,
+                                                                           const ros::WallTime &deadline, bool &repaired)
+{
+  repaired = false;
+
+  // attach the stored path to the start and goal of the request
+  robot_trajectory::RobotTrajectoryPtr candidate(new robot_trajectory::RobotTrajectory(planning_scene_->getRobotModel(), group));
+  candidate->addSuffixWayPoint(start_state, 0.0);
+  robot_state::RobotState waypoint(start_state);
+  for (std::size_t k = 1 ; k + 1 < path.waypoints_.size() ; ++k)
+  {
+    waypoint.setJointGroupPositions(group, path.waypoints_[k]);
+    waypoint.update();
+    appendInterpolated(*candidate, waypoint, group);
+  }
+  appendInterpolated(*candidate, goal_state, group);
+
+  std::vector<std::size_t> invalid;
+  if (planning_scene_->isPathValid(*candidate, request_.path_constraints, request_.goal_constraints, request_.group_name, false, &invalid))
+    return candidate;
+
+  // the start and the goal themselves cannot be repaired
+  const std::size_t last = candidate->getWayPointCount() - 1;
+  if (invalid.empty() || invalid.front() == 0 || invalid.back() == last)
+    return robot_trajectory::RobotTrajectoryPtr();
+
+  // plan again between the valid waypoints around each sequence of invalid ones
+  robot_trajectory::RobotTrajectoryPtr result(new robot_trajectory::RobotTrajectory(planning_scene_->getRobotModel(), group));
+  std::size_t next = 0;
+  std::size_t i = 0;
+  while (i < invalid.size())
+  {
+    std::size_t first_invalid = invalid[i];
+    std::size_t last_invalid = first_invalid;
+    while (i < invalid.size() && invalid[i] <= last_invalid + 1)
+      last_invalid = std::max(last_invalid, invalid[i++]);
+
+    for (std::size_t k = next ; k < first_invalid ; ++k)
+      result->addSuffixWayPoint(candidate->getWayPointPtr(k), 0.0);
+
+    robot_trajectory::RobotTrajectoryPtr segment = planSegment(candidate->getWayPoint(first_invalid - 1), candidate->getWayPoint(last_invalid + 1),
+                                                               group, deadline);
+    if (!segment)
+      return robot_trajectory::RobotTrajectoryPtr();
+    logDebug("Replanned waypoints %u to %u of a library path", (unsigned int)first_invalid, (unsigned int)last_invalid);
+
+    // the end points of the segment are the valid waypoints around it
+    for (std::size_t k = 1 ; k + 1 < segment->getWayPointCount() ; ++k)
+      result->addSuffixWayPoint(segment->getWayPointPtr(k), 0.0);
+    next = last_invalid + 1;
+  }
+  for (std::size_t k = next ; k <= last ; ++k)
+    result->addSuffixWayPoint(candidate->getWayPointPtr(k), 0.0);
+
+  if (planning_scene_->isPathValid(*result, request_.path_constraints, request_.goal_constraints, request_.group_name))
+  {
+    repaired = true;
+    return result;
+  }
+  return robot_trajectory::RobotTrajectoryPtr();
+}
+
+robot_trajectory::RobotTrajectoryPtr ExperiencePlanningContext::planSegment(const robot_state::RobotState &from, const robot_state::RobotState &to,
+                                                                            const robot_model::JointModelGroup *group, const ros::WallTime &deadline)
+{
+  double remaining = (deadline - ros::WallTime::now()).toSec();
+  if (remaining <= 0.0)
+    return robot_trajectory::RobotTrajectoryPtr();
+
+  MotionPlanRequest req = request_;
+  robot_state::robotStateToRobotStateMsg(from, req.start_state);
+  req.goal_constraints.clear();
+  req.goal_constraints.push_back(kinematic_constraints::constructGoalConstraints(to, group, REPAIR_GOAL_TOLERANCE));
+  req.allowed_planning_time = remaining;
+  req.num_planning_attempts = 1;
+
+  moveit_msgs::MoveItErrorCodes error_code;
+  PlanningContextPtr context = planner_->getPlanningContext(planning_scene_, req, error_code);
+  if (!context)
+    return robot_trajectory::RobotTrajectoryPtr();
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    if (terminated_ || scratch_solved_)
+      return robot_trajectory::RobotTrajectoryPtr();
+    repair_context_ = context;
+  }
+
+  MotionPlanResponse res;
+  bool solved = context->solve(res);
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    repair_context_.reset();
+  }
+  if (!solved || !res.trajectory_ || res.trajectory_->getWayPointCount() < 2)
+    return robot_trajectory::RobotTrajectoryPtr();
+  return res.trajectory_;
+}
+
+}
+
+ExperiencePlannerManager::ExperiencePlannerManager(const PlannerManagerPtr &planner, const PathLibraryPtr &library) :
+  PlannerManager(),
+  planner_(planner),
+  library_(library ? library : PathLibraryPtr(new PathLibrary())),
+  candidate_count_(3),
+  resolution_(0.05),
+  race_(true),
+  record_(true)
+{
+}
+
+bool ExperiencePlannerManager::initialize(const robot_model::RobotModelConstPtr& model, const std::string &ns)
+{
+  return planner_->initialize(model, ns);
+}
+
+std::string ExperiencePlannerManager::getDescription() const
+{
+  return "Experience-based " + planner_->getDescription();
+}
+
+void ExperiencePlannerManager::getPlanningAlgorithms(std::vector<std::string> &algs) const
+{
+  planner_->getPlanningAlgorithms(algs);
+}
+
+PlanningContextPtr ExperiencePlannerManager::getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                const MotionPlanRequest &req,
+                                                                moveit_msgs::MoveItErrorCodes &error_code) const
+{
+  PlanningContextPtr scratch = planner_->getPlanningContext(planning_scene, req, error_code);
+  if (!scratch)
+    return scratch;
+  PlanningContextPtr context(new ExperiencePlanningContext(planner_, library_, scratch, candidate_count_, resolution_, race_, record_));
+  context->setPlanningScene(planning_scene);
+  context->setMotionPlanRequest(req);
+  return context;
+}
+
+bool ExperiencePlannerManager::canServiceRequest(const MotionPlanRequest &req) const
+{
+  return planner_->canServiceRequest(req);
+}
+
+void ExperiencePlannerManager::setPlannerConfigurations(const PlannerConfigurationMap &pcs)
+{
+  PlannerManager::setPlannerConfigurations(pcs);
+  planner_->setPlannerConfigurations(pcs);
+}
+
+}
@@ -0,0 +1,282 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/path_library.h>
+#include <console_bridge/console.h>
+#include <algorithm>
+#include <cmath>
+
+namespace planning_interface
+{
+
+namespace
+{
+
+struct KeyAxisLess
+{
+  KeyAxisLess(const std::deque<std::vector<double> > &keys, std::size_t axis) :
+    keys_(keys),
+    axis_(axis)
+  {
+  }
+
+  bool operator()(std::size_t a, std::size_t b) const
+  {
+    return keys_[a][axis_] < keys_[b][axis_];
+  }
+
+  const std::deque<std::vector<double> > &keys_;
+  std::size_t axis_;
+};
+
+double squaredDistance(const std::vector<double> &a, const std::vector<double> &b)
+{
+  double d = 0.0;
+  for (std::size_t i = 0 ; i < a.size() ; ++i)
+    d += (a[i] - b[i]) * (a[i] - b[i]);
+  return d;
+}
+
+}
+
+PathLibrary::PathLibrary(std::size_t capacity) :
+  capacity_(capacity)
+{
+}
+
+void PathLibrary::setCapacity(std::size_t capacity)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  capacity_ = capacity;
+  for (std::map<std::string, GroupPaths>::iterator it = groups_.begin() ; it != groups_.end() ; ++it)
+    while (it->second.paths_.size() > capacity_)
+    {
+      it->second.paths_.pop_front();
+      it->second.keys_.pop_front();
+      it->second.dirty_ = true;
+    }
+}
+
+std::size_t PathLibrary::getCapacity() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return capacity_;
+}
+
+void PathLibrary::addPath(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  if (!group || trajectory.getWayPointCount() < 2)
+    return;
+  std::vector<std::vector<double> > waypoints(trajectory.getWayPointCount());
+  for (std::size_t k = 0 ; k < waypoints.size() ; ++k)
+    trajectory.getWayPoint(k).copyJointGroupPositions(group, waypoints[k]);
+  addPath(group->getName(), waypoints);
+}
+
+void PathLibrary::addPath(const std::string &group, const std::vector<std::vector<double> > &waypoints)
+{
+  if (waypoints.size() < 2)
+    return;
+
+  boost::shared_ptr<Path> path(new Path());
+  path->group_ = group;
+  path->waypoints_ = waypoints;
+  std::vector<double> key(waypoints.front());
+  key.insert(key.end(), waypoints.back().begin(), waypoints.back().end());
+
+  boost::mutex::scoped_lock slock(lock_);
+  GroupPaths &paths = groups_[group];
+  if (!paths.keys_.empty() && paths.keys_.front().size() != key.size())
+  {
+    logError("Path for group '%s' has %u variables per waypoint instead of %u", group.c_str(),
+             (unsigned int)waypoints.front().size(), (unsigned int)paths.keys_.front().size() / 2);
+    return;
+  }
+  paths.paths_.push_back(path);
+  paths.keys_.push_back(key);
+  while (paths.paths_.size() > capacity_)
+  {
+    paths.paths_.pop_front();
+    paths.keys_.pop_front();
+  }
+  paths.dirty_ = true;
+}
+
+int PathLibrary::buildTree(GroupPaths &group, std::vector<std::size_t> &index, std::size_t begin, std::size_t end)
+{
+  if (begin >= end)
+    return -1;
+
+  // split along the dimension in which the keys are spread the most
+  const std::size_t dim = group.keys_[index[begin]].size();
+  std::size_t axis = 0;
+  double max_spread = -1.0;
+  for (std::size_t d = 0 ; d < dim ; ++d)
+  {
+    double lo = group.keys_[index[begin]][d];
+    double hi = lo;
+    for (std::size_t i = begin + 1 ; i < end ; ++i)
+    {
+      double v = group.keys_[index[i]][d];
+      lo = std::min(lo, v);
+      hi = std::max(hi, v);
+    }
+    if (hi - lo > max_spread)
+    {
+      max_spread = hi - lo;
+      axis = d;
+    }
+  }
+
+  std::size_t mid = begin + (end - begin) / 2;
+  if (dim > 0)
+    std::nth_element(index.begin() + begin, index.begin() + mid, index.begin() + end, KeyAxisLess(group.keys_, axis));
+
+  KdNode node;
+  node.path_ = index[mid];
+  node.axis_ = axis;
+  node.split_ = dim > 0 ? group.keys_[index[mid]][axis] : 0.0;
+  node.left_ = -1;
+  node.right_ = -1;
+  group.tree_.push_back(node);
+  int id = group.tree_.size() - 1;
+
+  int left = buildTree(group, index, begin, mid);
+  int right = buildTree(group, index, mid + 1, end);
+  group.tree_[id].left_ = left;
+  group.tree_[id].right_ = right;
+  return id;
+}
+
+void PathLibrary::searchTree(const GroupPaths &group, int node, const std::vector<double> &query, std::size_t count,
+                             std::vector<std::pair<double, std::size_t> > &best)
+{
+  if (node < 0)
+    return;
+  const KdNode &n = group.tree_[node];
+
+  double d = squaredDistance(group.keys_[n.path_], query);
+  if (best.size() < count)
+  {
+    best.push_back(std::make_pair(d, n.path_));
+    std::push_heap(best.begin(), best.end());
+  }
+  else
+    if (d < best.front().first)
+    {
+      std::pop_heap(best.begin(), best.end());
+      best.back() = std::make_pair(d, n.path_);
+      std::push_heap(best.begin(), best.end());
+    }
+
+  if (query.empty())
+    return;
+  double diff = query[n.axis_] - n.split_;
+  searchTree(group, diff < 0.0 ? n.left_ : n.right_, query, count, best);
+  // the other side can only contain closer paths if the splitting plane is closer than the current worst match
+  if (best.size() < count || diff * diff < best.front().first)
+    searchTree(group, diff < 0.0 ? n.right_ : n.left_, query, count, best);
+}
+
+void PathLibrary::getNearestPaths(const std::string &group, const std::vector<double> &start, const std::vector<double> &goal, std::size_t count,
+                                  std::vector<PathConstPtr> &paths, std::vector<double> *distances) const
+{
+  paths.clear();
+  if (distances)
+    distances->clear();
+  if (count == 0)
+    return;
+
+  std::vector<double> query(start);
+  query.insert(query.end(), goal.begin(), goal.end());
+
+  std::vector<std::pair<double, std::size_t> > best;
+  boost::mutex::scoped_lock slock(lock_);
+  std::map<std::string, GroupPaths>::iterator it = groups_.find(group);
+  if (it == groups_.end() || it->second.paths_.empty())
+    return;
+  GroupPaths &g = it->second;
+  if (g.keys_.front().size() != query.size())
+  {
+    logError("Path library query for group '%s' has %u values instead of %u", group.c_str(),
+             (unsigned int)query.size(), (unsigned int)g.keys_.front().size());
+    return;
+  }
+
+  if (g.dirty_)
+  {
+    std::vector<std::size_t> index(g.paths_.size());
+    for (std::size_t i = 0 ; i < index.size() ; ++i)
+      index[i] = i;
+    g.tree_.clear();
+    g.tree_.reserve(index.size());
+    buildTree(g, index, 0, index.size());
+    g.dirty_ = false;
+  }
+
+  best.reserve(count + 1);
+  searchTree(g, 0, query, count, best);
+  std::sort_heap(best.begin(), best.end());
+  for (std::size_t i = 0 ; i < best.size() ; ++i)
+  {
+    paths.push_back(g.paths_[best[i].second]);
+    if (distances)
+      distances->push_back(sqrt(best[i].first));
+  }
+}
+
+std::size_t PathLibrary::getPathCount(const std::string &group) const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::map<std::string, GroupPaths>::const_iterator it = groups_.find(group);
+  return it == groups_.end() ? 0 : it->second.paths_.size();
+}
+
+std::size_t PathLibrary::getPathCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::size_t count = 0;
+  for (std::map<std::string, GroupPaths>::const_iterator it = groups_.begin() ; it != groups_.end() ; ++it)
+    count += it->second.paths_.size();
+  return count;
+}
+
+void PathLibrary::clear()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  groups_.clear();
+}
+
+}
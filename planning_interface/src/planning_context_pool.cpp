@@ -0,0 +1,191 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/planning_context_pool.h>
+#include <console_bridge/console.h>
+
+namespace planning_interface
+{
+
+PlanningContextPool::PlanningContextPool(const PlannerManagerPtr &planner, std::size_t max_idle_contexts) :
+  planner_(planner),
+  max_idle_contexts_(max_idle_contexts)
+{
+}
+
+std::string PlanningContextPool::getKey(const MotionPlanRequest &req)
+{
+  // group names cannot contain '\0', so the key is unambiguous
+  std::string key = req.group_name;
+  key += '\0';
+  key += req.planner_id;
+  return key;
+}
+
+void PlanningContextPool::setMaxIdleContexts(std::size_t max_idle_contexts)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  max_idle_contexts_ = max_idle_contexts;
+  for (std::map<std::string, std::vector<PlanningContextPtr> >::iterator it = idle_.begin() ; it != idle_.end() ; ++it)
+    if (it->second.size() > max_idle_contexts_)
+    {
+      statistics_.evictions_ += it->second.size() - max_idle_contexts_;
+      it->second.resize(max_idle_contexts_);
+    }
+}
+
+PlanningContextPtr PlanningContextPool::checkout(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req,
+                                                 moveit_msgs::MoveItErrorCodes &error_code)
+{
+  const std::string key = getKey(req);
+  PlanningContextPtr context;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    statistics_.checkouts_++;
+    std::map<std::string, std::vector<PlanningContextPtr> >::iterator it = idle_.find(key);
+    if (it != idle_.end() && !it->second.empty())
+    {
+      context = it->second.back();
+      it->second.pop_back();
+    }
+  }
+
+  // the context was cleared when it was checked in; reconfiguring it sets up the new problem
+  if (context)
+  {
+    if (context->reconfigure(planning_scene, req, error_code))
+    {
+      boost::mutex::scoped_lock slock(lock_);
+      checked_out_[context.get()] = key;
+      statistics_.hits_++;
+      return context;
+    }
+    logWarn("Unable to reconfigure planning context '%s'; constructing a new one", context->getName().c_str());
+    context.reset();
+  }
+
+  // construction can be slow, so it is done without holding the lock
+  context = planner_->getPlanningContext(planning_scene, req, error_code);
+
+  boost::mutex::scoped_lock slock(lock_);
+  if (context)
+  {
+    checked_out_[context.get()] = key;
+    statistics_.misses_++;
+  }
+  else
+    statistics_.failures_++;
+  return context;
+}
+
+void PlanningContextPool::checkin(const PlanningContextPtr &context)
+{
+  if (!context)
+    return;
+
+  std::string key;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    std::map<PlanningContext*, std::string>::iterator it = checked_out_.find(context.get());
+    if (it == checked_out_.end())
+    {
+      logWarn("Planning context '%s' was not checked out of this pool", context->getName().c_str());
+      return;
+    }
+    key.swap(it->second);
+    checked_out_.erase(it);
+  }
+
+  // contexts that set up the problem when they are constructed would solve the previous request again
+  if (!context->canReconfigure())
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    statistics_.discarded_++;
+    return;
+  }
+
+  context->clear();
+
+  boost::mutex::scoped_lock slock(lock_);
+  std::vector<PlanningContextPtr> &idle = idle_[key];
+  if (idle.size() < max_idle_contexts_)
+    idle.push_back(context);
+  else
+    statistics_.evictions_++;
+}
+
+bool PlanningContextPool::solve(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req, MotionPlanResponse &res)
+{
+  PlanningContextPtr context = checkout(planning_scene, req, res.error_code_);
+  if (!context)
+    return false;
+  bool result = context->solve(res);
+  checkin(context);
+  return result;
+}
+
+void PlanningContextPool::clear()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  idle_.clear();
+}
+
+std::size_t PlanningContextPool::getIdleContextCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::size_t count = 0;
+  for (std::map<std::string, std::vector<PlanningContextPtr> >::const_iterator it = idle_.begin() ; it != idle_.end() ; ++it)
+    count += it->second.size();
+  return count;
+}
+
+std::size_t PlanningContextPool::getCheckedOutContextCount() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return checked_out_.size();
+}
+
+PlanningContextPool::Statistics PlanningContextPool::getStatistics() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return statistics_;
+}
+
+void PlanningContextPool::resetStatistics()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  statistics_ = Statistics();
+}
+
+}
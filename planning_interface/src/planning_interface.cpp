@@ -88,6 +88,15 @@ void planning_interface::PlanningContext::setMotionPlanRequest(const MotionPlanR
   request_.num_planning_attempts = std::max(1, request_.num_planning_attempts);
 }
 
+bool planning_interface::PlanningContext::reconfigure(const planning_scene::PlanningSceneConstPtr &planning_scene,
+                                                     const MotionPlanRequest &req, moveit_msgs::MoveItErrorCodes &error_code)
+{
+  setPlanningScene(planning_scene);
+  setMotionPlanRequest(req);
+  error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+  return true;
+}
+
 bool planning_interface::PlannerManager::initialize(const robot_model::RobotModelConstPtr &, const std::string &)
 {
   return true;
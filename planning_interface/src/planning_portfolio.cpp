@@ -0,0 +1,275 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/planning_portfolio.h>
+#include <moveit/background_processing/task_scheduler.h>
+#include <console_bridge/console.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/bind.hpp>
+#include <ros/time.h>
+#include <limits>
+
+namespace planning_interface
+{
+
+namespace
+{
+
+// state shared between the calling thread and the tasks solving the contexts of a portfolio
+struct PortfolioRun
+{
+  PortfolioRun(PlanningPortfolio::Mode mode, std::size_t count) :
+    mode_(mode),
+    contexts_(count),
+    responses_(count),
+    results_(count),
+    running_(count, false),
+    next_(0),
+    finished_(0),
+    winner_(-1),
+    stop_(false)
+  {
+  }
+
+  PlanningPortfolio::Mode mode_;
+  std::vector<PlanningContextPtr> contexts_;
+
+  // each response is only accessed by the thread solving the corresponding context
+  std::vector<MotionPlanResponse> responses_;
+
+  // the members below are protected by lock_
+  std::vector<PlanningPortfolio::MemberResult> results_;
+  std::vector<bool> running_;
+  boost::mutex lock_;
+  boost::condition_variable condition_;
+  std::size_t next_;
+  std::size_t finished_;
+  int winner_;
+  bool stop_;
+};
+
+// record that member \e index, taken while run->lock_ is held, is not solved
+void skipMember(PortfolioRun *run, std::size_t index)
+{
+  if (run->contexts_[index])
+    run->results_[index].terminated_ = true;
+  run->finished_++;
+  run->condition_.notify_all();
+}
+
+void solveMembers(PortfolioRun *run)
+{
+  while (true)
+  {
+    std::size_t index;
+    {
+      boost::mutex::scoped_lock slock(run->lock_);
+      if (run->next_ >= run->contexts_.size())
+        return;
+      index = run->next_++;
+      // members whose context could not be constructed, or that are no longer needed, are not started
+      if (!run->contexts_[index] || run->stop_)
+      {
+        skipMember(run, index);
+        continue;
+      }
+      run->running_[index] = true;
+    }
+
+    MotionPlanResponse &response = run->responses_[index];
+    ros::WallTime start = ros::WallTime::now();
+    bool solved = run->contexts_[index]->solve(response) && response.trajectory_ && !response.trajectory_->empty();
+    double planning_time = (ros::WallTime::now() - start).toSec();
+    double length = solved ? PlanningPortfolio::getPathLength(*response.trajectory_) : 0.0;
+
+    boost::mutex::scoped_lock slock(run->lock_);
+    PlanningPortfolio::MemberResult &result = run->results_[index];
+    run->running_[index] = false;
+    result.solved_ = solved;
+    result.terminated_ = !solved && run->stop_;
+    result.planning_time_ = planning_time;
+    result.path_length_ = length;
+    result.error_code_ = response.error_code_;
+    if (solved && run->winner_ < 0 && run->mode_ == PlanningPortfolio::FIRST_SOLUTION)
+    {
+      run->winner_ = index;
+      run->stop_ = true;
+    }
+    run->finished_++;
+    run->condition_.notify_all();
+  }
+}
+
+}
+
+PlanningPortfolio::PlanningPortfolio(const PlannerManagerPtr &planner, Mode mode) :
+  planner_(planner),
+  mode_(mode),
+  max_threads_(0)
+{
+}
+
+void PlanningPortfolio::addPlanner(const std::string &planner_id, unsigned int replicas)
+{
+  for (unsigned int i = 0 ; i < replicas ; ++i)
+    planner_ids_.push_back(planner_id);
+}
+
+void PlanningPortfolio::addPlannerConfigurations(const std::string &group, unsigned int replicas)
+{
+  const PlannerConfigurationMap &configs = planner_->getPlannerConfigurations();
+  for (PlannerConfigurationMap::const_iterator it = configs.begin() ; it != configs.end() ; ++it)
+    if (it->second.group == group)
+      addPlanner(it->first, replicas);
+}
+
+void PlanningPortfolio::clearPlanners()
+{
+  planner_ids_.clear();
+}
+
+double PlanningPortfolio::getPathLength(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  double length = 0.0;
+  for (std::size_t k = 1 ; k < trajectory.getWayPointCount() ; ++k)
+    length += trajectory.getWayPoint(k - 1).distance(trajectory.getWayPoint(k), trajectory.getGroup());
+  return length;
+}
+
+bool PlanningPortfolio::solve(const planning_scene::PlanningSceneConstPtr &planning_scene, const MotionPlanRequest &req,
+                              MotionPlanResponse &res, std::vector<MemberResult> *member_results) const
+{
+  ros::WallTime start = ros::WallTime::now();
+  res.trajectory_.reset();
+
+  std::vector<std::string> planner_ids = planner_ids_;
+  if (planner_ids.empty())
+    planner_ids.push_back(req.planner_id);
+  const std::size_t count = planner_ids.size();
+
+  // the contexts are constructed by the calling thread; only solving happens in parallel
+  PortfolioRun run(mode_, count);
+  MotionPlanRequest member_req = req;
+  for (std::size_t i = 0 ; i < count ; ++i)
+  {
+    run.results_[i].planner_id_ = planner_ids[i];
+    member_req.planner_id = planner_ids[i];
+    run.contexts_[i] = planner_->getPlanningContext(planning_scene, member_req, run.results_[i].error_code_);
+    if (run.contexts_[i])
+      run.results_[i].context_name_ = run.contexts_[i]->getName();
+    else
+      logWarn("Unable to construct a planning context for planner '%s'", planner_ids[i].c_str());
+  }
+
+  // the same default the contexts use for the time budget
+  double budget = req.allowed_planning_time > 0.0 ? req.allowed_planning_time : 1.0;
+  ros::WallTime deadline = start + ros::WallDuration(budget);
+
+  // the members are solved by tasks of the scheduler shared by the process, so that portfolios do not start their own threads
+  std::size_t task_count = max_threads_ == 0 ? count : std::min<std::size_t>(max_threads_, count);
+  moveit::tools::TaskScheduler::TaskGroup group;
+  for (std::size_t t = 0 ; t < task_count ; ++t)
+    group.run(boost::bind(&solveMembers, &run));
+
+  {
+    boost::mutex::scoped_lock slock(run.lock_);
+    while (run.finished_ < count)
+    {
+      if (!run.stop_ && ros::WallTime::now() >= deadline)
+      {
+        logDebug("Planning portfolio reached its time budget of %lf seconds; terminating the remaining contexts", budget);
+        run.stop_ = true;
+      }
+      if (run.stop_)
+      {
+        // members no task has taken yet (the workers may all be busy) are not waited for
+        while (run.next_ < count)
+          skipMember(&run, run.next_++);
+        // a context that is about to enter solve() may miss a single terminate() call, so this is repeated until it returns
+        for (std::size_t i = 0 ; i < count ; ++i)
+          if (run.running_[i])
+            run.contexts_[i]->terminate();
+        run.condition_.timed_wait(slock, boost::posix_time::milliseconds(10));
+      }
+      else
+      {
+        double remaining = (deadline - ros::WallTime::now()).toSec();
+        run.condition_.timed_wait(slock, boost::posix_time::microseconds(std::max(1L, (long)(remaining * 1e6))));
+      }
+    }
+  }
+  // tasks that have not started yet find no members left and return at once
+  group.wait();
+
+  int best = run.winner_;
+  if (mode_ == BEST_SOLUTION)
+  {
+    double best_length = std::numeric_limits<double>::infinity();
+    for (std::size_t i = 0 ; i < count ; ++i)
+      if (run.results_[i].solved_ && run.results_[i].path_length_ < best_length)
+      {
+        best_length = run.results_[i].path_length_;
+        best = i;
+      }
+  }
+
+  if (best >= 0)
+  {
+    res.trajectory_ = run.responses_[best].trajectory_;
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+  }
+  else
+  {
+    // report the first failure of a member, if one was reported
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+    for (std::size_t i = 0 ; i < count ; ++i)
+      if (run.results_[i].error_code_.val != moveit_msgs::MoveItErrorCodes::SUCCESS && run.results_[i].error_code_.val != 0)
+      {
+        res.error_code_ = run.results_[i].error_code_;
+        break;
+      }
+  }
+  res.planning_time_ = (ros::WallTime::now() - start).toSec();
+
+  if (best >= 0)
+    logDebug("Planning portfolio selected the solution of planner '%s' (%u members, %lf seconds)",
+             planner_ids[best].c_str(), (unsigned int)count, res.planning_time_);
+
+  if (member_results)
+    member_results->swap(run.results_);
+  return best >= 0;
+}
+
+}
@@ -0,0 +1,362 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/experience_planner_manager.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/kinematic_constraints/utils.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
+#include <algorithm>
+
+// what the context of a stub planner does when solving
+struct StubBehavior
+{
+  StubBehavior(double delay = 0.0, std::size_t waypoints = 2, bool solves = true) :
+    delay_(delay),
+    waypoints_(waypoints),
+    solves_(solves)
+  {
+  }
+
+  /// seconds before solve() returns, unless terminated
+  double delay_;
+
+  /// the solution is the straight line from the start state to the joint space goal, with this many waypoints
+  std::size_t waypoints_;
+
+  bool solves_;
+};
+
+class StubPlanningContext : public planning_interface::PlanningContext
+{
+public:
+
+  StubPlanningContext(const std::string &name, const StubBehavior &behavior) :
+    planning_interface::PlanningContext(name, "arm"),
+    behavior_(behavior),
+    terminated_(false)
+  {
+  }
+
+  virtual bool solve(planning_interface::MotionPlanResponse &res)
+  {
+    const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(behavior_.delay_);
+    while (ros::WallTime::now() < deadline)
+    {
+      if (isTerminated())
+      {
+        res.error_code_.val = moveit_msgs::MoveItErrorCodes::PREEMPTED;
+        return false;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    if (!behavior_.solves_ || request_.goal_constraints.empty())
+    {
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+      return false;
+    }
+
+    robot_state::RobotStatePtr start = planning_scene_->getCurrentStateUpdated(request_.start_state);
+    robot_state::RobotState goal(*start);
+    const std::vector<moveit_msgs::JointConstraint> &jc = request_.goal_constraints[0].joint_constraints;
+    for (std::size_t j = 0 ; j < jc.size() ; ++j)
+      goal.setVariablePosition(jc[j].joint_name, jc[j].position);
+    goal.update();
+
+    const robot_model::JointModelGroup *group = start->getJointModelGroup("arm");
+    res.trajectory_.reset(new robot_trajectory::RobotTrajectory(start->getRobotModel(), "arm"));
+    for (std::size_t k = 0 ; k < behavior_.waypoints_ ; ++k)
+    {
+      robot_state::RobotState state(*start);
+      start->interpolate(goal, (double)k / (double)(behavior_.waypoints_ - 1), state, group);
+      res.trajectory_->addSuffixWayPoint(state, 0.0);
+    }
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  virtual bool solve(planning_interface::MotionPlanDetailedResponse &res)
+  {
+    return false;
+  }
+
+  virtual bool terminate()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    terminated_ = true;
+    return true;
+  }
+
+  virtual void clear()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    terminated_ = false;
+  }
+
+  bool isTerminated()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    return terminated_;
+  }
+
+private:
+
+  StubBehavior behavior_;
+  boost::mutex lock_;
+  bool terminated_;
+};
+
+typedef boost::shared_ptr<StubPlanningContext> StubPlanningContextPtr;
+
+// the first context constructed solves the request from scratch; the later ones repair library paths
+class StubPlannerManager : public planning_interface::PlannerManager
+{
+public:
+
+  StubPlannerManager(const StubBehavior &scratch, const StubBehavior &repair) :
+    scratch_(scratch),
+    repair_(repair)
+  {
+  }
+
+  virtual planning_interface::PlanningContextPtr getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                    const planning_interface::MotionPlanRequest &req,
+                                                                    moveit_msgs::MoveItErrorCodes &error_code) const
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    const bool scratch = contexts_.empty();
+    StubPlanningContextPtr context(new StubPlanningContext(scratch ? "scratch" : "repair", scratch ? scratch_ : repair_));
+    context->setPlanningScene(planning_scene);
+    context->setMotionPlanRequest(req);
+    contexts_.push_back(context);
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return context;
+  }
+
+  virtual bool canServiceRequest(const planning_interface::MotionPlanRequest &req) const
+  {
+    return true;
+  }
+
+  std::vector<StubPlanningContextPtr> getContexts() const
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    return contexts_;
+  }
+
+private:
+
+  StubBehavior scratch_;
+  StubBehavior repair_;
+  mutable std::vector<StubPlanningContextPtr> contexts_;
+  mutable boost::mutex lock_;
+};
+
+class ExperiencePlannerManagerTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("planar_arm");
+    ASSERT_TRUE(robot_model_);
+    scene_.reset(new planning_scene::PlanningScene(robot_model_));
+    library_.reset(new planning_interface::PathLibrary());
+
+    // from the default state (0, 0) to (2.5, 0), keeping the second joint within 0.5 rad of 0
+    robot_state::RobotState goal(robot_model_);
+    goal.setToDefaultValues();
+    goal.setVariablePosition("joint1", 2.5);
+    goal.update();
+    request_.group_name = "arm";
+    request_.allowed_planning_time = 10.0;
+    request_.goal_constraints.push_back(kinematic_constraints::constructGoalConstraints(goal, robot_model_->getJointModelGroup("arm"), 1e-3));
+    request_.path_constraints.joint_constraints.resize(1);
+    moveit_msgs::JointConstraint &jc = request_.path_constraints.joint_constraints[0];
+    jc.joint_name = "joint2";
+    jc.position = 0.0;
+    jc.tolerance_above = 0.5;
+    jc.tolerance_below = 0.5;
+    jc.weight = 1.0;
+  }
+
+  // a library path from (0, 0) to (2.5, 0); with a bump, the second joint reaches 1 rad in the middle
+  void addLibraryPath(bool bump)
+  {
+    std::vector<std::vector<double> > waypoints;
+    const double joint1[] = { 0.0, 0.5, 1.0, 1.5, 2.0, 2.5 };
+    const double joint2[] = { 0.0, 0.0, 1.0, 1.0, 0.0, 0.0 };
+    for (std::size_t k = 0 ; k < 6 ; ++k)
+    {
+      std::vector<double> waypoint(2);
+      waypoint[0] = joint1[k];
+      waypoint[1] = bump ? joint2[k] : 0.0;
+      waypoints.push_back(waypoint);
+    }
+    library_->addPath("arm", waypoints);
+  }
+
+  bool solve(const boost::shared_ptr<StubPlannerManager> &planner, planning_interface::MotionPlanResponse &res, bool race = true)
+  {
+    planning_interface::ExperiencePlannerManager manager(planner, library_);
+    manager.setRaceFromScratch(race);
+    moveit_msgs::MoveItErrorCodes error_code;
+    planning_interface::PlanningContextPtr context = manager.getPlanningContext(scene_, request_, error_code);
+    EXPECT_TRUE(context);
+    return context && context->solve(res);
+  }
+
+  bool isValid(const robot_trajectory::RobotTrajectory &trajectory) const
+  {
+    return scene_->isPathValid(trajectory, request_.path_constraints, request_.goal_constraints, "arm");
+  }
+
+  double getMaxJoint2(const robot_trajectory::RobotTrajectory &trajectory) const
+  {
+    double result = 0.0;
+    for (std::size_t k = 0 ; k < trajectory.getWayPointCount() ; ++k)
+      result = std::max(result, trajectory.getWayPoint(k).getVariablePosition("joint2"));
+    return result;
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  planning_scene::PlanningScenePtr scene_;
+  planning_interface::PathLibraryPtr library_;
+  planning_interface::MotionPlanRequest request_;
+};
+
+TEST_F(ExperiencePlannerManagerTest, LibraryHitIsRepaired)
+{
+  // the scratch planner takes too long; the part of the library path that violates the path constraints is planned again
+  addLibraryPath(true);
+  boost::shared_ptr<StubPlannerManager> planner(new StubPlannerManager(StubBehavior(5.0), StubBehavior(0.0, 10)));
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(solve(planner, res));
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS, res.error_code_.val);
+  EXPECT_LT(res.planning_time_, 5.0);
+
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_TRUE(isValid(*res.trajectory_));
+  EXPECT_NEAR(0.0, res.trajectory_->getFirstWayPoint().getVariablePosition("joint1"), 1e-12);
+  EXPECT_NEAR(2.5, res.trajectory_->getLastWayPoint().getVariablePosition("joint1"), 1e-12);
+  // the valid parts of the library path are kept: they rise to the limit of the path constraints
+  EXPECT_GT(getMaxJoint2(*res.trajectory_), 0.4);
+  EXPECT_LE(getMaxJoint2(*res.trajectory_), 0.5);
+
+  const std::vector<StubPlanningContextPtr> contexts = planner->getContexts();
+  ASSERT_EQ(2u, contexts.size());
+  EXPECT_EQ("scratch", contexts[0]->getName());
+  EXPECT_TRUE(contexts[0]->isTerminated());
+  EXPECT_EQ("repair", contexts[1]->getName());
+
+  // the repaired path is added to the library
+  EXPECT_EQ(2u, library_->getPathCount("arm"));
+}
+
+TEST_F(ExperiencePlannerManagerTest, ValidLibraryPathIsReused)
+{
+  addLibraryPath(false);
+  boost::shared_ptr<StubPlannerManager> planner(new StubPlannerManager(StubBehavior(5.0), StubBehavior(0.0, 10, false)));
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(solve(planner, res));
+  EXPECT_LT(res.planning_time_, 5.0);
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_TRUE(isValid(*res.trajectory_));
+  // the path is sampled at the resolution of the manager
+  EXPECT_GE(res.trajectory_->getWayPointCount(), 50u);
+  EXPECT_EQ(1u, planner->getContexts().size());
+  // paths reused unchanged are not added again
+  EXPECT_EQ(1u, library_->getPathCount("arm"));
+}
+
+TEST_F(ExperiencePlannerManagerTest, LibraryMissFallsBackToScratch)
+{
+  // the library is empty
+  boost::shared_ptr<StubPlannerManager> planner(new StubPlannerManager(StubBehavior(0.05, 3), StubBehavior(0.0, 10)));
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(solve(planner, res));
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_EQ(3u, res.trajectory_->getWayPointCount());
+  EXPECT_TRUE(isValid(*res.trajectory_));
+  EXPECT_EQ(1u, planner->getContexts().size());
+  EXPECT_EQ(1u, library_->getPathCount("arm"));
+
+  // without racing, the scratch planner is only used once the library path cannot be repaired
+  library_->clear();
+  addLibraryPath(true);
+  planner.reset(new StubPlannerManager(StubBehavior(0.0, 3), StubBehavior(0.0, 10, false)));
+  ASSERT_TRUE(solve(planner, res, false));
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_EQ(3u, res.trajectory_->getWayPointCount());
+  const std::vector<StubPlanningContextPtr> contexts = planner->getContexts();
+  ASSERT_EQ(2u, contexts.size());
+  EXPECT_EQ("repair", contexts[1]->getName());
+  EXPECT_FALSE(contexts[0]->isTerminated());
+
+  // when nothing solves the request, the failure of the scratch planner is reported
+  library_->clear();
+  planner.reset(new StubPlannerManager(StubBehavior(0.0, 3, false), StubBehavior(0.0, 10, false)));
+  EXPECT_FALSE(solve(planner, res));
+  EXPECT_FALSE(res.trajectory_);
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::PLANNING_FAILED, res.error_code_.val);
+}
+
+TEST_F(ExperiencePlannerManagerTest, RaceWinnerIsStored)
+{
+  // the repair takes too long, so the scratch planner wins; its path is stored and the repair is terminated
+  addLibraryPath(true);
+  boost::shared_ptr<StubPlannerManager> planner(new StubPlannerManager(StubBehavior(0.0, 3), StubBehavior(5.0, 10)));
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(solve(planner, res));
+  EXPECT_LT(res.planning_time_, 5.0);
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_EQ(3u, res.trajectory_->getWayPointCount());
+
+  ASSERT_EQ(2u, library_->getPathCount("arm"));
+  std::vector<double> start(2, 0.0), goal(2, 0.0);
+  goal[0] = 2.5;
+  std::vector<planning_interface::PathLibrary::PathConstPtr> paths;
+  library_->getNearestPaths("arm", start, goal, 2, paths);
+  ASSERT_EQ(2u, paths.size());
+  EXPECT_TRUE(paths[0]->waypoints_.size() == 3 || paths[1]->waypoints_.size() == 3);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
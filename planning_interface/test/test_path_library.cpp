@@ -0,0 +1,238 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/path_library.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <random_numbers/random_numbers.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+
+static const std::size_t DIMENSION = 3;
+
+static std::vector<double> randomConfiguration(random_numbers::RandomNumberGenerator &rng)
+{
+  std::vector<double> q(DIMENSION);
+  for (std::size_t i = 0 ; i < DIMENSION ; ++i)
+    q[i] = rng.uniformReal(-1.0, 1.0);
+  return q;
+}
+
+static std::vector<std::vector<double> > makePath(const std::vector<double> &start, const std::vector<double> &goal)
+{
+  std::vector<std::vector<double> > waypoints;
+  waypoints.push_back(start);
+  waypoints.push_back(goal);
+  return waypoints;
+}
+
+static double pathDistance(const planning_interface::PathLibrary::Path &path, const std::vector<double> &start, const std::vector<double> &goal)
+{
+  double d = 0.0;
+  for (std::size_t i = 0 ; i < DIMENSION ; ++i)
+  {
+    d += (path.waypoints_.front()[i] - start[i]) * (path.waypoints_.front()[i] - start[i]);
+    d += (path.waypoints_.back()[i] - goal[i]) * (path.waypoints_.back()[i] - goal[i]);
+  }
+  return sqrt(d);
+}
+
+// compare the kd-tree query against the distances of all stored paths, sorted
+static void checkNearest(const planning_interface::PathLibrary &library, const std::vector<std::vector<std::vector<double> > > &stored,
+                         const std::vector<double> &start, const std::vector<double> &goal, std::size_t count)
+{
+  std::vector<double> expected;
+  for (std::size_t i = 0 ; i < stored.size() ; ++i)
+  {
+    planning_interface::PathLibrary::Path path;
+    path.waypoints_ = stored[i];
+    expected.push_back(pathDistance(path, start, goal));
+  }
+  std::sort(expected.begin(), expected.end());
+  expected.resize(std::min(count, expected.size()));
+
+  std::vector<planning_interface::PathLibrary::PathConstPtr> paths;
+  std::vector<double> distances;
+  library.getNearestPaths("group", start, goal, count, paths, &distances);
+  ASSERT_EQ(expected.size(), paths.size());
+  ASSERT_EQ(expected.size(), distances.size());
+  for (std::size_t i = 0 ; i < expected.size() ; ++i)
+  {
+    EXPECT_NEAR(expected[i], distances[i], 1e-12);
+    EXPECT_NEAR(distances[i], pathDistance(*paths[i], start, goal), 1e-12);
+    EXPECT_EQ("group", paths[i]->group_);
+  }
+}
+
+TEST(PathLibrary, NearestMatchesLinearScan)
+{
+  random_numbers::RandomNumberGenerator rng(42);
+  planning_interface::PathLibrary library(1000);
+  std::vector<std::vector<std::vector<double> > > stored;
+
+  for (std::size_t i = 0 ; i < 300 ; ++i)
+  {
+    stored.push_back(makePath(randomConfiguration(rng), randomConfiguration(rng)));
+    library.addPath("group", stored.back());
+  }
+  EXPECT_EQ(300u, library.getPathCount("group"));
+
+  for (std::size_t q = 0 ; q < 50 ; ++q)
+  {
+    std::vector<double> start = randomConfiguration(rng);
+    std::vector<double> goal = randomConfiguration(rng);
+    checkNearest(library, stored, start, goal, 1);
+    checkNearest(library, stored, start, goal, 7);
+  }
+
+  // the tree is rebuilt after the library changes; queries on a stored path find it at distance 0
+  for (std::size_t i = 0 ; i < 30 ; ++i)
+  {
+    stored.push_back(makePath(randomConfiguration(rng), randomConfiguration(rng)));
+    library.addPath("group", stored.back());
+  }
+  for (std::size_t q = 0 ; q < stored.size() ; q += 11)
+    checkNearest(library, stored, stored[q].front(), stored[q].back(), 3);
+
+  // asking for more paths than stored returns all of them
+  checkNearest(library, stored, stored[0].front(), stored[0].back(), 1000);
+}
+
+TEST(PathLibrary, DuplicateKeys)
+{
+  planning_interface::PathLibrary library;
+  std::vector<std::vector<std::vector<double> > > stored;
+  std::vector<double> a(DIMENSION, 0.5), b(DIMENSION, -0.5);
+  for (std::size_t i = 0 ; i < 20 ; ++i)
+  {
+    stored.push_back(makePath(i % 2 ? a : b, i % 3 ? a : b));
+    library.addPath("group", stored.back());
+  }
+  checkNearest(library, stored, a, a, 5);
+  checkNearest(library, stored, a, b, 20);
+}
+
+TEST(PathLibrary, CapacityDropsOldestPaths)
+{
+  planning_interface::PathLibrary library(3);
+  for (std::size_t i = 0 ; i < 5 ; ++i)
+    library.addPath("group", makePath(std::vector<double>(DIMENSION, i), std::vector<double>(DIMENSION, i)));
+  EXPECT_EQ(3u, library.getPathCount("group"));
+
+  // the paths starting at 0 and 1 were dropped, so the closest one to 0 starts at 2
+  std::vector<planning_interface::PathLibrary::PathConstPtr> paths;
+  library.getNearestPaths("group", std::vector<double>(DIMENSION, 0.0), std::vector<double>(DIMENSION, 0.0), 5, paths);
+  ASSERT_EQ(3u, paths.size());
+  EXPECT_EQ(2.0, paths[0]->waypoints_.front()[0]);
+  EXPECT_EQ(3.0, paths[1]->waypoints_.front()[0]);
+  EXPECT_EQ(4.0, paths[2]->waypoints_.front()[0]);
+
+  library.setCapacity(1);
+  library.getNearestPaths("group", std::vector<double>(DIMENSION, 0.0), std::vector<double>(DIMENSION, 0.0), 5, paths);
+  ASSERT_EQ(1u, paths.size());
+  EXPECT_EQ(4.0, paths[0]->waypoints_.front()[0]);
+}
+
+TEST(PathLibrary, InvalidPathsAndQueries)
+{
+  planning_interface::PathLibrary library;
+  std::vector<planning_interface::PathLibrary::PathConstPtr> paths;
+  std::vector<double> q(DIMENSION, 0.0);
+
+  // paths need two waypoints, and all paths of a group the same number of variables
+  library.addPath("group", std::vector<std::vector<double> >(1, q));
+  EXPECT_EQ(0u, library.getPathCount());
+  library.addPath("group", makePath(q, q));
+  library.addPath("group", makePath(std::vector<double>(2, 0.0), std::vector<double>(2, 0.0)));
+  library.addPath("other", makePath(std::vector<double>(2, 0.0), std::vector<double>(2, 0.0)));
+  EXPECT_EQ(1u, library.getPathCount("group"));
+  EXPECT_EQ(1u, library.getPathCount("other"));
+  EXPECT_EQ(2u, library.getPathCount());
+
+  library.getNearestPaths("group", q, q, 0, paths);
+  EXPECT_TRUE(paths.empty());
+  library.getNearestPaths("group", std::vector<double>(2, 0.0), std::vector<double>(2, 0.0), 1, paths);
+  EXPECT_TRUE(paths.empty());
+  library.getNearestPaths("unknown", q, q, 1, paths);
+  EXPECT_TRUE(paths.empty());
+  library.getNearestPaths("other", std::vector<double>(2, 0.0), std::vector<double>(2, 0.0), 1, paths);
+  EXPECT_EQ(1u, paths.size());
+
+  library.clear();
+  EXPECT_EQ(0u, library.getPathCount());
+}
+
+TEST(PathLibrary, AddTrajectory)
+{
+  robot_model::RobotModelConstPtr robot_model = moveit::core::loadTestingRobotModel("planar_arm");
+  ASSERT_TRUE(robot_model);
+
+  robot_trajectory::RobotTrajectory trajectory(robot_model, "arm");
+  for (std::size_t k = 0 ; k < 3 ; ++k)
+  {
+    robot_state::RobotStatePtr state(new robot_state::RobotState(robot_model));
+    state->setToDefaultValues();
+    state->setVariablePosition("joint1", 0.1 * k);
+    state->setVariablePosition("joint2", -0.2 * k);
+    trajectory.addSuffixWayPoint(state, 0.1);
+  }
+
+  planning_interface::PathLibrary library;
+  library.addPath(trajectory);
+  ASSERT_EQ(1u, library.getPathCount("arm"));
+
+  std::vector<double> start(2, 0.0), goal(2);
+  goal[0] = 0.2;
+  goal[1] = -0.4;
+  std::vector<planning_interface::PathLibrary::PathConstPtr> paths;
+  std::vector<double> distances;
+  library.getNearestPaths("arm", start, goal, 1, paths, &distances);
+  ASSERT_EQ(1u, paths.size());
+  EXPECT_NEAR(0.0, distances[0], 1e-12);
+  ASSERT_EQ(3u, paths[0]->waypoints_.size());
+  EXPECT_NEAR(0.1, paths[0]->waypoints_[1][0], 1e-12);
+  EXPECT_NEAR(-0.2, paths[0]->waypoints_[1][1], 1e-12);
+
+  // trajectories with a single waypoint are ignored
+  robot_trajectory::RobotTrajectory single(robot_model, "arm");
+  single.addSuffixWayPoint(trajectory.getFirstWayPoint(), 0.0);
+  library.addPath(single);
+  EXPECT_EQ(1u, library.getPathCount("arm"));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
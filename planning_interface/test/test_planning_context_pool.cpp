@@ -0,0 +1,290 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/planning_context_pool.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+
+// Like planner plugins, the mock context sets up its goal when it is constructed (and when it is reconfigured);
+// solve() plans a straight line from 0 to that goal
+class MockPlanningContext : public planning_interface::PlanningContext
+{
+public:
+
+  MockPlanningContext(const robot_model::RobotModelConstPtr &model, const std::string &name, bool reconfigurable) :
+    planning_interface::PlanningContext(name, "arm"),
+    model_(model),
+    reconfigurable_(reconfigurable),
+    goal_(0.0),
+    clear_count_(0)
+  {
+  }
+
+  bool setGoal(const planning_interface::MotionPlanRequest &req, moveit_msgs::MoveItErrorCodes &error_code)
+  {
+    if (req.goal_constraints.empty() || req.goal_constraints[0].joint_constraints.empty())
+    {
+      error_code.val = moveit_msgs::MoveItErrorCodes::INVALID_GOAL_CONSTRAINTS;
+      return false;
+    }
+    goal_ = req.goal_constraints[0].joint_constraints[0].position;
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  virtual bool canReconfigure() const
+  {
+    return reconfigurable_;
+  }
+
+  virtual bool reconfigure(const planning_scene::PlanningSceneConstPtr &planning_scene, const planning_interface::MotionPlanRequest &req,
+                           moveit_msgs::MoveItErrorCodes &error_code)
+  {
+    return planning_interface::PlanningContext::reconfigure(planning_scene, req, error_code) && setGoal(req, error_code);
+  }
+
+  virtual bool solve(planning_interface::MotionPlanResponse &res)
+  {
+    res.trajectory_.reset(new robot_trajectory::RobotTrajectory(model_, "arm"));
+    robot_state::RobotStatePtr start(new robot_state::RobotState(model_));
+    start->setToDefaultValues();
+    start->setVariablePosition(0, 0.0);
+    robot_state::RobotStatePtr goal(new robot_state::RobotState(*start));
+    goal->setVariablePosition(0, goal_);
+    res.trajectory_->addSuffixWayPoint(start, 0.0);
+    res.trajectory_->addSuffixWayPoint(goal, 1.0);
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  virtual bool solve(planning_interface::MotionPlanDetailedResponse &res)
+  {
+    return false;
+  }
+
+  virtual bool terminate()
+  {
+    return true;
+  }
+
+  virtual void clear()
+  {
+    ++clear_count_;
+  }
+
+  unsigned int getClearCount() const
+  {
+    return clear_count_;
+  }
+
+private:
+
+  robot_model::RobotModelConstPtr model_;
+  bool reconfigurable_;
+  double goal_;
+  unsigned int clear_count_;
+};
+
+class MockPlannerManager : public planning_interface::PlannerManager
+{
+public:
+
+  MockPlannerManager(const robot_model::RobotModelConstPtr &model, bool reconfigurable) :
+    model_(model),
+    reconfigurable_(reconfigurable),
+    construction_count_(0)
+  {
+  }
+
+  virtual planning_interface::PlanningContextPtr getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                    const planning_interface::MotionPlanRequest &req,
+                                                                    moveit_msgs::MoveItErrorCodes &error_code) const
+  {
+    boost::shared_ptr<MockPlanningContext> context(new MockPlanningContext(model_, "mock", reconfigurable_));
+    context->setPlanningScene(planning_scene);
+    context->setMotionPlanRequest(req);
+    if (!context->setGoal(req, error_code))
+      return planning_interface::PlanningContextPtr();
+    ++construction_count_;
+    return context;
+  }
+
+  virtual bool canServiceRequest(const planning_interface::MotionPlanRequest &req) const
+  {
+    return true;
+  }
+
+  unsigned int getConstructionCount() const
+  {
+    return construction_count_;
+  }
+
+private:
+
+  robot_model::RobotModelConstPtr model_;
+  bool reconfigurable_;
+  mutable unsigned int construction_count_;
+};
+
+class PlanningContextPoolTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("one_dof_arm");
+    ASSERT_TRUE(robot_model_);
+  }
+
+  static planning_interface::MotionPlanRequest makeRequest(double goal)
+  {
+    planning_interface::MotionPlanRequest req;
+    req.group_name = "arm";
+    req.planner_id = "mock";
+    req.allowed_planning_time = 1.0;
+    req.goal_constraints.resize(1);
+    req.goal_constraints[0].joint_constraints.resize(1);
+    req.goal_constraints[0].joint_constraints[0].joint_name = "joint1";
+    req.goal_constraints[0].joint_constraints[0].position = goal;
+    return req;
+  }
+
+  static double getPlannedGoal(const planning_interface::MotionPlanResponse &res)
+  {
+    return res.trajectory_->getLastWayPoint().getVariablePosition(0);
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+};
+
+TEST_F(PlanningContextPoolTest, ReusedContextPlansNewGoal)
+{
+  boost::shared_ptr<MockPlannerManager> manager(new MockPlannerManager(robot_model_, true));
+  planning_interface::PlanningContextPool pool(manager);
+  moveit_msgs::MoveItErrorCodes error_code;
+
+  planning_interface::PlanningContextPtr first = pool.checkout(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), error_code);
+  ASSERT_TRUE(first);
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(first->solve(res));
+  EXPECT_EQ(1.0, getPlannedGoal(res));
+  pool.checkin(first);
+  EXPECT_EQ(1u, pool.getIdleContextCount());
+  EXPECT_EQ(1u, static_cast<MockPlanningContext*>(first.get())->getClearCount());
+
+  planning_interface::PlanningContextPtr second = pool.checkout(planning_scene::PlanningSceneConstPtr(), makeRequest(2.0), error_code);
+  ASSERT_TRUE(second);
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS, error_code.val);
+  EXPECT_EQ(2.0, second->getMotionPlanRequest().goal_constraints[0].joint_constraints[0].position);
+  ASSERT_TRUE(second->solve(res));
+  EXPECT_EQ(2.0, getPlannedGoal(res));
+  pool.checkin(second);
+
+  EXPECT_EQ(1u, manager->getConstructionCount());
+  planning_interface::PlanningContextPool::Statistics statistics = pool.getStatistics();
+  EXPECT_EQ(2u, statistics.checkouts_);
+  EXPECT_EQ(1u, statistics.hits_);
+  EXPECT_EQ(1u, statistics.misses_);
+  EXPECT_EQ(0u, statistics.discarded_);
+
+  // the pool also solves through reused contexts
+  ASSERT_TRUE(pool.solve(planning_scene::PlanningSceneConstPtr(), makeRequest(-0.5), res));
+  EXPECT_EQ(-0.5, getPlannedGoal(res));
+  EXPECT_EQ(1u, manager->getConstructionCount());
+}
+
+TEST_F(PlanningContextPoolTest, FailedReconfigureConstructsNewContext)
+{
+  boost::shared_ptr<MockPlannerManager> manager(new MockPlannerManager(robot_model_, true));
+  planning_interface::PlanningContextPool pool(manager);
+  moveit_msgs::MoveItErrorCodes error_code;
+  pool.checkin(pool.checkout(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), error_code));
+  ASSERT_EQ(1u, pool.getIdleContextCount());
+
+  // neither the idle context nor a new one accept a request without a goal
+  planning_interface::MotionPlanRequest req = makeRequest(1.0);
+  req.goal_constraints.clear();
+  EXPECT_FALSE(pool.checkout(planning_scene::PlanningSceneConstPtr(), req, error_code));
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::INVALID_GOAL_CONSTRAINTS, error_code.val);
+  EXPECT_EQ(0u, pool.getIdleContextCount());
+  EXPECT_EQ(0u, pool.getCheckedOutContextCount());
+  EXPECT_EQ(1u, pool.getStatistics().failures_);
+  EXPECT_EQ(0u, pool.getStatistics().hits_);
+}
+
+TEST_F(PlanningContextPoolTest, ContextsThatCannotBeReconfiguredAreNotReused)
+{
+  boost::shared_ptr<MockPlannerManager> manager(new MockPlannerManager(robot_model_, false));
+  planning_interface::PlanningContextPool pool(manager);
+  planning_interface::MotionPlanResponse res;
+
+  ASSERT_TRUE(pool.solve(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), res));
+  EXPECT_EQ(1.0, getPlannedGoal(res));
+  EXPECT_EQ(0u, pool.getIdleContextCount());
+  ASSERT_TRUE(pool.solve(planning_scene::PlanningSceneConstPtr(), makeRequest(2.0), res));
+  EXPECT_EQ(2.0, getPlannedGoal(res));
+
+  EXPECT_EQ(2u, manager->getConstructionCount());
+  planning_interface::PlanningContextPool::Statistics statistics = pool.getStatistics();
+  EXPECT_EQ(0u, statistics.hits_);
+  EXPECT_EQ(2u, statistics.misses_);
+  EXPECT_EQ(2u, statistics.discarded_);
+}
+
+TEST_F(PlanningContextPoolTest, IdleContextsAreBounded)
+{
+  boost::shared_ptr<MockPlannerManager> manager(new MockPlannerManager(robot_model_, true));
+  planning_interface::PlanningContextPool pool(manager, 1);
+  moveit_msgs::MoveItErrorCodes error_code;
+
+  planning_interface::PlanningContextPtr a = pool.checkout(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), error_code);
+  planning_interface::PlanningContextPtr b = pool.checkout(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), error_code);
+  ASSERT_TRUE(a && b);
+  EXPECT_EQ(2u, pool.getCheckedOutContextCount());
+  pool.checkin(a);
+  pool.checkin(b);
+  EXPECT_EQ(1u, pool.getIdleContextCount());
+  EXPECT_EQ(1u, pool.getStatistics().evictions_);
+
+  // contexts that do not come from the pool are ignored
+  pool.checkin(manager->getPlanningContext(planning_scene::PlanningSceneConstPtr(), makeRequest(1.0), error_code));
+  EXPECT_EQ(1u, pool.getIdleContextCount());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,320 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_interface/planning_portfolio.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
+
+// what the context of a mock planner does when solving
+struct MockBehavior
+{
+  MockBehavior(double delay = 0.0, double length = 0.0, bool solves = true) :
+    delay_(delay),
+    length_(length),
+    solves_(solves)
+  {
+  }
+
+  /// seconds before solve() returns, unless terminated
+  double delay_;
+
+  /// the length of the solution: joint1 moves from 0 to length_
+  double length_;
+
+  bool solves_;
+};
+
+class MockPlanningContext : public planning_interface::PlanningContext
+{
+public:
+
+  MockPlanningContext(const robot_model::RobotModelConstPtr &model, const std::string &name, const MockBehavior &behavior) :
+    planning_interface::PlanningContext(name, "arm"),
+    model_(model),
+    behavior_(behavior),
+    terminated_(false)
+  {
+  }
+
+  virtual bool solve(planning_interface::MotionPlanResponse &res)
+  {
+    const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(behavior_.delay_);
+    while (ros::WallTime::now() < deadline)
+    {
+      if (isTerminated())
+      {
+        res.error_code_.val = moveit_msgs::MoveItErrorCodes::PREEMPTED;
+        return false;
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    if (!behavior_.solves_)
+    {
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+      return false;
+    }
+
+    res.trajectory_.reset(new robot_trajectory::RobotTrajectory(model_, "arm"));
+    robot_state::RobotStatePtr start(new robot_state::RobotState(model_));
+    start->setToDefaultValues();
+    start->setVariablePosition("joint1", 0.0);
+    robot_state::RobotStatePtr goal(new robot_state::RobotState(*start));
+    goal->setVariablePosition("joint1", behavior_.length_);
+    res.trajectory_->addSuffixWayPoint(start, 0.0);
+    res.trajectory_->addSuffixWayPoint(goal, 1.0);
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  virtual bool solve(planning_interface::MotionPlanDetailedResponse &res)
+  {
+    return false;
+  }
+
+  virtual bool terminate()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    terminated_ = true;
+    return true;
+  }
+
+  virtual void clear()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    terminated_ = false;
+  }
+
+private:
+
+  bool isTerminated()
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    return terminated_;
+  }
+
+  robot_model::RobotModelConstPtr model_;
+  MockBehavior behavior_;
+  boost::mutex lock_;
+  bool terminated_;
+};
+
+// constructs a context that behaves as configured for the planner_id of the request
+class MockPlannerManager : public planning_interface::PlannerManager
+{
+public:
+
+  MockPlannerManager(const robot_model::RobotModelConstPtr &model) :
+    model_(model)
+  {
+  }
+
+  void addPlanner(const std::string &planner_id, const MockBehavior &behavior)
+  {
+    behaviors_[planner_id] = behavior;
+  }
+
+  virtual planning_interface::PlanningContextPtr getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                    const planning_interface::MotionPlanRequest &req,
+                                                                    moveit_msgs::MoveItErrorCodes &error_code) const
+  {
+    std::map<std::string, MockBehavior>::const_iterator it = behaviors_.find(req.planner_id);
+    if (it == behaviors_.end())
+    {
+      error_code.val = moveit_msgs::MoveItErrorCodes::INVALID_GROUP_NAME;
+      return planning_interface::PlanningContextPtr();
+    }
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return planning_interface::PlanningContextPtr(new MockPlanningContext(model_, req.planner_id + "_context", it->second));
+  }
+
+  virtual bool canServiceRequest(const planning_interface::MotionPlanRequest &req) const
+  {
+    return true;
+  }
+
+private:
+
+  robot_model::RobotModelConstPtr model_;
+  std::map<std::string, MockBehavior> behaviors_;
+};
+
+class PlanningPortfolioTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("planar_arm");
+    ASSERT_TRUE(robot_model_);
+
+    manager_.reset(new MockPlannerManager(robot_model_));
+    manager_->addPlanner("fast", MockBehavior(0.0, 2.0));
+    manager_->addPlanner("slow", MockBehavior(0.2, 1.0));
+    manager_->addPlanner("stuck", MockBehavior(30.0, 0.5));
+    manager_->addPlanner("failing", MockBehavior(0.0, 0.0, false));
+
+    request_.group_name = "arm";
+    request_.allowed_planning_time = 5.0;
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  boost::shared_ptr<MockPlannerManager> manager_;
+  planning_interface::MotionPlanRequest request_;
+};
+
+TEST_F(PlanningPortfolioTest, FirstSolution)
+{
+  planning_interface::PlanningPortfolio portfolio(manager_, planning_interface::PlanningPortfolio::FIRST_SOLUTION);
+  portfolio.addPlanner("stuck");
+  portfolio.addPlanner("failing");
+  portfolio.addPlanner("fast");
+
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  ASSERT_TRUE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::SUCCESS, res.error_code_.val);
+  ASSERT_TRUE(res.trajectory_);
+  EXPECT_NEAR(2.0, planning_interface::PlanningPortfolio::getPathLength(*res.trajectory_), 1e-9);
+  // the stuck context is terminated as soon as the fast one is done
+  EXPECT_LT(res.planning_time_, 2.0);
+
+  ASSERT_EQ(3u, results.size());
+  EXPECT_EQ("stuck", results[0].planner_id_);
+  EXPECT_EQ("stuck_context", results[0].context_name_);
+  EXPECT_FALSE(results[0].solved_);
+  EXPECT_TRUE(results[0].terminated_);
+  EXPECT_FALSE(results[1].solved_);
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::PLANNING_FAILED, results[1].error_code_.val);
+  EXPECT_TRUE(results[2].solved_);
+  EXPECT_NEAR(2.0, results[2].path_length_, 1e-9);
+}
+
+TEST_F(PlanningPortfolioTest, BestSolution)
+{
+  planning_interface::PlanningPortfolio portfolio(manager_, planning_interface::PlanningPortfolio::BEST_SOLUTION);
+  portfolio.addPlanner("fast");
+  portfolio.addPlanner("slow", 2);
+  portfolio.addPlanner("failing");
+  EXPECT_EQ(4u, portfolio.getPlanners().size());
+
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  ASSERT_TRUE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  ASSERT_TRUE(res.trajectory_);
+  // the slower planner finds the shorter path, and all members run to completion
+  EXPECT_NEAR(1.0, planning_interface::PlanningPortfolio::getPathLength(*res.trajectory_), 1e-9);
+  ASSERT_EQ(4u, results.size());
+  EXPECT_TRUE(results[0].solved_);
+  EXPECT_TRUE(results[1].solved_);
+  EXPECT_TRUE(results[2].solved_);
+  EXPECT_FALSE(results[3].solved_);
+  for (std::size_t i = 0 ; i < results.size() ; ++i)
+    EXPECT_FALSE(results[i].terminated_);
+  EXPECT_GE(results[1].planning_time_, 0.2);
+}
+
+TEST_F(PlanningPortfolioTest, BestSolutionWithinBudget)
+{
+  // members still running when the allowed planning time is over are terminated, and the best solution found so far is kept
+  planning_interface::PlanningPortfolio portfolio(manager_, planning_interface::PlanningPortfolio::BEST_SOLUTION);
+  portfolio.addPlanner("stuck");
+  portfolio.addPlanner("fast");
+  request_.allowed_planning_time = 0.5;
+
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  ASSERT_TRUE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  EXPECT_NEAR(2.0, planning_interface::PlanningPortfolio::getPathLength(*res.trajectory_), 1e-9);
+  EXPECT_LT(res.planning_time_, 5.0);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[0].terminated_);
+  EXPECT_TRUE(results[1].solved_);
+}
+
+TEST_F(PlanningPortfolioTest, LimitedThreads)
+{
+  // with a single thread, the members after the first solution are never started
+  planning_interface::PlanningPortfolio portfolio(manager_, planning_interface::PlanningPortfolio::FIRST_SOLUTION);
+  portfolio.setMaxThreads(1);
+  portfolio.addPlanner("fast");
+  portfolio.addPlanner("stuck");
+
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  ASSERT_TRUE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[0].solved_);
+  EXPECT_TRUE(results[1].terminated_);
+  EXPECT_EQ(0.0, results[1].planning_time_);
+}
+
+TEST_F(PlanningPortfolioTest, NoSolution)
+{
+  planning_interface::PlanningPortfolio portfolio(manager_);
+  portfolio.addPlanner("unknown");
+  portfolio.addPlanner("failing");
+
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  EXPECT_FALSE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  EXPECT_FALSE(res.trajectory_);
+  // the first failure reported by a member is returned
+  EXPECT_EQ(moveit_msgs::MoveItErrorCodes::INVALID_GROUP_NAME, res.error_code_.val);
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[0].context_name_.empty());
+  EXPECT_FALSE(results[0].solved_);
+  EXPECT_FALSE(results[0].terminated_);
+  EXPECT_FALSE(results[1].solved_);
+}
+
+TEST_F(PlanningPortfolioTest, EmptyPortfolioUsesRequestPlanner)
+{
+  planning_interface::PlanningPortfolio portfolio(manager_);
+  request_.planner_id = "slow";
+  planning_interface::MotionPlanResponse res;
+  std::vector<planning_interface::PlanningPortfolio::MemberResult> results;
+  ASSERT_TRUE(portfolio.solve(planning_scene::PlanningSceneConstPtr(), request_, res, &results));
+  ASSERT_EQ(1u, results.size());
+  EXPECT_EQ("slow", results[0].planner_id_);
+  EXPECT_NEAR(1.0, planning_interface::PlanningPortfolio::getPathLength(*res.trajectory_), 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,179 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_PLANNING_REQUEST_ADAPTER_PLAN_CACHE_ADAPTER_
+#define MOVEIT_PLANNING_REQUEST_ADAPTER_PLAN_CACHE_ADAPTER_
+
+#include <moveit/planning_request_adapter/planning_request_adapter.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <list>
+#include <map>
+
+namespace planning_request_adapter
+{
+
+/** \brief A planning request adapter that remembers the motion plans computed for previous requests.
+
+    The key of a request combines the start state (every variable is quantized to the state resolution),
+    the group, the goal constraints, the path constraints and the bodies attached to the start state with
+    a hash of the content of the planning scene: the world geometry, the octomap, the allowed collision
+    matrix and the padding and scaling of the links. The scene hash is only recomputed when
+    PlanningScene::getWorldVersion() changes. When a request with the same key is seen again, the cached path
+    is moved to the exact start state of the request and returned if PlanningScene::isPathValid() accepts
+    it; otherwise the entry is dropped and the planner is called. Only successful plans are stored. The
+    number of entries is bounded; the least recently used entry is evicted first. The cache can be saved
+    to and loaded from a file, so it can be kept across runs.
+
+    The adapter stores the trajectory as returned by the adapters that follow it in the chain, so it is
+    usually added first. All functions are thread safe. */
+class PlanCacheAdapter : public PlanningRequestAdapter
+{
+public:
+
+  /** \brief Counters describing the use of the cache */
+  struct Statistics
+  {
+    Statistics() :
+      lookups_(0),
+      hits_(0),
+      misses_(0),
+      rejected_(0),
+      evictions_(0)
+    {
+    }
+
+    /// The number of requests for which the cache was consulted
+    std::size_t lookups_;
+
+    /// The number of requests answered from the cache
+    std::size_t hits_;
+
+    /// The number of requests for which no entry was found
+    std::size_t misses_;
+
+    /// The number of entries found but rejected because the path is no longer valid
+    std::size_t rejected_;
+
+    /// The number of entries removed because the cache was full
+    std::size_t evictions_;
+  };
+
+  /** \brief Construct a cache holding at most \e capacity plans. Start state variables are quantized to \e state_resolution. */
+  PlanCacheAdapter(std::size_t capacity = 100, double state_resolution = 1e-3);
+
+  virtual std::string getDescription() const
+  {
+    return "Motion Plan Cache";
+  }
+
+  virtual bool adaptAndPlan(const PlannerFn &planner,
+                            const planning_scene::PlanningSceneConstPtr& planning_scene,
+                            const planning_interface::MotionPlanRequest &req,
+                            planning_interface::MotionPlanResponse &res,
+                            std::vector<std::size_t> &added_path_index) const;
+
+  /** \brief Set the maximum number of plans kept; least recently used plans are evicted if needed */
+  void setCapacity(std::size_t capacity);
+
+  std::size_t getCapacity() const;
+
+  /** \brief Set the resolution used to quantize the start state. Changing it invalidates the existing entries, so the cache is cleared. */
+  void setStateResolution(double resolution);
+
+  double getStateResolution() const;
+
+  /** \brief Get the number of plans in the cache */
+  std::size_t getSize() const;
+
+  /** \brief Remove all plans */
+  void clear();
+
+  Statistics getStatistics() const;
+
+  void resetStatistics();
+
+  /** \brief Save the cache to \e filename. Returns false if the file cannot be written. */
+  bool save(const std::string &filename) const;
+
+  /** \brief Add the plans stored in \e filename to the cache. The plans are converted using \e robot_model,
+      which must be the model they were computed for. Returns false if the file cannot be read or was written
+      for a different robot model or state resolution. */
+  bool load(const robot_model::RobotModelConstPtr &robot_model, const std::string &filename);
+
+  /** \brief Compute the hash of the parts of \e planning_scene that affect the validity of a path, except the attached
+      bodies, which are part of the start state */
+  static boost::uint64_t computeSceneHash(const planning_scene::PlanningScene &planning_scene);
+
+  /** \brief Compute the key under which the plan for \e req is cached. \e scene_hash is the result of computeSceneHash()
+      and \e start_state is the full start state of the request (the current state of the scene updated with req.start_state). */
+  boost::uint64_t computeRequestKey(boost::uint64_t scene_hash, const robot_state::RobotState &start_state,
+                                    const planning_interface::MotionPlanRequest &req) const;
+
+private:
+
+  struct Entry
+  {
+    boost::uint64_t key_;
+    robot_trajectory::RobotTrajectoryConstPtr trajectory_;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  /// Insert or replace an entry as the most recently used one; lock_ must be held
+  void insert(boost::uint64_t key, const robot_trajectory::RobotTrajectoryConstPtr &trajectory) const;
+
+  /// Get computeSceneHash() for \e planning_scene, reusing the last hash if the world version did not change
+  boost::uint64_t getSceneHash(const planning_scene::PlanningScene &planning_scene) const;
+
+  /// Evict entries until the capacity is respected; lock_ must be held
+  void enforceCapacity() const;
+
+  std::size_t capacity_;
+  double state_resolution_;
+
+  /// Entries ordered from the most to the least recently used
+  mutable EntryList entries_;
+  mutable std::map<boost::uint64_t, EntryList::iterator> index_;
+  mutable Statistics statistics_;
+
+  /// The world version and hash of the last scene seen; versions start at 1, so 0 means none
+  mutable boost::uint64_t scene_version_;
+  mutable boost::uint64_t scene_hash_;
+  mutable boost::mutex lock_;
+};
+
+}
+
+#endif
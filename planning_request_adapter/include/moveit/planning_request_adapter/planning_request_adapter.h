@@ -40,6 +40,8 @@
 #include <moveit/planning_interface/planning_interface.h>
 #include <moveit/planning_scene/planning_scene.h>
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <iostream>
 
 /** \brief Generic interface to adapting motion planning requests */
 namespace planning_request_adapter
@@ -90,11 +92,95 @@ public:
 typedef boost::shared_ptr<PlanningRequestAdapter> PlanningRequestAdapterPtr;
 typedef boost::shared_ptr<const PlanningRequestAdapter> PlanningRequestAdapterConstPtr;
 
+/// Timing and outcome of one step (an adapter or the planner) of PlanningRequestAdapterChain::adaptAndPlan()
+struct AdapterTiming
+{
+  AdapterTiming() :
+    calls_(0),
+    wall_time_(0.0),
+    total_wall_time_(0.0),
+    cpu_time_(0.0),
+    total_cpu_time_(0.0),
+    added_path_index_count_(0),
+    result_(false),
+    exception_(false)
+  {
+  }
+
+  /// The description of the adapter, or "planner" for the planner itself
+  std::string name_;
+
+  /// The number of times the step was executed; an adapter can skip the steps after it, or execute them more than once
+  std::size_t calls_;
+
+  /// Wall-clock time spent in this step, excluding the steps it called
+  double wall_time_;
+
+  /// Wall-clock time spent in this step, including the steps it called
+  double total_wall_time_;
+
+  /// CPU time of the calling thread spent in this step, excluding the steps it called; work done in other threads is not included
+  double cpu_time_;
+
+  /// CPU time of the calling thread spent in this step, including the steps it called; work done in other threads is not included
+  double total_cpu_time_;
+
+  /// The number of path index values the adapter reported as added
+  std::size_t added_path_index_count_;
+
+  /// The value returned by the last execution of the step
+  bool result_;
+
+  /// True if the adapter threw an exception and the chain continued without it
+  bool exception_;
+};
+
+/// Timing statistics accumulated over calls of PlanningRequestAdapterChain::adaptAndPlan()
+struct AdapterStatistics
+{
+  AdapterStatistics() :
+    calls_(0),
+    successes_(0),
+    exceptions_(0),
+    wall_time_(0.0),
+    max_wall_time_(0.0),
+    cpu_time_(0.0),
+    added_path_index_count_(0)
+  {
+  }
+
+  /// The description of the adapter, or "planner" for the planner itself
+  std::string name_;
+
+  /// The number of times the step was executed
+  std::size_t calls_;
+
+  /// The number of adaptAndPlan() calls in which the last execution of the step succeeded
+  std::size_t successes_;
+
+  /// The number of exceptions thrown by the adapter
+  std::size_t exceptions_;
+
+  /// Total wall-clock time spent in this step, excluding the steps it called
+  double wall_time_;
+
+  /// The largest wall-clock time of this step in a single adaptAndPlan() call, excluding the steps it called
+  double max_wall_time_;
+
+  /// Total CPU time of the calling thread spent in this step, excluding the steps it called
+  double cpu_time_;
+
+  /// The total number of path index values the adapter reported as added
+  std::size_t added_path_index_count_;
+};
+
 /// Apply a sequence of adapters to a motion plan
 class PlanningRequestAdapterChain
 {
 public:
-  PlanningRequestAdapterChain()
+  PlanningRequestAdapterChain() :
+    instrumentation_(false),
+    planning_calls_(0)
   {
   }
 
@@ -103,6 +189,33 @@ public:
     adapters_.push_back(adapter);
   }
 
+  /** \brief Enable or disable accumulating timing statistics for each adapter and the planner (disabled by default).
+      When disabled, the chain does not measure time. */
+  void setInstrumentation(bool enable)
+  {
+    instrumentation_ = enable;
+  }
+
+  bool getInstrumentation() const
+  {
+    return instrumentation_;
+  }
+
+  /** \brief Get the statistics accumulated while instrumentation was enabled. The adapters come first, in the order
+      they were added, followed by the planner. */
+  std::vector<AdapterStatistics> getStatistics() const;
+
+  /** \brief Get the number of adaptAndPlan() calls included in the statistics */
+  std::size_t getStatisticsCallCount() const;
+
+  void resetStatistics();
+
+  /** \brief Print the accumulated statistics in a human readable form */
+  void printStatistics(std::ostream &out = std::cout) const;
+
+  /** \brief Write the accumulated statistics as comma separated values, one line per step, with a header line */
+  void writeStatisticsCSV(std::ostream &out) const;
+
   bool adaptAndPlan(const planning_interface::PlannerManagerPtr &planner,
                     const planning_scene::PlanningSceneConstPtr& planning_scene,
                     const planning_interface::MotionPlanRequest &req,
@@ -114,8 +227,34 @@ public:
                     planning_interface::MotionPlanResponse &res,
                     std::vector<std::size_t> &added_path_index) const;
 
+  /** \brief Same as above, and store the timing of each adapter and of the planner in \e timing, whether instrumentation is enabled or not.
+      The adapters come first, in the order they were added, followed by the planner. */
+  bool adaptAndPlan(const planning_interface::PlannerManagerPtr &planner,
+                    const planning_scene::PlanningSceneConstPtr& planning_scene,
+                    const planning_interface::MotionPlanRequest &req,
+                    planning_interface::MotionPlanResponse &res,
+                    std::vector<std::size_t> &added_path_index,
+                    std::vector<AdapterTiming> &timing) const;
+
 private:
+
+  /// Run the chain; \e timing is NULL if no timing is to be measured
+  bool runChain(const planning_interface::PlannerManagerPtr &planner,
+                const planning_scene::PlanningSceneConstPtr& planning_scene,
+                const planning_interface::MotionPlanRequest &req,
+                planning_interface::MotionPlanResponse &res,
+                std::vector<std::size_t> &added_path_index,
+                std::vector<AdapterTiming> *timing) const;
+
+  /// Add \e timing to the accumulated statistics
+  void accumulate(const std::vector<AdapterTiming> &timing) const;
+
   std::vector<PlanningRequestAdapterConstPtr> adapters_;
+
+  bool instrumentation_;
+  mutable std::vector<AdapterStatistics> statistics_;
+  mutable std::size_t planning_calls_;
+  mutable boost::mutex statistics_lock_;
 };
 
 
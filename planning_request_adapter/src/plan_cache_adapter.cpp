@@ -0,0 +1,499 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_request_adapter/plan_cache_adapter.h>
+#include <moveit/robot_state/conversions.h>
+#include <moveit_msgs/PlanningSceneComponents.h>
+#include <console_bridge/console.h>
+#include <ros/serialization.h>
+#include <ros/time.h>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+namespace planning_request_adapter
+{
+
+namespace
+{
+
+static const char CACHE_FILE_MAGIC[4] = { 'M', 'P', 'C', 'F' };
+static const boost::uint32_t CACHE_FILE_VERSION = 1;
+
+// 64 bit FNV-1a hash, fed with raw bytes and serialized messages
+class KeyHash
+{
+public:
+  KeyHash() : hash_(14695981039346656037ULL)
+  {
+  }
+
+  void add(const void *data, std::size_t size)
+  {
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0 ; i < size ; ++i)
+    {
+      hash_ ^= bytes[i];
+      hash_ *= 1099511628211ULL;
+    }
+  }
+
+  template<typename T>
+  void addMessage(const T &msg)
+  {
+    boost::uint32_t size = ros::serialization::serializationLength(msg);
+    buffer_.resize(size);
+    if (size == 0)
+      return;
+    ros::serialization::OStream stream(&buffer_[0], size);
+    ros::serialization::serialize(stream, msg);
+    add(&buffer_[0], size);
+  }
+
+  boost::uint64_t get() const
+  {
+    return hash_;
+  }
+
+private:
+  boost::uint64_t hash_;
+  std::vector<boost::uint8_t> buffer_;
+};
+
+robot_trajectory::RobotTrajectoryPtr copyTrajectory(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  robot_trajectory::RobotTrajectoryPtr copy(new robot_trajectory::RobotTrajectory(trajectory.getRobotModel(), trajectory.getGroup()));
+  for (std::size_t k = 0 ; k < trajectory.getWayPointCount() ; ++k)
+    copy->addSuffixWayPoint(trajectory.getWayPoint(k), trajectory.getWayPointDurationFromPrevious(k));
+  return copy;
+}
+
+// the cached path, with every waypoint based on the start state of the new request
+robot_trajectory::RobotTrajectoryPtr adaptTrajectory(const robot_trajectory::RobotTrajectory &cached, const robot_state::RobotState &start_state,
+                                                     const robot_model::JointModelGroup *group)
+{
+  robot_trajectory::RobotTrajectoryPtr trajectory(new robot_trajectory::RobotTrajectory(cached.getRobotModel(), cached.getGroup()));
+  const std::vector<int> &index = group->getVariableIndexList();
+  std::vector<double> values;
+  trajectory->addSuffixWayPoint(start_state, 0.0);
+  for (std::size_t k = 1 ; k < cached.getWayPointCount() ; ++k)
+  {
+    const robot_state::RobotState &waypoint = cached.getWayPoint(k);
+    robot_state::RobotStatePtr state(new robot_state::RobotState(start_state));
+    waypoint.copyJointGroupPositions(group, values);
+    state->setJointGroupPositions(group, values);
+    if (waypoint.hasVelocities())
+      for (std::size_t i = 0 ; i < index.size() ; ++i)
+        state->setVariableVelocity(index[i], waypoint.getVariableVelocity(index[i]));
+    if (waypoint.hasAccelerations())
+      for (std::size_t i = 0 ; i < index.size() ; ++i)
+        state->setVariableAcceleration(index[i], waypoint.getVariableAcceleration(index[i]));
+    trajectory->addSuffixWayPoint(state, cached.getWayPointDurationFromPrevious(k));
+  }
+  return trajectory;
+}
+
+template<typename T>
+void writeValue(std::ostream &out, const T &value)
+{
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+bool readValue(std::istream &in, T &value)
+{
+  return in.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+}
+
+}
+
+PlanCacheAdapter::PlanCacheAdapter(std::size_t capacity, double state_resolution) :
+  PlanningRequestAdapter(),
+  capacity_(capacity),
+  state_resolution_(state_resolution > 0.0 ? state_resolution : 1e-3),
+  scene_version_(0),
+  scene_hash_(0)
+{
+}
+
+boost::uint64_t PlanCacheAdapter::computeSceneHash(const planning_scene::PlanningScene &planning_scene)
+{
+  moveit_msgs::PlanningSceneComponents comp;
+  comp.components =
+    moveit_msgs::PlanningSceneComponents::WORLD_OBJECT_GEOMETRY |
+    moveit_msgs::PlanningSceneComponents::OCTOMAP |
+    moveit_msgs::PlanningSceneComponents::ALLOWED_COLLISION_MATRIX |
+    moveit_msgs::PlanningSceneComponents::LINK_PADDING_AND_SCALING;
+  moveit_msgs::PlanningScene msg;
+  planning_scene.getPlanningSceneMsg(msg, comp);
+  msg.robot_model_name = planning_scene.getRobotModel()->getName();
+
+  KeyHash hash;
+  hash.addMessage(msg);
+  return hash.get();
+}
+
+boost::uint64_t PlanCacheAdapter::getSceneHash(const planning_scene::PlanningScene &planning_scene) const
+{
+  boost::uint64_t version = planning_scene.getWorldVersion();
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    if (scene_version_ == version)
+      return scene_hash_;
+  }
+
+  // serializing the scene is expensive, so it is done only when the world version changes
+  boost::uint64_t scene_hash = computeSceneHash(planning_scene);
+  boost::mutex::scoped_lock slock(lock_);
+  scene_version_ = version;
+  scene_hash_ = scene_hash;
+  return scene_hash;
+}
+
+boost::uint64_t PlanCacheAdapter::computeRequestKey(boost::uint64_t scene_hash, const robot_state::RobotState &start_state,
+                                                    const planning_interface::MotionPlanRequest &req) const
+{
+  KeyHash hash;
+  hash.add(&scene_hash, sizeof(scene_hash));
+
+  double resolution;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    resolution = state_resolution_;
+  }
+  const double *positions = start_state.getVariablePositions();
+  for (std::size_t i = 0 ; i < start_state.getVariableCount() ; ++i)
+  {
+    boost::int64_t q = (boost::int64_t)floor(positions[i] / resolution + 0.5);
+    hash.add(&q, sizeof(q));
+  }
+
+  // the attached bodies of the scene and of the request are both part of the start state
+  std::vector<const robot_state::AttachedBody*> attached_bodies;
+  start_state.getAttachedBodies(attached_bodies);
+  if (!attached_bodies.empty())
+  {
+    moveit_msgs::RobotState state_msg;
+    robot_state::robotStateToRobotStateMsg(start_state, state_msg, true);
+    hash.addMessage(state_msg.attached_collision_objects);
+  }
+  hash.addMessage(req.group_name);
+  hash.addMessage(req.goal_constraints);
+  hash.addMessage(req.path_constraints);
+  return hash.get();
+}
+
+bool PlanCacheAdapter::adaptAndPlan(const PlannerFn &planner,
+                                    const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                    const planning_interface::MotionPlanRequest &req,
+                                    planning_interface::MotionPlanResponse &res,
+                                    std::vector<std::size_t> &added_path_index) const
+{
+  const robot_model::RobotModelConstPtr &robot_model = planning_scene->getRobotModel();
+  if (!robot_model->hasJointModelGroup(req.group_name))
+    return planner(planning_scene, req, res);
+  const robot_model::JointModelGroup *group = robot_model->getJointModelGroup(req.group_name);
+
+  ros::WallTime start = ros::WallTime::now();
+  robot_state::RobotStatePtr start_state = planning_scene->getCurrentStateUpdated(req.start_state);
+  boost::uint64_t key = computeRequestKey(getSceneHash(*planning_scene), *start_state, req);
+
+  robot_trajectory::RobotTrajectoryConstPtr cached;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    statistics_.lookups_++;
+    std::map<boost::uint64_t, EntryList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end())
+    {
+      // mark as most recently used
+      entries_.splice(entries_.begin(), entries_, it->second);
+      cached = it->second->trajectory_;
+    }
+    else
+      statistics_.misses_++;
+  }
+
+  if (cached)
+  {
+    robot_trajectory::RobotTrajectoryPtr trajectory = adaptTrajectory(*cached, *start_state, group);
+    if (planning_scene->isPathValid(*trajectory, req.path_constraints, req.goal_constraints, req.group_name))
+    {
+      {
+        boost::mutex::scoped_lock slock(lock_);
+        statistics_.hits_++;
+      }
+      res.trajectory_ = trajectory;
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+      res.planning_time_ = (ros::WallTime::now() - start).toSec();
+      added_path_index.clear();
+      logDebug("Motion plan cache hit for group '%s' (%u waypoints)", req.group_name.c_str(), (unsigned int)trajectory->getWayPointCount());
+      return true;
+    }
+
+    logDebug("Cached motion plan for group '%s' is no longer valid", req.group_name.c_str());
+    boost::mutex::scoped_lock slock(lock_);
+    statistics_.rejected_++;
+    std::map<boost::uint64_t, EntryList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end() && it->second->trajectory_ == cached)
+    {
+      entries_.erase(it->second);
+      index_.erase(it);
+    }
+  }
+
+  bool result = planner(planning_scene, req, res);
+  if (result && res.trajectory_ && !res.trajectory_->empty())
+  {
+    // the adapters that follow this one may modify the waypoints in place, so a copy is stored
+    robot_trajectory::RobotTrajectoryConstPtr copy = copyTrajectory(*res.trajectory_);
+    boost::mutex::scoped_lock slock(lock_);
+    insert(key, copy);
+  }
+  return result;
+}
+
+void PlanCacheAdapter::insert(boost::uint64_t key, const robot_trajectory::RobotTrajectoryConstPtr &trajectory) const
+{
+  std::map<boost::uint64_t, EntryList::iterator>::iterator it = index_.find(key);
+  if (it != index_.end())
+    entries_.erase(it->second);
+  Entry entry;
+  entry.key_ = key;
+  entry.trajectory_ = trajectory;
+  entries_.push_front(entry);
+  index_[key] = entries_.begin();
+  enforceCapacity();
+}
+
+void PlanCacheAdapter::enforceCapacity() const
+{
+  while (entries_.size() > capacity_)
+  {
+    index_.erase(entries_.back().key_);
+    entries_.pop_back();
+    statistics_.evictions_++;
+  }
+}
+
+void PlanCacheAdapter::setCapacity(std::size_t capacity)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  capacity_ = capacity;
+  enforceCapacity();
+}
+
+std::size_t PlanCacheAdapter::getCapacity() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return capacity_;
+}
+
+void PlanCacheAdapter::setStateResolution(double resolution)
+{
+  if (resolution <= 0.0)
+  {
+    logError("The state resolution of the motion plan cache must be positive (%lf specified)", resolution);
+    return;
+  }
+  boost::mutex::scoped_lock slock(lock_);
+  state_resolution_ = resolution;
+  entries_.clear();
+  index_.clear();
+}
+
+double PlanCacheAdapter::getStateResolution() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return state_resolution_;
+}
+
+std::size_t PlanCacheAdapter::getSize() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return entries_.size();
+}
+
+void PlanCacheAdapter::clear()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  entries_.clear();
+  index_.clear();
+}
+
+PlanCacheAdapter::Statistics PlanCacheAdapter::getStatistics() const
+{
+  boost::mutex::scoped_lock slock(lock_);
+  return statistics_;
+}
+
+void PlanCacheAdapter::resetStatistics()
+{
+  boost::mutex::scoped_lock slock(lock_);
+  statistics_ = Statistics();
+}
+
+bool PlanCacheAdapter::save(const std::string &filename) const
+{
+  // take a snapshot, so the conversion to messages happens without holding the lock
+  std::vector<Entry> entries;
+  std::string model_name;
+  double resolution;
+  {
+    boost::mutex::scoped_lock slock(lock_);
+    entries.assign(entries_.rbegin(), entries_.rend());
+    resolution = state_resolution_;
+  }
+
+  std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out.good())
+  {
+    logError("Unable to open '%s' for writing the motion plan cache", filename.c_str());
+    return false;
+  }
+
+  if (!entries.empty())
+    model_name = entries.front().trajectory_->getRobotModel()->getName();
+
+  out.write(CACHE_FILE_MAGIC, sizeof(CACHE_FILE_MAGIC));
+  writeValue(out, CACHE_FILE_VERSION);
+  writeValue(out, resolution);
+  writeValue(out, (boost::uint32_t)model_name.size());
+  out.write(model_name.data(), model_name.size());
+  writeValue(out, (boost::uint32_t)entries.size());
+
+  // entries are written from the least to the most recently used, so loading restores the order
+  std::vector<boost::uint8_t> buffer;
+  moveit_msgs::MotionPlanResponse msg;
+  for (std::size_t i = 0 ; i < entries.size() ; ++i)
+  {
+    const robot_trajectory::RobotTrajectory &trajectory = *entries[i].trajectory_;
+    robot_state::robotStateToRobotStateMsg(trajectory.getFirstWayPoint(), msg.trajectory_start);
+    trajectory.getRobotTrajectoryMsg(msg.trajectory);
+    msg.group_name = trajectory.getGroupName();
+
+    boost::uint32_t size = ros::serialization::serializationLength(msg);
+    buffer.resize(size);
+    ros::serialization::OStream stream(&buffer[0], size);
+    ros::serialization::serialize(stream, msg);
+
+    writeValue(out, entries[i].key_);
+    writeValue(out, size);
+    out.write(reinterpret_cast<const char*>(&buffer[0]), size);
+  }
+
+  if (!out.good())
+  {
+    logError("Error writing the motion plan cache to '%s'", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool PlanCacheAdapter::load(const robot_model::RobotModelConstPtr &robot_model, const std::string &filename)
+{
+  std::ifstream in(filename.c_str(), std::ios::binary);
+  if (!in.good())
+  {
+    logError("Unable to open motion plan cache '%s'", filename.c_str());
+    return false;
+  }
+
+  char magic[sizeof(CACHE_FILE_MAGIC)];
+  boost::uint32_t version, name_size, count;
+  double resolution;
+  if (!in.read(magic, sizeof(magic)).good() || !std::equal(magic, magic + sizeof(magic), CACHE_FILE_MAGIC) ||
+      !readValue(in, version) || version != CACHE_FILE_VERSION ||
+      !readValue(in, resolution) || !readValue(in, name_size))
+  {
+    logError("'%s' is not a motion plan cache file", filename.c_str());
+    return false;
+  }
+  std::string model_name(name_size, '\0');
+  if (name_size > 0 && !in.read(&model_name[0], name_size).good())
+    return false;
+  if (!readValue(in, count))
+    return false;
+
+  if (count > 0 && model_name != robot_model->getName())
+  {
+    logError("Motion plan cache '%s' was saved for robot '%s', not '%s'", filename.c_str(), model_name.c_str(), robot_model->getName().c_str());
+    return false;
+  }
+  if (fabs(resolution - getStateResolution()) > std::numeric_limits<double>::epsilon() * fabs(resolution))
+  {
+    logError("Motion plan cache '%s' was saved with state resolution %lf, not %lf", filename.c_str(), resolution, getStateResolution());
+    return false;
+  }
+
+  std::vector<boost::uint8_t> buffer;
+  moveit_msgs::MotionPlanResponse msg;
+  robot_state::RobotState reference_state(robot_model);
+  reference_state.setToDefaultValues();
+  for (boost::uint32_t i = 0 ; i < count ; ++i)
+  {
+    boost::uint64_t key;
+    boost::uint32_t size;
+    if (!readValue(in, key) || !readValue(in, size))
+    {
+      logError("Motion plan cache '%s' is truncated", filename.c_str());
+      return false;
+    }
+    buffer.resize(size);
+    if (size == 0 || !in.read(reinterpret_cast<char*>(&buffer[0]), size).good())
+    {
+      logError("Motion plan cache '%s' is truncated", filename.c_str());
+      return false;
+    }
+    ros::serialization::IStream stream(&buffer[0], size);
+    ros::serialization::deserialize(stream, msg);
+
+    if (!robot_model->hasJointModelGroup(msg.group_name))
+    {
+      logWarn("Skipping cached motion plan for unknown group '%s'", msg.group_name.c_str());
+      continue;
+    }
+    robot_state::robotStateMsgToRobotState(msg.trajectory_start, reference_state);
+    robot_trajectory::RobotTrajectoryPtr trajectory(new robot_trajectory::RobotTrajectory(robot_model, msg.group_name));
+    trajectory->setRobotTrajectoryMsg(reference_state, msg.trajectory);
+    if (trajectory->empty())
+      continue;
+
+    boost::mutex::scoped_lock slock(lock_);
+    insert(key, trajectory);
+  }
+  return true;
+}
+
+}
@@ -35,8 +35,12 @@
 /* Author: Ioan Sucan */
 
 #include <moveit/planning_request_adapter/planning_request_adapter.h>
+#include <ros/time.h>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <algorithm>
+#include <ctime>
+#include <unistd.h>
 
 // we could really use some c++11 lambda functions here :)
 
@@ -82,6 +86,63 @@ namespace planning_request_adapter
 namespace
 {
 
+/* CPU time of the calling thread, in seconds */
+inline double threadCpuTime()
+{
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+#else
+  // falls back to process CPU time
+  return (double)std::clock() / (double)CLOCKS_PER_SEC;
+#endif
+}
+
+// measures the wall-clock and thread CPU time of one execution of a step; does nothing if there is no timing to fill
+class StepTimer
+{
+public:
+
+  StepTimer(AdapterTiming *timing) :
+    timing_(timing)
+  {
+    if (timing_)
+    {
+      wall_start_ = ros::WallTime::now();
+      cpu_start_ = threadCpuTime();
+    }
+  }
+
+  void stop(bool result)
+  {
+    if (!timing_)
+      return;
+    timing_->calls_++;
+    timing_->total_wall_time_ += (ros::WallTime::now() - wall_start_).toSec();
+    timing_->total_cpu_time_ += threadCpuTime() - cpu_start_;
+    timing_->result_ = result;
+  }
+
+private:
+
+  AdapterTiming *timing_;
+  ros::WallTime wall_start_;
+  double cpu_start_;
+};
+
+bool callPlanner(const planning_interface::PlannerManager *planner,
+                 AdapterTiming *timing,
+                 const planning_scene::PlanningSceneConstPtr& planning_scene,
+                 const planning_interface::MotionPlanRequest &req,
+                 planning_interface::MotionPlanResponse &res)
+{
+  StepTimer timer(timing);
+  bool result = callPlannerInterfaceSolve(planner, planning_scene, req, res);
+  timer.stop(result);
+  return result;
+}
+
 // boost bind is not happy with overloading, so we add intermediate function objects
 
 bool callAdapter1(const PlanningRequestAdapter *adapter,
@@ -89,24 +150,37 @@ bool callAdapter1(const PlanningRequestAdapter *adapter,
                   const planning_scene::PlanningSceneConstPtr& planning_scene,
                   const planning_interface::MotionPlanRequest &req,
                   planning_interface::MotionPlanResponse &res,
-                  std::vector<std::size_t> &added_path_index)
+                  std::vector<std::size_t> &added_path_index,
+                  AdapterTiming *timing,
+                  AdapterTiming *planner_timing)
 {
+  StepTimer timer(timing);
+  bool result;
+  PlanningRequestAdapter::PlannerFn fn = boost::bind(&callPlanner, planner.get(), planner_timing, _1, _2, _3);
   try
   {
-    return adapter->adaptAndPlan(planner, planning_scene, req, res, added_path_index);
+    result = adapter->adaptAndPlan(fn, planning_scene, req, res, added_path_index);
   }
   catch(std::runtime_error &ex)
   {
     logError("Exception caught executing *final* adapter '%s': %s", adapter->getDescription().c_str(), ex.what());
     added_path_index.clear();
-    return callPlannerInterfaceSolve(planner.get(), planning_scene, req, res);
+    if (timing)
+      timing->exception_ = true;
+    result = fn(planning_scene, req, res);
   }
   catch(...)
   {
     logError("Exception caught executing *final* adapter '%s'", adapter->getDescription().c_str());
     added_path_index.clear();
-    return callPlannerInterfaceSolve(planner.get(), planning_scene, req, res);
+    if (timing)
+      timing->exception_ = true;
+    result = fn(planning_scene, req, res);
   }
+  if (timing)
+    timing->added_path_index_count_ += added_path_index.size();
+  timer.stop(result);
+  return result;
 }
 
 bool callAdapter2(const PlanningRequestAdapter *adapter,
@@ -114,24 +188,35 @@ bool callAdapter2(const PlanningRequestAdapter *adapter,
                   const planning_scene::PlanningSceneConstPtr& planning_scene,
                   const planning_interface::MotionPlanRequest &req,
                   planning_interface::MotionPlanResponse &res,
-                  std::vector<std::size_t> &added_path_index)
+                  std::vector<std::size_t> &added_path_index,
+                  AdapterTiming *timing)
 {
+  StepTimer timer(timing);
+  bool result;
   try
   {
-    return adapter->adaptAndPlan(planner, planning_scene, req, res, added_path_index);
+    result = adapter->adaptAndPlan(planner, planning_scene, req, res, added_path_index);
   }
   catch(std::runtime_error &ex)
   {
     logError("Exception caught executing *next* adapter '%s': %s", adapter->getDescription().c_str(), ex.what());
     added_path_index.clear();
-    return planner(planning_scene, req, res);
+    if (timing)
+      timing->exception_ = true;
+    result = planner(planning_scene, req, res);
   }
   catch(...)
   {
     logError("Exception caught executing *next* adapter '%s'", adapter->getDescription().c_str());
     added_path_index.clear();
-    return planner(planning_scene, req, res);
+    if (timing)
+      timing->exception_ = true;
+    result = planner(planning_scene, req, res);
   }
+  if (timing)
+    timing->added_path_index_count_ += added_path_index.size();
+  timer.stop(result);
+  return result;
 }
 
 }
@@ -153,11 +238,49 @@ bool planning_request_adapter::PlanningRequestAdapterChain::adaptAndPlan(const p
                                                                          planning_interface::MotionPlanResponse &res,
                                                                          std::vector<std::size_t> &added_path_index) const
 {
+  if (!instrumentation_)
+    return runChain(planner, planning_scene, req, res, added_path_index, NULL);
+  std::vector<AdapterTiming> timing;
+  return runChain(planner, planning_scene, req, res, added_path_index, &timing);
+}
+
+bool planning_request_adapter::PlanningRequestAdapterChain::adaptAndPlan(const planning_interface::PlannerManagerPtr &planner,
+                                                                         const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                         const planning_interface::MotionPlanRequest &req,
+                                                                         planning_interface::MotionPlanResponse &res,
+                                                                         std::vector<std::size_t> &added_path_index,
+                                                                         std::vector<AdapterTiming> &timing) const
+{
+  return runChain(planner, planning_scene, req, res, added_path_index, &timing);
+}
+
+bool planning_request_adapter::PlanningRequestAdapterChain::runChain(const planning_interface::PlannerManagerPtr &planner,
+                                                                     const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                     const planning_interface::MotionPlanRequest &req,
+                                                                     planning_interface::MotionPlanResponse &res,
+                                                                     std::vector<std::size_t> &added_path_index,
+                                                                     std::vector<AdapterTiming> *timing) const
+{
+  // one entry per adapter, followed by the planner
+  if (timing)
+  {
+    timing->assign(adapters_.size() + 1, AdapterTiming());
+    for (std::size_t i = 0 ; i < adapters_.size() ; ++i)
+    {
+      (*timing)[i].name_ = adapters_[i]->getDescription();
+      if ((*timing)[i].name_.empty())
+        (*timing)[i].name_ = "adapter " + boost::lexical_cast<std::string>(i);
+    }
+    timing->back().name_ = "planner";
+  }
+  AdapterTiming *planner_timing = timing ? &timing->back() : NULL;
+
+  bool result;
   // if there are no adapters, run the planner directly
   if (adapters_.empty())
   {
     added_path_index.clear();
-    return callPlannerInterfaceSolve(planner.get(), planning_scene, req, res);
+    result = callPlanner(planner.get(), planner_timing, planning_scene, req, res);
   }
   else
   {
@@ -166,10 +289,13 @@ bool planning_request_adapter::PlanningRequestAdapterChain::adaptAndPlan(const p
 
     // if there are adapters, construct a function pointer for each, in order,
     // so that in the end we have a nested sequence of function pointers that call the adapters in the correct order.
-    PlanningRequestAdapter::PlannerFn fn = boost::bind(&callAdapter1, adapters_.back().get(), planner, _1, _2, _3, boost::ref(added_path_index_each.back()));
+    const std::size_t last = adapters_.size() - 1;
+    PlanningRequestAdapter::PlannerFn fn = boost::bind(&callAdapter1, adapters_.back().get(), planner, _1, _2, _3, boost::ref(added_path_index_each.back()),
+                                                       timing ? &(*timing)[last] : NULL, planner_timing);
     for (int i = adapters_.size() - 2 ; i >= 0 ; --i)
-      fn = boost::bind(&callAdapter2, adapters_[i].get(), fn, _1, _2, _3, boost::ref(added_path_index_each[i]));
-    bool result = fn(planning_scene, req, res);
+      fn = boost::bind(&callAdapter2, adapters_[i].get(), fn, _1, _2, _3, boost::ref(added_path_index_each[i]),
+                       timing ? &(*timing)[i] : NULL);
+    result = fn(planning_scene, req, res);
     added_path_index.clear();
 
     // merge the index values from each adapter
@@ -182,6 +308,122 @@ bool planning_request_adapter::PlanningRequestAdapterChain::adaptAndPlan(const p
         added_path_index.push_back(added_path_index_each[i][j]);
       }
     std::sort(added_path_index.begin(), added_path_index.end());
-    return result;
+  }
+
+  if (timing)
+  {
+    // the steps are nested, so the time of a step without the steps it called is the difference to the next step
+    for (std::size_t i = 0 ; i < timing->size() ; ++i)
+    {
+      AdapterTiming &t = (*timing)[i];
+      t.wall_time_ = t.total_wall_time_;
+      t.cpu_time_ = t.total_cpu_time_;
+      if (i + 1 < timing->size())
+      {
+        t.wall_time_ = std::max(0.0, t.wall_time_ - (*timing)[i + 1].total_wall_time_);
+        t.cpu_time_ = std::max(0.0, t.cpu_time_ - (*timing)[i + 1].total_cpu_time_);
+      }
+    }
+    if (instrumentation_)
+      accumulate(*timing);
+  }
+  return result;
+}
+
+void planning_request_adapter::PlanningRequestAdapterChain::accumulate(const std::vector<AdapterTiming> &timing) const
+{
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  // adapters may have been added since the last call; the planner is always last
+  if (statistics_.size() != timing.size())
+  {
+    AdapterStatistics planner_statistics;
+    if (!statistics_.empty())
+    {
+      planner_statistics = statistics_.back();
+      statistics_.pop_back();
+    }
+    statistics_.resize(timing.size() - 1);
+    statistics_.push_back(planner_statistics);
+  }
+
+  for (std::size_t i = 0 ; i < timing.size() ; ++i)
+  {
+    AdapterStatistics &s = statistics_[i];
+    const AdapterTiming &t = timing[i];
+    s.name_ = t.name_;
+    s.calls_ += t.calls_;
+    if (t.calls_ > 0 && t.result_)
+      s.successes_++;
+    if (t.exception_)
+      s.exceptions_++;
+    s.wall_time_ += t.wall_time_;
+    s.max_wall_time_ = std::max(s.max_wall_time_, t.wall_time_);
+    s.cpu_time_ += t.cpu_time_;
+    s.added_path_index_count_ += t.added_path_index_count_;
+  }
+  planning_calls_++;
+}
+
+std::vector<planning_request_adapter::AdapterStatistics> planning_request_adapter::PlanningRequestAdapterChain::getStatistics() const
+{
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  return statistics_;
+}
+
+std::size_t planning_request_adapter::PlanningRequestAdapterChain::getStatisticsCallCount() const
+{
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  return planning_calls_;
+}
+
+void planning_request_adapter::PlanningRequestAdapterChain::resetStatistics()
+{
+  boost::mutex::scoped_lock slock(statistics_lock_);
+  statistics_.clear();
+  planning_calls_ = 0;
+}
+
+void planning_request_adapter::PlanningRequestAdapterChain::printStatistics(std::ostream &out) const
+{
+  std::vector<AdapterStatistics> statistics;
+  std::size_t calls;
+  {
+    boost::mutex::scoped_lock slock(statistics_lock_);
+    statistics = statistics_;
+    calls = planning_calls_;
+  }
+
+  double total = 0.0;
+  for (std::size_t i = 0 ; i < statistics.size() ; ++i)
+    total += statistics[i].wall_time_;
+
+  out << std::endl;
+  out << " *** Planning request adapter statistics. " << calls << " planning calls, " << total << " seconds" << std::endl;
+  for (std::size_t i = 0 ; i < statistics.size() ; ++i)
+  {
+    const AdapterStatistics &s = statistics[i];
+    out << s.name_ << ": " << s.wall_time_ << "s (" << (total > 0.0 ? 100.0 * s.wall_time_ / total : 0.0) << "%), "
+        << s.calls_ << " calls, " << s.successes_ << " successes";
+    if (calls > 0)
+      out << ", " << s.wall_time_ / calls << " s on average, " << s.max_wall_time_ << " s at most";
+    out << ", CPU " << s.cpu_time_ << " s";
+    if (s.added_path_index_count_ > 0)
+      out << ", " << s.added_path_index_count_ << " added path index values";
+    if (s.exceptions_ > 0)
+      out << ", " << s.exceptions_ << " exceptions";
+    out << std::endl;
+  }
+  out << std::endl;
+}
+
+void planning_request_adapter::PlanningRequestAdapterChain::writeStatisticsCSV(std::ostream &out) const
+{
+  std::vector<AdapterStatistics> statistics = getStatistics();
+  out << "name,calls,successes,exceptions,wall_time,max_wall_time,cpu_time,added_path_index_count" << std::endl;
+  for (std::size_t i = 0 ; i < statistics.size() ; ++i)
+  {
+    const AdapterStatistics &s = statistics[i];
+    out << '"' << s.name_ << "\"," << s.calls_ << ',' << s.successes_ << ',' << s.exceptions_ << ','
+        << s.wall_time_ << ',' << s.max_wall_time_ << ',' << s.cpu_time_ << ',' << s.added_path_index_count_ << std::endl;
   }
 }
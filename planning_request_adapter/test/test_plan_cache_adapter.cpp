@@ -0,0 +1,259 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_request_adapter/plan_cache_adapter.h>
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <geometric_shapes/shapes.h>
+#include <boost/filesystem.hpp>
+#include <boost/bind.hpp>
+#include <gtest/gtest.h>
+
+// plans a straight line from the start state to the goal of the request and counts the calls
+class MockPlanner
+{
+public:
+
+  MockPlanner() : calls_(0), solves_(true)
+  {
+  }
+
+  bool plan(const planning_scene::PlanningSceneConstPtr &planning_scene, const planning_interface::MotionPlanRequest &req,
+            planning_interface::MotionPlanResponse &res)
+  {
+    ++calls_;
+    if (!solves_)
+    {
+      res.error_code_.val = moveit_msgs::MoveItErrorCodes::PLANNING_FAILED;
+      return false;
+    }
+    robot_state::RobotStatePtr start = planning_scene->getCurrentStateUpdated(req.start_state);
+    double from = start->getVariablePosition("joint1");
+    double to = req.goal_constraints[0].joint_constraints[0].position;
+    res.trajectory_.reset(new robot_trajectory::RobotTrajectory(planning_scene->getRobotModel(), req.group_name));
+    res.trajectory_->addSuffixWayPoint(start, 0.0);
+    for (int i = 1 ; i <= 4 ; ++i)
+    {
+      robot_state::RobotStatePtr state(new robot_state::RobotState(*start));
+      state->setVariablePosition("joint1", from + (to - from) * i / 4.0);
+      res.trajectory_->addSuffixWayPoint(state, 0.25);
+    }
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  unsigned int calls_;
+  bool solves_;
+};
+
+class PlanCacheAdapterTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("one_dof_arm");
+    ASSERT_TRUE(robot_model_);
+    scene_.reset(new planning_scene::PlanningScene(robot_model_));
+    planner_fn_ = boost::bind(&MockPlanner::plan, &planner_, _1, _2, _3);
+  }
+
+  static planning_interface::MotionPlanRequest makeRequest(double start, double goal)
+  {
+    planning_interface::MotionPlanRequest req;
+    req.group_name = "arm";
+    req.start_state.joint_state.name.push_back("joint1");
+    req.start_state.joint_state.position.push_back(start);
+    req.goal_constraints.resize(1);
+    req.goal_constraints[0].joint_constraints.resize(1);
+    req.goal_constraints[0].joint_constraints[0].joint_name = "joint1";
+    req.goal_constraints[0].joint_constraints[0].position = goal;
+    req.goal_constraints[0].joint_constraints[0].tolerance_above = 1e-3;
+    req.goal_constraints[0].joint_constraints[0].tolerance_below = 1e-3;
+    req.goal_constraints[0].joint_constraints[0].weight = 1.0;
+    return req;
+  }
+
+  bool plan(const planning_request_adapter::PlanCacheAdapter &cache, const planning_scene::PlanningSceneConstPtr &scene,
+            double start, double goal, planning_interface::MotionPlanResponse &res)
+  {
+    std::vector<std::size_t> added_path_index;
+    return cache.adaptAndPlan(planner_fn_, scene, makeRequest(start, goal), res, added_path_index);
+  }
+
+  bool plan(const planning_request_adapter::PlanCacheAdapter &cache, double start, double goal)
+  {
+    planning_interface::MotionPlanResponse res;
+    return plan(cache, scene_, start, goal, res);
+  }
+
+  robot_model::RobotModelPtr robot_model_;
+  planning_scene::PlanningScenePtr scene_;
+  MockPlanner planner_;
+  planning_request_adapter::PlanningRequestAdapter::PlannerFn planner_fn_;
+};
+
+TEST_F(PlanCacheAdapterTest, HitAndMiss)
+{
+  planning_request_adapter::PlanCacheAdapter cache(10, 1e-3);
+  planning_interface::MotionPlanResponse res;
+
+  ASSERT_TRUE(plan(cache, scene_, 0.0, 1.0, res));
+  EXPECT_EQ(1u, planner_.calls_);
+  EXPECT_EQ(1u, cache.getSize());
+
+  // the same request is answered from the cache
+  ASSERT_TRUE(plan(cache, scene_, 0.0, 1.0, res));
+  EXPECT_EQ(1u, planner_.calls_);
+  ASSERT_EQ(5u, res.trajectory_->getWayPointCount());
+  EXPECT_NEAR(1.0, res.trajectory_->getLastWayPoint().getVariablePosition("joint1"), 1e-9);
+
+  // a start state within the resolution hits too, and the path starts at the exact start state
+  ASSERT_TRUE(plan(cache, scene_, 2e-4, 1.0, res));
+  EXPECT_EQ(1u, planner_.calls_);
+  EXPECT_NEAR(2e-4, res.trajectory_->getFirstWayPoint().getVariablePosition("joint1"), 1e-12);
+
+  // other start states and goals miss
+  EXPECT_TRUE(plan(cache, 0.1, 1.0));
+  EXPECT_EQ(2u, planner_.calls_);
+  EXPECT_TRUE(plan(cache, 0.0, 0.5));
+  EXPECT_EQ(3u, planner_.calls_);
+
+  planning_request_adapter::PlanCacheAdapter::Statistics statistics = cache.getStatistics();
+  EXPECT_EQ(5u, statistics.lookups_);
+  EXPECT_EQ(2u, statistics.hits_);
+  EXPECT_EQ(3u, statistics.misses_);
+  EXPECT_EQ(0u, statistics.rejected_);
+  EXPECT_EQ(3u, cache.getSize());
+}
+
+TEST_F(PlanCacheAdapterTest, FailedPlansAreNotStored)
+{
+  planning_request_adapter::PlanCacheAdapter cache;
+  planner_.solves_ = false;
+  EXPECT_FALSE(plan(cache, 0.0, 1.0));
+  EXPECT_FALSE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(2u, planner_.calls_);
+  EXPECT_EQ(0u, cache.getSize());
+}
+
+TEST_F(PlanCacheAdapterTest, SceneChangesMiss)
+{
+  planning_request_adapter::PlanCacheAdapter cache;
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+
+  // a diff that changes nothing has the version of its parent
+  planning_scene::PlanningScenePtr diff = scene_->diff();
+  EXPECT_EQ(scene_->getWorldVersion(), diff->getWorldVersion());
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(plan(cache, diff, 0.0, 1.0, res));
+  EXPECT_EQ(1u, planner_.calls_);
+
+  // changing the world of the parent changes the version of both scenes
+  boost::uint64_t version = scene_->getWorldVersion();
+  scene_->getWorldNonConst()->addToObject("box", shapes::ShapeConstPtr(new shapes::Box(0.1, 0.1, 0.1)), Eigen::Affine3d::Identity());
+  EXPECT_NE(version, scene_->getWorldVersion());
+  EXPECT_NE(version, diff->getWorldVersion());
+  EXPECT_NE(scene_->getWorldVersion(), diff->getWorldVersion());
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(2u, planner_.calls_);
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(2u, planner_.calls_);
+
+  // so does changing the allowed collision matrix
+  version = scene_->getWorldVersion();
+  scene_->getAllowedCollisionMatrixNonConst().setEntry("box", "link1", true);
+  EXPECT_NE(version, scene_->getWorldVersion());
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(3u, planner_.calls_);
+}
+
+TEST_F(PlanCacheAdapterTest, LeastRecentlyUsedIsEvicted)
+{
+  planning_request_adapter::PlanCacheAdapter cache(2);
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  ASSERT_TRUE(plan(cache, 0.0, 2.0));
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(2u, planner_.calls_);
+
+  // the plan to 2.0 is now the least recently used one
+  ASSERT_TRUE(plan(cache, 0.0, -1.0));
+  EXPECT_EQ(3u, planner_.calls_);
+  EXPECT_EQ(2u, cache.getSize());
+  EXPECT_EQ(1u, cache.getStatistics().evictions_);
+
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  EXPECT_EQ(3u, planner_.calls_);
+  ASSERT_TRUE(plan(cache, 0.0, 2.0));
+  EXPECT_EQ(4u, planner_.calls_);
+
+  cache.setCapacity(1);
+  EXPECT_EQ(1u, cache.getSize());
+  ASSERT_TRUE(plan(cache, 0.0, 2.0));
+  EXPECT_EQ(4u, planner_.calls_);
+}
+
+TEST_F(PlanCacheAdapterTest, SaveAndLoad)
+{
+  std::string filename = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("test_plan_cache_%%%%%%%%.bin")).string();
+
+  planning_request_adapter::PlanCacheAdapter cache(10, 1e-3);
+  ASSERT_TRUE(plan(cache, 0.0, 1.0));
+  ASSERT_TRUE(plan(cache, 0.5, 2.0));
+  ASSERT_TRUE(cache.save(filename));
+
+  planning_request_adapter::PlanCacheAdapter loaded(10, 1e-3);
+  ASSERT_TRUE(loaded.load(robot_model_, filename));
+  EXPECT_EQ(2u, loaded.getSize());
+  planning_interface::MotionPlanResponse res;
+  ASSERT_TRUE(plan(loaded, scene_, 0.5, 2.0, res));
+  ASSERT_TRUE(plan(loaded, scene_, 0.0, 1.0, res));
+  EXPECT_EQ(2u, planner_.calls_);
+  EXPECT_EQ(2u, loaded.getStatistics().hits_);
+  EXPECT_NEAR(1.0, res.trajectory_->getLastWayPoint().getVariablePosition("joint1"), 1e-9);
+
+  // keys depend on the resolution, so caches saved with another one are refused
+  planning_request_adapter::PlanCacheAdapter other(10, 1e-2);
+  EXPECT_FALSE(other.load(robot_model_, filename));
+  EXPECT_EQ(0u, other.getSize());
+
+  boost::filesystem::remove(filename);
+  EXPECT_FALSE(loaded.load(robot_model_, filename));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,374 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/planning_request_adapter/planning_request_adapter.h>
+#include <gtest/gtest.h>
+#include <boost/thread/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <sstream>
+#include <ctime>
+#include <stdexcept>
+
+static void sleepFor(double seconds)
+{
+  boost::this_thread::sleep(boost::posix_time::microseconds((boost::int64_t)(seconds * 1e6)));
+}
+
+// keep the calling thread busy until it has used \e seconds of CPU time
+static void spinFor(double seconds)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  const double end = ts.tv_sec + 1e-9 * ts.tv_nsec + seconds;
+  do
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  while (ts.tv_sec + 1e-9 * ts.tv_nsec < end);
+}
+
+// a planning context that sleeps for a known time and succeeds
+class SleepingPlanningContext : public planning_interface::PlanningContext
+{
+public:
+
+  SleepingPlanningContext(double duration) :
+    planning_interface::PlanningContext("sleeping", "arm"),
+    duration_(duration)
+  {
+  }
+
+  virtual bool solve(planning_interface::MotionPlanResponse &res)
+  {
+    sleepFor(duration_);
+    res.error_code_.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return true;
+  }
+
+  virtual bool solve(planning_interface::MotionPlanDetailedResponse &res)
+  {
+    return false;
+  }
+
+  virtual bool terminate()
+  {
+    return true;
+  }
+
+  virtual void clear()
+  {
+  }
+
+private:
+
+  double duration_;
+};
+
+class SleepingPlannerManager : public planning_interface::PlannerManager
+{
+public:
+
+  SleepingPlannerManager(double duration) :
+    duration_(duration)
+  {
+  }
+
+  virtual planning_interface::PlanningContextPtr getPlanningContext(const planning_scene::PlanningSceneConstPtr& planning_scene,
+                                                                    const planning_interface::MotionPlanRequest &req,
+                                                                    moveit_msgs::MoveItErrorCodes &error_code) const
+  {
+    error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
+    return planning_interface::PlanningContextPtr(new SleepingPlanningContext(duration_));
+  }
+
+  virtual bool canServiceRequest(const planning_interface::MotionPlanRequest &req) const
+  {
+    return true;
+  }
+
+private:
+
+  double duration_;
+};
+
+// an adapter that sleeps before and after calling the planner, calls it a given number of times,
+// and optionally spins the CPU, reports added path index values or throws
+class SleepingAdapter : public planning_request_adapter::PlanningRequestAdapter
+{
+public:
+
+  SleepingAdapter(const std::string &name, double before, double after, unsigned int planner_calls = 1) :
+    name_(name),
+    before_(before),
+    after_(after),
+    spin_(0.0),
+    planner_calls_(planner_calls),
+    added_path_index_count_(0),
+    throws_(false)
+  {
+  }
+
+  virtual std::string getDescription() const
+  {
+    return name_;
+  }
+
+  virtual bool adaptAndPlan(const PlannerFn &planner,
+                            const planning_scene::PlanningSceneConstPtr& planning_scene,
+                            const planning_interface::MotionPlanRequest &req,
+                            planning_interface::MotionPlanResponse &res,
+                            std::vector<std::size_t> &added_path_index) const
+  {
+    sleepFor(before_);
+    spinFor(spin_);
+    if (throws_)
+      throw std::runtime_error("adapter failure");
+    bool result = true;
+    for (unsigned int i = 0 ; i < planner_calls_ ; ++i)
+      result = planner(planning_scene, req, res);
+    sleepFor(after_);
+    for (std::size_t i = 0 ; i < added_path_index_count_ ; ++i)
+      added_path_index.push_back(i);
+    return result;
+  }
+
+  std::string name_;
+  double before_;
+  double after_;
+  double spin_;
+  unsigned int planner_calls_;
+  std::size_t added_path_index_count_;
+  bool throws_;
+};
+
+typedef boost::shared_ptr<SleepingAdapter> SleepingAdapterPtr;
+
+// sleeps can last longer than requested, never shorter
+static const double SLACK = 0.05;
+
+class PlanningRequestAdapterChainTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    planner_.reset(new SleepingPlannerManager(0.025));
+    first_.reset(new SleepingAdapter("first", 0.02, 0.01));
+    second_.reset(new SleepingAdapter("second", 0.03, 0.0, 2));
+    chain_.addAdapter(first_);
+    chain_.addAdapter(second_);
+  }
+
+
+  bool plan(std::vector<planning_request_adapter::AdapterTiming> &timing)
+  {
+    planning_interface::MotionPlanResponse res;
+    std::vector<std::size_t> added_path_index;
+    return chain_.adaptAndPlan(planner_, planning_scene::PlanningSceneConstPtr(), planning_interface::MotionPlanRequest(), res,
+                               added_path_index, timing);
+  }
+
+  bool plan()
+  {
+    planning_interface::MotionPlanResponse res;
+    return chain_.adaptAndPlan(planner_, planning_scene::PlanningSceneConstPtr(), planning_interface::MotionPlanRequest(), res);
+  }
+
+  planning_interface::PlannerManagerPtr planner_;
+  SleepingAdapterPtr first_;
+  SleepingAdapterPtr second_;
+  planning_request_adapter::PlanningRequestAdapterChain chain_;
+};
+
+TEST_F(PlanningRequestAdapterChainTest, ExclusiveTimes)
+{
+  first_->added_path_index_count_ = 2;
+  std::vector<planning_request_adapter::AdapterTiming> timing;
+  ASSERT_TRUE(plan(timing));
+  ASSERT_EQ(3u, timing.size());
+  EXPECT_EQ("first", timing[0].name_);
+  EXPECT_EQ("second", timing[1].name_);
+  EXPECT_EQ("planner", timing[2].name_);
+
+  // the second adapter retries the planner, so the planner time covers both executions
+  EXPECT_EQ(1u, timing[0].calls_);
+  EXPECT_EQ(1u, timing[1].calls_);
+  EXPECT_EQ(2u, timing[2].calls_);
+
+  // each step is charged for its own sleeps only
+  const double own[3] = { 0.03, 0.03, 0.05 };
+  for (std::size_t i = 0 ; i < 3 ; ++i)
+  {
+    EXPECT_GE(timing[i].wall_time_, own[i] - 1e-3);
+    EXPECT_LT(timing[i].wall_time_, own[i] + SLACK);
+    EXPECT_TRUE(timing[i].result_);
+    EXPECT_FALSE(timing[i].exception_);
+    // sleeping does not use the CPU
+    EXPECT_LT(timing[i].cpu_time_, 0.01);
+    EXPECT_LE(timing[i].cpu_time_, timing[i].total_cpu_time_);
+  }
+  EXPECT_NEAR(timing[0].total_wall_time_, timing[0].wall_time_ + timing[1].total_wall_time_, 1e-9);
+  EXPECT_NEAR(timing[1].total_wall_time_, timing[1].wall_time_ + timing[2].total_wall_time_, 1e-9);
+  EXPECT_GE(timing[0].total_wall_time_, 0.11 - 1e-3);
+  EXPECT_EQ(2u, timing[0].added_path_index_count_);
+  EXPECT_EQ(0u, timing[1].added_path_index_count_);
+
+  // CPU time is charged to the step that used it
+  second_->spin_ = 0.02;
+  ASSERT_TRUE(plan(timing));
+  EXPECT_GE(timing[1].cpu_time_, 0.02 - 1e-3);
+  EXPECT_LT(timing[0].cpu_time_, 0.01);
+  EXPECT_LT(timing[2].cpu_time_, 0.01);
+}
+
+TEST_F(PlanningRequestAdapterChainTest, AdapterExceptions)
+{
+  // the chain skips an adapter that throws and calls the planner directly
+  second_->throws_ = true;
+  std::vector<planning_request_adapter::AdapterTiming> timing;
+  ASSERT_TRUE(plan(timing));
+  ASSERT_EQ(3u, timing.size());
+  EXPECT_FALSE(timing[0].exception_);
+  EXPECT_TRUE(timing[1].exception_);
+  EXPECT_EQ(1u, timing[2].calls_);
+  EXPECT_GE(timing[1].wall_time_, 0.03 - 1e-3);
+  EXPECT_GE(timing[2].wall_time_, 0.025 - 1e-3);
+}
+
+TEST_F(PlanningRequestAdapterChainTest, Statistics)
+{
+  // nothing is recorded unless instrumentation is enabled
+  EXPECT_FALSE(chain_.getInstrumentation());
+  ASSERT_TRUE(plan());
+  EXPECT_TRUE(chain_.getStatistics().empty());
+  EXPECT_EQ(0u, chain_.getStatisticsCallCount());
+
+  chain_.setInstrumentation(true);
+  ASSERT_TRUE(plan());
+  first_->after_ = 0.05;
+  ASSERT_TRUE(plan());
+  chain_.setInstrumentation(false);
+  ASSERT_TRUE(plan());
+
+  EXPECT_EQ(2u, chain_.getStatisticsCallCount());
+  std::vector<planning_request_adapter::AdapterStatistics> statistics = chain_.getStatistics();
+  ASSERT_EQ(3u, statistics.size());
+  EXPECT_EQ("first", statistics[0].name_);
+  EXPECT_EQ("planner", statistics[2].name_);
+  EXPECT_EQ(2u, statistics[0].calls_);
+  EXPECT_EQ(2u, statistics[1].calls_);
+  EXPECT_EQ(4u, statistics[2].calls_);
+  for (std::size_t i = 0 ; i < 3 ; ++i)
+  {
+    EXPECT_EQ(2u, statistics[i].successes_);
+    EXPECT_EQ(0u, statistics[i].exceptions_);
+  }
+
+  // the first adapter slept 0.03s, then 0.07s
+  EXPECT_GE(statistics[0].wall_time_, 0.1 - 2e-3);
+  EXPECT_LT(statistics[0].wall_time_, 0.1 + 2 * SLACK);
+  EXPECT_GE(statistics[0].max_wall_time_, 0.07 - 1e-3);
+  EXPECT_LT(statistics[0].max_wall_time_, 0.07 + SLACK);
+  EXPECT_GE(statistics[2].wall_time_, 0.1 - 2e-3);
+  EXPECT_LT(statistics[2].wall_time_, 0.1 + 2 * SLACK);
+
+  // the printed statistics mention every step
+  std::stringstream printed;
+  chain_.printStatistics(printed);
+  EXPECT_NE(std::string::npos, printed.str().find("2 planning calls"));
+  EXPECT_NE(std::string::npos, printed.str().find("second: "));
+  EXPECT_NE(std::string::npos, printed.str().find("planner: "));
+
+  chain_.resetStatistics();
+  EXPECT_TRUE(chain_.getStatistics().empty());
+  EXPECT_EQ(0u, chain_.getStatisticsCallCount());
+}
+
+TEST_F(PlanningRequestAdapterChainTest, StatisticsCSV)
+{
+  chain_.setInstrumentation(true);
+  first_->added_path_index_count_ = 3;
+  ASSERT_TRUE(plan());
+
+  std::stringstream csv;
+  chain_.writeStatisticsCSV(csv);
+  std::string line;
+  ASSERT_TRUE(std::getline(csv, line));
+  EXPECT_EQ("name,calls,successes,exceptions,wall_time,max_wall_time,cpu_time,added_path_index_count", line);
+
+  const std::string names[3] = { "\"first\"", "\"second\"", "\"planner\"" };
+  const std::size_t calls[3] = { 1, 1, 2 };
+  const std::size_t added[3] = { 3, 0, 0 };
+  const double wall_times[3] = { 0.03, 0.03, 0.05 };
+  for (std::size_t i = 0 ; i < 3 ; ++i)
+  {
+    ASSERT_TRUE(std::getline(csv, line));
+    std::vector<std::string> fields;
+    std::stringstream ss(line);
+    std::string field;
+    while (std::getline(ss, field, ','))
+      fields.push_back(field);
+    ASSERT_EQ(8u, fields.size());
+    EXPECT_EQ(names[i], fields[0]);
+    EXPECT_EQ(calls[i], boost::lexical_cast<std::size_t>(fields[1]));
+    EXPECT_EQ(1u, boost::lexical_cast<std::size_t>(fields[2]));
+    EXPECT_EQ(0u, boost::lexical_cast<std::size_t>(fields[3]));
+    const double wall_time = boost::lexical_cast<double>(fields[4]);
+    EXPECT_GE(wall_time, wall_times[i] - 1e-3);
+    EXPECT_LT(wall_time, wall_times[i] + SLACK);
+    EXPECT_EQ(wall_time, boost::lexical_cast<double>(fields[5]));
+    EXPECT_EQ(added[i], boost::lexical_cast<std::size_t>(fields[7]));
+  }
+  EXPECT_FALSE(std::getline(csv, line));
+}
+
+TEST(PlanningRequestAdapterChain, PlannerOnly)
+{
+  planning_request_adapter::PlanningRequestAdapterChain chain;
+  planning_interface::PlannerManagerPtr planner(new SleepingPlannerManager(0.01));
+  planning_interface::MotionPlanResponse res;
+  std::vector<std::size_t> added_path_index;
+  std::vector<planning_request_adapter::AdapterTiming> timing;
+  ASSERT_TRUE(chain.adaptAndPlan(planner, planning_scene::PlanningSceneConstPtr(), planning_interface::MotionPlanRequest(), res,
+                                 added_path_index, timing));
+  ASSERT_EQ(1u, timing.size());
+  EXPECT_EQ("planner", timing[0].name_);
+  EXPECT_EQ(1u, timing[0].calls_);
+  EXPECT_EQ(timing[0].total_wall_time_, timing[0].wall_time_);
+  EXPECT_GE(timing[0].wall_time_, 0.01 - 1e-3);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -55,6 +55,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/concept_check.hpp>
+#include <boost/cstdint.hpp>
 
 /** \brief This namespace includes the central class for representing planning contexts */
 namespace planning_scene
@@ -326,6 +327,13 @@ public:
   /** \brief Get the allowed collision matrix */
   collision_detection::AllowedCollisionMatrix& getAllowedCollisionMatrixNonConst();
 
+  /** \brief Get the version of the world, the allowed collision matrix and the link padding and scaling of this scene.
+      Versions are unique within the process: the version changes whenever the world changes or the allowed collision
+      matrix or the collision robot is obtained for modification, and two scenes with the same version have the same
+      world, allowed collision matrix and padding (e.g., a diff that did not change anything yet has the version of its
+      parent). This makes it possible to cache information computed from these parts of a scene. */
+  boost::uint64_t getWorldVersion() const;
+
   /**@}*/
 
   /**
@@ -883,6 +891,12 @@ private:
    * Requires a valid robot_model_ */
   void initialize();
 
+  /* Give this scene a new world version; called when the world, the ACM or the padding may have changed */
+  void updateWorldVersion();
+
+  /* Observer of world_ that updates the world version */
+  void worldChanged(const collision_detection::World::ObjectConstPtr &object, collision_detection::World::Action action);
+
   /* helper function to create a RobotModel from a urdf/srdf. */
   static robot_model::RobotModelPtr createRobotModel(const boost::shared_ptr<const urdf::ModelInterface> &urdf_model,
                                                      const boost::shared_ptr<const srdf::Model> &srdf_model);
@@ -947,6 +961,10 @@ private:
   collision_detection::WorldDiffPtr              world_diff_;   // NULL unless this is a diff scene
   collision_detection::World::ObserverCallbackFn current_world_object_update_callback_;
   collision_detection::World::ObserverHandle     current_world_object_update_observer_handle_;
+  collision_detection::World::ObserverHandle     world_version_observer_handle_;
+
+  mutable boost::uint64_t                        world_version_;        // 0 if this is a diff with the version of its parent
+  mutable boost::uint64_t                        parent_world_version_; // the version of the parent when world_version_ was set
 
   std::map<std::string, CollisionDetectorPtr>    collision_;          // never empty
   CollisionDetectorPtr                           active_collision_;   // copy of one of the entries in collision_.  Never NULL.
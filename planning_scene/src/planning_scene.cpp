@@ -44,6 +44,8 @@
 #include <moveit/exceptions/exceptions.h>
 #include <octomap_msgs/conversions.h>
 #include <eigen_conversions/eigen_msg.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
 #include <set>
 
 namespace planning_scene
@@ -51,6 +53,13 @@ namespace planning_scene
 const std::string PlanningScene::OCTOMAP_NS = "<octomap>";
 const std::string PlanningScene::DEFAULT_SCENE_NAME = "(noname)";
 
+namespace
+{
+// world versions are allocated from a single counter, so they are unique within the process
+boost::mutex world_version_lock;
+boost::uint64_t last_world_version = 0;
+}
+
 class SceneTransforms : public robot_state::Transforms
 {
 public:
@@ -152,6 +161,7 @@ planning_scene::PlanningScene::~PlanningScene()
 {
   if (current_world_object_update_callback_)
     world_->removeObserver(current_world_object_update_observer_handle_);
+  world_->removeObserver(world_version_observer_handle_);
 }
 
 void planning_scene::PlanningScene::initialize()
@@ -174,6 +184,10 @@ void planning_scene::PlanningScene::initialize()
     acm_->setEntry(it->link1_, it->link2_, true);
 
   setActiveCollisionDetector(collision_detection::CollisionDetectorAllocatorFCL::create());
+
+  parent_world_version_ = 0;
+  updateWorldVersion();
+  world_version_observer_handle_ = world_->addObserver(boost::bind(&PlanningScene::worldChanged, this, _1, _2));
 }
 
 /* return NULL on failure */
@@ -206,6 +220,11 @@ planning_scene::PlanningScene::PlanningScene(const PlanningSceneConstPtr &parent
   // record changes to the world
   world_diff_.reset(new collision_detection::WorldDiff(world_));
 
+  // until something changes, this scene has the version of its parent
+  world_version_ = 0;
+  parent_world_version_ = parent_->getWorldVersion();
+  world_version_observer_handle_ = world_->addObserver(boost::bind(&PlanningScene::worldChanged, this, _1, _2));
+
   // Set up the same collision detectors as the parent
   for (CollisionDetectorConstIterator it = parent_->collision_.begin() ; it != parent_->collision_.end() ; ++it)
   {
@@ -264,6 +283,7 @@ void planning_scene::PlanningScene::propogateRobotPadding()
 {
   if (!active_collision_->crobot_)
     return;
+  updateWorldVersion();
 
   for (CollisionDetectorIterator it = collision_.begin() ; it != collision_.end() ; ++it)
   {
@@ -429,6 +449,7 @@ void planning_scene::PlanningScene::clearDiffs()
   world_diff_.reset(new collision_detection::WorldDiff(world_));
   if (current_world_object_update_callback_)
     current_world_object_update_observer_handle_ = world_->addObserver(current_world_object_update_callback_);
+  world_version_observer_handle_ = world_->addObserver(boost::bind(&PlanningScene::worldChanged, this, _1, _2));
 
   // use parent crobot_ if it exists.  Otherwise copy padding from parent.
   for (CollisionDetectorIterator it = collision_.begin() ; it != collision_.end() ; ++it)
@@ -460,6 +481,12 @@ void planning_scene::PlanningScene::clearDiffs()
   acm_.reset();
   object_colors_.reset();
   object_types_.reset();
+
+  // the scene is the same as its parent again
+  const boost::uint64_t parent_version = parent_->getWorldVersion();
+  boost::mutex::scoped_lock slock(world_version_lock);
+  world_version_ = 0;
+  parent_world_version_ = parent_version;
 }
 
 void planning_scene::PlanningScene::pushDiffs(const PlanningScenePtr &scene)
@@ -468,7 +495,7 @@ void planning_scene::PlanningScene::pushDiffs(const PlanningScenePtr &scene)
     return;
 
   if (ftf_)
-    scene->getTransformsNonConst().setAllTransforms(ftf_->getAllTransforms());
+    scene->getTransformsNonConst().setAllTransforms(*ftf_);
 
   if (kstate_)
     scene->getCurrentStateNonConst() = *kstate_;
@@ -622,6 +649,7 @@ void planning_scene::PlanningScene::getCollidingLinks(std::vector<std::string> &
 
 const collision_detection::CollisionRobotPtr& planning_scene::PlanningScene::getCollisionRobotNonConst()
 {
+  updateWorldVersion();
   if (!active_collision_->crobot_)
   {
     active_collision_->crobot_ = active_collision_->alloc_->allocateRobot(active_collision_->parent_->getCollisionRobot());
@@ -668,9 +696,36 @@ collision_detection::AllowedCollisionMatrix& planning_scene::PlanningScene::getA
 {
   if (!acm_)
     acm_.reset(new collision_detection::AllowedCollisionMatrix(parent_->getAllowedCollisionMatrix()));
+  updateWorldVersion();
   return *acm_;
 }
 
+boost::uint64_t planning_scene::PlanningScene::getWorldVersion() const
+{
+  const boost::uint64_t parent_version = parent_ ? parent_->getWorldVersion() : 0;
+  boost::mutex::scoped_lock slock(world_version_lock);
+  // a diff keeps its own copy of the world but may share the ACM and padding of its parent, so it needs a new version
+  // whenever its parent changes
+  if (parent_version != parent_world_version_)
+  {
+    world_version_ = ++last_world_version;
+    parent_world_version_ = parent_version;
+  }
+  return world_version_ ? world_version_ : parent_version;
+}
+
+void planning_scene::PlanningScene::updateWorldVersion()
+{
+  boost::mutex::scoped_lock slock(world_version_lock);
+  world_version_ = ++last_world_version;
+}
+
+void planning_scene::PlanningScene::worldChanged(const collision_detection::World::ObjectConstPtr &object,
+                                                 collision_detection::World::Action action)
+{
+  updateWorldVersion();
+}
+
 const robot_state::Transforms& planning_scene::PlanningScene::getTransforms()
 {
   getCurrentStateNonConst().update();
@@ -683,7 +738,7 @@ robot_state::Transforms& planning_scene::PlanningScene::getTransformsNonConst()
   if (!ftf_)
   {
     ftf_.reset(new SceneTransforms(this));
-    ftf_->setAllTransforms(parent_->getTransforms().getAllTransforms());
+    ftf_->setAllTransforms(parent_->getTransforms());
   }
   return *ftf_;
 }
@@ -1069,10 +1124,14 @@ void planning_scene::PlanningScene::decoupleParent()
   if (!parent_)
     return;
 
+  // the content does not change, but the version can no longer follow the parent
+  world_version_ = getWorldVersion();
+  parent_world_version_ = 0;
+
   if (!ftf_)
   {
     ftf_.reset(new SceneTransforms(this));
-    ftf_->setAllTransforms(parent_->getTransforms().getAllTransforms());
+    ftf_->setAllTransforms(parent_->getTransforms());
   }
 
   if (!kstate_)
@@ -1159,10 +1218,14 @@ void planning_scene::PlanningScene::setPlanningSceneDiffMsg(const moveit_msgs::P
 
   // if at least some links are mentioned in the allowed collision matrix, then we have an update
   if (!scene_msg.allowed_collision_matrix.entry_names.empty())
+  {
     acm_.reset(new collision_detection::AllowedCollisionMatrix(scene_msg.allowed_collision_matrix));
+    updateWorldVersion();
+  }
 
   if (!scene_msg.link_padding.empty() || !scene_msg.link_scale.empty())
   {
+    updateWorldVersion();
     for (CollisionDetectorIterator it = collision_.begin() ; it != collision_.end() ; ++it)
     {
       if (!it->second->crobot_)
@@ -1207,6 +1270,7 @@ void planning_scene::PlanningScene::setPlanningSceneMsg(const moveit_msgs::Plann
   ftf_->setTransforms(scene_msg.fixed_frame_transforms);
   setCurrentState(scene_msg.robot_state);
   acm_.reset(new collision_detection::AllowedCollisionMatrix(scene_msg.allowed_collision_matrix));
+  updateWorldVersion();
   for (CollisionDetectorIterator it = collision_.begin() ; it != collision_.end() ; ++it)
   {
     if (!it->second->crobot_)
@@ -56,10 +56,13 @@
 
 #include <map>
 #include <string>
+#include <vector>
 #include <iostream>
+#include <algorithm>
 #include <boost/thread.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 
 namespace moveit
 {
@@ -71,30 +74,81 @@ namespace tools
     spent in various chunks of code. This is different from
     external profiling tools in that it allows the user to count
     time spent in various bits of code (sub-function granularity)
-    or count how many times certain pieces of code are executed.*/
+    or count how many times certain pieces of code are executed.
+
+    Names are interned: each distinct name is mapped once to a small
+    integer id that is shared by all profiler instances. Every thread
+    records into its own buffer, indexed by that id, so recording an
+    event never touches global state. Recording is not lock-free: it
+    takes the mutex of the thread's own buffer, which is only contended
+    while status(), getSnapshot(), writeTrace() or clear() copy or reset
+    that buffer. The buffers of all threads are only combined when the
+    statistics are read. When a thread exits, its buffer is merged into
+    the statistics of finished threads and freed, so threads that come
+    and go do not accumulate buffers. For the lowest overhead, create a
+    Key once (e.g., as a static variable) and pass it instead of a name;
+    the variants taking a std::string remain available and only add a
+    per-thread hash lookup.
+
+    A profiler must outlive the recording done with it. Threads that
+    recorded with a profiler may outlive it; their buffers are then
+    freed when they exit. */
 class Profiler : private boost::noncopyable
 {
 public:
 
+  /** \brief An interned name. Constructing a key takes a global lock; using it afterwards only takes the lock of the calling thread's buffer. */
+  class Key
+  {
+  public:
+
+    /** \brief Intern \e name */
+    explicit Key(const std::string &name) : id_(Profiler::intern(name))
+    {
+    }
+
+    /** \brief The id assigned to the name */
+    unsigned int id(void) const
+    {
+      return id_;
+    }
+
+    /** \brief The interned name */
+    std::string name(void) const
+    {
+      return Profiler::getName(id_);
+    }
+
+  private:
+
+    unsigned int id_;
+  };
+
   /** \brief This instance will call Profiler::begin() when constructed and Profiler::end() when it goes out of scope. */
   class ScopedBlock
   {
   public:
     /** \brief Start counting time for the block named \e name of the profiler \e prof */
-    ScopedBlock(const std::string &name, Profiler &prof = Profiler::Instance()) : name_(name), prof_(prof)
+    ScopedBlock(const std::string &name, Profiler &prof = Profiler::Instance()) : prof_(prof), id_(prof.lookup(name))
     {
-      prof_.begin(name);
+      prof_.begin(id_);
+    }
+
+    /** \brief Start counting time for the block identified by \e key of the profiler \e prof */
+    ScopedBlock(const Key &key, Profiler &prof = Profiler::Instance()) : prof_(prof), id_(key.id())
+    {
+      prof_.begin(id_);
     }
 
     ~ScopedBlock(void)
     {
-      prof_.end(name_);
+      prof_.end(id_);
     }
 
   private:
 
-    std::string  name_;
-    Profiler    &prof_;
+    Profiler     &prof_;
+    unsigned int  id_;
   };
 
   /** \brief This instance will call Profiler::start() when constructed and Profiler::stop() when it goes out of scope.
@@ -127,18 +181,16 @@ public:
 
   /** \brief Constructor. It is allowed to separately instantiate this
       class (not only as a singleton) */
-  Profiler(bool printOnDestroy = false, bool autoStart = false) : running_(false), printOnDestroy_(printOnDestroy)
-  {
-    if (autoStart)
-      start();
-  }
+  Profiler(bool printOnDestroy = false, bool autoStart = false);
 
   /** \brief Destructor */
-  ~Profiler(void)
-  {
-    if (printOnDestroy_ && !data_.empty())
-      status();
-  }
+  ~Profiler(void);
+
+  /** \brief Return the id of \e name, assigning a new one if the name was not seen before */
+  static unsigned int intern(const std::string &name);
+
+  /** \brief Return the name an id was assigned to (empty if the id is unknown) */
+  static std::string getName(unsigned int id);
 
   /** \brief Start counting time */
   static void Start(void)
@@ -174,7 +226,43 @@ public:
   }
 
   /** \brief Count a specific event for a number of times */
-  void event(const std::string &name, const unsigned int times = 1);
+  static void Event(const Key &key, const unsigned int times = 1)
+  {
+    Instance().event(key.id(), times);
+  }
+
+  /** \brief Count a specific event for a number of times */
+  void event(const std::string &name, const unsigned int times = 1)
+  {
+    event(lookup(name), times);
+  }
+
+  /** \brief Count a specific event for a number of times */
+  void event(const Key &key, const unsigned int times = 1)
+  {
+    event(key.id(), times);
+  }
+
+  /** \brief Count \e times occurrences of the counter \e key in the global profiler (Instance()), if counters are enabled.
+      Library code calls this from hot paths (e.g., forward kinematics, collision checking), so it does nothing
+      but test a flag while counters are disabled. Counters are reported as events (see status() and getSnapshot()) */
+  static void Count(const Key &key, const unsigned int times = 1)
+  {
+    if (counters_enabled_)
+      Instance().event(key.id(), times);
+  }
+
+  /** \brief Enable or disable the counters recorded through Count(). They are disabled by default */
+  static void SetCountersEnabled(bool flag)
+  {
+    counters_enabled_ = flag;
+  }
+
+  /** \brief Check if the counters recorded through Count() are enabled */
+  static bool CountersEnabled(void)
+  {
+    return counters_enabled_;
+  }
 
   /** \brief Maintain the average of a specific value */
   static void Average(const std::string& name, const double value)
@@ -183,7 +271,22 @@ public:
   }
 
   /** \brief Maintain the average of a specific value */
-  void average(const std::string &name, const double value);
+  static void Average(const Key &key, const double value)
+  {
+    Instance().average(key.id(), value);
+  }
+
+  /** \brief Maintain the average of a specific value */
+  void average(const std::string &name, const double value)
+  {
+    average(lookup(name), value);
+  }
+
+  /** \brief Maintain the average of a specific value */
+  void average(const Key &key, const double value)
+  {
+    average(key.id(), value);
+  }
 
   /** \brief Begin counting time for a specific chunk of code */
   static void Begin(const std::string &name)
@@ -191,17 +294,47 @@ public:
     Instance().begin(name);
   }
 
+  /** \brief Begin counting time for a specific chunk of code */
+  static void Begin(const Key &key)
+  {
+    Instance().begin(key.id());
+  }
+
   /** \brief Stop counting time for a specific chunk of code */
   static void End(const std::string &name)
   {
     Instance().end(name);
   }
 
+  /** \brief Stop counting time for a specific chunk of code */
+  static void End(const Key &key)
+  {
+    Instance().end(key.id());
+  }
+
+  /** \brief Begin counting time for a specific chunk of code */
+  void begin(const std::string &name)
+  {
+    begin(lookup(name));
+  }
+
   /** \brief Begin counting time for a specific chunk of code */
-  void begin(const std::string &name);
+  void begin(const Key &key)
+  {
+    begin(key.id());
+  }
 
   /** \brief Stop counting time for a specific chunk of code */
-  void end(const std::string &name);
+  void end(const std::string &name)
+  {
+    end(lookup(name));
+  }
+
+  /** \brief Stop counting time for a specific chunk of code */
+  void end(const Key &key)
+  {
+    end(key.id());
+  }
 
   /** \brief Print the status of the profiled code chunks and
       events. Optionally, computation done by different threads
@@ -239,52 +372,213 @@ public:
     return Instance().running();
   }
 
+  /** \brief Histogram of time intervals (in nanoseconds). Intervals below SUB_BUCKETS ns are counted exactly;
+      above that, every power of two is split into SUB_BUCKETS buckets of equal width, so the bucket
+      width is always less than 1/SUB_BUCKETS of the values it holds. Only the buckets up to the largest
+      recorded interval are allocated. */
+  class Histogram
+  {
+  public:
+
+    enum { SUB_BUCKET_BITS = 4, SUB_BUCKETS = 1 << SUB_BUCKET_BITS };
+
+    Histogram(void) : count_(0)
+    {
+    }
+
+    /** \brief Count the interval \e ns */
+    void add(long long int ns)
+    {
+      std::size_t b = bucket(ns);
+      if (b >= counts_.size())
+        counts_.resize(b + 1, 0);
+      counts_[b]++;
+      count_++;
+    }
+
+    /** \brief Add the counts of \e other to this histogram */
+    void merge(const Histogram &other);
+
+    /** \brief Number of counted intervals */
+    unsigned long int count(void) const
+    {
+      return count_;
+    }
+
+    /** \brief Return the interval below which a fraction \e q (in [0, 1]) of the counted intervals
+        fall. The value is the middle of the bucket the percentile falls in; 0 if nothing was counted. */
+    long long int percentile(double q) const;
+
+    /** \brief Return the index of the bucket for the interval \e ns */
+    static std::size_t bucket(long long int ns)
+    {
+      if (ns < (long long int)SUB_BUCKETS)
+        return ns < 0 ? 0 : (std::size_t)ns;
+      unsigned int e = msb((unsigned long long int)ns);
+      return SUB_BUCKETS + (e - SUB_BUCKET_BITS) * SUB_BUCKETS + (std::size_t)((ns >> (e - SUB_BUCKET_BITS)) - SUB_BUCKETS);
+    }
+
+    /** \brief Return the smallest interval counted in bucket \e b */
+    static long long int bucketLowerBound(std::size_t b);
+
+    /** \brief Return the width of bucket \e b */
+    static long long int bucketWidth(std::size_t b);
+
+  private:
+
+    /** \brief Index of the most significant bit set in \e v (\e v > 0) */
+    static unsigned int msb(unsigned long long int v)
+    {
+#ifdef __GNUC__
+      return 63 - __builtin_clzll(v);
+#else
+      unsigned int r = 0;
+      while (v >>= 1)
+        ++r;
+      return r;
+#endif
+    }
+
+    std::vector<unsigned long int> counts_;
+    unsigned long int              count_;
+  };
+
+  /** \brief Statistics for a timed block of code; times are in seconds */
+  struct BlockStatistics
+  {
+    std::string       name;
+    unsigned long int parts;
+    double            total;
+    double            shortest;
+    double            longest;
+    double            average;
+    double            p50;
+    double            p99;
+    double            p999;
+  };
+
+  /** \brief Statistics for an averaged value */
+  struct AverageStatistics
+  {
+    std::string       name;
+    unsigned long int parts;
+    double            average;
+    double            stddev;
+  };
+
+  /** \brief The number of times an event occurred */
+  struct EventStatistics
+  {
+    std::string       name;
+    unsigned long int count;
+  };
+
+  /** \brief The statistics of all threads, merged */
+  struct Snapshot
+  {
+    /** \brief Time counted since start() (in seconds), including the time the profiler has been running for so far */
+    double                         total_time;
+
+    std::vector<EventStatistics>   events;
+    std::vector<AverageStatistics> averages;
+    std::vector<BlockStatistics>   blocks;
+  };
+
+  /** \brief Fill \e snapshot with the statistics collected so far. Unlike status(), this does not stop
+      the profiler, so it can be called periodically (e.g., to publish metrics) */
+  static void GetSnapshot(Snapshot &snapshot)
+  {
+    Instance().getSnapshot(snapshot);
+  }
+
+  /** \brief Fill \e snapshot with the statistics collected so far. Unlike status(), this does not stop
+      the profiler, so it can be called periodically (e.g., to publish metrics) */
+  void getSnapshot(Snapshot &snapshot);
+
+  /** \brief Keep the last \e events timed blocks of every thread, for writeTrace(). A capacity of 0 (the default) disables tracing */
+  static void SetTraceCapacity(std::size_t events)
+  {
+    Instance().setTraceCapacity(events);
+  }
+
+  /** \brief Keep the last \e events timed blocks of every thread, for writeTrace(). A capacity of 0 (the default) disables tracing */
+  void setTraceCapacity(std::size_t events);
+
+  /** \brief Get the number of timed blocks kept for every thread */
+  std::size_t getTraceCapacity(void) const
+  {
+    return trace_capacity_;
+  }
+
+  /** \brief Write the timed blocks kept so far in the Chrome trace-event JSON format, with one track per running thread
+      and one for the most recent blocks of the threads that finished. The output can be loaded in chrome://tracing, Perfetto or speedscope. Nothing but the thread tracks
+      is written if tracing is disabled (see setTraceCapacity()) */
+  static void WriteTrace(std::ostream &out)
+  {
+    Instance().writeTrace(out);
+  }
+
+  /** \brief Write the timed blocks kept so far in the Chrome trace-event JSON format, with one track per running thread
+      and one for the most recent blocks of the threads that finished. The output can be loaded in chrome://tracing, Perfetto or speedscope. Nothing but the thread tracks
+      is written if tracing is disabled (see setTraceCapacity()) */
+  void writeTrace(std::ostream &out);
+
 private:
 
-  /** \brief Information about time spent in a section of the code */
+  /** \brief Information about time spent in a section of the code. Times are in nanoseconds. */
   struct TimeInfo
   {
-    TimeInfo(void) : total(0, 0, 0, 0), shortest(boost::posix_time::pos_infin), longest(boost::posix_time::neg_infin), parts(0)
+    TimeInfo(void) : total(0), shortest(0), longest(0), parts(0), start(0)
     {
     }
 
     /** \brief Total time counted. */
-    boost::posix_time::time_duration total;
+    long long int total;
 
     /** \brief The shortest counted time interval */
-    boost::posix_time::time_duration shortest;
+    long long int shortest;
 
     /** \brief The longest counted time interval */
-    boost::posix_time::time_duration longest;
+    long long int longest;
 
     /** \brief Number of times a chunk of time was added to this structure */
     unsigned long int parts;
 
     /** \brief The point in time when counting time started */
-    boost::posix_time::ptime start;
+    long long int start;
 
-    /** \brief Begin counting time */
-    void set(void)
-    {
-      start = boost::posix_time::microsec_clock::universal_time();
-    }
+    /** \brief The distribution of the counted time intervals */
+    Histogram     histogram;
 
-    /** \brief Add the counted time to the total time */
-    void update(void)
+    /** \brief Add the time interval \e dt to the total time */
+    void add(long long int dt)
     {
-      const boost::posix_time::time_duration &dt = boost::posix_time::microsec_clock::universal_time() - start;
-      if (dt > longest)
+      histogram.add(dt);
+      if (parts == 0 || dt > longest)
         longest = dt;
-      if (dt < shortest)
+      if (parts == 0 || dt < shortest)
         shortest = dt;
-      total = total + dt;
+      total += dt;
       ++parts;
     }
+
+    /** \brief The percentile \e q of the counted intervals, limited to [shortest, longest] */
+    long long int percentile(double q) const
+    {
+      return std::min(std::max(histogram.percentile(q), shortest), longest);
+    }
+
+    /** \brief Combine the time counted by \e other into this structure */
+    void merge(const TimeInfo &other);
   };
 
   /** \brief Information maintained about averaged values */
   struct AvgInfo
   {
+    AvgInfo(void) : total(0.0), totalSqr(0.0), parts(0)
+    {
+    }
+
     /** \brief The sum of the values to average */
     double            total;
 
@@ -295,26 +589,108 @@ private:
     unsigned long int parts;
   };
 
-  /** \brief Information to be maintained for each thread */
+  /** \brief Information to be maintained for each thread. The vectors are indexed by interned id. */
   struct PerThread
   {
     /** \brief The stored events */
-    std::map<std::string, unsigned long int> events;
+    std::vector<unsigned long int> events;
 
     /** \brief The stored averages */
-    std::map<std::string, AvgInfo>           avg;
+    std::vector<AvgInfo>           avg;
 
     /** \brief The amount of time spent in various places */
-    std::map<std::string, TimeInfo>          time;
+    std::vector<TimeInfo>          time;
+  };
+
+  /** \brief A timed block kept for writeTrace() */
+  struct TraceEvent
+  {
+    unsigned int  id;
+    long long int start;
+    long long int duration;
   };
 
-  void printThreadInfo(std::ostream &out, const PerThread &data);
+  /** \brief The buffer a thread records into. Only the owning thread writes to it; the lock is
+      therefore uncontended, except for the short time status() or clear() take to access the buffer. */
+  struct ThreadBuffer
+  {
+    ThreadBuffer(Profiler *p) : owner(p), trace_capacity(0), trace_next(0)
+    {
+    }
+
+    /** \brief The profiler the buffer is listed in; NULL once that profiler is destroyed */
+    Profiler                                          *owner;
+    boost::thread::id                                  thread;
+    boost::mutex                                       lock;
+    PerThread                                          data;
+
+    /** \brief The most recent timed blocks, used as a ring buffer once trace_capacity entries are filled */
+    std::vector<TraceEvent>                            trace;
+    std::size_t                                        trace_capacity;
+    std::size_t                                        trace_next;
+
+    /** \brief Cache of the ids of names used by this thread, so that the variants of the calls taking
+        a name do not need to access the global name registry */
+    boost::unordered_map<std::string, unsigned int>    ids;
+  };
+
+  /** \brief Return the buffer of the calling thread, creating it on first use */
+  ThreadBuffer* getThreadBuffer(void)
+  {
+    ThreadBuffer *b = buffer_.get();
+    // a buffer owned by another profiler is left over from a destroyed profiler that had the same address
+    return b && b->owner == this ? b : addThreadBuffer();
+  }
+
+  ThreadBuffer* addThreadBuffer(void);
+
+  /** \brief Cleanup function for buffer_, called when a thread exits: the buffer is retired from
+      its profiler, if that still exists, and freed */
+  static void retireThreadBuffer(ThreadBuffer *b);
+
+  /** \brief Merge the data of \e b into the data of finished threads and remove it from buffers_ */
+  void retire(ThreadBuffer *b);
+
+  /** \brief Return the id of \e name using the cache of the calling thread */
+  unsigned int lookup(const std::string &name);
+
+  void event(unsigned int id, const unsigned int times);
+  void average(unsigned int id, const double value);
+  void begin(unsigned int id);
+  void end(unsigned int id);
+
+  /** \brief Copy the data of all threads and the registered names */
+  void collect(std::vector<PerThread> &data, std::vector<std::string> &names);
+
+  /** \brief Merge the data of all threads into \e combined */
+  static void combine(const std::vector<PerThread> &data, std::size_t count, PerThread &combined);
+
+  /** \brief Add \e data to \e combined, growing \e combined as needed */
+  static void accumulate(const PerThread &data, PerThread &combined);
 
-  boost::mutex                           lock_;
-  std::map<boost::thread::id, PerThread> data_;
-  TimeInfo                               tinfo_;
-  bool                                   running_;
-  bool                                   printOnDestroy_;
+  void printThreadInfo(std::ostream &out, const PerThread &data, const std::vector<std::string> &names);
+
+  /** \brief Flag set by SetCountersEnabled() */
+  static bool                                        counters_enabled_;
+
+  boost::mutex                                       lock_;
+
+  /** \brief The buffers of the running threads; each is freed when its thread exits */
+  std::vector<ThreadBuffer*>                         buffers_;
+  boost::thread_specific_ptr<ThreadBuffer>           buffer_;
+
+  /** \brief The combined data of the threads that exited */
+  PerThread                                          retired_;
+
+  /** \brief The most recent timed blocks of the threads that exited, at most trace_capacity_ */
+  std::vector<TraceEvent>                            retired_trace_;
+
+  /** \brief The number of threads that exited after recording */
+  std::size_t                                        retired_threads_;
+  TimeInfo                                           tinfo_;
+  std::size_t                                        trace_capacity_;
+  bool                                               running_;
+  bool                                               printOnDestroy_;
 
 };
 }
@@ -323,6 +699,7 @@ private:
 #else
 
 #include <string>
+#include <vector>
 #include <iostream>
 
 /* If profiling is disabled, provide empty implementations for the
@@ -336,6 +713,25 @@ class Profiler
 {
 public:
 
+  class Key
+  {
+  public:
+
+    explicit Key(const std::string &)
+    {
+    }
+
+    unsigned int id(void) const
+    {
+      return 0;
+    }
+
+    std::string name(void) const
+    {
+      return std::string();
+    }
+  };
+
   class ScopedBlock
   {
   public:
@@ -344,6 +740,10 @@ public:
     {
     }
 
+    ScopedBlock(const Key &, Profiler & = Profiler::Instance())
+    {
+    }
+
     ~ScopedBlock(void)
     {
     }
@@ -372,6 +772,16 @@ public:
   {
   }
 
+  static unsigned int intern(const std::string &)
+  {
+    return 0;
+  }
+
+  static std::string getName(unsigned int)
+  {
+    return std::string();
+  }
+
   static void Start(void)
   {
   }
@@ -400,34 +810,79 @@ public:
   {
   }
 
+  static void Event(const Key &, const unsigned int = 1)
+  {
+  }
+
   void event(const std::string &, const unsigned int = 1)
   {
   }
 
+  void event(const Key &, const unsigned int = 1)
+  {
+  }
+
+  static void Count(const Key &, const unsigned int = 1)
+  {
+  }
+
+  static void SetCountersEnabled(bool)
+  {
+  }
+
+  static bool CountersEnabled(void)
+  {
+    return false;
+  }
+
   static void Average(const std::string&, const double)
   {
   }
 
+  static void Average(const Key &, const double)
+  {
+  }
+
   void average(const std::string &, const double)
   {
   }
 
+  void average(const Key &, const double)
+  {
+  }
+
   static void Begin(const std::string &)
   {
   }
 
+  static void Begin(const Key &)
+  {
+  }
+
   static void End(const std::string &)
   {
   }
 
+  static void End(const Key &)
+  {
+  }
+
   void begin(const std::string &)
   {
   }
 
+  void begin(const Key &)
+  {
+  }
+
   void end(const std::string &)
   {
   }
 
+  void end(const Key &)
+  {
+  }
+
   static void Status(std::ostream & = std::cout, bool = true)
   {
   }
@@ -453,6 +908,77 @@ public:
   {
     return false;
   }
+
+  struct BlockStatistics
+  {
+    std::string       name;
+    unsigned long int parts;
+    double            total;
+    double            shortest;
+    double            longest;
+    double            average;
+    double            p50;
+    double            p99;
+    double            p999;
+  };
+
+  struct AverageStatistics
+  {
+    std::string       name;
+    unsigned long int parts;
+    double            average;
+    double            stddev;
+  };
+
+  struct EventStatistics
+  {
+    std::string       name;
+    unsigned long int count;
+  };
+
+  struct Snapshot
+  {
+    double                         total_time;
+    std::vector<EventStatistics>   events;
+    std::vector<AverageStatistics> averages;
+    std::vector<BlockStatistics>   blocks;
+  };
+
+  static void GetSnapshot(Snapshot &snapshot)
+  {
+    Instance().getSnapshot(snapshot);
+  }
+
+  void getSnapshot(Snapshot &snapshot)
+  {
+    snapshot.total_time = 0.0;
+    snapshot.events.clear();
+    snapshot.averages.clear();
+    snapshot.blocks.clear();
+  }
+
+  static void SetTraceCapacity(std::size_t)
+  {
+  }
+
+  void setTraceCapacity(std::size_t)
+  {
+  }
+
+  std::size_t getTraceCapacity(void) const
+  {
+    return 0;
+  }
+
+  static void WriteTrace(std::ostream &out)
+  {
+    Instance().writeTrace(out);
+  }
+
+  void writeTrace(std::ostream &out)
+  {
+    out << "{\"traceEvents\":[]}" << std::endl;
+  }
 };
 
 }
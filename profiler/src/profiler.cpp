@@ -48,13 +48,224 @@ moveit::tools::Profiler& moveit::tools::Profiler::Instance(void)
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <cmath>
+#include <time.h>
+#include <unistd.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+/// @cond IGNORE
+namespace
+{
+
+/* The registry of interned names; shared by all profiler instances */
+struct NameRegistry
+{
+  boost::mutex                        lock;
+  std::vector<std::string>            names;
+  std::map<std::string, unsigned int> ids;
+};
+
+NameRegistry& getNameRegistry(void)
+{
+  static NameRegistry registry;
+  return registry;
+}
+
+/* Monotonic time in nanoseconds */
+inline long long int now(void)
+{
+#if defined(_POSIX_MONOTONIC_CLOCK) && _POSIX_MONOTONIC_CLOCK >= 0
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long int)ts.tv_sec * 1000000000LL + (long long int)ts.tv_nsec;
+#else
+  static const boost::posix_time::ptime epoch(boost::posix_time::microsec_clock::universal_time());
+  return (boost::posix_time::microsec_clock::universal_time() - epoch).total_microseconds() * 1000LL;
+#endif
+}
+
+inline double to_seconds(long long int ns)
+{
+  return (double)ns / 1000000000.0;
+}
+
+struct TraceEventStartLess
+{
+  template<typename T>
+  bool operator()(const T &a, const T &b) const
+  {
+    return a.start < b.start;
+  }
+};
+
+}
+/// @endcond
+
+bool moveit::tools::Profiler::counters_enabled_ = false;
+
+moveit::tools::Profiler::Profiler(bool printOnDestroy, bool autoStart) :
+  buffer_(&retireThreadBuffer),
+  retired_threads_(0),
+  trace_capacity_(0),
+  running_(false),
+  printOnDestroy_(printOnDestroy)
+{
+  if (autoStart)
+    start();
+}
+
+moveit::tools::Profiler::~Profiler(void)
+{
+  if (printOnDestroy_ && (!buffers_.empty() || retired_threads_ > 0))
+    status();
+
+  // the buffers of threads that are still running are freed when those threads exit
+  boost::mutex::scoped_lock slock(lock_);
+  for (std::size_t i = 0 ; i < buffers_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock block(buffers_[i]->lock);
+    buffers_[i]->owner = NULL;
+  }
+}
+
+unsigned int moveit::tools::Profiler::intern(const std::string &name)
+{
+  NameRegistry &r = getNameRegistry();
+  boost::mutex::scoped_lock slock(r.lock);
+  std::map<std::string, unsigned int>::const_iterator it = r.ids.find(name);
+  if (it != r.ids.end())
+    return it->second;
+  unsigned int id = r.names.size();
+  r.names.push_back(name);
+  r.ids[name] = id;
+  return id;
+}
+
+std::string moveit::tools::Profiler::getName(unsigned int id)
+{
+  NameRegistry &r = getNameRegistry();
+  boost::mutex::scoped_lock slock(r.lock);
+  return id < r.names.size() ? r.names[id] : std::string();
+}
+
+moveit::tools::Profiler::ThreadBuffer* moveit::tools::Profiler::addThreadBuffer(void)
+{
+  ThreadBuffer *b = new ThreadBuffer(this);
+  b->thread = boost::this_thread::get_id();
+  lock_.lock();
+  b->trace_capacity = trace_capacity_;
+  buffers_.push_back(b);
+  lock_.unlock();
+  buffer_.reset(b);
+  return b;
+}
+
+void moveit::tools::Profiler::retireThreadBuffer(ThreadBuffer *b)
+{
+  Profiler *owner;
+  {
+    boost::mutex::scoped_lock slock(b->lock);
+    owner = b->owner;
+  }
+  if (owner)
+    owner->retire(b);
+  delete b;
+}
+
+void moveit::tools::Profiler::retire(ThreadBuffer *b)
+{
+  boost::mutex::scoped_lock slock(lock_);
+  std::vector<ThreadBuffer*>::iterator it = std::find(buffers_.begin(), buffers_.end(), b);
+  if (it == buffers_.end())
+    return;
+  buffers_.erase(it);
+
+  boost::mutex::scoped_lock block(b->lock);
+  accumulate(b->data, retired_);
+  retired_threads_++;
+  if (trace_capacity_ > 0 && !b->trace.empty())
+  {
+    // keep the most recent blocks of all finished threads
+    retired_trace_.insert(retired_trace_.end(), b->trace.begin(), b->trace.end());
+    if (retired_trace_.size() > trace_capacity_)
+    {
+      std::sort(retired_trace_.begin(), retired_trace_.end(), TraceEventStartLess());
+      retired_trace_.erase(retired_trace_.begin(), retired_trace_.end() - trace_capacity_);
+    }
+  }
+}
+
+unsigned int moveit::tools::Profiler::lookup(const std::string &name)
+{
+  ThreadBuffer *b = getThreadBuffer();
+  boost::unordered_map<std::string, unsigned int>::const_iterator it = b->ids.find(name);
+  if (it != b->ids.end())
+    return it->second;
+  unsigned int id = intern(name);
+  b->ids[name] = id;
+  return id;
+}
+
+long long int moveit::tools::Profiler::Histogram::bucketLowerBound(std::size_t b)
+{
+  if (b < (std::size_t)SUB_BUCKETS)
+    return b;
+  std::size_t e = (b - SUB_BUCKETS) / SUB_BUCKETS;
+  return (long long int)(SUB_BUCKETS + (b - SUB_BUCKETS) % SUB_BUCKETS) << e;
+}
+
+long long int moveit::tools::Profiler::Histogram::bucketWidth(std::size_t b)
+{
+  if (b < (std::size_t)SUB_BUCKETS)
+    return 1;
+  return 1LL << ((b - SUB_BUCKETS) / SUB_BUCKETS);
+}
+
+void moveit::tools::Profiler::Histogram::merge(const Histogram &other)
+{
+  if (other.counts_.size() > counts_.size())
+    counts_.resize(other.counts_.size(), 0);
+  for (std::size_t i = 0 ; i < other.counts_.size() ; ++i)
+    counts_[i] += other.counts_[i];
+  count_ += other.count_;
+}
+
+long long int moveit::tools::Profiler::Histogram::percentile(double q) const
+{
+  if (count_ == 0)
+    return 0;
+  unsigned long int rank = (unsigned long int)ceil(std::min(std::max(q, 0.0), 1.0) * (double)count_);
+  if (rank == 0)
+    rank = 1;
+  unsigned long int seen = 0;
+  for (std::size_t i = 0 ; i < counts_.size() ; ++i)
+  {
+    seen += counts_[i];
+    if (seen >= rank)
+      return bucketLowerBound(i) + bucketWidth(i) / 2;
+  }
+  return bucketLowerBound(counts_.size() - 1) + bucketWidth(counts_.size() - 1) / 2;
+}
+
+void moveit::tools::Profiler::TimeInfo::merge(const TimeInfo &other)
+{
+  if (other.parts == 0)
+    return;
+  histogram.merge(other.histogram);
+  if (parts == 0 || other.longest > longest)
+    longest = other.longest;
+  if (parts == 0 || other.shortest < shortest)
+    shortest = other.shortest;
+  total += other.total;
+  parts += other.parts;
+}
 
 void moveit::tools::Profiler::start(void)
 {
   lock_.lock();
   if (!running_)
   {
-    tinfo_.set();
+    tinfo_.start = now();
     running_ = true;
   }
   lock_.unlock();
@@ -65,7 +276,7 @@ void moveit::tools::Profiler::stop(void)
   lock_.lock();
   if (running_)
   {
-    tinfo_.update();
+    tinfo_.add(now() - tinfo_.start);
     running_ = false;
   }
   lock_.unlock();
@@ -74,98 +285,316 @@ void moveit::tools::Profiler::stop(void)
 void moveit::tools::Profiler::clear(void)
 {
   lock_.lock();
-  data_.clear();
+  for (std::size_t i = 0 ; i < buffers_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(buffers_[i]->lock);
+    buffers_[i]->data = PerThread();
+    buffers_[i]->trace.clear();
+    buffers_[i]->trace_next = 0;
+  }
+  retired_ = PerThread();
+  retired_trace_.clear();
+  retired_threads_ = 0;
   tinfo_ = TimeInfo();
   if (running_)
-    tinfo_.set();
+    tinfo_.start = now();
   lock_.unlock();
 }
 
-void moveit::tools::Profiler::event(const std::string &name, const unsigned int times)
+void moveit::tools::Profiler::event(unsigned int id, const unsigned int times)
 {
-  lock_.lock();
-  data_[boost::this_thread::get_id()].events[name] += times;
-  lock_.unlock();
+  ThreadBuffer *b = getThreadBuffer();
+  boost::mutex::scoped_lock slock(b->lock);
+  if (id >= b->data.events.size())
+    b->data.events.resize(id + 1, 0);
+  b->data.events[id] += times;
 }
 
-void moveit::tools::Profiler::average(const std::string &name, const double value)
+void moveit::tools::Profiler::average(unsigned int id, const double value)
 {
-  lock_.lock();
-  AvgInfo &a = data_[boost::this_thread::get_id()].avg[name];
+  ThreadBuffer *b = getThreadBuffer();
+  boost::mutex::scoped_lock slock(b->lock);
+  if (id >= b->data.avg.size())
+    b->data.avg.resize(id + 1);
+  AvgInfo &a = b->data.avg[id];
   a.total += value;
   a.totalSqr += value*value;
   a.parts++;
-  lock_.unlock();
 }
 
-void moveit::tools::Profiler::begin(const std::string &name)
+void moveit::tools::Profiler::begin(unsigned int id)
 {
-  lock_.lock();
-  data_[boost::this_thread::get_id()].time[name].set();
-  lock_.unlock();
+  ThreadBuffer *b = getThreadBuffer();
+  boost::mutex::scoped_lock slock(b->lock);
+  if (id >= b->data.time.size())
+    b->data.time.resize(id + 1);
+  b->data.time[id].start = now();
 }
 
-void moveit::tools::Profiler::end(const std::string &name)
+void moveit::tools::Profiler::end(unsigned int id)
+{
+  long long int t = now();
+  ThreadBuffer *b = getThreadBuffer();
+  boost::mutex::scoped_lock slock(b->lock);
+  if (id >= b->data.time.size())
+    b->data.time.resize(id + 1);
+  TimeInfo &ti = b->data.time[id];
+  ti.add(t - ti.start);
+  if (b->trace_capacity > 0)
+  {
+    TraceEvent e = { id, ti.start, t - ti.start };
+    if (b->trace.size() < b->trace_capacity)
+      b->trace.push_back(e);
+    else
+    {
+      b->trace[b->trace_next] = e;
+      b->trace_next = (b->trace_next + 1) % b->trace_capacity;
+    }
+  }
+}
+
+void moveit::tools::Profiler::setTraceCapacity(std::size_t events)
 {
   lock_.lock();
-  data_[boost::this_thread::get_id()].time[name].update();
+  trace_capacity_ = events;
+  for (std::size_t i = 0 ; i < buffers_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(buffers_[i]->lock);
+    buffers_[i]->trace.clear();
+    buffers_[i]->trace_next = 0;
+    buffers_[i]->trace_capacity = events;
+  }
+  retired_trace_.clear();
   lock_.unlock();
 }
 
-namespace
+void moveit::tools::Profiler::collect(std::vector<PerThread> &data, std::vector<std::string> &names)
 {
+  {
+    NameRegistry &r = getNameRegistry();
+    boost::mutex::scoped_lock slock(r.lock);
+    names = r.names;
+  }
+
+  // copy the buffers one at a time, so that each thread is held up only for as long as its own buffer is copied
+  data.resize(buffers_.size());
+  for (std::size_t i = 0 ; i < buffers_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(buffers_[i]->lock);
+    data[i] = buffers_[i]->data;
+  }
+
+  // the data of finished threads comes last
+  if (retired_threads_ > 0)
+    data.push_back(retired_);
+}
 
-inline double to_seconds(const boost::posix_time::time_duration &d)
+void moveit::tools::Profiler::combine(const std::vector<PerThread> &data, std::size_t count, PerThread &combined)
 {
-  return (double)d.total_microseconds() / 1000000.0;
+  for (std::size_t i = 0 ; i < data.size() ; ++i)
+    accumulate(data[i], combined);
+  // ids of names registered after the names were copied are left out
+  combined.events.resize(count, 0);
+  combined.avg.resize(count);
+  combined.time.resize(count);
 }
 
+void moveit::tools::Profiler::accumulate(const PerThread &data, PerThread &combined)
+{
+  if (data.events.size() > combined.events.size())
+    combined.events.resize(data.events.size(), 0);
+  if (data.avg.size() > combined.avg.size())
+    combined.avg.resize(data.avg.size());
+  if (data.time.size() > combined.time.size())
+    combined.time.resize(data.time.size());
+
+  for (std::size_t j = 0 ; j < data.events.size() ; ++j)
+    combined.events[j] += data.events[j];
+  for (std::size_t j = 0 ; j < data.avg.size() ; ++j)
+  {
+    combined.avg[j].total += data.avg[j].total;
+    combined.avg[j].totalSqr += data.avg[j].totalSqr;
+    combined.avg[j].parts += data.avg[j].parts;
+  }
+  for (std::size_t j = 0 ; j < data.time.size() ; ++j)
+    combined.time[j].merge(data.time[j]);
 }
 
 void moveit::tools::Profiler::status(std::ostream &out, bool merge)
 {
   stop();
+
   lock_.lock();
   printOnDestroy_ = false;
 
+  std::vector<PerThread> data;
+  std::vector<std::string> names;
+  collect(data, names);
+
   out << std::endl;
   out << " *** Profiling statistics. Total counted time : " << to_seconds(tinfo_.total) << " seconds" << std::endl;
 
   if (merge)
   {
     PerThread combined;
-    for (std::map<boost::thread::id, PerThread>::const_iterator it = data_.begin() ; it != data_.end() ; ++it)
-    {
-      for (std::map<std::string, unsigned long int>::const_iterator iev = it->second.events.begin() ; iev != it->second.events.end(); ++iev)
-        combined.events[iev->first] += iev->second;
-      for (std::map<std::string, AvgInfo>::const_iterator iavg = it->second.avg.begin() ; iavg != it->second.avg.end(); ++iavg)
-      {
-        combined.avg[iavg->first].total += iavg->second.total;
-        combined.avg[iavg->first].totalSqr += iavg->second.totalSqr;
-        combined.avg[iavg->first].parts += iavg->second.parts;
-      }
-      for (std::map<std::string, TimeInfo>::const_iterator itm = it->second.time.begin() ; itm != it->second.time.end(); ++itm)
-      {
-        TimeInfo &tc = combined.time[itm->first];
-        tc.total = tc.total + itm->second.total;
-        tc.parts = tc.parts + itm->second.parts;
-        if (tc.shortest > itm->second.shortest)
-          tc.shortest = itm->second.shortest;
-        if (tc.longest < itm->second.longest)
-          tc.longest = itm->second.longest;
-      }
-    }
-    printThreadInfo(out, combined);
+    combine(data, names.size(), combined);
+    printThreadInfo(out, combined, names);
   }
   else
-    for (std::map<boost::thread::id, PerThread>::const_iterator it = data_.begin() ; it != data_.end() ; ++it)
+    for (std::size_t i = 0 ; i < data.size() ; ++i)
     {
-      out << "Thread " << it->first << ":" << std::endl;
-      printThreadInfo(out, it->second);
+      if (i < buffers_.size())
+        out << "Thread " << buffers_[i]->thread << ":" << std::endl;
+      else
+        out << "Finished threads (" << retired_threads_ << "):" << std::endl;
+      printThreadInfo(out, data[i], names);
     }
   lock_.unlock();
 }
 
+void moveit::tools::Profiler::getSnapshot(Snapshot &snapshot)
+{
+  lock_.lock();
+  std::vector<PerThread> data;
+  std::vector<std::string> names;
+  collect(data, names);
+  snapshot.total_time = to_seconds(tinfo_.total + (running_ ? now() - tinfo_.start : 0));
+  lock_.unlock();
+
+  PerThread combined;
+  combine(data, names.size(), combined);
+
+  snapshot.events.clear();
+  snapshot.averages.clear();
+  snapshot.blocks.clear();
+  for (std::size_t i = 0 ; i < names.size() ; ++i)
+  {
+    if (combined.events[i] > 0)
+    {
+      EventStatistics ev;
+      ev.name = names[i];
+      ev.count = combined.events[i];
+      snapshot.events.push_back(ev);
+    }
+    const AvgInfo &a = combined.avg[i];
+    if (a.parts > 0)
+    {
+      AverageStatistics av;
+      av.name = names[i];
+      av.parts = a.parts;
+      av.average = a.total / (double)a.parts;
+      av.stddev = a.parts > 1 ? sqrt(fabs(a.totalSqr - (double)a.parts * av.average * av.average) / ((double)a.parts - 1.)) : 0.0;
+      snapshot.averages.push_back(av);
+    }
+    const TimeInfo &t = combined.time[i];
+    if (t.parts > 0)
+    {
+      BlockStatistics bl;
+      bl.name = names[i];
+      bl.parts = t.parts;
+      bl.total = to_seconds(t.total);
+      bl.shortest = to_seconds(t.shortest);
+      bl.longest = to_seconds(t.longest);
+      bl.average = bl.total / (double)t.parts;
+      bl.p50 = to_seconds(t.percentile(0.5));
+      bl.p99 = to_seconds(t.percentile(0.99));
+      bl.p999 = to_seconds(t.percentile(0.999));
+      snapshot.blocks.push_back(bl);
+    }
+  }
+}
+
+/// @cond IGNORE
+namespace
+{
+
+void writeJSONString(std::ostream &out, const std::string &str)
+{
+  static const char *hex = "0123456789abcdef";
+  out << '"';
+  for (std::size_t i = 0 ; i < str.size() ; ++i)
+  {
+    unsigned char c = str[i];
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c < 0x20)
+      out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+    else
+      out << c;
+  }
+  out << '"';
+}
+
+}
+/// @endcond
+
+void moveit::tools::Profiler::writeTrace(std::ostream &out)
+{
+  std::vector<std::string> names;
+  {
+    NameRegistry &r = getNameRegistry();
+    boost::mutex::scoped_lock slock(r.lock);
+    names = r.names;
+  }
+
+  lock_.lock();
+  std::vector<std::vector<TraceEvent> > traces(buffers_.size());
+  std::vector<std::string> tracks(buffers_.size());
+  for (std::size_t i = 0 ; i < buffers_.size() ; ++i)
+  {
+    boost::mutex::scoped_lock slock(buffers_[i]->lock);
+    traces[i] = buffers_[i]->trace;
+    std::stringstream thread_name;
+    thread_name << "Thread " << buffers_[i]->thread;
+    tracks[i] = thread_name.str();
+  }
+  if (!retired_trace_.empty())
+  {
+    traces.push_back(retired_trace_);
+    tracks.push_back("Finished threads");
+  }
+  lock_.unlock();
+
+  // timestamps are written in microseconds, relative to the earliest recorded block
+  long long int origin = 0;
+  bool first = true;
+  for (std::size_t i = 0 ; i < traces.size() ; ++i)
+    for (std::size_t j = 0 ; j < traces[i].size() ; ++j)
+      if (first || traces[i][j].start < origin)
+      {
+        origin = traces[i][j].start;
+        first = false;
+      }
+
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+  out.precision(3);
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  first = true;
+  for (std::size_t i = 0 ; i < traces.size() ; ++i)
+  {
+    out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << i << ",\"args\":{\"name\":";
+    writeJSONString(out, tracks[i]);
+    out << "}}";
+    first = false;
+    for (std::size_t j = 0 ; j < traces[i].size() ; ++j)
+    {
+      const TraceEvent &e = traces[i][j];
+      out << ",\n{\"name\":";
+      writeJSONString(out, e.id < names.size() ? names[e.id] : std::string());
+      out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << i
+          << ",\"ts\":" << (double)(e.start - origin) / 1000.0
+          << ",\"dur\":" << (double)e.duration / 1000.0 << "}";
+    }
+  }
+  out << "\n]}" << std::endl;
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
 void moveit::tools::Profiler::console(void)
 {
   std::stringstream ss;
@@ -196,6 +625,7 @@ struct dataDoubleVal
 {
   std::string  name;
   double       value;
+  std::size_t  index;
 };
 
 struct SortDoubleByValue
@@ -208,16 +638,17 @@ struct SortDoubleByValue
 }
 /// @endcond
 
-void moveit::tools::Profiler::printThreadInfo(std::ostream &out, const PerThread &data)
+void moveit::tools::Profiler::printThreadInfo(std::ostream &out, const PerThread &data, const std::vector<std::string> &names)
 {
   double total = to_seconds(tinfo_.total);
 
   std::vector<dataIntVal> events;
-  for (std::map<std::string, unsigned long int>::const_iterator iev = data.events.begin() ; iev != data.events.end() ; ++iev)
-  {
-    dataIntVal next = {iev->first, iev->second};
-    events.push_back(next);
-  }
+  for (std::size_t i = 0 ; i < data.events.size() && i < names.size() ; ++i)
+    if (data.events[i] > 0)
+    {
+      dataIntVal next = {names[i], data.events[i]};
+      events.push_back(next);
+    }
   std::sort(events.begin(), events.end(), SortIntByValue());
   if (!events.empty())
     out << "Events:" << std::endl;
@@ -225,28 +656,30 @@ void moveit::tools::Profiler::printThreadInfo(std::ostream &out, const PerThread
     out << events[i].name << ": " << events[i].value << std::endl;
 
   std::vector<dataDoubleVal> avg;
-  for (std::map<std::string, AvgInfo>::const_iterator ia = data.avg.begin() ; ia != data.avg.end() ; ++ia)
-  {
-    dataDoubleVal next = {ia->first, ia->second.total / (double)ia->second.parts};
-    avg.push_back(next);
-  }
+  for (std::size_t i = 0 ; i < data.avg.size() && i < names.size() ; ++i)
+    if (data.avg[i].parts > 0)
+    {
+      dataDoubleVal next = {names[i], data.avg[i].total / (double)data.avg[i].parts, i};
+      avg.push_back(next);
+    }
   std::sort(avg.begin(), avg.end(), SortDoubleByValue());
   if (!avg.empty())
     out << "Averages:" << std::endl;
   for (unsigned int i = 0 ; i < avg.size() ; ++i)
   {
-    const AvgInfo &a = data.avg.find(avg[i].name)->second;
+    const AvgInfo &a = data.avg[avg[i].index];
     out << avg[i].name << ": " << avg[i].value << " (stddev = " <<
       sqrt(fabs(a.totalSqr - (double)a.parts * avg[i].value * avg[i].value) / ((double)a.parts - 1.)) << ")" << std::endl;
   }
 
   std::vector<dataDoubleVal> time;
 
-  for (std::map<std::string, TimeInfo>::const_iterator itm = data.time.begin() ; itm != data.time.end() ; ++itm)
-  {
-    dataDoubleVal next = {itm->first, to_seconds(itm->second.total)};
-    time.push_back(next);
-  }
+  for (std::size_t i = 0 ; i < data.time.size() && i < names.size() ; ++i)
+    if (data.time[i].parts > 0)
+    {
+      dataDoubleVal next = {names[i], to_seconds(data.time[i].total), i};
+      time.push_back(next);
+    }
 
   std::sort(time.begin(), time.end(), SortDoubleByValue());
   if (!time.empty())
@@ -255,7 +688,7 @@ void moveit::tools::Profiler::printThreadInfo(std::ostream &out, const PerThread
   double unaccounted = total;
   for (unsigned int i = 0 ; i < time.size() ; ++i)
   {
-    const TimeInfo &d = data.time.find(time[i].name)->second;
+    const TimeInfo &d = data.time[time[i].index];
 
     double tS = to_seconds(d.shortest);
     double tL = to_seconds(d.longest);
@@ -267,6 +700,9 @@ void moveit::tools::Profiler::printThreadInfo(std::ostream &out, const PerThread
       out << ", " << pavg << " s on average";
       if (pavg < 1.0)
         out << " (" << 1.0/pavg << " /s)";
+      out << ", percentiles: " << to_seconds(d.percentile(0.5)) << " s (50%), "
+          << to_seconds(d.percentile(0.99)) << " s (99%), "
+          << to_seconds(d.percentile(0.999)) << " s (99.9%)";
     }
     out << std::endl;
     unaccounted -= time[i].value;
@@ -0,0 +1,358 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/profiler/profiler.h>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <sstream>
+#include <cmath>
+
+static const std::size_t BLOCKS_PER_THREAD = 100;
+
+static void record(moveit::tools::Profiler *profiler)
+{
+  static const moveit::tools::Profiler::Key block_key("test_profiler_block");
+  for (std::size_t i = 0 ; i < BLOCKS_PER_THREAD ; ++i)
+  {
+    moveit::tools::Profiler::ScopedBlock block(block_key, *profiler);
+    profiler->event("test_profiler_event");
+    profiler->average("test_profiler_average", (double)i);
+  }
+}
+
+static void recordAndWait(moveit::tools::Profiler *profiler, boost::barrier *recorded, boost::barrier *destroyed)
+{
+  record(profiler);
+  recorded->wait();
+  destroyed->wait();
+}
+
+static const moveit::tools::Profiler::EventStatistics* findEvent(const moveit::tools::Profiler::Snapshot &snapshot, const std::string &name)
+{
+  for (std::size_t i = 0 ; i < snapshot.events.size() ; ++i)
+    if (snapshot.events[i].name == name)
+      return &snapshot.events[i];
+  return NULL;
+}
+
+static const moveit::tools::Profiler::BlockStatistics* findBlock(const moveit::tools::Profiler::Snapshot &snapshot, const std::string &name)
+{
+  for (std::size_t i = 0 ; i < snapshot.blocks.size() ; ++i)
+    if (snapshot.blocks[i].name == name)
+      return &snapshot.blocks[i];
+  return NULL;
+}
+
+static std::size_t countOccurrences(const std::string &text, const std::string &pattern)
+{
+  std::size_t count = 0;
+  for (std::size_t pos = text.find(pattern) ; pos != std::string::npos ; pos = text.find(pattern, pos + 1))
+    ++count;
+  return count;
+}
+
+TEST(Profiler, FinishedThreadsAreMerged)
+{
+  moveit::tools::Profiler profiler;
+  profiler.setTraceCapacity(10);
+  for (std::size_t i = 0 ; i < 20 ; ++i)
+  {
+    boost::thread thread(boost::bind(&record, &profiler));
+    thread.join();
+  }
+
+  moveit::tools::Profiler::Snapshot snapshot;
+  profiler.getSnapshot(snapshot);
+  const moveit::tools::Profiler::EventStatistics *event = findEvent(snapshot, "test_profiler_event");
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(20 * BLOCKS_PER_THREAD, event->count);
+  const moveit::tools::Profiler::BlockStatistics *block = findBlock(snapshot, "test_profiler_block");
+  ASSERT_TRUE(block != NULL);
+  EXPECT_EQ(20 * BLOCKS_PER_THREAD, block->parts);
+  ASSERT_EQ(1u, snapshot.averages.size());
+  EXPECT_EQ(20 * BLOCKS_PER_THREAD, snapshot.averages[0].parts);
+  EXPECT_NEAR((BLOCKS_PER_THREAD - 1) / 2.0, snapshot.averages[0].average, 1e-9);
+
+  // the buffers of the threads were freed; only their combined data is reported
+  std::stringstream status;
+  profiler.status(status, false);
+  EXPECT_EQ(0u, countOccurrences(status.str(), "Thread "));
+  EXPECT_EQ(1u, countOccurrences(status.str(), "Finished threads (20):"));
+
+  // the trace of finished threads keeps the most recent blocks, up to the trace capacity
+  std::stringstream trace;
+  profiler.writeTrace(trace);
+  EXPECT_EQ(1u, countOccurrences(trace.str(), "\"Finished threads\""));
+  EXPECT_EQ(10u, countOccurrences(trace.str(), "\"ph\":\"X\""));
+
+  profiler.clear();
+  profiler.getSnapshot(snapshot);
+  EXPECT_TRUE(snapshot.events.empty());
+  EXPECT_TRUE(snapshot.blocks.empty());
+  std::stringstream cleared;
+  profiler.status(cleared, false);
+  EXPECT_EQ(0u, countOccurrences(cleared.str(), "Finished threads"));
+}
+
+TEST(Profiler, RunningAndFinishedThreads)
+{
+  moveit::tools::Profiler profiler;
+  record(&profiler);
+  boost::thread_group threads;
+  for (std::size_t i = 0 ; i < 4 ; ++i)
+    threads.create_thread(boost::bind(&record, &profiler));
+  threads.join_all();
+
+  std::stringstream status;
+  profiler.status(status, false);
+  EXPECT_EQ(1u, countOccurrences(status.str(), "Thread "));
+  EXPECT_EQ(1u, countOccurrences(status.str(), "Finished threads (4):"));
+
+  moveit::tools::Profiler::Snapshot snapshot;
+  profiler.getSnapshot(snapshot);
+  const moveit::tools::Profiler::EventStatistics *event = findEvent(snapshot, "test_profiler_event");
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(5 * BLOCKS_PER_THREAD, event->count);
+}
+
+TEST(Profiler, ConcurrentSnapshots)
+{
+  moveit::tools::Profiler profiler;
+  boost::thread_group threads;
+  for (std::size_t i = 0 ; i < 4 ; ++i)
+    threads.create_thread(boost::bind(&record, &profiler));
+  moveit::tools::Profiler::Snapshot snapshot;
+  for (std::size_t i = 0 ; i < 100 ; ++i)
+    profiler.getSnapshot(snapshot);
+  threads.join_all();
+
+  profiler.getSnapshot(snapshot);
+  const moveit::tools::Profiler::EventStatistics *event = findEvent(snapshot, "test_profiler_event");
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(4 * BLOCKS_PER_THREAD, event->count);
+}
+
+TEST(Profiler, ThreadsMayOutliveTheProfiler)
+{
+  boost::barrier recorded(2), destroyed(2);
+  moveit::tools::Profiler *profiler = new moveit::tools::Profiler();
+  boost::thread thread(boost::bind(&recordAndWait, profiler, &recorded, &destroyed));
+  recorded.wait();
+  delete profiler;
+  destroyed.wait();
+  // the thread frees its buffer when it exits
+  thread.join();
+
+  // a new profiler, possibly at the same address, does not pick up buffers of the destroyed one
+  for (std::size_t i = 0 ; i < 3 ; ++i)
+  {
+    moveit::tools::Profiler other;
+    record(&other);
+    moveit::tools::Profiler::Snapshot snapshot;
+    other.getSnapshot(snapshot);
+    const moveit::tools::Profiler::EventStatistics *event = findEvent(snapshot, "test_profiler_event");
+    ASSERT_TRUE(event != NULL);
+    EXPECT_EQ(BLOCKS_PER_THREAD, event->count);
+  }
+}
+
+TEST(Profiler, HistogramBuckets)
+{
+  typedef moveit::tools::Profiler::Histogram Histogram;
+
+  // small intervals are counted exactly
+  for (long long int ns = 0 ; ns < Histogram::SUB_BUCKETS ; ++ns)
+  {
+    EXPECT_EQ(ns, Histogram::bucketLowerBound(Histogram::bucket(ns)));
+    EXPECT_EQ(1, Histogram::bucketWidth(Histogram::bucket(ns)));
+  }
+
+  // every interval falls in its bucket, and buckets are narrower than 1/SUB_BUCKETS of the values they hold
+  std::size_t previous = 0;
+  for (long long int ns = 1 ; ns < (1LL << 50) ; ns += ns / 7 + 1)
+  {
+    std::size_t b = Histogram::bucket(ns);
+    EXPECT_GE(b, previous);
+    previous = b;
+    long long int lower = Histogram::bucketLowerBound(b);
+    long long int width = Histogram::bucketWidth(b);
+    EXPECT_LE(lower, ns);
+    EXPECT_LT(ns, lower + width);
+    if (ns >= Histogram::SUB_BUCKETS)
+    {
+      EXPECT_LE(width * Histogram::SUB_BUCKETS, lower);
+    }
+    // buckets are contiguous
+    EXPECT_EQ(lower + width, Histogram::bucketLowerBound(b + 1));
+  }
+}
+
+TEST(Profiler, HistogramPercentiles)
+{
+  moveit::tools::Profiler::Histogram empty;
+  EXPECT_EQ(0, empty.percentile(0.5));
+
+  // 1000 ns, 2000 ns, ..., 1000000 ns
+  moveit::tools::Profiler::Histogram first, second, all;
+  for (long long int i = 1 ; i <= 1000 ; ++i)
+  {
+    (i % 2 ? first : second).add(i * 1000);
+    all.add(i * 1000);
+  }
+  EXPECT_EQ(1000u, all.count());
+
+  const double quantiles[] = { 0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 0.999, 1.0 };
+  for (std::size_t i = 0 ; i < sizeof(quantiles) / sizeof(quantiles[0]) ; ++i)
+  {
+    double q = quantiles[i];
+    double exact = 1000.0 * std::max(1.0, ceil(q * 1000.0));
+    EXPECT_NEAR(exact, (double)all.percentile(q), exact / moveit::tools::Profiler::Histogram::SUB_BUCKETS) << "quantile " << q;
+  }
+
+  // merging the histograms of two halves gives the histogram of the whole
+  first.merge(second);
+  EXPECT_EQ(all.count(), first.count());
+  for (std::size_t i = 0 ; i < sizeof(quantiles) / sizeof(quantiles[0]) ; ++i)
+    EXPECT_EQ(all.percentile(quantiles[i]), first.percentile(quantiles[i]));
+
+  // quantiles outside [0, 1] are clamped
+  EXPECT_EQ(all.percentile(0.0), all.percentile(-1.0));
+  EXPECT_EQ(all.percentile(1.0), all.percentile(2.0));
+}
+
+TEST(Profiler, SnapshotPercentiles)
+{
+  moveit::tools::Profiler profiler;
+  record(&profiler);
+  moveit::tools::Profiler::Snapshot snapshot;
+  profiler.getSnapshot(snapshot);
+  const moveit::tools::Profiler::BlockStatistics *block = findBlock(snapshot, "test_profiler_block");
+  ASSERT_TRUE(block != NULL);
+  EXPECT_EQ(BLOCKS_PER_THREAD, block->parts);
+  EXPECT_LE(block->shortest, block->p50);
+  EXPECT_LE(block->p50, block->p99);
+  EXPECT_LE(block->p99, block->p999);
+  EXPECT_LE(block->p999, block->longest);
+  EXPECT_NEAR(block->total / block->parts, block->average, 1e-12);
+}
+
+TEST(Profiler, TraceExport)
+{
+  moveit::tools::Profiler profiler;
+  static const moveit::tools::Profiler::Key key("test \"trace\"\\block\x01");
+
+  // without a trace capacity, only the thread tracks are written
+  {
+    moveit::tools::Profiler::ScopedBlock block(key, profiler);
+  }
+  std::stringstream untraced;
+  profiler.writeTrace(untraced);
+  EXPECT_EQ(0u, untraced.str().find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+  EXPECT_EQ(1u, countOccurrences(untraced.str(), "\"ph\":\"M\""));
+  EXPECT_EQ(0u, countOccurrences(untraced.str(), "\"ph\":\"X\""));
+
+  // only the last blocks are kept
+  profiler.setTraceCapacity(3);
+  EXPECT_EQ(3u, profiler.getTraceCapacity());
+  for (std::size_t i = 0 ; i < 5 ; ++i)
+  {
+    moveit::tools::Profiler::ScopedBlock block(key, profiler);
+  }
+  std::stringstream traced;
+  profiler.writeTrace(traced);
+  const std::string json = traced.str();
+  EXPECT_EQ(3u, countOccurrences(json, "\"ph\":\"X\""));
+  EXPECT_EQ(3u, countOccurrences(json, "{\"name\":\"test \\\"trace\\\"\\\\block\\u0001\",\"ph\":\"X\""));
+  // timestamps are relative to the earliest block
+  EXPECT_EQ(1u, countOccurrences(json, "\"ts\":0.000,"));
+  EXPECT_EQ(json.size() - 4, json.rfind("\n]}\n"));
+
+  // blocks of other threads get their own track
+  boost::thread thread(boost::bind(&record, &profiler));
+  thread.join();
+  std::stringstream finished;
+  profiler.writeTrace(finished);
+  EXPECT_EQ(2u, countOccurrences(finished.str(), "\"ph\":\"M\""));
+  EXPECT_EQ(6u, countOccurrences(finished.str(), "\"ph\":\"X\""));
+}
+
+static void count(const moveit::tools::Profiler::Key *key)
+{
+  for (std::size_t i = 0 ; i < BLOCKS_PER_THREAD ; ++i)
+    moveit::tools::Profiler::Count(*key);
+}
+
+TEST(Profiler, Counters)
+{
+  static const moveit::tools::Profiler::Key counter_key("test_profiler_counter");
+  moveit::tools::Profiler::Clear();
+  moveit::tools::Profiler::Snapshot snapshot;
+
+  // counters are disabled by default and record nothing
+  EXPECT_FALSE(moveit::tools::Profiler::CountersEnabled());
+  moveit::tools::Profiler::Count(counter_key);
+  moveit::tools::Profiler::Count(counter_key, 5);
+  moveit::tools::Profiler::Instance().getSnapshot(snapshot);
+  const moveit::tools::Profiler::EventStatistics *event = findEvent(snapshot, "test_profiler_counter");
+  EXPECT_TRUE(event == NULL || event->count == 0);
+
+  // once enabled, they are recorded by the global profiler, from any thread
+  moveit::tools::Profiler::SetCountersEnabled(true);
+  EXPECT_TRUE(moveit::tools::Profiler::CountersEnabled());
+  moveit::tools::Profiler::Count(counter_key);
+  moveit::tools::Profiler::Count(counter_key, 5);
+  boost::thread thread(boost::bind(&count, &counter_key));
+  thread.join();
+  moveit::tools::Profiler::Instance().getSnapshot(snapshot);
+  event = findEvent(snapshot, "test_profiler_counter");
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(6 + BLOCKS_PER_THREAD, event->count);
+
+  // disabling them again stops recording, but keeps what was recorded
+  moveit::tools::Profiler::SetCountersEnabled(false);
+  moveit::tools::Profiler::Count(counter_key, 100);
+  moveit::tools::Profiler::Instance().getSnapshot(snapshot);
+  event = findEvent(snapshot, "test_profiler_counter");
+  ASSERT_TRUE(event != NULL);
+  EXPECT_EQ(6 + BLOCKS_PER_THREAD, event->count);
+
+  moveit::tools::Profiler::Clear();
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -43,6 +43,17 @@
 #include <moveit/profiler/profiler.h>
 #include <boost/bind.hpp>
 
+namespace
+{
+// counters reported by the profiler when enabled (see moveit::tools::Profiler::Count())
+const moveit::tools::Profiler::Key COUNT_LINK_TRANSFORM_UPDATES("RobotState: link transform updates");
+const moveit::tools::Profiler::Key COUNT_LINKS_UPDATED("RobotState: link transforms computed");
+const moveit::tools::Profiler::Key COUNT_COLLISION_BODY_UPDATES("RobotState: collision body transform updates");
+const moveit::tools::Profiler::Key COUNT_COLLISION_BODY_LINKS_UPDATED("RobotState: links with collision bodies updated");
+const moveit::tools::Profiler::Key COUNT_IK_CALLS("RobotState: setFromIK calls");
+const moveit::tools::Profiler::Key COUNT_IK_ATTEMPTS("RobotState: setFromIK attempts");
+}
+
 moveit::core::RobotState::RobotState(const RobotModelConstPtr &robot_model)
   : robot_model_(robot_model)
   , has_velocity_(false)
@@ -447,6 +458,8 @@ void moveit::core::RobotState::updateCollisionBodyTransforms()
   {
     const std::vector<const LinkModel*> &links = dirty_collision_body_transforms_->getDescendantLinkModels();
     dirty_collision_body_transforms_ = NULL; 
+    moveit::tools::Profiler::Count(COUNT_COLLISION_BODY_UPDATES);
+    moveit::tools::Profiler::Count(COUNT_COLLISION_BODY_LINKS_UPDATED, links.size());
 
     for (std::size_t i = 0 ; i < links.size() ; ++i)
     {
@@ -476,6 +489,8 @@ void moveit::core::RobotState::updateLinkTransforms()
 void moveit::core::RobotState::updateLinkTransformsInternal(const JointModel *start)
 {  
   const std::vector<const LinkModel*> &links = start->getDescendantLinkModels();
+  moveit::tools::Profiler::Count(COUNT_LINK_TRANSFORM_UPDATES);
+  moveit::tools::Profiler::Count(COUNT_LINKS_UPDATED, links.size());
   if (!links.empty())
   { 
     const LinkModel *parent = links[0]->getParentLinkModel();
@@ -1457,10 +1472,12 @@ bool moveit::core::RobotState::setFromIK(const JointModelGroup *jmg, const Eigen
   // Bijection
   const std::vector<unsigned int> &bij = jmg->getKinematicsSolverJointBijection();
 
+  moveit::tools::Profiler::Count(COUNT_IK_CALLS);
   bool first_seed = true;
   std::vector<double> initial_values;
   for (unsigned int st = 0 ; st < attempts ; ++st)
   {
+    moveit::tools::Profiler::Count(COUNT_IK_ATTEMPTS);
     std::vector<double> seed(bij.size());
 
     // the first seed is the current robot state joint values
@@ -1645,9 +1662,11 @@ bool moveit::core::RobotState::setFromIKSubgroups(const JointModelGroup *jmg, co
   if (timeout < std::numeric_limits<double>::epsilon())
     timeout = jmg->getDefaultIKTimeout();
 
+  moveit::tools::Profiler::Count(COUNT_IK_CALLS);
   bool first_seed = true;
   for (unsigned int st = 0 ; st < attempts ; ++st)
   {
+    moveit::tools::Profiler::Count(COUNT_IK_ATTEMPTS);
     bool found_solution = true;
     for (std::size_t sg = 0; sg < sub_groups.size(); ++sg)
     {
@@ -36,6 +36,7 @@
 
 #include <moveit/robot_model/robot_model.h>
 #include <moveit/robot_state/robot_state.h>
+#include <moveit/profiler/profiler.h>
 #include <urdf_parser/urdf_parser.h>
 #include <gtest/gtest.h>
 #include <sstream>
@@ -508,6 +509,70 @@ TEST(FK, OneRobot)
     EXPECT_TRUE(state.satisfiesBounds(model->getJointModel("joint_a")));
 }
 
+static std::size_t getProfilerEventCount(const std::string &name)
+{
+    moveit::tools::Profiler::Snapshot snapshot;
+    moveit::tools::Profiler::Instance().getSnapshot(snapshot);
+    for (std::size_t i = 0 ; i < snapshot.events.size() ; ++i)
+        if (snapshot.events[i].name == name)
+            return snapshot.events[i].count;
+    return 0;
+}
+
+TEST(FK, ProfilerCounters)
+{
+    static const std::string MODEL =
+        "<?xml version=\"1.0\" ?>"
+        "<robot name=\"myrobot\">"
+        "  <link name=\"base_link\">"
+        "    <collision>"
+        "    <geometry>"
+        "      <box size=\"0.65 0.65 0.23\"/>"
+        "    </geometry>"
+        "    </collision>"
+        "   </link>"
+        "</robot>";
+
+    static const std::string SMODEL =
+        "<?xml version=\"1.0\" ?>"
+        "<robot name=\"myrobot\">"
+        "<virtual_joint name=\"base_joint\" child_link=\"base_link\" parent_frame=\"odom_combined\" type=\"planar\"/>"
+        "</robot>";
+
+    boost::shared_ptr<urdf::ModelInterface> urdfModel = urdf::parseURDF(MODEL);
+    boost::shared_ptr<srdf::Model> srdfModel(new srdf::Model());
+    srdfModel->initString(*urdfModel, SMODEL);
+    moveit::core::RobotModelPtr model(new moveit::core::RobotModel(urdfModel, srdfModel));
+    moveit::core::RobotState state(model);
+    state.setToDefaultValues();
+    moveit::tools::Profiler::Clear();
+
+    // counters are disabled by default
+    state.update();
+    EXPECT_EQ(0u, getProfilerEventCount("RobotState: link transform updates"));
+    EXPECT_EQ(0u, getProfilerEventCount("RobotState: collision body transform updates"));
+
+    // each update of dirty transforms is counted once enabled
+    moveit::tools::Profiler::SetCountersEnabled(true);
+    state.setVariablePosition("base_joint/x", 1.0);
+    state.updateLinkTransforms();
+    state.updateLinkTransforms();
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: link transform updates"));
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: link transforms computed"));
+    EXPECT_EQ(0u, getProfilerEventCount("RobotState: collision body transform updates"));
+    state.updateCollisionBodyTransforms();
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: collision body transform updates"));
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: links with collision bodies updated"));
+
+    // and not counted once disabled again
+    moveit::tools::Profiler::SetCountersEnabled(false);
+    state.setVariablePosition("base_joint/x", 2.0);
+    state.update();
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: link transform updates"));
+    EXPECT_EQ(1u, getProfilerEventCount("RobotState: collision body transform updates"));
+    moveit::tools::Profiler::Clear();
+}
+
 int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,223 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_ROBOT_TRAJECTORY_COMPACT_ROBOT_TRAJECTORY_
+#define MOVEIT_ROBOT_TRAJECTORY_COMPACT_ROBOT_TRAJECTORY_
+
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <vector>
+
+namespace robot_trajectory
+{
+
+/** \brief A trajectory stored as contiguous arrays of the positions, velocities and
+    accelerations of the variables of one group, plus the durations between waypoints.
+    The values of the variables outside the group are those of a single reference state.
+    Waypoints are stored one after the other (the values of waypoint \e i start at
+    index i * getVariableCount()), in the order of the group variables.
+    Full RobotStates are only constructed when requested. */
+class CompactRobotTrajectory
+{
+public:
+
+  /** \brief Construct an empty trajectory for \e group. If \e group is empty, all the variables of the model are stored.
+      The variables outside the group take their values from \e reference_state. Throws moveit::ConstructException
+      if the model has no group named \e group */
+  CompactRobotTrajectory(const robot_state::RobotState &reference_state, const std::string &group);
+
+  CompactRobotTrajectory(const robot_state::RobotState &reference_state, const robot_model::JointModelGroup *group);
+
+  /** \brief Construct from a RobotTrajectory; the first waypoint is used as reference state */
+  explicit CompactRobotTrajectory(const RobotTrajectory &trajectory);
+
+  const robot_model::RobotModelConstPtr& getRobotModel() const
+  {
+    return reference_state_->getRobotModel();
+  }
+
+  const robot_model::JointModelGroup* getGroup() const
+  {
+    return group_;
+  }
+
+  const std::string& getGroupName() const;
+
+  /** \brief The state that provides the values of the variables outside the group */
+  const robot_state::RobotState& getReferenceState() const
+  {
+    return *reference_state_;
+  }
+
+  void setReferenceState(const robot_state::RobotState &reference_state);
+
+  /** \brief The number of values stored per waypoint */
+  std::size_t getVariableCount() const
+  {
+    return variable_index_.size();
+  }
+
+  std::size_t getWayPointCount() const
+  {
+    return durations_.size();
+  }
+
+  bool empty() const
+  {
+    return durations_.empty();
+  }
+
+  bool hasVelocities() const
+  {
+    return has_velocities_;
+  }
+
+  bool hasAccelerations() const
+  {
+    return has_accelerations_;
+  }
+
+  /** \brief Reserve memory for \e count waypoints */
+  void reserve(std::size_t count);
+
+  /** \brief Add a waypoint. \e velocities and \e accelerations may be NULL; if they are set for one waypoint,
+      all other waypoints have zero velocities (accelerations) unless specified.
+      \param positions The values of the variables, getVariableCount() of them
+      \param dt The duration from the previous waypoint */
+  void addSuffixWayPoint(const double *positions, const double *velocities, const double *accelerations, double dt);
+
+  /** \brief Add a waypoint, copying the values of the stored variables from \e state */
+  void addSuffixWayPoint(const robot_state::RobotState &state, double dt);
+
+  const double* getWayPointPositions(std::size_t index) const
+  {
+    return &positions_[index * getVariableCount()];
+  }
+
+  double* getWayPointPositions(std::size_t index)
+  {
+    return &positions_[index * getVariableCount()];
+  }
+
+  /** \brief Get the velocities of a waypoint. Return NULL if the trajectory has no velocities */
+  const double* getWayPointVelocities(std::size_t index) const
+  {
+    return has_velocities_ ? &velocities_[index * getVariableCount()] : NULL;
+  }
+
+  /** \brief Get the velocities of a waypoint for writing; this marks the trajectory as having velocities */
+  double* getWayPointVelocities(std::size_t index);
+
+  /** \brief Get the accelerations of a waypoint. Return NULL if the trajectory has no accelerations */
+  const double* getWayPointAccelerations(std::size_t index) const
+  {
+    return has_accelerations_ ? &accelerations_[index * getVariableCount()] : NULL;
+  }
+
+  /** \brief Get the accelerations of a waypoint for writing; this marks the trajectory as having accelerations */
+  double* getWayPointAccelerations(std::size_t index);
+
+  /** \brief All positions, waypoint after waypoint */
+  const std::vector<double>& getPositions() const
+  {
+    return positions_;
+  }
+
+  const std::vector<double>& getWayPointDurations() const
+  {
+    return durations_;
+  }
+
+  double getWayPointDurationFromPrevious(std::size_t index) const
+  {
+    return index < durations_.size() ? durations_[index] : 0.0;
+  }
+
+  void setWayPointDurationFromPrevious(std::size_t index, double value)
+  {
+    durations_[index] = value;
+  }
+
+  double getDuration() const;
+
+  /** \brief Fill \e state (a state of the same robot model) with waypoint \e index: the reference state with the stored variables overwritten.
+      The transforms of \e state are updated. */
+  void getWayPoint(std::size_t index, robot_state::RobotState &state) const;
+
+  /** \brief Fill \e state with the trajectory at \e duration from start. The positions of the stored variables are
+      interpolated between the waypoints around that time as in RobotTrajectory::getStateAtDurationFromStart(), and
+      the velocities and accelerations linearly. This takes time linear in the number of waypoints.
+      Return false if the trajectory is empty. */
+  bool getStateAtDurationFromStart(double duration, robot_state::RobotState &state) const;
+
+  /** \brief Construct the full state for waypoint \e index */
+  robot_state::RobotStatePtr createWayPoint(std::size_t index) const;
+
+  /** \brief Construct the full states of all waypoints in \e trajectory */
+  void getRobotTrajectory(RobotTrajectory &trajectory) const;
+
+  /** \brief Replace the content of this trajectory with \e trajectory. The group is the one of \e trajectory
+      and the reference state becomes its first waypoint */
+  void setRobotTrajectory(const RobotTrajectory &trajectory);
+
+  void swap(CompactRobotTrajectory &other);
+
+  void clear();
+
+private:
+
+  void initialize(const robot_model::JointModelGroup *group);
+
+  /** \brief Grow \e values to match the number of waypoints, filling with zeros, and return the values of the last waypoint */
+  double* getLastWayPointValues(std::vector<double> &values, bool &has_values);
+
+  robot_state::RobotStatePtr reference_state_;
+  const robot_model::JointModelGroup *group_;
+
+  /** \brief The index in the full state of each stored variable */
+  std::vector<int> variable_index_;
+
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+  std::vector<double> accelerations_;
+  std::vector<double> durations_;
+  bool has_velocities_;
+  bool has_accelerations_;
+};
+
+typedef boost::shared_ptr<CompactRobotTrajectory> CompactRobotTrajectoryPtr;
+typedef boost::shared_ptr<const CompactRobotTrajectory> CompactRobotTrajectoryConstPtr;
+
+}
+
+#endif
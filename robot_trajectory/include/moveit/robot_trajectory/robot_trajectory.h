@@ -40,6 +40,7 @@
 #include <moveit/robot_state/robot_state.h>
 #include <moveit_msgs/RobotTrajectory.h>
 #include <moveit_msgs/RobotState.h>
+#include <boost/thread/mutex.hpp>
 #include <deque>
 
 namespace robot_trajectory
@@ -54,6 +55,10 @@ public:
 
   RobotTrajectory(const robot_model::RobotModelConstPtr &robot_model, const robot_model::JointModelGroup* group); 
 
+  RobotTrajectory(const RobotTrajectory &other);
+
+  RobotTrajectory& operator=(const RobotTrajectory &other);
+
   const robot_model::RobotModelConstPtr& getRobotModel() const
   {
     return robot_model_;
@@ -114,6 +119,9 @@ public:
    */
   double getWaypointDurationFromStart(std::size_t index) const;
 
+  /** @brief Returns the duration of the whole trajectory (the duration from start of the last waypoint) */
+  double getDuration() const;
+
   double getWayPointDurationFromPrevious(std::size_t index) const
   {
     if (duration_from_previous_.size() > index)
@@ -127,6 +135,7 @@ public:
     if (duration_from_previous_.size() <= index)
       duration_from_previous_.resize(index + 1, 0.0);
     duration_from_previous_[index] = value;
+    invalidateDurationsFromStart(index);
   }
 
   bool empty() const
@@ -166,6 +175,7 @@ public:
     state->update();
     waypoints_.push_front(state);
     duration_from_previous_.push_front(dt);
+    invalidateDurationsFromStart(0);
   }
 
   void insertWayPoint(std::size_t index, const robot_state::RobotState &state, double dt)
@@ -178,6 +188,7 @@ public:
     state->update();
     waypoints_.insert(waypoints_.begin() + index, state);
     duration_from_previous_.insert(duration_from_previous_.begin() + index, dt);
+    invalidateDurationsFromStart(index);
   }
 
   void append(const RobotTrajectory &source, double dt);
@@ -188,6 +199,8 @@ public:
 
   double getAverageSegmentDuration() const;
 
+  /** \brief Convert the trajectory to a message. The memory already allocated for the points of \e trajectory is reused,
+      so converting repeatedly into the same message object does not allocate once the message is large enough. */
   void getRobotTrajectoryMsg(moveit_msgs::RobotTrajectory &trajectory) const;
 
   /** \brief Copy the content of the trajectory message into this class. The trajectory message itself is not required to contain the values
@@ -198,7 +211,8 @@ public:
   
   /** \brief Copy the content of the trajectory message into this class. The trajectory message itself is not required to contain the values
       for all joints. For this reason a full starting state must be specified as reference (\e reference_state). Each point in the trajectory 
-      to be constructed internally is obtained by copying the reference state and overwriting the content from a trajectory point in \e trajectory. */
+      to be constructed internally is obtained by copying the reference state and overwriting the content from a trajectory point in \e trajectory.
+      Multi-DOF joints that are not part of the robot model are reported as errors and skipped. */
   void setRobotTrajectoryMsg(const robot_state::RobotState &reference_state,
                              const moveit_msgs::RobotTrajectory &trajectory);
   
@@ -214,7 +228,8 @@ public:
   void unwind();
   void unwind(const robot_state::RobotState &state);
 
-  /** @brief Finds the waypoint indicies before and after a duration from start.
+  /** @brief Finds the waypoint indicies before and after a duration from start. This is a binary search
+   *  over the cached durations from start, so it takes logarithmic time in the number of waypoints.
    *  @param The duration from start.
    *  @param The waypoint index before the supplied duration.
    *  @param The waypoint index after (or equal to) the supplied duration.
@@ -233,10 +248,37 @@ public:
 
 private:
 
+  /** \brief Implementation of setRobotTrajectoryMsg(); the variable names are resolved once for the whole trajectory.
+      \e mdof_trajectory may be NULL. Multi-DOF joints not known to the model are reported and skipped, so their values
+      are taken from the reference state. Points that do not have a position for every joint are reported and skipped.
+      The waypoints this trajectory held before are reused for the new points when nothing else refers to them */
+  void setRobotTrajectoryMsg(const robot_state::RobotState &reference_state,
+                             const trajectory_msgs::JointTrajectory *trajectory,
+                             const trajectory_msgs::MultiDOFJointTrajectory *mdof_trajectory);
+
+  /** \brief Mark the durations from start of the waypoints from \e index on as out of date */
+  void invalidateDurationsFromStart(std::size_t index)
+  {
+    if (valid_durations_from_start_ > index)
+      valid_durations_from_start_ = index;
+  }
+
+  /** \brief Bring the durations from start up to date and return them. The returned values stay
+      valid until the trajectory is modified */
+  const std::vector<double>& getDurationsFromStart() const;
+
   robot_model::RobotModelConstPtr robot_model_;
   const robot_model::JointModelGroup *group_;
   std::deque<robot_state::RobotStatePtr> waypoints_;
   std::deque<double> duration_from_previous_;
+
+  /** \brief Cache of the running sum of duration_from_previous_. The first valid_durations_from_start_
+      entries are up to date; edits of the trajectory lower that count and lookups recompute the rest. */
+  mutable std::vector<double> durations_from_start_;
+  mutable std::size_t valid_durations_from_start_;
+
+  /** \brief Lookups update the cache, so concurrent lookups on a const trajectory are serialized by this lock */
+  mutable boost::mutex durations_from_start_lock_;
 };
 
 typedef boost::shared_ptr<RobotTrajectory> RobotTrajectoryPtr;
@@ -0,0 +1,232 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_ROBOT_TRAJECTORY_TRAJECTORY_LOG_
+#define MOVEIT_ROBOT_TRAJECTORY_TRAJECTORY_LOG_
+
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/macros/class_forward.h>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/cstdint.hpp>
+#include <cstdio>
+
+namespace robot_trajectory
+{
+
+/** \brief Binary log of trajectories, meant to be memory mapped when read.
+
+    The file starts with a header that identifies the robot model (a hash
+    of its name and variable names), the group and the names of the
+    logged variables. The rest of the file is a sequence of fixed-size
+    records, one per waypoint, in native byte order:
+    \code
+      double time                // seconds; never decreases along the file
+      double duration            // from the previous waypoint of the same trajectory
+      uint32 trajectory          // index of the trajectory in the log
+      uint32 flags               // TrajectoryLogRecordFlags
+      double positions[n]
+      double velocities[n]       // 0 if not available
+      double accelerations[n]    // 0 if not available
+    \endcode
+    Since records have a fixed size and time is monotonic, a reader finds
+    the waypoint at a given time by binary search, without parsing the
+    file. A record that was only partially written (e.g., the process
+    stopped while logging) is ignored. */
+namespace trajectory_log
+{
+/** \brief Flags of a waypoint record */
+enum RecordFlags
+{
+  HAS_VELOCITIES = 1,
+  HAS_ACCELERATIONS = 2,
+  /** \brief The waypoint is the first of its trajectory */
+  TRAJECTORY_START = 4
+};
+
+/** \brief Compute the hash stored in logs to identify \e model */
+boost::uint64_t computeModelHash(const robot_model::RobotModel &model);
+}
+
+MOVEIT_CLASS_FORWARD(TrajectoryLogWriter);
+MOVEIT_CLASS_FORWARD(TrajectoryLogReader);
+
+/** \brief Append trajectories of one group to a log file. Writes are buffered; see flush(). */
+class TrajectoryLogWriter : private boost::noncopyable
+{
+public:
+
+  /** \brief Log the variables of \e group; if \e group is empty, all the variables of the model are logged */
+  TrajectoryLogWriter(const robot_model::RobotModelConstPtr &model, const std::string &group);
+  ~TrajectoryLogWriter();
+
+  /** \brief Open \e filename for writing. If the file exists, it must be a log for the same model, group
+      and variables, and new trajectories are appended to it. Otherwise a new log is created. */
+  bool open(const std::string &filename);
+
+  bool isOpen() const
+  {
+    return file_ != NULL;
+  }
+
+  /** \brief Append the waypoints of \e trajectory, the first one at time \e start_time (e.g., when execution started).
+      \e start_time may not be earlier than the time of the last waypoint already in the log */
+  bool append(const RobotTrajectory &trajectory, double start_time);
+
+  /** \brief Write the buffered records to the file, so they become visible to readers */
+  bool flush();
+
+  void close();
+
+  /** \brief Get the time of the last waypoint written */
+  double getEndTime() const
+  {
+    return end_time_;
+  }
+
+  const std::vector<std::string>& getVariableNames() const
+  {
+    return variable_names_;
+  }
+
+private:
+
+  bool checkHeader(std::FILE *file);
+
+  robot_model::RobotModelConstPtr model_;
+  std::string group_name_;
+  std::vector<std::string> variable_names_;
+  std::vector<int> variable_index_;
+
+  std::FILE *file_;
+  std::vector<char> header_;
+  std::vector<char> record_;
+  boost::uint32_t trajectory_count_;
+  double end_time_;
+};
+
+/** \brief Read a trajectory log by mapping it in memory */
+class TrajectoryLogReader : private boost::noncopyable
+{
+public:
+
+  TrajectoryLogReader();
+  ~TrajectoryLogReader();
+
+  /** \brief Map \e filename in memory and check its header */
+  bool open(const std::string &filename);
+
+  /** \brief Map the file again, to see the records appended since it was opened */
+  bool refresh();
+
+  void close();
+
+  bool isOpen() const
+  {
+    return region_.get() != NULL;
+  }
+
+  boost::uint64_t getModelHash() const
+  {
+    return model_hash_;
+  }
+
+  const std::string& getGroupName() const
+  {
+    return group_name_;
+  }
+
+  const std::vector<std::string>& getVariableNames() const
+  {
+    return variable_names_;
+  }
+
+  /** \brief Get the number of waypoints (records) in the log */
+  std::size_t getWayPointCount() const
+  {
+    return record_count_;
+  }
+
+  double getTime(std::size_t index) const;
+  double getDurationFromPrevious(std::size_t index) const;
+  boost::uint32_t getTrajectoryIndex(std::size_t index) const;
+  boost::uint32_t getFlags(std::size_t index) const;
+
+  /** \brief Get the positions of the logged variables at waypoint \e index; the pointer is valid until the log is closed or refreshed */
+  const double* getPositions(std::size_t index) const;
+
+  /** \brief Get the velocities at waypoint \e index, or NULL if they were not logged */
+  const double* getVelocities(std::size_t index) const;
+
+  /** \brief Get the accelerations at waypoint \e index, or NULL if they were not logged */
+  const double* getAccelerations(std::size_t index) const;
+
+  /** \brief Find the last waypoint at or before \e time (0 if \e time is before the first waypoint). Logarithmic in the number of waypoints */
+  std::size_t findWayPoint(double time) const;
+
+  /** \brief Copy waypoint \e index to the logged variables of \e state */
+  bool getWayPoint(std::size_t index, robot_state::RobotState &state) const;
+
+  /** \brief Extract the waypoints between \e start_time and \e end_time (inclusive) into \e trajectory.
+      The variables that are not logged take their values from \e reference_state.
+      The log must have been written for the model of \e reference_state */
+  bool getRobotTrajectory(const robot_state::RobotState &reference_state, double start_time, double end_time,
+                          RobotTrajectory &trajectory) const;
+
+private:
+
+  const char* getRecord(std::size_t index) const
+  {
+    return data_ + index * record_size_;
+  }
+
+  bool checkModel(const robot_model::RobotModel &model, std::vector<int> &variable_index) const;
+
+  std::string filename_;
+  boost::scoped_ptr<boost::interprocess::file_mapping> mapping_;
+  boost::scoped_ptr<boost::interprocess::mapped_region> region_;
+  const char *data_;
+  std::size_t record_size_;
+  std::size_t record_count_;
+
+  boost::uint64_t model_hash_;
+  std::string group_name_;
+  std::vector<std::string> variable_names_;
+};
+
+}
+
+#endif
@@ -0,0 +1,326 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_trajectory/compact_robot_trajectory.h>
+#include <numeric>
+
+namespace
+{
+robot_state::RobotStatePtr makeReferenceState(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  if (!trajectory.empty())
+    return robot_state::RobotStatePtr(new robot_state::RobotState(trajectory.getFirstWayPoint()));
+  robot_state::RobotStatePtr state(new robot_state::RobotState(trajectory.getRobotModel()));
+  state->setToDefaultValues();
+  return state;
+}
+}
+
+robot_trajectory::CompactRobotTrajectory::CompactRobotTrajectory(const robot_state::RobotState &reference_state, const std::string &group) :
+  reference_state_(new robot_state::RobotState(reference_state))
+{
+  const robot_model::JointModelGroup *jmg = NULL;
+  if (!group.empty() && !(jmg = reference_state.getRobotModel()->getJointModelGroup(group)))
+    throw moveit::ConstructException("Cannot store a trajectory for group '" + group + "', which is not known to model '" +
+                                     reference_state.getRobotModel()->getName() + "'");
+  initialize(jmg);
+}
+
+robot_trajectory::CompactRobotTrajectory::CompactRobotTrajectory(const robot_state::RobotState &reference_state,
+                                                                 const robot_model::JointModelGroup *group) :
+  reference_state_(new robot_state::RobotState(reference_state))
+{
+  initialize(group);
+}
+
+robot_trajectory::CompactRobotTrajectory::CompactRobotTrajectory(const RobotTrajectory &trajectory) :
+  group_(NULL),
+  has_velocities_(false),
+  has_accelerations_(false)
+{
+  setRobotTrajectory(trajectory);
+}
+
+void robot_trajectory::CompactRobotTrajectory::initialize(const robot_model::JointModelGroup *group)
+{
+  group_ = group;
+  has_velocities_ = false;
+  has_accelerations_ = false;
+  if (group_)
+    variable_index_ = group_->getVariableIndexList();
+  else
+  {
+    variable_index_.resize(reference_state_->getVariableCount());
+    for (std::size_t i = 0 ; i < variable_index_.size() ; ++i)
+      variable_index_[i] = i;
+  }
+}
+
+const std::string& robot_trajectory::CompactRobotTrajectory::getGroupName() const
+{
+  if (group_)
+    return group_->getName();
+  static const std::string empty;
+  return empty;
+}
+
+void robot_trajectory::CompactRobotTrajectory::setReferenceState(const robot_state::RobotState &reference_state)
+{
+  reference_state_.reset(new robot_state::RobotState(reference_state));
+}
+
+void robot_trajectory::CompactRobotTrajectory::reserve(std::size_t count)
+{
+  const std::size_t size = count * getVariableCount();
+  positions_.reserve(size);
+  if (has_velocities_)
+    velocities_.reserve(size);
+  if (has_accelerations_)
+    accelerations_.reserve(size);
+  durations_.reserve(count);
+}
+
+double* robot_trajectory::CompactRobotTrajectory::getWayPointVelocities(std::size_t index)
+{
+  if (!has_velocities_)
+  {
+    velocities_.assign(positions_.size(), 0.0);
+    has_velocities_ = true;
+  }
+  return &velocities_[index * getVariableCount()];
+}
+
+double* robot_trajectory::CompactRobotTrajectory::getWayPointAccelerations(std::size_t index)
+{
+  if (!has_accelerations_)
+  {
+    accelerations_.assign(positions_.size(), 0.0);
+    has_accelerations_ = true;
+  }
+  return &accelerations_[index * getVariableCount()];
+}
+
+double* robot_trajectory::CompactRobotTrajectory::getLastWayPointValues(std::vector<double> &values, bool &has_values)
+{
+  if (has_values)
+    values.resize(positions_.size(), 0.0);
+  else
+  {
+    values.assign(positions_.size(), 0.0);
+    has_values = true;
+  }
+  return &values[positions_.size() - getVariableCount()];
+}
+
+void robot_trajectory::CompactRobotTrajectory::addSuffixWayPoint(const double *positions, const double *velocities,
+                                                                 const double *accelerations, double dt)
+{
+  const std::size_t count = getVariableCount();
+  positions_.insert(positions_.end(), positions, positions + count);
+  durations_.push_back(dt);
+  if (velocities || has_velocities_)
+  {
+    double *v = getLastWayPointValues(velocities_, has_velocities_);
+    if (velocities)
+      std::copy(velocities, velocities + count, v);
+  }
+  if (accelerations || has_accelerations_)
+  {
+    double *a = getLastWayPointValues(accelerations_, has_accelerations_);
+    if (accelerations)
+      std::copy(accelerations, accelerations + count, a);
+  }
+}
+
+void robot_trajectory::CompactRobotTrajectory::addSuffixWayPoint(const robot_state::RobotState &state, double dt)
+{
+  const std::size_t count = getVariableCount();
+  const double *positions = state.getVariablePositions();
+  for (std::size_t j = 0 ; j < count ; ++j)
+    positions_.push_back(positions[variable_index_[j]]);
+  durations_.push_back(dt);
+
+  if (state.hasVelocities() || has_velocities_)
+  {
+    double *v = getLastWayPointValues(velocities_, has_velocities_);
+    if (state.hasVelocities())
+    {
+      const double *velocities = state.getVariableVelocities();
+      for (std::size_t j = 0 ; j < count ; ++j)
+        v[j] = velocities[variable_index_[j]];
+    }
+  }
+  if (state.hasAccelerations() || has_accelerations_)
+  {
+    double *a = getLastWayPointValues(accelerations_, has_accelerations_);
+    if (state.hasAccelerations())
+    {
+      const double *accelerations = state.getVariableAccelerations();
+      for (std::size_t j = 0 ; j < count ; ++j)
+        a[j] = accelerations[variable_index_[j]];
+    }
+  }
+}
+
+double robot_trajectory::CompactRobotTrajectory::getDuration() const
+{
+  return std::accumulate(durations_.begin(), durations_.end(), 0.0);
+}
+
+void robot_trajectory::CompactRobotTrajectory::getWayPoint(std::size_t index, robot_state::RobotState &state) const
+{
+  state = *reference_state_;
+  const std::size_t count = getVariableCount();
+  const double *positions = getWayPointPositions(index);
+  if (group_)
+    state.setJointGroupPositions(group_, positions);
+  else
+    state.setVariablePositions(positions);
+  if (has_velocities_)
+  {
+    const double *velocities = getWayPointVelocities(index);
+    double *state_velocities = state.getVariableVelocities();
+    for (std::size_t j = 0 ; j < count ; ++j)
+      state_velocities[variable_index_[j]] = velocities[j];
+  }
+  if (has_accelerations_)
+  {
+    const double *accelerations = getWayPointAccelerations(index);
+    double *state_accelerations = state.getVariableAccelerations();
+    for (std::size_t j = 0 ; j < count ; ++j)
+      state_accelerations[variable_index_[j]] = accelerations[j];
+  }
+  state.update();
+}
+
+bool robot_trajectory::CompactRobotTrajectory::getStateAtDurationFromStart(double duration, robot_state::RobotState &state) const
+{
+  if (durations_.empty())
+    return false;
+
+  // find the first waypoint reached at or after the requested duration, as RobotTrajectory does
+  const std::size_t n = durations_.size();
+  std::size_t after = 0;
+  double time = durations_[0];
+  if (duration >= 0.0)
+    while (after < n && time < duration)
+      if (++after < n)
+        time += durations_[after];
+  if (duration < 0.0 || after == 0 || after == n)
+  {
+    getWayPoint(after == n ? n - 1 : 0, state);
+    return true;
+  }
+
+  const std::size_t before = after - 1;
+  const double blend = (duration - (time - durations_[after])) / durations_[after];
+  const std::size_t count = getVariableCount();
+  std::vector<double> values(count);
+  if (group_)
+    group_->interpolate(getWayPointPositions(before), getWayPointPositions(after), blend, &values[0]);
+  else
+    getRobotModel()->interpolate(getWayPointPositions(before), getWayPointPositions(after), blend, &values[0]);
+
+  state = *reference_state_;
+  if (group_)
+    state.setJointGroupPositions(group_, values);
+  else
+    state.setVariablePositions(values);
+  if (has_velocities_)
+  {
+    const double *a = getWayPointVelocities(before);
+    const double *b = getWayPointVelocities(after);
+    double *state_velocities = state.getVariableVelocities();
+    for (std::size_t j = 0 ; j < count ; ++j)
+      state_velocities[variable_index_[j]] = a[j] + blend * (b[j] - a[j]);
+  }
+  if (has_accelerations_)
+  {
+    const double *a = getWayPointAccelerations(before);
+    const double *b = getWayPointAccelerations(after);
+    double *state_accelerations = state.getVariableAccelerations();
+    for (std::size_t j = 0 ; j < count ; ++j)
+      state_accelerations[variable_index_[j]] = a[j] + blend * (b[j] - a[j]);
+  }
+  state.update();
+  return true;
+}
+
+robot_state::RobotStatePtr robot_trajectory::CompactRobotTrajectory::createWayPoint(std::size_t index) const
+{
+  robot_state::RobotStatePtr state(new robot_state::RobotState(*reference_state_));
+  getWayPoint(index, *state);
+  return state;
+}
+
+void robot_trajectory::CompactRobotTrajectory::getRobotTrajectory(RobotTrajectory &trajectory) const
+{
+  RobotTrajectory result(getRobotModel(), group_);
+  for (std::size_t i = 0 ; i < durations_.size() ; ++i)
+    result.addSuffixWayPoint(createWayPoint(i), durations_[i]);
+  trajectory.swap(result);
+}
+
+void robot_trajectory::CompactRobotTrajectory::setRobotTrajectory(const RobotTrajectory &trajectory)
+{
+  clear();
+  reference_state_ = makeReferenceState(trajectory);
+  initialize(trajectory.getGroup());
+  reserve(trajectory.getWayPointCount());
+  for (std::size_t i = 0 ; i < trajectory.getWayPointCount() ; ++i)
+    addSuffixWayPoint(trajectory.getWayPoint(i), trajectory.getWayPointDurationFromPrevious(i));
+}
+
+void robot_trajectory::CompactRobotTrajectory::swap(CompactRobotTrajectory &other)
+{
+  reference_state_.swap(other.reference_state_);
+  std::swap(group_, other.group_);
+  variable_index_.swap(other.variable_index_);
+  positions_.swap(other.positions_);
+  velocities_.swap(other.velocities_);
+  accelerations_.swap(other.accelerations_);
+  durations_.swap(other.durations_);
+  std::swap(has_velocities_, other.has_velocities_);
+  std::swap(has_accelerations_, other.has_accelerations_);
+}
+
+void robot_trajectory::CompactRobotTrajectory::clear()
+{
+  positions_.clear();
+  velocities_.clear();
+  accelerations_.clear();
+  durations_.clear();
+  has_velocities_ = false;
+  has_accelerations_ = false;
+}
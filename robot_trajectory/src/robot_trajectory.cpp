@@ -39,20 +39,45 @@
 #include <eigen_conversions/eigen_msg.h>
 #include <boost/math/constants/constants.hpp>
 #include <numeric>
+#include <algorithm>
 
 robot_trajectory::RobotTrajectory::RobotTrajectory(const robot_model::RobotModelConstPtr &robot_model, const std::string &group) :
   robot_model_(robot_model),
-  group_(group.empty() ? NULL : robot_model->getJointModelGroup(group))
+  group_(group.empty() ? NULL : robot_model->getJointModelGroup(group)),
+  valid_durations_from_start_(0)
 {
 }
 
 robot_trajectory::RobotTrajectory::RobotTrajectory(const robot_model::RobotModelConstPtr &robot_model, 
                                                    const robot_model::JointModelGroup* group) :
   robot_model_(robot_model),
-  group_(group)
+  group_(group),
+  valid_durations_from_start_(0)
 {
 }
 
+robot_trajectory::RobotTrajectory::RobotTrajectory(const RobotTrajectory &other) :
+  robot_model_(other.robot_model_),
+  group_(other.group_),
+  waypoints_(other.waypoints_),
+  duration_from_previous_(other.duration_from_previous_),
+  valid_durations_from_start_(0)
+{
+}
+
+robot_trajectory::RobotTrajectory& robot_trajectory::RobotTrajectory::operator=(const RobotTrajectory &other)
+{
+  if (this != &other)
+  {
+    robot_model_ = other.robot_model_;
+    group_ = other.group_;
+    waypoints_ = other.waypoints_;
+    duration_from_previous_ = other.duration_from_previous_;
+    invalidateDurationsFromStart(0);
+  }
+  return *this;
+}
+
 void robot_trajectory::RobotTrajectory::setGroupName(const std::string &group_name)
 {
   group_ = robot_model_->getJointModelGroup(group_name);
@@ -80,6 +105,8 @@ void robot_trajectory::RobotTrajectory::swap(robot_trajectory::RobotTrajectory &
   std::swap(group_, other.group_);
   waypoints_.swap(other.waypoints_);
   duration_from_previous_.swap(other.duration_from_previous_);
+  durations_from_start_.swap(other.durations_from_start_);
+  std::swap(valid_durations_from_start_, other.valid_durations_from_start_);
 }
 
 void robot_trajectory::RobotTrajectory::append(const RobotTrajectory &source, double dt)
@@ -89,6 +116,7 @@ void robot_trajectory::RobotTrajectory::append(const RobotTrajectory &source, do
   duration_from_previous_.insert(duration_from_previous_.end(), source.duration_from_previous_.begin(), source.duration_from_previous_.end());
   if (duration_from_previous_.size() > index)
     duration_from_previous_[index] += dt;
+  invalidateDurationsFromStart(index);
 }
 
 void robot_trajectory::RobotTrajectory::reverse()
@@ -100,6 +128,7 @@ void robot_trajectory::RobotTrajectory::reverse()
     std::reverse(duration_from_previous_.begin(), duration_from_previous_.end());
     duration_from_previous_.pop_back();
   }
+  invalidateDurationsFromStart(0);
 }
 
 void robot_trajectory::RobotTrajectory::unwind()
@@ -186,93 +215,103 @@ void robot_trajectory::RobotTrajectory::clear()
 {
   waypoints_.clear();
   duration_from_previous_.clear();
+  invalidateDurationsFromStart(0);
 }
 
-void robot_trajectory::RobotTrajectory::getRobotTrajectoryMsg(moveit_msgs::RobotTrajectory &trajectory) const
+namespace
 {
-  trajectory = moveit_msgs::RobotTrajectory();
-  if (waypoints_.empty())
+
+// Reset the header and size the points of a trajectory message, keeping the memory already allocated for the points
+template<typename JointTrajectoryMsg>
+void resizeJointTrajectoryMsg(JointTrajectoryMsg &trajectory, std::size_t point_count)
+{
+  trajectory.header = std_msgs::Header();
+  trajectory.joint_names.clear();
+  trajectory.points.resize(point_count);
+}
+
+// Copy the values at the variable indices \e index of \e values to \e out, or clear \e out if there are no values
+void copyVariableValues(const double *values, const std::vector<int> &index, std::vector<double> &out)
+{
+  if (!values)
+  {
+    out.clear();
     return;
+  }
+  out.resize(index.size());
+  for (std::size_t j = 0 ; j < index.size() ; ++j)
+    out[j] = values[index[j]];
+}
+
+}
+
+void robot_trajectory::RobotTrajectory::getRobotTrajectoryMsg(moveit_msgs::RobotTrajectory &trajectory) const
+{
+  // the points already in the message are reused, so converting repeatedly into the same message does not allocate
   const std::vector<const robot_model::JointModel*> &jnt = group_ ? group_->getActiveJointModels() : robot_model_->getActiveJointModels();
 
-  std::vector<const robot_model::JointModel*> onedof;
   std::vector<const robot_model::JointModel*> mdof;
-  trajectory.joint_trajectory.joint_names.clear();
-  trajectory.multi_dof_joint_trajectory.joint_names.clear();
-
+  std::vector<int> onedof_index;
+  onedof_index.reserve(jnt.size());
   for (std::size_t i = 0 ; i < jnt.size() ; ++i)
     if (jnt[i]->getVariableCount() == 1)
-    {
-      trajectory.joint_trajectory.joint_names.push_back(jnt[i]->getName());
-      onedof.push_back(jnt[i]);
-    }
+      onedof_index.push_back(jnt[i]->getFirstVariableIndex());
     else
-    {
-      trajectory.multi_dof_joint_trajectory.joint_names.push_back(jnt[i]->getName());
       mdof.push_back(jnt[i]);
-    }
-  if (!onedof.empty())
+
+  const std::size_t point_count = waypoints_.size();
+  resizeJointTrajectoryMsg(trajectory.joint_trajectory, onedof_index.empty() ? 0 : point_count);
+  resizeJointTrajectoryMsg(trajectory.multi_dof_joint_trajectory, mdof.empty() ? 0 : point_count);
+  if (point_count == 0)
+    return;
+
+  if (!onedof_index.empty())
   {
     trajectory.joint_trajectory.header.frame_id = robot_model_->getModelFrame();
     trajectory.joint_trajectory.header.stamp = ros::Time(0);
-    trajectory.joint_trajectory.points.resize(waypoints_.size());
+    trajectory.joint_trajectory.joint_names.reserve(onedof_index.size());
+    for (std::size_t i = 0 ; i < jnt.size() ; ++i)
+      if (jnt[i]->getVariableCount() == 1)
+        trajectory.joint_trajectory.joint_names.push_back(jnt[i]->getName());
   }
 
   if (!mdof.empty())
   {
     trajectory.multi_dof_joint_trajectory.header.frame_id = robot_model_->getModelFrame();
     trajectory.multi_dof_joint_trajectory.header.stamp = ros::Time(0);
-    trajectory.multi_dof_joint_trajectory.points.resize(waypoints_.size());
+    trajectory.multi_dof_joint_trajectory.joint_names.reserve(mdof.size());
+    for (std::size_t j = 0 ; j < mdof.size() ; ++j)
+      trajectory.multi_dof_joint_trajectory.joint_names.push_back(mdof[j]->getName());
   }
 
   static const ros::Duration zero_duration(0.0);
   double total_time = 0.0;
-  for (std::size_t i = 0 ; i < waypoints_.size() ; ++i)
+  for (std::size_t i = 0 ; i < point_count ; ++i)
   {
+    const robot_state::RobotState &waypoint = *waypoints_[i];
     if (duration_from_previous_.size() > i)
       total_time += duration_from_previous_[i];
+    const ros::Duration time_from_start = duration_from_previous_.size() > i ? ros::Duration(total_time) : zero_duration;
 
-    if (!onedof.empty())
+    if (!onedof_index.empty())
     {
-      trajectory.joint_trajectory.points[i].positions.resize(onedof.size());
-      trajectory.joint_trajectory.points[i].velocities.reserve(onedof.size());
-
-      for (std::size_t j = 0 ; j < onedof.size() ; ++j)
-      {
-        trajectory.joint_trajectory.points[i].positions[j] = waypoints_[i]->getVariablePosition(onedof[j]->getFirstVariableIndex());
-        // if we have velocities/accelerations/effort, copy those too
-        if (waypoints_[i]->hasVelocities())
-          trajectory.joint_trajectory.points[i].velocities.push_back(waypoints_[i]->getVariableVelocity(onedof[j]->getFirstVariableIndex()));
-        if (waypoints_[i]->hasAccelerations())
-          trajectory.joint_trajectory.points[i].accelerations.push_back(waypoints_[i]->getVariableAcceleration(onedof[j]->getFirstVariableIndex()));
-        if (waypoints_[i]->hasEffort())
-          trajectory.joint_trajectory.points[i].effort.push_back(waypoints_[i]->getVariableEffort(onedof[j]->getFirstVariableIndex()));
-      }
-      // clear velocities if we have an incomplete specification
-      if (trajectory.joint_trajectory.points[i].velocities.size() != onedof.size())
-        trajectory.joint_trajectory.points[i].velocities.clear();
-      // clear accelerations if we have an incomplete specification
-      if (trajectory.joint_trajectory.points[i].accelerations.size() != onedof.size())
-        trajectory.joint_trajectory.points[i].accelerations.clear();
-      // clear effort if we have an incomplete specification
-      if (trajectory.joint_trajectory.points[i].effort.size() != onedof.size())
-        trajectory.joint_trajectory.points[i].effort.clear();
-
-      if (duration_from_previous_.size() > i)
-        trajectory.joint_trajectory.points[i].time_from_start = ros::Duration(total_time);
-      else
-        trajectory.joint_trajectory.points[i].time_from_start = zero_duration;
+      trajectory_msgs::JointTrajectoryPoint &point = trajectory.joint_trajectory.points[i];
+      // velocities, accelerations and effort are only copied if the waypoint has them
+      copyVariableValues(waypoint.getVariablePositions(), onedof_index, point.positions);
+      copyVariableValues(waypoint.hasVelocities() ? waypoint.getVariableVelocities() : NULL, onedof_index, point.velocities);
+      copyVariableValues(waypoint.hasAccelerations() ? waypoint.getVariableAccelerations() : NULL, onedof_index, point.accelerations);
+      copyVariableValues(waypoint.hasEffort() ? waypoint.getVariableEffort() : NULL, onedof_index, point.effort);
+      point.time_from_start = time_from_start;
     }
     if (!mdof.empty())
     {
-      trajectory.multi_dof_joint_trajectory.points[i].transforms.resize(mdof.size());
+      trajectory_msgs::MultiDOFJointTrajectoryPoint &point = trajectory.multi_dof_joint_trajectory.points[i];
+      point.transforms.resize(mdof.size());
       for (std::size_t j = 0 ; j < mdof.size() ; ++j)
-        tf::transformEigenToMsg(waypoints_[i]->getJointTransform(mdof[j]),
-                                trajectory.multi_dof_joint_trajectory.points[i].transforms[j]);
-      if (duration_from_previous_.size() > i)
-        trajectory.multi_dof_joint_trajectory.points[i].time_from_start = ros::Duration(total_time);
-      else
-        trajectory.multi_dof_joint_trajectory.points[i].time_from_start = zero_duration;
+        tf::transformEigenToMsg(waypoints_[i]->getJointTransform(mdof[j]), point.transforms[j]);
+      point.velocities.clear();
+      point.accelerations.clear();
+      point.time_from_start = time_from_start;
     }
   }
 }
@@ -280,67 +319,122 @@ void robot_trajectory::RobotTrajectory::getRobotTrajectoryMsg(moveit_msgs::Robot
 void robot_trajectory::RobotTrajectory::setRobotTrajectoryMsg(const robot_state::RobotState &reference_state,
                                                               const trajectory_msgs::JointTrajectory &trajectory)
 {
-  // make a copy just in case the next clear() removes the memory for the reference passed in
-  robot_state::RobotState copy = reference_state;
-  clear();
-  std::size_t state_count = trajectory.points.size();
-  ros::Time last_time_stamp = trajectory.header.stamp;
-  ros::Time this_time_stamp = last_time_stamp;
-  
-  for (std::size_t i = 0 ; i < state_count ; ++i)
-  {
-    this_time_stamp = trajectory.header.stamp + trajectory.points[i].time_from_start;
-    robot_state::RobotStatePtr st(new robot_state::RobotState(copy));
-    st->setVariablePositions(trajectory.joint_names, trajectory.points[i].positions);
-    if (!trajectory.points[i].velocities.empty())
-      st->setVariableVelocities(trajectory.joint_names, trajectory.points[i].velocities);
-    if (!trajectory.points[i].accelerations.empty())
-      st->setVariableAccelerations(trajectory.joint_names, trajectory.points[i].accelerations);
-    if (!trajectory.points[i].effort.empty())
-      st->setVariableEffort(trajectory.joint_names, trajectory.points[i].effort);
-    addSuffixWayPoint(st, (this_time_stamp - last_time_stamp).toSec());
-    last_time_stamp = this_time_stamp;
-  }
+  setRobotTrajectoryMsg(reference_state, &trajectory, NULL);
 }
 
 void robot_trajectory::RobotTrajectory::setRobotTrajectoryMsg(const robot_state::RobotState &reference_state,
                                                               const moveit_msgs::RobotTrajectory &trajectory)
+{
+  setRobotTrajectoryMsg(reference_state, &trajectory.joint_trajectory, &trajectory.multi_dof_joint_trajectory);
+}
+
+void robot_trajectory::RobotTrajectory::setRobotTrajectoryMsg(const robot_state::RobotState &reference_state,
+                                                              const trajectory_msgs::JointTrajectory *trajectory,
+                                                              const trajectory_msgs::MultiDOFJointTrajectory *mdof_trajectory)
 {
   // make a copy just in case the next clear() removes the memory for the reference passed in
   robot_state::RobotState copy = reference_state;
+  // the waypoints that are not referenced anywhere else are reused for the new points
+  std::deque<robot_state::RobotStatePtr> previous_waypoints;
+  previous_waypoints.swap(waypoints_);
   clear();
-  
-  std::size_t state_count = std::max(trajectory.joint_trajectory.points.size(),
-                                     trajectory.multi_dof_joint_trajectory.points.size());
-  ros::Time last_time_stamp = trajectory.joint_trajectory.points.empty() ?
-    trajectory.multi_dof_joint_trajectory.header.stamp : trajectory.joint_trajectory.header.stamp;
+
+  // resolve the names once for the whole trajectory
+  std::vector<int> index(trajectory->joint_names.size());
+  for (std::size_t j = 0 ; j < index.size() ; ++j)
+    index[j] = robot_model_->getVariableIndex(trajectory->joint_names[j]);
+  const std::size_t mdof_count = mdof_trajectory ? mdof_trajectory->joint_names.size() : 0;
+  std::vector<const robot_model::JointModel*> mdof(mdof_count);
+  for (std::size_t j = 0 ; j < mdof_count ; ++j)
+    if (!(mdof[j] = robot_model_->getJointModel(mdof_trajectory->joint_names[j])))
+      logError("Joint '%s' in the multi-DOF trajectory is not known to model '%s'; its values are ignored",
+               mdof_trajectory->joint_names[j].c_str(), robot_model_->getName().c_str());
+
+  const std::size_t point_count = trajectory->points.size();
+  const std::size_t mdof_point_count = mdof_trajectory ? mdof_trajectory->points.size() : 0;
+  const std::size_t state_count = std::max(point_count, mdof_point_count);
+  ros::Time last_time_stamp = point_count == 0 && mdof_trajectory ? mdof_trajectory->header.stamp : trajectory->header.stamp;
   ros::Time this_time_stamp = last_time_stamp;
-  
+
+  std::size_t reused = 0;
   for (std::size_t i = 0 ; i < state_count ; ++i)
   {
-    robot_state::RobotStatePtr st(new robot_state::RobotState(copy));
-    if (trajectory.joint_trajectory.points.size() > i)
+    // points without a value for every joint are skipped; their duration is added to the next point
+    if (point_count > i && trajectory->points[i].positions.size() != index.size())
+    {
+      logError("Point %u of the trajectory has %u positions for %u joints; it is skipped", (unsigned int)i,
+               (unsigned int)trajectory->points[i].positions.size(), (unsigned int)index.size());
+      continue;
+    }
+    if (mdof_point_count > i && mdof_trajectory->points[i].transforms.size() != mdof_count)
     {
-      st->setVariablePositions(trajectory.joint_trajectory.joint_names, trajectory.joint_trajectory.points[i].positions);
-      if (!trajectory.joint_trajectory.points[i].velocities.empty())
-        st->setVariableVelocities(trajectory.joint_trajectory.joint_names, trajectory.joint_trajectory.points[i].velocities);
-      if (!trajectory.joint_trajectory.points[i].accelerations.empty())
-        st->setVariableAccelerations(trajectory.joint_trajectory.joint_names, trajectory.joint_trajectory.points[i].accelerations);
-      if (!trajectory.joint_trajectory.points[i].effort.empty())
-        st->setVariableEffort(trajectory.joint_trajectory.joint_names, trajectory.joint_trajectory.points[i].effort);
-      this_time_stamp = trajectory.joint_trajectory.header.stamp + trajectory.joint_trajectory.points[i].time_from_start;
+      logError("Point %u of the multi-DOF trajectory has %u transforms for %u joints; it is skipped", (unsigned int)i,
+               (unsigned int)mdof_trajectory->points[i].transforms.size(), (unsigned int)mdof_count);
+      continue;
+    }
+
+    robot_state::RobotStatePtr st;
+    while (!st && reused < previous_waypoints.size())
+    {
+      robot_state::RobotStatePtr &candidate = previous_waypoints[reused++];
+      if (candidate.unique() && candidate->getRobotModel() == copy.getRobotModel())
+      {
+        st.swap(candidate);
+        *st = copy;
+      }
+    }
+    if (!st)
+      st.reset(new robot_state::RobotState(copy));
+
+    if (point_count > i)
+    {
+      const trajectory_msgs::JointTrajectoryPoint &point = trajectory->points[i];
+      for (std::size_t j = 0 ; j < index.size() ; ++j)
+        st->setVariablePosition(index[j], point.positions[j]);
+      // velocities, accelerations and effort are optional, but must be given for every joint if they are given at all
+      if (point.velocities.size() == index.size())
+      {
+        double *velocities = st->getVariableVelocities();
+        for (std::size_t j = 0 ; j < index.size() ; ++j)
+          velocities[index[j]] = point.velocities[j];
+      }
+      else if (!point.velocities.empty())
+        logError("Point %u of the trajectory has %u velocities for %u joints; they are ignored", (unsigned int)i,
+                 (unsigned int)point.velocities.size(), (unsigned int)index.size());
+      if (point.accelerations.size() == index.size())
+      {
+        double *accelerations = st->getVariableAccelerations();
+        for (std::size_t j = 0 ; j < index.size() ; ++j)
+          accelerations[index[j]] = point.accelerations[j];
+      }
+      else if (!point.accelerations.empty())
+        logError("Point %u of the trajectory has %u accelerations for %u joints; they are ignored", (unsigned int)i,
+                 (unsigned int)point.accelerations.size(), (unsigned int)index.size());
+      if (point.effort.size() == index.size())
+      {
+        double *effort = st->getVariableEffort();
+        for (std::size_t j = 0 ; j < index.size() ; ++j)
+          effort[index[j]] = point.effort[j];
+      }
+      else if (!point.effort.empty())
+        logError("Point %u of the trajectory has %u effort values for %u joints; they are ignored", (unsigned int)i,
+                 (unsigned int)point.effort.size(), (unsigned int)index.size());
+      this_time_stamp = trajectory->header.stamp + point.time_from_start;
     }
-    if (trajectory.multi_dof_joint_trajectory.points.size() > i)
+    if (mdof_point_count > i)
     {
-      for (std::size_t j = 0 ; j < trajectory.multi_dof_joint_trajectory.joint_names.size() ; ++j)
+      const trajectory_msgs::MultiDOFJointTrajectoryPoint &point = mdof_trajectory->points[i];
+      for (std::size_t j = 0 ; j < mdof_count ; ++j)
       {
+        if (!mdof[j])
+          continue;
         Eigen::Affine3d t;
-        tf::transformMsgToEigen(trajectory.multi_dof_joint_trajectory.points[i].transforms[j], t);
-        st->setJointPositions(trajectory.multi_dof_joint_trajectory.joint_names[j], t);
+        tf::transformMsgToEigen(point.transforms[j], t);
+        st->setJointPositions(mdof[j], t);
       }
-      this_time_stamp = trajectory.multi_dof_joint_trajectory.header.stamp + trajectory.multi_dof_joint_trajectory.points[i].time_from_start;
+      this_time_stamp = mdof_trajectory->header.stamp + point.time_from_start;
     }
-    
+
     addSuffixWayPoint(st, (this_time_stamp - last_time_stamp).toSec());
     last_time_stamp = this_time_stamp;
   }
@@ -354,6 +448,24 @@ void robot_trajectory::RobotTrajectory::setRobotTrajectoryMsg(const robot_state:
   setRobotTrajectoryMsg(st, trajectory);
 }
 
+const std::vector<double>& robot_trajectory::RobotTrajectory::getDurationsFromStart() const
+{
+  boost::mutex::scoped_lock slock(durations_from_start_lock_);
+  const std::size_t count = duration_from_previous_.size();
+  if (valid_durations_from_start_ < count || durations_from_start_.size() != count)
+  {
+    durations_from_start_.resize(count);
+    double time = valid_durations_from_start_ > 0 ? durations_from_start_[valid_durations_from_start_ - 1] : 0.0;
+    for (std::size_t i = valid_durations_from_start_ ; i < count ; ++i)
+    {
+      time += duration_from_previous_[i];
+      durations_from_start_[i] = time;
+    }
+    valid_durations_from_start_ = count;
+  }
+  return durations_from_start_;
+}
+
 void robot_trajectory::RobotTrajectory::findWayPointIndicesForDurationAfterStart(const double& duration, int& before, int& after, double &blend) const
 {
   if (duration < 0.0)
@@ -364,24 +476,22 @@ void robot_trajectory::RobotTrajectory::findWayPointIndicesForDurationAfterStart
     return;
   }
 
-  // Find indicies
-  std::size_t index = 0, num_points = waypoints_.size();
-  double running_duration = 0.0;
-  for ( ; index < num_points; ++index)
-  {
-    running_duration += duration_from_previous_[index];
-    if (running_duration >= duration)
-      break;
-  }
+  // Find the first waypoint reached at or after the requested duration
+  const std::vector<double> &durations_from_start = getDurationsFromStart();
+  std::size_t num_points = std::min(waypoints_.size(), durations_from_start.size());
+  std::size_t index = std::lower_bound(durations_from_start.begin(), durations_from_start.begin() + num_points, duration)
+    - durations_from_start.begin();
   before = std::max<int>(index - 1, 0);
   after = std::min<int>(index, num_points - 1);
 
   // Compute duration blend
-  double before_time = running_duration - duration_from_previous_[index];
   if (after == before)
     blend = 1.0;
   else
+  {
+    double before_time = durations_from_start[index] - duration_from_previous_[index];
     blend = (duration - before_time) / duration_from_previous_[index];
+  }
 }
 
 double robot_trajectory::RobotTrajectory::getWaypointDurationFromStart(std::size_t index) const
@@ -390,11 +500,14 @@ double robot_trajectory::RobotTrajectory::getWaypointDurationFromStart(std::size
     return 0.0;
   if (index >= duration_from_previous_.size())
     index = duration_from_previous_.size() - 1;
-  
-  double time = 0.0;
-  for (std::size_t i = 0; i <= index; ++i)
-    time += duration_from_previous_[i];
-  return time;
+  return getDurationsFromStart()[index];
+}
+
+double robot_trajectory::RobotTrajectory::getDuration() const
+{
+  if (duration_from_previous_.empty())
+    return 0.0;
+  return getDurationsFromStart().back();
 }
 
 bool robot_trajectory::RobotTrajectory::getStateAtDurationFromStart(const double request_duration, robot_state::RobotStatePtr& output_state) const
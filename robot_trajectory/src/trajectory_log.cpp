@@ -0,0 +1,503 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_trajectory/trajectory_log.h>
+#include <console_bridge/console.h>
+#include <boost/interprocess/exceptions.hpp>
+#include <cstring>
+
+namespace robot_trajectory
+{
+
+namespace
+{
+
+const char LOG_MAGIC[8] = { 'M', 'V', 'T', 'R', 'J', 'L', 'O', 'G' };
+const boost::uint32_t LOG_BYTE_ORDER = 0x01020304;
+const boost::uint32_t LOG_VERSION = 1;
+
+// time, duration, trajectory index and flags
+const std::size_t RECORD_HEADER_SIZE = 2 * sizeof(double) + 2 * sizeof(boost::uint32_t);
+
+std::size_t getRecordSize(std::size_t variable_count)
+{
+  return RECORD_HEADER_SIZE + 3 * variable_count * sizeof(double);
+}
+
+template<typename T>
+void write(std::vector<char> &buffer, const T &value)
+{
+  const char *bytes = reinterpret_cast<const char*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void writeString(std::vector<char> &buffer, const std::string &value)
+{
+  write(buffer, (boost::uint32_t)value.size());
+  buffer.insert(buffer.end(), value.begin(), value.end());
+}
+
+// Sequential reads from the header; every read checks that the data is within bounds
+class HeaderParser
+{
+public:
+
+  HeaderParser(const char *data, std::size_t size) : data_(data), size_(size), offset_(0)
+  {
+  }
+
+  template<typename T>
+  bool read(T &value)
+  {
+    if (offset_ + sizeof(T) > size_)
+      return false;
+    memcpy(&value, data_ + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool readString(std::string &value)
+  {
+    boost::uint32_t length;
+    if (!read(length) || offset_ + length > size_)
+      return false;
+    value.assign(data_ + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+private:
+
+  const char *data_;
+  std::size_t size_;
+  std::size_t offset_;
+};
+
+}
+
+boost::uint64_t trajectory_log::computeModelHash(const robot_model::RobotModel &model)
+{
+  // 64 bit FNV-1a of the model name and the variable names, each followed by a 0
+  boost::uint64_t hash = 14695981039346656037ULL;
+  const std::vector<std::string> &names = model.getVariableNames();
+  for (std::size_t i = 0 ; i <= names.size() ; ++i)
+  {
+    const std::string &name = i == 0 ? model.getName() : names[i - 1];
+    for (std::size_t k = 0 ; k <= name.size() ; ++k)
+    {
+      hash ^= (unsigned char)(k < name.size() ? name[k] : 0);
+      hash *= 1099511628211ULL;
+    }
+  }
+  return hash;
+}
+
+TrajectoryLogWriter::TrajectoryLogWriter(const robot_model::RobotModelConstPtr &model, const std::string &group)
+  : model_(model)
+  , group_name_(group)
+  , file_(NULL)
+  , trajectory_count_(0)
+  , end_time_(0.0)
+{
+  if (group.empty())
+  {
+    variable_names_ = model_->getVariableNames();
+    variable_index_.resize(variable_names_.size());
+    for (std::size_t i = 0 ; i < variable_index_.size() ; ++i)
+      variable_index_[i] = i;
+  }
+  else
+  {
+    const robot_model::JointModelGroup *jmg = model_->getJointModelGroup(group);
+    if (jmg)
+    {
+      variable_names_ = jmg->getVariableNames();
+      variable_index_ = jmg->getVariableIndexList();
+    }
+    else
+      logError("Unable to log trajectories for unknown group '%s'", group.c_str());
+  }
+
+  // the header is padded so the records that follow it are aligned
+  write(header_, LOG_MAGIC);
+  write(header_, LOG_BYTE_ORDER);
+  write(header_, LOG_VERSION);
+  write(header_, trajectory_log::computeModelHash(*model_));
+  const std::size_t header_size_offset = header_.size();
+  write(header_, (boost::uint32_t)0);
+  write(header_, (boost::uint32_t)variable_names_.size());
+  writeString(header_, group_name_);
+  for (std::size_t i = 0 ; i < variable_names_.size() ; ++i)
+    writeString(header_, variable_names_[i]);
+  header_.resize((header_.size() + sizeof(double) - 1) / sizeof(double) * sizeof(double), 0);
+  const boost::uint32_t header_size = header_.size();
+  memcpy(&header_[header_size_offset], &header_size, sizeof(header_size));
+
+  record_.resize(getRecordSize(variable_names_.size()));
+}
+
+TrajectoryLogWriter::~TrajectoryLogWriter()
+{
+  close();
+}
+
+bool TrajectoryLogWriter::checkHeader(std::FILE *file)
+{
+  std::vector<char> header(header_.size());
+  if (fread(&header[0], 1, header.size(), file) != header.size() || header != header_)
+    return false;
+
+  // continue after the last complete record
+  if (fseek(file, 0, SEEK_END) != 0)
+    return false;
+  const long size = ftell(file);
+  const std::size_t record_count = (size - header_.size()) / record_.size();
+  if (record_count > 0)
+  {
+    if (fseek(file, header_.size() + (record_count - 1) * record_.size(), SEEK_SET) != 0 ||
+        fread(&record_[0], 1, record_.size(), file) != record_.size())
+      return false;
+    memcpy(&end_time_, &record_[0], sizeof(double));
+    memcpy(&trajectory_count_, &record_[2 * sizeof(double)], sizeof(boost::uint32_t));
+    ++trajectory_count_;
+  }
+  return fseek(file, header_.size() + record_count * record_.size(), SEEK_SET) == 0;
+}
+
+bool TrajectoryLogWriter::open(const std::string &filename)
+{
+  close();
+  if (variable_names_.empty())
+  {
+    logError("No variables to log");
+    return false;
+  }
+  trajectory_count_ = 0;
+  end_time_ = 0.0;
+
+  std::FILE *file = fopen(filename.c_str(), "r+b");
+  if (file)
+  {
+    if (!checkHeader(file))
+    {
+      logError("File '%s' is not a trajectory log for the same robot model, group and variables", filename.c_str());
+      fclose(file);
+      return false;
+    }
+  }
+  else
+  {
+    file = fopen(filename.c_str(), "w+b");
+    if (!file || fwrite(&header_[0], 1, header_.size(), file) != header_.size())
+    {
+      logError("Unable to create trajectory log '%s'", filename.c_str());
+      if (file)
+        fclose(file);
+      return false;
+    }
+  }
+  file_ = file;
+  return true;
+}
+
+bool TrajectoryLogWriter::append(const RobotTrajectory &trajectory, double start_time)
+{
+  if (!file_)
+  {
+    logError("Trajectory log is not open");
+    return false;
+  }
+  if (trajectory_count_ > 0 && start_time < end_time_)
+  {
+    logError("Trajectories need to be logged in chronological order (start time %lf is before %lf)", start_time, end_time_);
+    return false;
+  }
+
+  const std::size_t n = variable_index_.size();
+  double *values = reinterpret_cast<double*>(&record_[RECORD_HEADER_SIZE]);
+  double time = start_time;
+  for (std::size_t i = 0 ; i < trajectory.getWayPointCount() ; ++i)
+  {
+    const robot_state::RobotState &waypoint = trajectory.getWayPoint(i);
+    const double duration = i > 0 ? trajectory.getWayPointDurationFromPrevious(i) : 0.0;
+    time += duration;
+    boost::uint32_t flags = i == 0 ? trajectory_log::TRAJECTORY_START : 0;
+
+    const double *positions = waypoint.getVariablePositions();
+    for (std::size_t j = 0 ; j < n ; ++j)
+      values[j] = positions[variable_index_[j]];
+    if (waypoint.hasVelocities())
+    {
+      flags |= trajectory_log::HAS_VELOCITIES;
+      const double *velocities = waypoint.getVariableVelocities();
+      for (std::size_t j = 0 ; j < n ; ++j)
+        values[n + j] = velocities[variable_index_[j]];
+    }
+    else
+      std::fill(values + n, values + 2 * n, 0.0);
+    if (waypoint.hasAccelerations())
+    {
+      flags |= trajectory_log::HAS_ACCELERATIONS;
+      const double *accelerations = waypoint.getVariableAccelerations();
+      for (std::size_t j = 0 ; j < n ; ++j)
+        values[2 * n + j] = accelerations[variable_index_[j]];
+    }
+    else
+      std::fill(values + 2 * n, values + 3 * n, 0.0);
+
+    memcpy(&record_[0], &time, sizeof(double));
+    memcpy(&record_[sizeof(double)], &duration, sizeof(double));
+    memcpy(&record_[2 * sizeof(double)], &trajectory_count_, sizeof(boost::uint32_t));
+    memcpy(&record_[2 * sizeof(double) + sizeof(boost::uint32_t)], &flags, sizeof(boost::uint32_t));
+    if (fwrite(&record_[0], 1, record_.size(), file_) != record_.size())
+    {
+      logError("Unable to write to trajectory log");
+      return false;
+    }
+  }
+  end_time_ = time;
+  ++trajectory_count_;
+  return true;
+}
+
+bool TrajectoryLogWriter::flush()
+{
+  return file_ && fflush(file_) == 0;
+}
+
+void TrajectoryLogWriter::close()
+{
+  if (file_)
+  {
+    fclose(file_);
+    file_ = NULL;
+  }
+}
+
+TrajectoryLogReader::TrajectoryLogReader()
+  : data_(NULL)
+  , record_size_(0)
+  , record_count_(0)
+  , model_hash_(0)
+{
+}
+
+TrajectoryLogReader::~TrajectoryLogReader()
+{
+  close();
+}
+
+void TrajectoryLogReader::close()
+{
+  region_.reset();
+  mapping_.reset();
+  data_ = NULL;
+  record_size_ = 0;
+  record_count_ = 0;
+}
+
+bool TrajectoryLogReader::open(const std::string &filename)
+{
+  close();
+  filename_ = filename;
+  const char *base;
+  std::size_t size;
+  try
+  {
+    mapping_.reset(new boost::interprocess::file_mapping(filename.c_str(), boost::interprocess::read_only));
+    region_.reset(new boost::interprocess::mapped_region(*mapping_, boost::interprocess::read_only));
+    base = static_cast<const char*>(region_->get_address());
+    size = region_->get_size();
+  }
+  catch (boost::interprocess::interprocess_exception &ex)
+  {
+    logError("Unable to map trajectory log '%s': %s", filename.c_str(), ex.what());
+    close();
+    return false;
+  }
+
+  HeaderParser parser(base, size);
+  char magic[sizeof(LOG_MAGIC)];
+  boost::uint32_t byte_order, version, header_size, variable_count;
+  if (!parser.read(magic) || memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 ||
+      !parser.read(byte_order) || byte_order != LOG_BYTE_ORDER ||
+      !parser.read(version) || version != LOG_VERSION)
+  {
+    logError("File '%s' is not a trajectory log written by this version on this architecture", filename.c_str());
+    close();
+    return false;
+  }
+  bool ok = parser.read(model_hash_) && parser.read(header_size) && parser.read(variable_count) &&
+    parser.readString(group_name_) && header_size <= size;
+  variable_names_.resize(ok ? variable_count : 0);
+  for (std::size_t i = 0 ; ok && i < variable_names_.size() ; ++i)
+    ok = parser.readString(variable_names_[i]);
+  if (!ok)
+  {
+    logError("The header of trajectory log '%s' is corrupt", filename.c_str());
+    close();
+    return false;
+  }
+
+  data_ = base + header_size;
+  record_size_ = getRecordSize(variable_names_.size());
+  record_count_ = (size - header_size) / record_size_;
+  return true;
+}
+
+bool TrajectoryLogReader::refresh()
+{
+  const std::string filename = filename_;
+  return open(filename);
+}
+
+double TrajectoryLogReader::getTime(std::size_t index) const
+{
+  return *reinterpret_cast<const double*>(getRecord(index));
+}
+
+double TrajectoryLogReader::getDurationFromPrevious(std::size_t index) const
+{
+  return *reinterpret_cast<const double*>(getRecord(index) + sizeof(double));
+}
+
+boost::uint32_t TrajectoryLogReader::getTrajectoryIndex(std::size_t index) const
+{
+  return *reinterpret_cast<const boost::uint32_t*>(getRecord(index) + 2 * sizeof(double));
+}
+
+boost::uint32_t TrajectoryLogReader::getFlags(std::size_t index) const
+{
+  return *reinterpret_cast<const boost::uint32_t*>(getRecord(index) + 2 * sizeof(double) + sizeof(boost::uint32_t));
+}
+
+const double* TrajectoryLogReader::getPositions(std::size_t index) const
+{
+  return reinterpret_cast<const double*>(getRecord(index) + RECORD_HEADER_SIZE);
+}
+
+const double* TrajectoryLogReader::getVelocities(std::size_t index) const
+{
+  return getFlags(index) & trajectory_log::HAS_VELOCITIES ? getPositions(index) + variable_names_.size() : NULL;
+}
+
+const double* TrajectoryLogReader::getAccelerations(std::size_t index) const
+{
+  return getFlags(index) & trajectory_log::HAS_ACCELERATIONS ? getPositions(index) + 2 * variable_names_.size() : NULL;
+}
+
+std::size_t TrajectoryLogReader::findWayPoint(double time) const
+{
+  // first record after time
+  std::size_t low = 0, high = record_count_;
+  while (low < high)
+  {
+    const std::size_t mid = low + (high - low) / 2;
+    if (getTime(mid) <= time)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low > 0 ? low - 1 : 0;
+}
+
+bool TrajectoryLogReader::checkModel(const robot_model::RobotModel &model, std::vector<int> &variable_index) const
+{
+  if (trajectory_log::computeModelHash(model) != model_hash_)
+  {
+    logError("Trajectory log '%s' was not written for robot model '%s'", filename_.c_str(), model.getName().c_str());
+    return false;
+  }
+  variable_index.resize(variable_names_.size());
+  for (std::size_t j = 0 ; j < variable_names_.size() ; ++j)
+    variable_index[j] = model.getVariableIndex(variable_names_[j]);
+  return true;
+}
+
+bool TrajectoryLogReader::getWayPoint(std::size_t index, robot_state::RobotState &state) const
+{
+  std::vector<int> variable_index;
+  if (index >= record_count_ || !checkModel(*state.getRobotModel(), variable_index))
+    return false;
+
+  const double *positions = getPositions(index);
+  for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+    state.setVariablePosition(variable_index[j], positions[j]);
+  if (const double *velocities = getVelocities(index))
+    for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+      state.setVariableVelocity(variable_index[j], velocities[j]);
+  if (const double *accelerations = getAccelerations(index))
+    for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+      state.setVariableAcceleration(variable_index[j], accelerations[j]);
+  return true;
+}
+
+bool TrajectoryLogReader::getRobotTrajectory(const robot_state::RobotState &reference_state, double start_time, double end_time,
+                                             RobotTrajectory &trajectory) const
+{
+  std::vector<int> variable_index;
+  if (!checkModel(*reference_state.getRobotModel(), variable_index))
+    return false;
+
+  RobotTrajectory result(reference_state.getRobotModel(), group_name_);
+  std::size_t begin = findWayPoint(start_time);
+  if (begin < record_count_ && getTime(begin) < start_time)
+    ++begin;
+  double previous_time = 0.0;
+  for (std::size_t i = begin ; i < record_count_ && getTime(i) <= end_time ; ++i)
+  {
+    robot_state::RobotStatePtr state(new robot_state::RobotState(reference_state));
+    const double *positions = getPositions(i);
+    for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+      state->setVariablePosition(variable_index[j], positions[j]);
+    if (const double *velocities = getVelocities(i))
+    {
+      double *out = state->getVariableVelocities();
+      for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+        out[variable_index[j]] = velocities[j];
+    }
+    if (const double *accelerations = getAccelerations(i))
+    {
+      double *out = state->getVariableAccelerations();
+      for (std::size_t j = 0 ; j < variable_index.size() ; ++j)
+        out[variable_index[j]] = accelerations[j];
+    }
+    result.addSuffixWayPoint(state, result.empty() ? 0.0 : getTime(i) - previous_time);
+    previous_time = getTime(i);
+  }
+  trajectory.swap(result);
+  return true;
+}
+
+}
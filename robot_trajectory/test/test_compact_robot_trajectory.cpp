@@ -0,0 +1,183 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_trajectory/compact_robot_trajectory.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+
+class CompactRobotTrajectoryTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("two_dof_arm");
+    ASSERT_TRUE(robot_model_);
+
+    // waypoints with positions, velocities and accelerations, at uneven durations
+    trajectory_.reset(new robot_trajectory::RobotTrajectory(robot_model_, "arm"));
+    for (std::size_t i = 0 ; i < 6 ; ++i)
+    {
+      robot_state::RobotState state(robot_model_);
+      state.setToDefaultValues();
+      state.setVariablePosition("joint1", -1.0 + 0.4 * i);
+      state.setVariablePosition("joint2", 0.1 * (i % 3));
+      state.setVariableVelocity("joint1", 0.2 * i);
+      state.setVariableVelocity("joint2", -0.1 * i);
+      state.setVariableAcceleration("joint1", 1.0 - 0.3 * i);
+      state.setVariableAcceleration("joint2", 0.05 * i);
+      trajectory_->addSuffixWayPoint(state, i == 0 ? 0.0 : 0.1 + 0.05 * i);
+    }
+  }
+
+  static void expectEqualStates(const robot_state::RobotState &expected, const robot_state::RobotState &state, bool dynamics)
+  {
+    for (std::size_t j = 0 ; j < expected.getVariableCount() ; ++j)
+    {
+      EXPECT_NEAR(expected.getVariablePosition(j), state.getVariablePosition(j), 1e-12);
+      if (dynamics)
+      {
+        EXPECT_NEAR(expected.getVariableVelocity(j), state.getVariableVelocity(j), 1e-12);
+        EXPECT_NEAR(expected.getVariableAcceleration(j), state.getVariableAcceleration(j), 1e-12);
+      }
+    }
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  robot_trajectory::RobotTrajectoryPtr trajectory_;
+};
+
+TEST_F(CompactRobotTrajectoryTest, RoundTrip)
+{
+  robot_trajectory::CompactRobotTrajectory compact(*trajectory_);
+  EXPECT_EQ("arm", compact.getGroupName());
+  ASSERT_EQ(trajectory_->getWayPointCount(), compact.getWayPointCount());
+  ASSERT_EQ(2u, compact.getVariableCount());
+  EXPECT_TRUE(compact.hasVelocities());
+  EXPECT_TRUE(compact.hasAccelerations());
+  EXPECT_NEAR(trajectory_->getDuration(), compact.getDuration(), 1e-12);
+  // the values are stored in the order of the group variables
+  EXPECT_EQ(-1.0 + 0.4 * 4, compact.getWayPointPositions(4)[0]);
+  EXPECT_EQ(0.1, compact.getWayPointPositions(4)[1]);
+
+  robot_trajectory::RobotTrajectory converted(robot_model_, "arm");
+  compact.getRobotTrajectory(converted);
+  EXPECT_EQ(trajectory_->getGroup(), converted.getGroup());
+  ASSERT_EQ(trajectory_->getWayPointCount(), converted.getWayPointCount());
+  for (std::size_t i = 0 ; i < converted.getWayPointCount() ; ++i)
+  {
+    EXPECT_EQ(trajectory_->getWayPointDurationFromPrevious(i), converted.getWayPointDurationFromPrevious(i));
+    ASSERT_TRUE(converted.getWayPoint(i).hasVelocities());
+    ASSERT_TRUE(converted.getWayPoint(i).hasAccelerations());
+    expectEqualStates(trajectory_->getWayPoint(i), converted.getWayPoint(i), true);
+  }
+
+  // and back again; the group becomes the one of the trajectory
+  robot_trajectory::CompactRobotTrajectory again(converted.getFirstWayPoint(), "first_joint");
+  again.setRobotTrajectory(converted);
+  EXPECT_EQ("arm", again.getGroupName());
+  ASSERT_EQ(compact.getPositions().size(), again.getPositions().size());
+  for (std::size_t k = 0 ; k < compact.getPositions().size() ; ++k)
+    EXPECT_EQ(compact.getPositions()[k], again.getPositions()[k]);
+}
+
+TEST_F(CompactRobotTrajectoryTest, VariablesOutsideTheGroup)
+{
+  // only the first joint is stored; the second one comes from the reference state
+  robot_state::RobotState reference(robot_model_);
+  reference.setToDefaultValues();
+  reference.setVariablePosition("joint2", 0.7);
+  robot_trajectory::CompactRobotTrajectory compact(reference, "first_joint");
+  ASSERT_EQ(1u, compact.getVariableCount());
+  for (std::size_t i = 0 ; i < trajectory_->getWayPointCount() ; ++i)
+    compact.addSuffixWayPoint(trajectory_->getWayPoint(i), trajectory_->getWayPointDurationFromPrevious(i));
+
+  robot_state::RobotState state(robot_model_);
+  for (std::size_t i = 0 ; i < compact.getWayPointCount() ; ++i)
+  {
+    compact.getWayPoint(i, state);
+    EXPECT_EQ(trajectory_->getWayPoint(i).getVariablePosition("joint1"), state.getVariablePosition("joint1"));
+    EXPECT_EQ(0.7, state.getVariablePosition("joint2"));
+  }
+
+  // without a group, all the variables are stored
+  robot_trajectory::CompactRobotTrajectory all(reference, "");
+  EXPECT_EQ(robot_model_->getVariableCount(), all.getVariableCount());
+  EXPECT_TRUE(all.getGroupName().empty());
+}
+
+TEST_F(CompactRobotTrajectoryTest, UnknownGroup)
+{
+  robot_state::RobotState reference(robot_model_);
+  reference.setToDefaultValues();
+  EXPECT_THROW(robot_trajectory::CompactRobotTrajectory(reference, "no_such_group"), moveit::ConstructException);
+}
+
+TEST_F(CompactRobotTrajectoryTest, Interpolation)
+{
+  robot_trajectory::CompactRobotTrajectory compact(*trajectory_);
+  robot_state::RobotStatePtr expected(new robot_state::RobotState(trajectory_->getFirstWayPoint()));
+  robot_state::RobotState state(robot_model_);
+  state.setToDefaultValues();
+
+  // before the start, at and between the waypoints, and after the end
+  const double duration = trajectory_->getDuration();
+  for (double time = -0.1 ; time <= duration + 0.1 ; time += 0.01)
+  {
+    ASSERT_TRUE(trajectory_->getStateAtDurationFromStart(time, expected));
+    ASSERT_TRUE(compact.getStateAtDurationFromStart(time, state));
+    expectEqualStates(*expected, state, false);
+  }
+  for (std::size_t i = 0 ; i < trajectory_->getWayPointCount() ; ++i)
+  {
+    ASSERT_TRUE(compact.getStateAtDurationFromStart(trajectory_->getWaypointDurationFromStart(i), state));
+    expectEqualStates(trajectory_->getWayPoint(i), state, true);
+  }
+
+  // velocities and accelerations are interpolated linearly, halfway between the third and fourth waypoints
+  const double middle = 0.5 * (trajectory_->getWaypointDurationFromStart(2) + trajectory_->getWaypointDurationFromStart(3));
+  ASSERT_TRUE(compact.getStateAtDurationFromStart(middle, state));
+  EXPECT_NEAR(0.5 * (0.4 + 0.6), state.getVariableVelocity("joint1"), 1e-12);
+  EXPECT_NEAR(0.5 * (1.0 - 0.6 + 1.0 - 0.9), state.getVariableAcceleration("joint1"), 1e-12);
+  EXPECT_NEAR(-1.0 + 0.4 * 2.5, state.getVariablePosition("joint1"), 1e-12);
+
+  robot_trajectory::CompactRobotTrajectory empty(trajectory_->getFirstWayPoint(), "arm");
+  EXPECT_FALSE(empty.getStateAtDurationFromStart(0.0, state));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,294 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+
+class RobotTrajectoryTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("two_dof_arm");
+    ASSERT_TRUE(robot_model_);
+  }
+
+  robot_state::RobotState makeState(double value) const
+  {
+    robot_state::RobotState state(robot_model_);
+    state.setToDefaultValues();
+    state.setVariablePosition("joint1", value);
+    return state;
+  }
+
+  void addWayPoints(robot_trajectory::RobotTrajectory &trajectory, std::size_t count) const
+  {
+    for (std::size_t i = 0 ; i < count ; ++i)
+      trajectory.addSuffixWayPoint(makeState(0.01 * i), i == 0 ? 0.0 : 0.05 + 0.01 * (i % 7));
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+};
+
+// the lookup as it was done before durations from start were cached: a linear scan over the durations
+static void findWayPointIndicesLinear(const robot_trajectory::RobotTrajectory &trajectory, double duration,
+                                      int &before, int &after, double &blend)
+{
+  if (duration < 0.0)
+  {
+    before = 0;
+    after = 0;
+    blend = 0.0;
+    return;
+  }
+  const std::size_t num_points = trajectory.getWayPointCount();
+  std::size_t index = 0;
+  double running_duration = 0.0;
+  for ( ; index < num_points ; ++index)
+  {
+    running_duration += trajectory.getWayPointDurationFromPrevious(index);
+    if (running_duration >= duration)
+      break;
+  }
+  before = std::max<int>(index - 1, 0);
+  after = std::min<int>(index, num_points - 1);
+  if (after == before)
+    blend = 1.0;
+  else
+  {
+    const double before_time = running_duration - trajectory.getWayPointDurationFromPrevious(index);
+    blend = (duration - before_time) / trajectory.getWayPointDurationFromPrevious(index);
+  }
+}
+
+static void expectSameAsLinearScan(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  double time = 0.0;
+  for (std::size_t i = 0 ; i < trajectory.getWayPointCount() ; ++i)
+  {
+    time += trajectory.getWayPointDurationFromPrevious(i);
+    EXPECT_NEAR(time, trajectory.getWaypointDurationFromStart(i), 1e-12);
+  }
+  EXPECT_NEAR(time, trajectory.getDuration(), 1e-12);
+
+  // sample in between waypoints, exactly at waypoints and past the end
+  for (double t = -0.1 ; t < time + 0.2 ; t += 0.0137)
+  {
+    int before, after, expected_before, expected_after;
+    double blend, expected_blend;
+    trajectory.findWayPointIndicesForDurationAfterStart(t, before, after, blend);
+    findWayPointIndicesLinear(trajectory, t, expected_before, expected_after, expected_blend);
+    EXPECT_EQ(expected_before, before);
+    EXPECT_EQ(expected_after, after);
+    EXPECT_NEAR(expected_blend, blend, 1e-9);
+  }
+  for (std::size_t i = 0 ; i < trajectory.getWayPointCount() ; ++i)
+  {
+    int before, after, expected_before, expected_after;
+    double blend, expected_blend;
+    const double t = trajectory.getWaypointDurationFromStart(i);
+    trajectory.findWayPointIndicesForDurationAfterStart(t, before, after, blend);
+    findWayPointIndicesLinear(trajectory, t, expected_before, expected_after, expected_blend);
+    EXPECT_EQ(expected_before, before);
+    EXPECT_EQ(expected_after, after);
+    EXPECT_NEAR(expected_blend, blend, 1e-9);
+  }
+}
+
+TEST_F(RobotTrajectoryTest, DurationsFromStartMatchLinearScan)
+{
+  robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+  EXPECT_EQ(0.0, trajectory.getDuration());
+  addWayPoints(trajectory, 30);
+  expectSameAsLinearScan(trajectory);
+
+  // every kind of edit invalidates the cache from the right waypoint on
+  trajectory.addSuffixWayPoint(makeState(1.0), 0.3);
+  expectSameAsLinearScan(trajectory);
+  trajectory.addPrefixWayPoint(makeState(-1.0), 0.2);
+  expectSameAsLinearScan(trajectory);
+  trajectory.insertWayPoint(10, makeState(0.5), 0.15);
+  expectSameAsLinearScan(trajectory);
+  trajectory.setWayPointDurationFromPrevious(5, 0.4);
+  expectSameAsLinearScan(trajectory);
+  trajectory.setWayPointDurationFromPrevious(trajectory.getWayPointCount() - 1, 0.1);
+  trajectory.addSuffixWayPoint(makeState(2.0), 0.1);
+  expectSameAsLinearScan(trajectory);
+
+  robot_trajectory::RobotTrajectory other(robot_model_, "arm");
+  addWayPoints(other, 12);
+  trajectory.append(other, 0.25);
+  expectSameAsLinearScan(trajectory);
+  trajectory.reverse();
+  expectSameAsLinearScan(trajectory);
+
+  robot_trajectory::RobotTrajectory copy(trajectory);
+  trajectory.swap(other);
+  expectSameAsLinearScan(trajectory);
+  expectSameAsLinearScan(other);
+  expectSameAsLinearScan(copy);
+  copy = trajectory;
+  expectSameAsLinearScan(copy);
+
+  trajectory.clear();
+  EXPECT_EQ(0.0, trajectory.getDuration());
+  addWayPoints(trajectory, 3);
+  expectSameAsLinearScan(trajectory);
+}
+
+static void lookUpDurations(const robot_trajectory::RobotTrajectory *trajectory, const std::vector<double> *expected, bool *success)
+{
+  *success = true;
+  for (int repeat = 0 ; repeat < 20 ; ++repeat)
+    for (std::size_t i = expected->size() ; i > 0 ; --i)
+      if (fabs(trajectory->getWaypointDurationFromStart(i - 1) - (*expected)[i - 1]) > 1e-12)
+        *success = false;
+}
+
+TEST_F(RobotTrajectoryTest, ConcurrentLookups)
+{
+  robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+  addWayPoints(trajectory, 2000);
+  std::vector<double> expected(trajectory.getWayPointCount());
+  double time = 0.0;
+  for (std::size_t i = 0 ; i < expected.size() ; ++i)
+    expected[i] = time += trajectory.getWayPointDurationFromPrevious(i);
+
+  for (int round = 0 ; round < 5 ; ++round)
+  {
+    // invalidate the cache so that the readers need to rebuild it
+    trajectory.setWayPointDurationFromPrevious(0, round * 0.1);
+    for (std::size_t i = 0 ; i < expected.size() ; ++i)
+      expected[i] += round == 0 ? 0.0 : 0.1;
+
+    bool success[4];
+    boost::thread_group threads;
+    for (int k = 0 ; k < 4 ; ++k)
+      threads.create_thread(boost::bind(&lookUpDurations, &trajectory, &expected, &success[k]));
+    threads.join_all();
+    for (int k = 0 ; k < 4 ; ++k)
+      EXPECT_TRUE(success[k]);
+  }
+}
+
+TEST_F(RobotTrajectoryTest, MessageRoundTrip)
+{
+  robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+  for (std::size_t i = 0 ; i < 5 ; ++i)
+  {
+    robot_state::RobotState state = makeState(0.1 * i);
+    state.setVariablePosition("joint2", 0.02 * i);
+    state.setVariableVelocity("joint1", 0.5 + i);
+    state.setVariableVelocity("joint2", -0.1 * i);
+    trajectory.addSuffixWayPoint(state, i == 0 ? 0.0 : 0.1 * i);
+  }
+  moveit_msgs::RobotTrajectory msg;
+  trajectory.getRobotTrajectoryMsg(msg);
+  ASSERT_EQ(5u, msg.joint_trajectory.points.size());
+
+  const robot_state::RobotState reference = makeState(0.0);
+  robot_trajectory::RobotTrajectory copy(robot_model_, "arm");
+  copy.setRobotTrajectoryMsg(reference, msg);
+  ASSERT_EQ(trajectory.getWayPointCount(), copy.getWayPointCount());
+  for (std::size_t i = 0 ; i < copy.getWayPointCount() ; ++i)
+  {
+    EXPECT_NEAR(trajectory.getWayPointDurationFromPrevious(i), copy.getWayPointDurationFromPrevious(i), 1e-9);
+    ASSERT_TRUE(copy.getWayPoint(i).hasVelocities());
+    for (std::size_t j = 0 ; j < robot_model_->getVariableCount() ; ++j)
+    {
+      EXPECT_EQ(trajectory.getWayPoint(i).getVariablePosition(j), copy.getWayPoint(i).getVariablePosition(j));
+      EXPECT_EQ(trajectory.getWayPoint(i).getVariableVelocity(j), copy.getWayPoint(i).getVariableVelocity(j));
+    }
+  }
+
+  // reading the message again reuses the waypoints, except those that are referenced elsewhere
+  std::vector<const robot_state::RobotState*> waypoints;
+  for (std::size_t i = 0 ; i < copy.getWayPointCount() ; ++i)
+    waypoints.push_back(copy.getWayPointPtr(i).get());
+  robot_state::RobotStatePtr kept = copy.getWayPointPtr(0);
+  const double kept_position = kept->getVariablePosition("joint1");
+  msg.joint_trajectory.points[0].positions[0] = 1.0;
+  copy.setRobotTrajectoryMsg(reference, msg);
+  ASSERT_EQ(5u, copy.getWayPointCount());
+  EXPECT_EQ(kept_position, kept->getVariablePosition("joint1"));
+  EXPECT_EQ(1.0, copy.getWayPoint(0).getVariablePosition("joint1"));
+  std::size_t reused = 0;
+  for (std::size_t i = 0 ; i < copy.getWayPointCount() ; ++i)
+  {
+    EXPECT_NE(kept.get(), copy.getWayPointPtr(i).get());
+    reused += std::count(waypoints.begin(), waypoints.end(), copy.getWayPointPtr(i).get());
+  }
+  EXPECT_EQ(4u, reused);
+}
+
+TEST_F(RobotTrajectoryTest, MalformedMessagePoints)
+{
+  robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+  addWayPoints(trajectory, 5);
+  moveit_msgs::RobotTrajectory msg;
+  trajectory.getRobotTrajectoryMsg(msg);
+  ASSERT_EQ(2u, msg.joint_trajectory.joint_names.size());
+
+  // the second point is short of a position, the third has too few velocities, the fourth too many accelerations
+  msg.joint_trajectory.points[1].positions.resize(1);
+  msg.joint_trajectory.points[2].velocities.assign(1, 1.0);
+  msg.joint_trajectory.points[3].accelerations.assign(3, 1.0);
+
+  robot_trajectory::RobotTrajectory copy(robot_model_, "arm");
+  copy.setRobotTrajectoryMsg(makeState(0.0), msg);
+  ASSERT_EQ(4u, copy.getWayPointCount());
+  const std::size_t original[] = { 0, 2, 3, 4 };
+  for (std::size_t i = 0 ; i < copy.getWayPointCount() ; ++i)
+  {
+    EXPECT_EQ(trajectory.getWayPoint(original[i]).getVariablePosition("joint1"), copy.getWayPoint(i).getVariablePosition("joint1"));
+    EXPECT_NEAR(trajectory.getWaypointDurationFromStart(original[i]), copy.getWaypointDurationFromStart(i), 1e-9);
+    EXPECT_FALSE(copy.getWayPoint(i).hasVelocities());
+    EXPECT_FALSE(copy.getWayPoint(i).hasAccelerations());
+  }
+  // the skipped point's duration is added to the next one
+  EXPECT_NEAR(trajectory.getWayPointDurationFromPrevious(1) + trajectory.getWayPointDurationFromPrevious(2),
+              copy.getWayPointDurationFromPrevious(1), 1e-9);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,241 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/robot_trajectory/trajectory_log.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+
+class TrajectoryLogTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("two_dof_arm");
+    ASSERT_TRUE(robot_model_);
+    filename_ = (boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("test_trajectory_log_%%%%%%%%.bin")).string();
+  }
+
+  virtual void TearDown()
+  {
+    boost::filesystem::remove(filename_);
+  }
+
+  // count waypoints starting at offset; velocities and accelerations are only set if requested
+  robot_trajectory::RobotTrajectory makeTrajectory(std::size_t count, double offset, bool derivatives) const
+  {
+    robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+    for (std::size_t i = 0 ; i < count ; ++i)
+    {
+      robot_state::RobotStatePtr state(new robot_state::RobotState(robot_model_));
+      state->setToDefaultValues();
+      state->setVariablePosition("joint1", offset + 0.1 * i);
+      state->setVariablePosition("joint2", 0.5 - 0.05 * i);
+      if (derivatives)
+      {
+        state->setVariableVelocity(0, 0.2 * i);
+        state->setVariableVelocity(1, -0.1 * i);
+        state->setVariableAcceleration(0, 0.3);
+        state->setVariableAcceleration(1, -0.4);
+      }
+      trajectory.addSuffixWayPoint(state, i == 0 ? 0.0 : 0.1 + 0.01 * i);
+    }
+    return trajectory;
+  }
+
+  static void expectSameWayPoints(const robot_trajectory::RobotTrajectory &expected, const robot_trajectory::RobotTrajectory &actual)
+  {
+    ASSERT_EQ(expected.getWayPointCount(), actual.getWayPointCount());
+    for (std::size_t i = 0 ; i < expected.getWayPointCount() ; ++i)
+    {
+      const robot_state::RobotState &e = expected.getWayPoint(i);
+      const robot_state::RobotState &a = actual.getWayPoint(i);
+      if (i > 0)
+        EXPECT_NEAR(expected.getWayPointDurationFromPrevious(i), actual.getWayPointDurationFromPrevious(i), 1e-12);
+      EXPECT_EQ(e.hasVelocities(), a.hasVelocities());
+      EXPECT_EQ(e.hasAccelerations(), a.hasAccelerations());
+      for (std::size_t j = 0 ; j < e.getVariableCount() ; ++j)
+      {
+        EXPECT_EQ(e.getVariablePosition(j), a.getVariablePosition(j));
+        if (e.hasVelocities() && a.hasVelocities())
+          EXPECT_EQ(e.getVariableVelocity(j), a.getVariableVelocity(j));
+        if (e.hasAccelerations() && a.hasAccelerations())
+          EXPECT_EQ(e.getVariableAcceleration(j), a.getVariableAcceleration(j));
+      }
+    }
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  std::string filename_;
+};
+
+TEST_F(TrajectoryLogTest, RoundTrip)
+{
+  const robot_trajectory::RobotTrajectory first = makeTrajectory(5, 0.0, true);
+  const robot_trajectory::RobotTrajectory second = makeTrajectory(4, 1.0, false);
+
+  robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+  ASSERT_TRUE(writer.open(filename_));
+  ASSERT_TRUE(writer.append(first, 10.0));
+  ASSERT_TRUE(writer.append(second, 20.0));
+  // trajectories must be appended in chronological order
+  EXPECT_FALSE(writer.append(second, 15.0));
+  ASSERT_TRUE(writer.flush());
+  EXPECT_NEAR(20.0 + second.getDuration(), writer.getEndTime(), 1e-12);
+
+  robot_trajectory::TrajectoryLogReader reader;
+  ASSERT_TRUE(reader.open(filename_));
+  EXPECT_EQ(robot_trajectory::trajectory_log::computeModelHash(*robot_model_), reader.getModelHash());
+  EXPECT_EQ("arm", reader.getGroupName());
+  EXPECT_EQ(writer.getVariableNames(), reader.getVariableNames());
+  ASSERT_EQ(first.getWayPointCount() + second.getWayPointCount(), reader.getWayPointCount());
+
+  for (std::size_t i = 0 ; i < reader.getWayPointCount() ; ++i)
+  {
+    const bool in_first = i < first.getWayPointCount();
+    const std::size_t k = in_first ? i : i - first.getWayPointCount();
+    const robot_trajectory::RobotTrajectory &source = in_first ? first : second;
+    EXPECT_EQ(in_first ? 0u : 1u, reader.getTrajectoryIndex(i));
+    EXPECT_NEAR((in_first ? 10.0 : 20.0) + source.getWaypointDurationFromStart(k), reader.getTime(i), 1e-12);
+    EXPECT_EQ(k == 0, (reader.getFlags(i) & robot_trajectory::trajectory_log::TRAJECTORY_START) != 0);
+    EXPECT_EQ(in_first, reader.getVelocities(i) != NULL);
+    EXPECT_EQ(in_first, reader.getAccelerations(i) != NULL);
+    EXPECT_EQ(source.getWayPoint(k).getVariablePosition("joint1"), reader.getPositions(i)[0]);
+    EXPECT_EQ(source.getWayPoint(k).getVariablePosition("joint2"), reader.getPositions(i)[1]);
+    EXPECT_EQ(i, reader.findWayPoint(reader.getTime(i)));
+  }
+  EXPECT_EQ(0u, reader.findWayPoint(0.0));
+  EXPECT_EQ(reader.getWayPointCount() - 1, reader.findWayPoint(1e9));
+
+  robot_state::RobotState reference(robot_model_);
+  reference.setToDefaultValues();
+  robot_trajectory::RobotTrajectory extracted(robot_model_, "arm");
+  ASSERT_TRUE(reader.getRobotTrajectory(reference, 10.0, 15.0, extracted));
+  expectSameWayPoints(first, extracted);
+  ASSERT_TRUE(reader.getRobotTrajectory(reference, 20.0, writer.getEndTime(), extracted));
+  expectSameWayPoints(second, extracted);
+
+  robot_state::RobotState state(reference);
+  ASSERT_TRUE(reader.getWayPoint(2, state));
+  EXPECT_EQ(first.getWayPoint(2).getVariablePosition("joint1"), state.getVariablePosition("joint1"));
+  EXPECT_EQ(first.getWayPoint(2).getVariableVelocity(0), state.getVariableVelocity(0));
+  EXPECT_FALSE(reader.getWayPoint(reader.getWayPointCount(), state));
+}
+
+TEST_F(TrajectoryLogTest, AppendToExistingLog)
+{
+  const robot_trajectory::RobotTrajectory trajectory = makeTrajectory(3, 0.0, false);
+  {
+    robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+    ASSERT_TRUE(writer.open(filename_));
+    ASSERT_TRUE(writer.append(trajectory, 1.0));
+  }
+
+  // a log for other variables cannot be appended to
+  robot_trajectory::TrajectoryLogWriter other(robot_model_, "");
+  EXPECT_FALSE(other.open(filename_));
+
+  robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+  ASSERT_TRUE(writer.open(filename_));
+  EXPECT_NEAR(1.0 + trajectory.getDuration(), writer.getEndTime(), 1e-12);
+  EXPECT_FALSE(writer.append(trajectory, 1.0));
+  ASSERT_TRUE(writer.append(trajectory, 5.0));
+  ASSERT_TRUE(writer.flush());
+
+  robot_trajectory::TrajectoryLogReader reader;
+  ASSERT_TRUE(reader.open(filename_));
+  ASSERT_EQ(2 * trajectory.getWayPointCount(), reader.getWayPointCount());
+  EXPECT_EQ(1u, reader.getTrajectoryIndex(reader.getWayPointCount() - 1));
+  EXPECT_NEAR(5.0, reader.getTime(trajectory.getWayPointCount()), 1e-12);
+
+  // records appended after the log was mapped are seen after a refresh
+  ASSERT_TRUE(writer.append(trajectory, 10.0));
+  ASSERT_TRUE(writer.flush());
+  EXPECT_EQ(2 * trajectory.getWayPointCount(), reader.getWayPointCount());
+  ASSERT_TRUE(reader.refresh());
+  EXPECT_EQ(3 * trajectory.getWayPointCount(), reader.getWayPointCount());
+}
+
+TEST_F(TrajectoryLogTest, PartialRecordIsIgnored)
+{
+  const robot_trajectory::RobotTrajectory trajectory = makeTrajectory(3, 0.0, true);
+  {
+    robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+    ASSERT_TRUE(writer.open(filename_));
+    ASSERT_TRUE(writer.append(trajectory, 0.0));
+  }
+  {
+    // simulate a process that stopped in the middle of a record
+    std::ofstream out(filename_.c_str(), std::ios::binary | std::ios::app);
+    const char partial[7] = { 1, 2, 3, 4, 5, 6, 7 };
+    out.write(partial, sizeof(partial));
+  }
+
+  robot_trajectory::TrajectoryLogReader reader;
+  ASSERT_TRUE(reader.open(filename_));
+  EXPECT_EQ(trajectory.getWayPointCount(), reader.getWayPointCount());
+
+  // the writer continues after the last complete record
+  robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+  ASSERT_TRUE(writer.open(filename_));
+  ASSERT_TRUE(writer.append(trajectory, 5.0));
+  writer.close();
+  ASSERT_TRUE(reader.refresh());
+  ASSERT_EQ(2 * trajectory.getWayPointCount(), reader.getWayPointCount());
+  EXPECT_NEAR(5.0, reader.getTime(trajectory.getWayPointCount()), 1e-12);
+  EXPECT_EQ(1u, reader.getTrajectoryIndex(trajectory.getWayPointCount()));
+}
+
+TEST_F(TrajectoryLogTest, RejectsOtherFiles)
+{
+  {
+    std::ofstream out(filename_.c_str(), std::ios::binary);
+    out << "not a trajectory log";
+  }
+  robot_trajectory::TrajectoryLogReader reader;
+  EXPECT_FALSE(reader.open(filename_));
+  EXPECT_FALSE(reader.isOpen());
+
+  robot_trajectory::TrajectoryLogWriter writer(robot_model_, "arm");
+  EXPECT_FALSE(writer.open(filename_));
+  EXPECT_FALSE(writer.isOpen());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
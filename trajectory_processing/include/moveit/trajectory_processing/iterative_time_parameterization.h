@@ -40,33 +40,37 @@
 #include <trajectory_msgs/JointTrajectory.h>
 #include <moveit_msgs/JointLimits.h>
 #include <moveit_msgs/RobotState.h>
-#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/trajectory_processing/time_parameterization.h>
+#include <Eigen/Core>
 
 namespace trajectory_processing
 {
 
 /// \brief This class  modifies the timestamps of a trajectory to respect
 /// velocity and acceleration constraints.
-class IterativeParabolicTimeParameterization
+class IterativeParabolicTimeParameterization : public TimeParameterization
 {
 public:
   IterativeParabolicTimeParameterization(unsigned int max_iterations = 100,
                                          double max_time_change_per_it = .01);
   ~IterativeParabolicTimeParameterization();
 
-  bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
-                         const double max_velocity_scaling_factor = 1.0) const;
+  virtual bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                 const double max_velocity_scaling_factor = 1.0) const;
 
 private:
 
   unsigned int max_iterations_;         /// @brief maximum number of iterations to find solution
   double max_time_change_per_it_;       /// @brief maximum allowed time change per iteration in seconds
 
-  void applyVelocityConstraints(robot_trajectory::RobotTrajectory& rob_trajectory,
-                                std::vector<double> &time_diff,
-                                const double max_velocity_scaling_factor) const;
+  /// The positions are a (waypoints x joints) matrix, extracted once from the trajectory
+  void applyVelocityConstraints(const Eigen::MatrixXd &positions,
+                                const std::vector<double> &max_velocities,
+                                std::vector<double> &time_diff) const;
 
-  void applyAccelerationConstraints(robot_trajectory::RobotTrajectory& rob_trajectory,
+  void applyAccelerationConstraints(const Eigen::MatrixXd &positions,
+                                    const std::vector<double> &max_accelerations,
+                                    const std::vector<double> *start_velocities,
                                     std::vector<double> & time_diff) const;
 
   double findT1( const double d1, const double d2, double t1, const double t2, const double a_max) const;
@@ -0,0 +1,101 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_TRAJECTORY_PROCESSING_JERK_LIMITED_TIME_PARAMETERIZATION_
+#define MOVEIT_TRAJECTORY_PROCESSING_JERK_LIMITED_TIME_PARAMETERIZATION_
+
+#include <moveit/trajectory_processing/reachability_time_parameterization.h>
+#include <map>
+
+namespace trajectory_processing
+{
+
+/// \brief Time parameterization that also limits the jerk of the joints, so
+/// accelerations change continuously (S-curve profiles).
+///
+/// The time-optimal motion along the path is computed first (see
+/// ReachabilityTimeParameterization). Its path parameter s(t) is then
+/// filtered with a moving average over a window of length max(2 a / j) for
+/// the joint acceleration and jerk limits a and j. This turns the jumps of
+/// the path acceleration (at most from -a to a) into ramps of bounded slope
+/// and makes the motion last one window longer. Since filtering can only
+/// approximately preserve the joint limits along a curved path, the
+/// trajectory is finally slowed down uniformly if any velocity,
+/// acceleration or jerk still exceeds its limit. These are checked at a
+/// fixed number of times between consecutive waypoints, so the jerk is the
+/// change of acceleration over a fraction of a segment rather than over a
+/// whole one. The cost is O(n log n) in the number of waypoints.
+///
+/// Jerk limits are not part of the robot model; they are specified per
+/// variable, and variables without a jerk limit use the default one.
+class JerkLimitedTimeParameterization : public ReachabilityTimeParameterization
+{
+public:
+  JerkLimitedTimeParameterization(double default_max_jerk = 1.0);
+  ~JerkLimitedTimeParameterization();
+
+  /// \brief Set the jerk limit of the variable \e name
+  void setJerkLimit(const std::string &name, double max_jerk);
+
+  /// \brief Set the jerk limits of several variables at once (variable name to limit)
+  void setJerkLimits(const std::map<std::string, double> &max_jerks);
+
+  /// \brief Get the jerk limit used for the variable \e name
+  double getJerkLimit(const std::string &name) const;
+
+  void setDefaultJerkLimit(double max_jerk);
+
+  double getDefaultJerkLimit() const
+  {
+    return default_max_jerk_;
+  }
+
+  virtual bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                 const double max_velocity_scaling_factor = 1.0) const;
+
+  /// \brief Same as above, with acceleration limits multiplied by \e max_acceleration_scaling_factor, in (0, 1].
+  /// Jerk limits are not scaled.
+  virtual bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                 const double max_velocity_scaling_factor,
+                                 const double max_acceleration_scaling_factor) const;
+
+private:
+
+  double default_max_jerk_;
+  std::map<std::string, double> max_jerks_;
+};
+
+}
+
+#endif
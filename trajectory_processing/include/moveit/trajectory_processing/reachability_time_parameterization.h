@@ -0,0 +1,123 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_TRAJECTORY_PROCESSING_REACHABILITY_TIME_PARAMETERIZATION_
+#define MOVEIT_TRAJECTORY_PROCESSING_REACHABILITY_TIME_PARAMETERIZATION_
+
+#include <moveit/trajectory_processing/time_parameterization.h>
+#include <Eigen/Core>
+
+namespace trajectory_processing
+{
+
+/// \brief The motion along a path computed by ReachabilityTimeParameterization,
+/// in terms of the arc length s of the path. Waypoints that coincide with the
+/// previous one are not part of the grid the motion is defined on.
+struct PathTimeLaw
+{
+  /// \brief Index of the waypoint at each grid point
+  std::vector<int> waypoints_;
+
+  /// \brief Arc length at each grid point
+  std::vector<double> arc_length_;
+
+  /// \brief Path velocity (ds/dt) at each grid point
+  std::vector<double> path_velocity_;
+
+  /// \brief Path acceleration when leaving each grid point (when arriving, for the last one). It is constant
+  /// from a grid point to the next one, except over segments that start and end (almost) at rest: those
+  /// accelerate at their start and decelerate at their end.
+  std::vector<double> path_acceleration_;
+
+  /// \brief Time from the previous grid point (0 for the first one)
+  std::vector<double> durations_;
+
+  /// \brief dq/ds and d2q/ds2 at the grid points, one column per grid point
+  Eigen::MatrixXd first_derivatives_;
+  Eigen::MatrixXd second_derivatives_;
+};
+
+/// \brief Time-optimal parameterization of the path described by the waypoints
+/// of a trajectory, based on reachability analysis (TOPP-RA).
+///
+/// The path is parameterized by its arc length s in joint space; path
+/// derivatives are estimated from the waypoints by finite differences.
+/// A backward pass computes, for every waypoint, the interval of squared
+/// path velocities from which the end of the path can be reached at rest
+/// without violating the joint velocity and acceleration limits. A forward
+/// pass then greedily picks the largest reachable velocity at every
+/// waypoint. The cost is linear in the number of waypoints. The path starts
+/// and ends at rest. Joints without specified limits use a limit of 1.
+class ReachabilityTimeParameterization : public TimeParameterization
+{
+public:
+  ReachabilityTimeParameterization();
+  ~ReachabilityTimeParameterization();
+
+  virtual bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                 const double max_velocity_scaling_factor = 1.0) const;
+
+  /// \brief Same as above, with acceleration limits multiplied by \e max_acceleration_scaling_factor, in (0, 1]
+  virtual bool computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                 const double max_velocity_scaling_factor,
+                                 const double max_acceleration_scaling_factor) const;
+
+  /// \brief Compute the time-optimal motion along the path whose waypoints are the columns of \e positions
+  static bool computeTimeLaw(const Eigen::MatrixXd &positions,
+                             const Eigen::VectorXd &max_velocities,
+                             const Eigen::VectorXd &max_accelerations,
+                             PathTimeLaw &law);
+
+protected:
+
+  /// \brief Unwind \e trajectory and extract the positions of its group variables (one column per
+  /// waypoint) and the scaled velocity and acceleration limits of those variables
+  bool extractPath(robot_trajectory::RobotTrajectory& trajectory,
+                   const double max_velocity_scaling_factor,
+                   const double max_acceleration_scaling_factor,
+                   Eigen::MatrixXd &positions,
+                   Eigen::VectorXd &max_velocities,
+                   Eigen::VectorXd &max_accelerations) const;
+
+  /// \brief Write the durations (time from the previous waypoint), velocities and accelerations
+  /// (one column per waypoint) to the group variables of the waypoints of \e trajectory
+  void writeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                       const std::vector<double> &durations,
+                       const Eigen::MatrixXd &velocities,
+                       const Eigen::MatrixXd &accelerations) const;
+};
+
+}
+
+#endif
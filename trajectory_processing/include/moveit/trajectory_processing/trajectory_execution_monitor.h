@@ -0,0 +1,195 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_EXECUTION_MONITOR_
+#define MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_EXECUTION_MONITOR_
+
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/macros/class_forward.h>
+
+namespace trajectory_processing
+{
+
+MOVEIT_CLASS_FORWARD(TrajectoryExecutionMonitor);
+
+/// \brief Compare the states measured while a trajectory executes against the planned trajectory.
+///
+/// Measured states are passed to update() along with the time since the
+/// start of execution. The reference (planned) positions and velocities of
+/// the group variables are interpolated linearly between waypoints. Since
+/// time usually increases from one update to the next, the segment of the
+/// trajectory is found by moving forward from the previous one, which takes
+/// constant amortized time; going back in time falls back to a binary search.
+///
+/// If a planning scene is set, update() also predicts collisions over an
+/// upcoming time horizon: the reference states at a few sample times in the
+/// horizon, offset by the current tracking error, are checked for collisions.
+///
+/// All memory is allocated by setTrajectory(); update() does not allocate
+/// (collision checking aside).
+class TrajectoryExecutionMonitor
+{
+public:
+
+  /// \brief Flags reported by update()
+  enum Flags
+  {
+    POSITION_TOLERANCE_VIOLATED = 1,
+    VELOCITY_TOLERANCE_VIOLATED = 2,
+    COLLISION_PREDICTED = 4,
+    /// the time is past the end of the trajectory
+    TRAJECTORY_COMPLETE = 8
+  };
+
+  /// \brief The outcome of an update
+  struct Status
+  {
+    /// combination of Flags; 0 means the execution is on track
+    unsigned int flags_;
+
+    double time_from_start_;
+
+    /// the waypoint at the start of the current segment
+    std::size_t waypoint_;
+
+    /// the largest absolute position error, and the group variable it occurs for
+    double max_position_error_;
+    int max_position_error_variable_;
+
+    /// the largest absolute velocity error (0 if velocities are not measured)
+    double max_velocity_error_;
+
+    /// the time from start of the first predicted collision (only meaningful if COLLISION_PREDICTED is set)
+    double collision_time_;
+  };
+
+  /// \brief Construct a monitor; without a planning scene, collisions are not predicted
+  TrajectoryExecutionMonitor(const planning_scene::PlanningSceneConstPtr &scene = planning_scene::PlanningSceneConstPtr());
+
+  /// \brief Set the trajectory to monitor and rewind to its start
+  bool setTrajectory(const robot_trajectory::RobotTrajectory &trajectory);
+
+  void setPlanningScene(const planning_scene::PlanningSceneConstPtr &scene);
+
+  /// \brief Set the same position tolerance for all group variables
+  void setPositionTolerance(double tolerance);
+
+  /// \brief Set the position tolerance of each group variable (in group order); must be called after setTrajectory()
+  bool setPositionTolerances(const std::vector<double> &tolerances);
+
+  /// \brief Set the velocity tolerance of all group variables; 0 disables velocity checks
+  void setVelocityTolerance(double tolerance);
+
+  /// \brief Predict collisions for the next \e horizon seconds, checking \e samples states in that interval
+  void setCollisionHorizon(double horizon, unsigned int samples);
+
+  /// \brief Go back to the start of the trajectory
+  void reset();
+
+  /// \brief Compare the measured \e state against the trajectory at \e time_from_start
+  const Status& update(const robot_state::RobotState &state, double time_from_start);
+
+  /// \brief Same as above, with the measured positions (and optionally velocities) of the group variables, in group order
+  const Status& update(const double *positions, const double *velocities, double time_from_start);
+
+  const Status& getStatus() const
+  {
+    return status_;
+  }
+
+  /// \brief Get the reference positions of the group variables at the time of the last update
+  const std::vector<double>& getReferencePositions() const
+  {
+    return reference_positions_;
+  }
+
+  /// \brief Get the measured minus reference positions of the group variables at the time of the last update
+  const std::vector<double>& getPositionErrors() const
+  {
+    return position_errors_;
+  }
+
+  const robot_model::JointModelGroup* getGroup() const
+  {
+    return group_;
+  }
+
+  double getDuration() const
+  {
+    return times_.empty() ? 0.0 : times_.back();
+  }
+
+private:
+
+  /// \brief Move \e segment so that the times of waypoints segment and segment + 1 bracket \e time
+  void findSegment(double time, std::size_t &segment) const;
+
+  /// \brief Interpolate the positions of the group variables at \e time, in segment \e segment
+  void interpolatePositions(double time, std::size_t segment, double *positions) const;
+
+  void predictCollisions(double time_from_start);
+
+  planning_scene::PlanningSceneConstPtr scene_;
+  const robot_model::JointModelGroup *group_;
+  std::size_t variable_count_;
+
+  /// time from start, positions and velocities of the waypoints (values of waypoint i start at i * variable_count_)
+  std::vector<double> times_;
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+
+  std::vector<double> position_tolerances_;
+  double default_position_tolerance_;
+  double velocity_tolerance_;
+  double collision_horizon_;
+  unsigned int collision_samples_;
+
+  std::size_t segment_;
+  Status status_;
+
+  std::vector<double> measured_positions_;
+  std::vector<double> measured_velocities_;
+  std::vector<double> reference_positions_;
+  std::vector<double> position_errors_;
+  std::vector<double> predicted_positions_;
+
+  robot_state::RobotStatePtr predicted_state_;
+  collision_detection::CollisionRequest collision_request_;
+  collision_detection::CollisionResult collision_result_;
+};
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_RESAMPLER_
+#define MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_RESAMPLER_
+
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/robot_trajectory/compact_robot_trajectory.h>
+#include <boost/function.hpp>
+#include <vector>
+
+namespace trajectory_processing
+{
+
+/** \brief Sample a time-parameterized trajectory at a fixed period.
+
+    The values of the variables of the trajectory's group (all variables if the
+    trajectory has no group) are extracted once when sampling starts, and samples are
+    then produced one at a time, in increasing order of time, into buffers owned by the
+    resampler. Producing a sample takes amortized constant time and, once the buffers
+    have grown to the size of the trajectory, sampling does not allocate memory.
+
+    Between waypoints, positions are interpolated with polynomials that match the
+    waypoint velocities (cubic) or velocities and accelerations (quintic). If the
+    trajectory does not specify the required derivatives at every waypoint, the
+    interpolation falls back to the highest order the data supports.
+
+    The first sample is at time 0. If the duration of the trajectory is not a multiple of
+    the period, one more sample is produced, at the next multiple of the period, with the
+    values of the last waypoint. */
+class TrajectoryResampler
+{
+public:
+
+  enum Interpolation
+  {
+    LINEAR,
+    CUBIC,
+    QUINTIC
+  };
+
+  /** \brief Callback for a sample: the time from start and the positions, velocities and accelerations of the variables.
+      Return false to stop sampling */
+  typedef boost::function<bool(double time, const double *positions, const double *velocities, const double *accelerations)> SampleCallback;
+
+  TrajectoryResampler(double period, Interpolation interpolation = CUBIC);
+
+  double getPeriod() const
+  {
+    return period_;
+  }
+
+  void setPeriod(double period);
+
+  Interpolation getInterpolation() const
+  {
+    return interpolation_;
+  }
+
+  void setInterpolation(Interpolation interpolation)
+  {
+    interpolation_ = interpolation;
+  }
+
+  /** \brief Start sampling \e trajectory. Return false if the trajectory is empty */
+  bool start(const robot_trajectory::RobotTrajectory &trajectory);
+
+  /** \brief Start sampling \e trajectory. Return false if the trajectory is empty */
+  bool start(const robot_trajectory::CompactRobotTrajectory &trajectory);
+
+  /** \brief Compute the next sample. Return false when all samples have been produced */
+  bool next();
+
+  /** \brief The number of samples for the trajectory being sampled */
+  std::size_t getSampleCount() const
+  {
+    return sample_count_;
+  }
+
+  /** \brief The number of values in a sample */
+  std::size_t getVariableCount() const
+  {
+    return variable_count_;
+  }
+
+  /** \brief The interpolation actually used for the trajectory being sampled */
+  Interpolation getEffectiveInterpolation() const
+  {
+    return effective_interpolation_;
+  }
+
+  /** \brief The time from start of the current sample */
+  double getTime() const
+  {
+    return time_;
+  }
+
+  const double* getPositions() const
+  {
+    return &sample_positions_[0];
+  }
+
+  const double* getVelocities() const
+  {
+    return &sample_velocities_[0];
+  }
+
+  const double* getAccelerations() const
+  {
+    return &sample_accelerations_[0];
+  }
+
+  /** \brief Produce all samples of \e trajectory, passing them to \e callback. Return false if the trajectory
+      is empty or the callback stopped the sampling */
+  bool resample(const robot_trajectory::RobotTrajectory &trajectory, const SampleCallback &callback);
+
+  /** \brief Produce all samples of \e trajectory into flat arrays (sample after sample, getVariableCount() values each).
+      The arrays are resized as needed, so passing the same arrays again avoids allocations. Return the number of samples */
+  std::size_t resample(const robot_trajectory::RobotTrajectory &trajectory,
+                       std::vector<double> &positions, std::vector<double> &velocities, std::vector<double> &accelerations);
+
+private:
+
+  /** \brief Size the buffers for \e waypoint_count waypoints of \e variable_count values */
+  void allocate(std::size_t waypoint_count, std::size_t variable_count);
+
+  /** \brief Compute the number of samples and reset the sampling position */
+  void initializeSampling(bool has_velocities, bool has_accelerations);
+
+  void collectSamples(std::vector<double> &positions, std::vector<double> &velocities, std::vector<double> &accelerations);
+
+  double period_;
+  Interpolation interpolation_;
+  Interpolation effective_interpolation_;
+
+  std::size_t variable_count_;
+  std::size_t waypoint_count_;
+
+  /** \brief Values at the waypoints, waypoint after waypoint */
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+  std::vector<double> accelerations_;
+
+  /** \brief Time from start of each waypoint */
+  std::vector<double> times_;
+
+  std::size_t sample_count_;
+  std::size_t next_sample_;
+  std::size_t segment_;
+  double time_;
+
+  std::vector<double> sample_positions_;
+  std::vector<double> sample_velocities_;
+  std::vector<double> sample_accelerations_;
+};
+
+}
+
+#endif
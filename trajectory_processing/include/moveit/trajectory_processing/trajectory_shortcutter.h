@@ -0,0 +1,173 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_SHORTCUTTER_
+#define MOVEIT_TRAJECTORY_PROCESSING_TRAJECTORY_SHORTCUTTER_
+
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/robot_trajectory/robot_trajectory.h>
+#include <moveit/kinematic_constraints/kinematic_constraint.h>
+#include <moveit/macros/class_forward.h>
+#include <ros/time.h>
+#include <boost/function.hpp>
+#include <boost/cstdint.hpp>
+
+namespace trajectory_processing
+{
+
+MOVEIT_CLASS_FORWARD(TrajectoryShortcutter);
+
+/// \brief Shorten and smooth the path of a trajectory, keeping it valid in a planning scene.
+///
+/// Shortcutting proceeds in rounds. In every round a batch of candidate
+/// shortcuts (pairs of waypoints to connect directly) is drawn from a
+/// random number generator and the candidates are validated in parallel:
+/// the states along each shortcut, spaced at most the resolution apart,
+/// are checked for collisions, feasibility and the path constraints. The
+/// valid shortcuts that do not overlap are then applied, largest length
+/// reduction first. Smoothing moves the waypoints towards the midpoint of
+/// their neighbors, updating every other waypoint in parallel, as long as
+/// the waypoint and its segments remain valid.
+///
+/// For a given seed, the result does not depend on the number of threads
+/// as long as shortcutting stops because the round limit is reached. The
+/// time budget is also checked while candidates are validated, so when it
+/// runs out first the result depends on timing; only the round limit gives
+/// reproducible results. The waypoints of the input are assumed to be
+/// valid. Only the positions of the group variables are changed; the
+/// durations of all waypoints and the velocities and accelerations of the
+/// group variables are reset to 0, so the trajectory needs to be time
+/// parameterized again.
+class TrajectoryShortcutter
+{
+public:
+
+  TrajectoryShortcutter(const planning_scene::PlanningSceneConstPtr &scene);
+
+  /// \brief Require the states along the path to satisfy \e constraints (in addition to being collision free and feasible)
+  bool setPathConstraints(const moveit_msgs::Constraints &constraints);
+
+  void clearPathConstraints();
+
+  /// \brief Set the seed of the random number generator used to pick shortcuts
+  void setSeed(boost::uint32_t seed)
+  {
+    seed_ = seed;
+  }
+
+  /// \brief Set the number of parts validation is split into; the parts are executed by the shared
+  /// moveit::tools::TaskScheduler. 0 means one per worker of the scheduler
+  void setThreadCount(unsigned int thread_count)
+  {
+    thread_count_ = thread_count;
+  }
+
+  /// \brief Set the number of candidate shortcuts validated in every round
+  void setCandidatesPerRound(unsigned int count)
+  {
+    candidates_per_round_ = std::max(1u, count);
+  }
+
+  /// \brief Set the maximum number of shortcutting rounds
+  void setMaxRounds(unsigned int count)
+  {
+    max_rounds_ = count;
+  }
+
+  /// \brief Set the largest distance (as computed by RobotState::distance()) between states checked along a segment
+  void setResolution(double resolution);
+
+  double getResolution() const
+  {
+    return resolution_;
+  }
+
+  /// \brief Replace parts of the path by straight segments, for at most \e allowed_time seconds.
+  /// Return false if the trajectory cannot be processed (e.g., it has no group)
+  bool shortcut(robot_trajectory::RobotTrajectory &trajectory, double allowed_time) const;
+
+  /// \brief Smooth the path for \e iterations iterations, each moving all waypoints except the end points once
+  bool smooth(robot_trajectory::RobotTrajectory &trajectory, unsigned int iterations) const;
+
+  /// \brief Check the states strictly between \e from and \e to along the straight segment for the variables of \e group.
+  /// \e state is used as scratch memory
+  bool isSegmentValid(const robot_state::RobotState &from, const robot_state::RobotState &to,
+                      const robot_model::JointModelGroup *group, robot_state::RobotState &state) const;
+
+  /// \brief Check a single state; \e state is updated if needed
+  bool isStateValid(robot_state::RobotState &state, const robot_model::JointModelGroup *group) const;
+
+  /// \brief Compute the length of the path, as the sum of the distances between consecutive waypoints for the group variables
+  static double getPathLength(const robot_trajectory::RobotTrajectory &trajectory);
+
+private:
+
+  struct Candidate
+  {
+    std::size_t start_;
+    std::size_t end_;
+    double gain_;
+    bool valid_;
+  };
+
+  /// \brief Validate the candidates in [begin, end); candidates are not validated (and considered invalid) after \e end_time
+  void validateShortcuts(const std::vector<robot_state::RobotStatePtr> *waypoints, const robot_model::JointModelGroup *group,
+                         std::vector<Candidate> *candidates, ros::WallTime end_time, std::size_t begin, std::size_t end) const;
+
+  /// \brief Try to move the waypoints indices[begin], ..., indices[end - 1] towards the midpoints of their neighbors;
+  /// the moved waypoints are stored in \e moved (NULL if a waypoint cannot be moved)
+  void smoothWayPoints(const std::vector<robot_state::RobotStatePtr> *waypoints, const robot_model::JointModelGroup *group,
+                       const std::vector<std::size_t> *indices, std::vector<robot_state::RobotStatePtr> *moved,
+                       std::size_t begin, std::size_t end) const;
+
+  /// \brief Replace the waypoints of \e trajectory by \e waypoints, with durations, velocities and accelerations of 0.
+  /// Waypoints that have velocities or accelerations are copied first, since they may be shared with other trajectories
+  static void setWayPoints(robot_trajectory::RobotTrajectory &trajectory, const std::vector<robot_state::RobotStatePtr> &waypoints);
+
+  /// \brief Run \e function on \e count items split in thread_count_ contiguous ranges, using the shared task scheduler
+  void runInParallel(std::size_t count, const boost::function<void(std::size_t, std::size_t)> &function) const;
+
+  planning_scene::PlanningSceneConstPtr scene_;
+  kinematic_constraints::KinematicConstraintSetPtr path_constraints_;
+
+  boost::uint32_t seed_;
+  unsigned int thread_count_;
+  unsigned int candidates_per_round_;
+  unsigned int max_rounds_;
+  double resolution_;
+};
+
+}
+
+#endif
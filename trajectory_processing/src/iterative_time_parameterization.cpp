@@ -98,40 +98,20 @@ void printStats(const trajectory_msgs::JointTrajectory& trajectory, const std::v
 }
 
 // Applies velocity
-void IterativeParabolicTimeParameterization::applyVelocityConstraints(robot_trajectory::RobotTrajectory& rob_trajectory,
-                                                                      std::vector<double> &time_diff,
-                                                                      const double max_velocity_scaling_factor) const
+void IterativeParabolicTimeParameterization::applyVelocityConstraints(const Eigen::MatrixXd &positions,
+                                                                      const std::vector<double> &max_velocities,
+                                                                      std::vector<double> &time_diff) const
 {
-  const robot_model::JointModelGroup *group = rob_trajectory.getGroup();
-  const std::vector<std::string> &vars = group->getVariableNames();
-  const std::vector<int> &idx = group->getVariableIndexList();
-  const robot_model::RobotModel &rmodel = group->getParentModel();
-  const int num_points = rob_trajectory.getWayPointCount();
-  
-  double velocity_scaling_factor = 1.0;
+  const int num_points = positions.rows();
+  const int num_joints = positions.cols();
 
-  if (max_velocity_scaling_factor > 0.0 && max_velocity_scaling_factor <= 1.0)  
-    velocity_scaling_factor = max_velocity_scaling_factor;
-  else
-    if (max_velocity_scaling_factor == 0.0)
-      logDebug("A max_velocity_scaling_factor of 0.0 was specified, defaulting to %f instead.", velocity_scaling_factor);
-    else
-      logWarn("Invalid max_velocity_scaling_factor %f specified, defaulting to %f instead.", max_velocity_scaling_factor, velocity_scaling_factor);
-
-  for (int i = 0 ; i < num_points-1 ; ++i)
+  for (int j = 0 ; j < num_joints ; ++j)
   {
-    const robot_state::RobotStatePtr &curr_waypoint = rob_trajectory.getWayPointPtr(i);
-    const robot_state::RobotStatePtr &next_waypoint = rob_trajectory.getWayPointPtr(i+1);
-
-    for (std::size_t j = 0 ; j < vars.size() ; ++j)
+    const double *q = positions.col(j).data();
+    const double v_max = max_velocities[j];
+    for (int i = 0 ; i < num_points-1 ; ++i)
     {
-      double v_max = 1.0;
-      const robot_model::VariableBounds &b = rmodel.getVariableBounds(vars[j]);
-      if (b.velocity_bounded_)
-        v_max = std::min(fabs(b.max_velocity_* velocity_scaling_factor), fabs(b.min_velocity_* velocity_scaling_factor));
-      const double dq1 = curr_waypoint->getVariablePosition(idx[j]);
-      const double dq2 = next_waypoint->getVariablePosition(idx[j]);
-      const double t_min = std::abs(dq2-dq1) / v_max;
+      const double t_min = std::abs(q[i+1]-q[i]) / v_max;
       if (t_min > time_diff[i])
         time_diff[i] = t_min;
     }
@@ -188,90 +168,57 @@ double IterativeParabolicTimeParameterization::findT2(const double dq1,
 namespace
 {
 
-// Takes the time differences, and updates the timestamps, velocities and accelerations
-// in the trajectory.
-void updateTrajectory(robot_trajectory::RobotTrajectory& rob_trajectory,
-                      const std::vector<double>& time_diff)
+// Takes the time differences, and computes the velocities and accelerations at the waypoints.
+// A column of the matrices holds the values of one joint at all waypoints.
+void computeDerivatives(const Eigen::MatrixXd &positions,
+                        const std::vector<double>& time_diff,
+                        const std::vector<double> *start_velocities,
+                        Eigen::MatrixXd &velocities,
+                        Eigen::MatrixXd &accelerations)
 {
-  // Error check
-  if (time_diff.empty())
-    return;
-
-  double time_sum = 0.0;
-  
-  robot_state::RobotStatePtr prev_waypoint;
-  robot_state::RobotStatePtr curr_waypoint;
-  robot_state::RobotStatePtr next_waypoint;
-
-  const robot_model::JointModelGroup *group = rob_trajectory.getGroup();
-  const std::vector<std::string> &vars = group->getVariableNames();
-  const std::vector<int> &idx = group->getVariableIndexList();
-
-  int num_points = rob_trajectory.getWayPointCount();
-  
-  rob_trajectory.setWayPointDurationFromPrevious(0, time_sum);
+  const int num_points = positions.rows();
+  const int num_joints = positions.cols();
+  velocities.resize(num_points, num_joints);
+  accelerations.resize(num_points, num_joints);
 
-  // Times
-  for (int i = 1; i < num_points; ++i)
-    // Update the time between the waypoints in the robot_trajectory.
-    rob_trajectory.setWayPointDurationFromPrevious(i, time_diff[i-1]);
-  
-  // Return if there is only one point in the trajectory!
-  if (num_points <= 1)
-    return;
-
-  // Accelerations
-  for (int i = 0; i < num_points; ++i)
+  for (int j = 0; j < num_joints; ++j)
   {
-    curr_waypoint = rob_trajectory.getWayPointPtr(i);
-    
-    if (i > 0)
-      prev_waypoint = rob_trajectory.getWayPointPtr(i-1);
-
-    if (i < num_points-1)
-      next_waypoint = rob_trajectory.getWayPointPtr(i+1);
-    
-    for (std::size_t j = 0; j < vars.size(); ++j)
+    const double *q = positions.col(j).data();
+    double *vel = velocities.col(j).data();
+    double *acc = accelerations.col(j).data();
+
+    for (int i = 0; i < num_points; ++i)
     {
       double q1;
-      double q2;
+      double q2 = q[i];
       double q3;
       double dt1;
       double dt2;
 
       if (i == 0)
-      { 
+      {
         // First point
-        q1 = next_waypoint->getVariablePosition(idx[j]);
-        q2 = curr_waypoint->getVariablePosition(idx[j]);
-        q3 = q1;
-        
+        q1 = q3 = q[i+1];
         dt1 = dt2 = time_diff[i];
       }
       else
         if (i < num_points-1)
         {
           // middle points
-          q1 = prev_waypoint->getVariablePosition(idx[j]);
-          q2 = curr_waypoint->getVariablePosition(idx[j]);
-          q3 = next_waypoint->getVariablePosition(idx[j]);
-          
+          q1 = q[i-1];
+          q3 = q[i+1];
           dt1 = time_diff[i-1];
           dt2 = time_diff[i];
         }
         else
-        { 
+        {
           // last point
-          q1 = prev_waypoint->getVariablePosition(idx[j]);
-          q2 = curr_waypoint->getVariablePosition(idx[j]);
-          q3 = q1;
-          
+          q1 = q3 = q[i-1];
           dt1 = dt2 = time_diff[i-1];
         }
-      
+
       double v1, v2, a;
 
-      bool start_velocity = false;
       if (dt1 == 0.0 || dt2 == 0.0)
       {
         v1 = 0.0;
@@ -280,22 +227,49 @@ void updateTrajectory(robot_trajectory::RobotTrajectory& rob_trajectory,
       }
       else
       {
-        if (i == 0)
+        if (i == 0 && start_velocities)
+          v1 = v2 = (*start_velocities)[j]; // Needed to ensure continuous velocity for first point
+        else
         {
-          if (curr_waypoint->hasVelocities())
-          {
-            start_velocity = true;
-            v1 = curr_waypoint->getVariableVelocity(idx[j]);
-          }
+          v1 = (q2-q1)/dt1;
+          v2 = (q3-q2)/dt2;
         }
-        v1 = start_velocity ? v1 : (q2-q1)/dt1;
-        //v2 = (q3-q2)/dt2;
-        v2 = start_velocity ? v1 : (q3-q2)/dt2; // Needed to ensure continuous velocity for first point
         a = 2.0*(v2-v1)/(dt1+dt2);
       }
-      
-      curr_waypoint->setVariableVelocity(idx[j], (v2+v1)/2.0);
-      curr_waypoint->setVariableAcceleration(idx[j], a);
+
+      vel[i] = (v2+v1)/2.0;
+      acc[i] = a;
+    }
+  }
+}
+
+// Writes the time differences, velocities and accelerations to the trajectory.
+void updateTrajectory(robot_trajectory::RobotTrajectory& rob_trajectory,
+                      const std::vector<double>& time_diff,
+                      const Eigen::MatrixXd &velocities,
+                      const Eigen::MatrixXd &accelerations)
+{
+  const std::vector<int> &idx = rob_trajectory.getGroup()->getVariableIndexList();
+  const int num_points = rob_trajectory.getWayPointCount();
+  const int num_joints = idx.size();
+
+  // Error check
+  if (time_diff.empty())
+    return;
+
+  rob_trajectory.setWayPointDurationFromPrevious(0, 0.0);
+  for (int i = 1; i < num_points; ++i)
+    rob_trajectory.setWayPointDurationFromPrevious(i, time_diff[i-1]);
+
+  for (int i = 0; i < num_points; ++i)
+  {
+    robot_state::RobotState &waypoint = *rob_trajectory.getWayPointPtr(i);
+    double *vel = waypoint.getVariableVelocities();
+    double *acc = waypoint.getVariableAccelerations();
+    for (int j = 0; j < num_joints; ++j)
+    {
+      vel[idx[j]] = velocities(i, j);
+      acc[idx[j]] = accelerations(i, j);
     }
   }
 }
@@ -303,20 +277,13 @@ void updateTrajectory(robot_trajectory::RobotTrajectory& rob_trajectory,
 
 
 // Applies Acceleration constraints
-void IterativeParabolicTimeParameterization::applyAccelerationConstraints(robot_trajectory::RobotTrajectory& rob_trajectory,
+void IterativeParabolicTimeParameterization::applyAccelerationConstraints(const Eigen::MatrixXd &positions,
+                                                                          const std::vector<double> &max_accelerations,
+                                                                          const std::vector<double> *start_velocities,
                                                                           std::vector<double> & time_diff) const
 {
-  robot_state::RobotStatePtr prev_waypoint;
-  robot_state::RobotStatePtr curr_waypoint;
-  robot_state::RobotStatePtr next_waypoint;
-
-  const robot_model::JointModelGroup *group = rob_trajectory.getGroup();
-  const std::vector<std::string> &vars = group->getVariableNames();
-  const std::vector<int> &idx = group->getVariableIndexList();
-  const robot_model::RobotModel &rmodel = group->getParentModel();
-  
-  const int num_points = rob_trajectory.getWayPointCount();
-  const unsigned int num_joints = group->getVariableCount();
+  const int num_points = positions.rows();
+  const int num_joints = positions.cols();
   int num_updates = 0;
   int iteration = 0;
   bool backwards = false;
@@ -336,35 +303,24 @@ void IterativeParabolicTimeParameterization::applyAccelerationConstraints(robot_
 
     // In this case we iterate through the joints on the outer loop.
     // This is so that any time interval increases have a chance to get propogated through the trajectory
-    for (unsigned int j = 0; j < num_joints ; ++j)
+    for (int j = 0; j < num_joints ; ++j)
     {
+      const double *q = positions.col(j).data();
+      const double a_max = max_accelerations[j];
+
       // Loop forwards, then backwards
       for (int count = 0; count < 2; ++count)
       {
         for (int i = 0 ; i < num_points-1; ++i)
         {
           int index = backwards ? (num_points-1)-i : i;
-          
-          curr_waypoint = rob_trajectory.getWayPointPtr(index);
-
-          if (index > 0)
-            prev_waypoint = rob_trajectory.getWayPointPtr(index-1);
-          
-          if (index < num_points-1)
-            next_waypoint = rob_trajectory.getWayPointPtr(index+1);
-
-          // Get acceleration limits
-          double a_max = 1.0;
-          const robot_model::VariableBounds &b = rmodel.getVariableBounds(vars[j]);
-          if (b.acceleration_bounded_)
-            a_max = std::min(fabs(b.max_acceleration_), fabs(b.min_acceleration_));
-          
+
           if (index == 0)
-          { 
+          {
             // First point
-            q1 = next_waypoint->getVariablePosition(idx[j]);
-            q2 = curr_waypoint->getVariablePosition(idx[j]);
-            q3 = next_waypoint->getVariablePosition(idx[j]);
+            q1 = q[index+1];
+            q2 = q[index];
+            q3 = q[index+1];
 
             dt1 = dt2 = time_diff[index];
             assert(!backwards);
@@ -373,42 +329,33 @@ void IterativeParabolicTimeParameterization::applyAccelerationConstraints(robot_
             if (index < num_points-1)
             {
               // middle points
-              q1 = prev_waypoint->getVariablePosition(idx[j]);
-              q2 = curr_waypoint->getVariablePosition(idx[j]);
-              q3 = next_waypoint->getVariablePosition(idx[j]);
-              
+              q1 = q[index-1];
+              q2 = q[index];
+              q3 = q[index+1];
+
               dt1 = time_diff[index-1];
               dt2 = time_diff[index];
             }
             else
-            { 
+            {
               // last point - careful, there are only numpoints-1 time intervals
-              q1 = prev_waypoint->getVariablePosition(idx[j]);
-              q2 = curr_waypoint->getVariablePosition(idx[j]);
-              q3 = prev_waypoint->getVariablePosition(idx[j]);
-              
+              q1 = q[index-1];
+              q2 = q[index];
+              q3 = q[index-1];
+
               dt1 = dt2 = time_diff[index-1];
               assert(backwards);
             }
-          
+
           if (dt1 == 0.0 || dt2 == 0.0)
           {
             v1 = 0.0;
             v2 = 0.0;
             a = 0.0;
-          } 
+          }
           else
           {
-            bool start_velocity = false;
-            if (index == 0)
-            {
-              if (curr_waypoint->hasVelocities())
-              {
-                start_velocity = true;
-                v1 = curr_waypoint->getVariableVelocity(idx[j]);
-              }
-            }
-            v1 = start_velocity ? v1 : (q2-q1)/dt1;
+            v1 = (index == 0 && start_velocities) ? (*start_velocities)[j] : (q2-q1)/dt1;
             v2 = (q3-q2)/dt2;
             a = 2.0*(v2-v1)/(dt1+dt2);
           }
@@ -426,19 +373,6 @@ void IterativeParabolicTimeParameterization::applyAccelerationConstraints(robot_
               time_diff[index-1] = dt1;
             }
             num_updates++;
-            
-            if (dt1 == 0.0 || dt2 == 0.0)
-            {
-              v1 = 0.0;
-              v2 = 0.0;
-              a = 0.0;
-            } 
-            else
-            {
-              v1 = (q2-q1)/dt1;
-              v2 = (q3-q2)/dt2;
-              a = 2*(v2-v1)/(dt1+dt2);
-            }
           }
         }
         backwards = !backwards;
@@ -464,13 +398,65 @@ bool IterativeParabolicTimeParameterization::computeTimeStamps(robot_trajectory:
   // this lib does not actually work properly when angles wrap around, so we need to unwind the path first
   trajectory.unwind();
 
+  double velocity_scaling_factor = 1.0;
+
+  if (max_velocity_scaling_factor > 0.0 && max_velocity_scaling_factor <= 1.0)
+    velocity_scaling_factor = max_velocity_scaling_factor;
+  else
+    if (max_velocity_scaling_factor == 0.0)
+      logDebug("A max_velocity_scaling_factor of 0.0 was specified, defaulting to %f instead.", velocity_scaling_factor);
+    else
+      logWarn("Invalid max_velocity_scaling_factor %f specified, defaulting to %f instead.", max_velocity_scaling_factor, velocity_scaling_factor);
+
+  const std::vector<std::string> &vars = group->getVariableNames();
+  const std::vector<int> &idx = group->getVariableIndexList();
+  const robot_model::RobotModel &rmodel = group->getParentModel();
   const int num_points = trajectory.getWayPointCount();
+  const int num_joints = vars.size();
+
+  // look up the limits once
+  std::vector<double> max_velocities(num_joints, DEFAULT_VEL_MAX);
+  std::vector<double> max_accelerations(num_joints, DEFAULT_ACCEL_MAX);
+  for (int j = 0 ; j < num_joints ; ++j)
+  {
+    const robot_model::VariableBounds &b = rmodel.getVariableBounds(vars[j]);
+    if (b.velocity_bounded_)
+      max_velocities[j] = std::min(fabs(b.max_velocity_* velocity_scaling_factor), fabs(b.min_velocity_* velocity_scaling_factor));
+    if (b.acceleration_bounded_)
+      max_accelerations[j] = std::min(fabs(b.max_acceleration_), fabs(b.min_acceleration_));
+  }
+
+  // extract the positions once; all passes work on this matrix (one column per joint)
+  Eigen::MatrixXd positions(num_points, num_joints);
+  for (int i = 0 ; i < num_points ; ++i)
+  {
+    const double *q = trajectory.getWayPoint(i).getVariablePositions();
+    for (int j = 0 ; j < num_joints ; ++j)
+      positions(i, j) = q[idx[j]];
+  }
+
+  // the first waypoint may specify the velocity to start with
+  std::vector<double> start_velocities;
+  const robot_state::RobotState &first_waypoint = trajectory.getFirstWayPoint();
+  if (first_waypoint.hasVelocities())
+  {
+    start_velocities.resize(num_joints);
+    for (int j = 0 ; j < num_joints ; ++j)
+      start_velocities[j] = first_waypoint.getVariableVelocity(idx[j]);
+  }
+  const std::vector<double> *start = start_velocities.empty() ? NULL : &start_velocities;
+
   std::vector<double> time_diff(num_points-1, 0.0);       // the time difference between adjacent points
-  
-  applyVelocityConstraints(trajectory, time_diff, max_velocity_scaling_factor);
-  applyAccelerationConstraints(trajectory, time_diff);
-  
-  updateTrajectory(trajectory, time_diff);
+
+  applyVelocityConstraints(positions, max_velocities, time_diff);
+  applyAccelerationConstraints(positions, max_accelerations, start, time_diff);
+
+  Eigen::MatrixXd velocities, accelerations;
+  if (num_points > 1)
+    computeDerivatives(positions, time_diff, start, velocities, accelerations);
+
+  // write the results back once
+  updateTrajectory(trajectory, time_diff, velocities, accelerations);
   return true;
 }
 
@@ -0,0 +1,316 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/jerk_limited_time_parameterization.h>
+#include <console_bridge/console.h>
+#include <algorithm>
+#include <cmath>
+
+namespace trajectory_processing
+{
+
+static const double EPSILON = 1e-9;
+
+// number of points the limits are checked at between consecutive grid points
+static const int SAMPLES_PER_SEGMENT = 16;
+
+namespace
+{
+
+// The time-optimal motion s(t) along the path: within a segment, the path acceleration is constant
+class TimeLaw
+{
+public:
+
+  TimeLaw(const PathTimeLaw &law) : s_(law.arc_length_), v_(law.path_velocity_)
+  {
+    const std::size_t m = s_.size();
+    t_.resize(m);
+    a_.assign(m, 0.0);
+    integral_.resize(m);
+    t_[0] = 0.0;
+    integral_[0] = 0.0;
+    for (std::size_t i = 0 ; i + 1 < m ; ++i)
+    {
+      // the acceleration that reaches the next grid point exactly in the computed time
+      const double dt = law.durations_[i + 1];
+      a_[i] = 2.0 * (s_[i + 1] - s_[i] - v_[i] * dt) / (dt * dt);
+      t_[i + 1] = t_[i] + dt;
+      integral_[i + 1] = integral_[i] + s_[i] * dt + v_[i] * dt * dt / 2.0 + a_[i] * dt * dt * dt / 6.0;
+    }
+    v_[m - 1] = 0.0;
+  }
+
+  double getDuration() const
+  {
+    return t_.back();
+  }
+
+  // the time grid point i is reached
+  double getTime(std::size_t i) const
+  {
+    return t_[i];
+  }
+
+  // evaluate s, ds/dt and the integral of s from 0, at time t
+  void evaluate(double t, double &s, double &v, double &integral) const
+  {
+    if (t <= 0.0)
+    {
+      s = s_[0];
+      v = 0.0;
+      integral = s_[0] * t;
+      return;
+    }
+    if (t >= t_.back())
+    {
+      s = s_.back();
+      v = 0.0;
+      integral = integral_.back() + s_.back() * (t - t_.back());
+      return;
+    }
+    const std::size_t i = std::upper_bound(t_.begin(), t_.end(), t) - t_.begin() - 1;
+    const double d = t - t_[i];
+    s = s_[i] + v_[i] * d + a_[i] * d * d / 2.0;
+    v = v_[i] + a_[i] * d;
+    integral = integral_[i] + s_[i] * d + v_[i] * d * d / 2.0 + a_[i] * d * d * d / 6.0;
+  }
+
+  // evaluate the motion filtered with a moving average over \e window: position, velocity and acceleration at time t
+  void evaluateFiltered(double t, double window, double &s, double &v, double &a) const
+  {
+    double s_prev, v_prev, integral, integral_prev;
+    evaluate(t, s, v, integral);
+    evaluate(t - window, s_prev, v_prev, integral_prev);
+    a = (v - v_prev) / window;
+    v = (s - s_prev) / window;
+    s = (integral - integral_prev) / window;
+  }
+
+private:
+
+  std::vector<double> t_;
+  std::vector<double> s_;
+  std::vector<double> v_;
+  std::vector<double> a_;
+  std::vector<double> integral_;
+};
+
+}
+
+JerkLimitedTimeParameterization::JerkLimitedTimeParameterization(double default_max_jerk)
+  : default_max_jerk_(1.0)
+{
+  setDefaultJerkLimit(default_max_jerk);
+}
+
+JerkLimitedTimeParameterization::~JerkLimitedTimeParameterization()
+{
+}
+
+void JerkLimitedTimeParameterization::setJerkLimit(const std::string &name, double max_jerk)
+{
+  if (max_jerk > 0.0)
+    max_jerks_[name] = max_jerk;
+  else
+    logError("The jerk limit of variable '%s' must be positive (not %lf)", name.c_str(), max_jerk);
+}
+
+void JerkLimitedTimeParameterization::setJerkLimits(const std::map<std::string, double> &max_jerks)
+{
+  for (std::map<std::string, double>::const_iterator it = max_jerks.begin() ; it != max_jerks.end() ; ++it)
+    setJerkLimit(it->first, it->second);
+}
+
+double JerkLimitedTimeParameterization::getJerkLimit(const std::string &name) const
+{
+  std::map<std::string, double>::const_iterator it = max_jerks_.find(name);
+  return it == max_jerks_.end() ? default_max_jerk_ : it->second;
+}
+
+void JerkLimitedTimeParameterization::setDefaultJerkLimit(double max_jerk)
+{
+  if (max_jerk > 0.0)
+    default_max_jerk_ = max_jerk;
+  else
+    logError("The default jerk limit must be positive (not %lf)", max_jerk);
+}
+
+bool JerkLimitedTimeParameterization::computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                                        const double max_velocity_scaling_factor) const
+{
+  return computeTimeStamps(trajectory, max_velocity_scaling_factor, 1.0);
+}
+
+bool JerkLimitedTimeParameterization::computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                                        const double max_velocity_scaling_factor,
+                                                        const double max_acceleration_scaling_factor) const
+{
+  if (trajectory.empty())
+    return true;
+
+  Eigen::MatrixXd q;
+  Eigen::VectorXd v_max, a_max;
+  if (!extractPath(trajectory, max_velocity_scaling_factor, max_acceleration_scaling_factor, q, v_max, a_max))
+    return false;
+
+  PathTimeLaw law;
+  if (!computeTimeLaw(q, v_max, a_max, law))
+    return false;
+
+  const int num_joints = q.rows();
+  const int num_points = q.cols();
+  const int m = law.waypoints_.size();
+  std::vector<double> durations(num_points, 0.0);
+  Eigen::MatrixXd qd = Eigen::MatrixXd::Zero(num_joints, num_points);
+  Eigen::MatrixXd qdd = Eigen::MatrixXd::Zero(num_joints, num_points);
+  if (m < 2)
+  {
+    writeTimeStamps(trajectory, durations, qd, qdd);
+    return true;
+  }
+
+  // the jerk of the filtered motion is the difference of two accelerations of the optimal motion divided by the window;
+  // accelerations can flip from +a to -a, so the window is the time needed to ramp the acceleration of any joint
+  // from -a to a
+  const std::vector<std::string> &vars = trajectory.getGroup()->getVariableNames();
+  Eigen::VectorXd j_max(num_joints);
+  double window = 0.0;
+  for (int j = 0 ; j < num_joints ; ++j)
+  {
+    j_max(j) = getJerkLimit(vars[j]);
+    window = std::max(window, 2.0 * a_max(j) / j_max(j));
+  }
+
+  // find the time each grid point is reached by the filtered motion
+  //   s_f(t) = 1/window * integral of s over [t - window, t]
+  // which lags the optimal motion by at most one window, and compute the joint velocities and accelerations there
+  const TimeLaw time_law(law);
+  const double duration = time_law.getDuration();
+  std::vector<double> times(m, 0.0);
+  Eigen::MatrixXd grid_qd(num_joints, m), grid_qdd(num_joints, m);
+  for (int i = 0 ; i < m ; ++i)
+  {
+    double s, v, integral, s_prev, v_prev, integral_prev;
+    if (i == m - 1)
+      times[i] = duration + window;
+    else if (i > 0)
+    {
+      // the filtered motion reaches the grid point at most one window later than the optimal one
+      double lower = std::max(times[i - 1], time_law.getTime(i));
+      double upper = time_law.getTime(i) + window;
+      while (upper - lower > EPSILON * (1.0 + upper))
+      {
+        const double t = 0.5 * (lower + upper);
+        time_law.evaluate(t, s, v, integral);
+        time_law.evaluate(t - window, s_prev, v_prev, integral_prev);
+        if ((integral - integral_prev) / window < law.arc_length_[i])
+          lower = t;
+        else
+          upper = t;
+      }
+      times[i] = 0.5 * (lower + upper);
+    }
+    time_law.evaluate(times[i], s, v, integral);
+    time_law.evaluate(times[i] - window, s_prev, v_prev, integral_prev);
+    const double path_velocity = (s - s_prev) / window;
+    const double path_acceleration = (v - v_prev) / window;
+    grid_qd.col(i) = law.first_derivatives_.col(i) * path_velocity;
+    grid_qdd.col(i) = law.first_derivatives_.col(i) * path_acceleration +
+      law.second_derivatives_.col(i) * (path_velocity * path_velocity);
+  }
+
+  // filtering keeps the path limits, but along a curved path the joint limits may be slightly exceeded;
+  // slowing down by a factor f divides velocities by f, accelerations by f^2 and jerks by f^3.
+  // The limits are checked on a time grid that is denser than the waypoints, with the path derivatives
+  // interpolated linearly in s between grid points
+  double factor = 1.0;
+  Eigen::VectorXd sample_qd(num_joints), sample_qdd(num_joints), previous_qdd = grid_qdd.col(0);
+  for (int j = 0 ; j < num_joints ; ++j)
+  {
+    factor = std::max(factor, fabs(grid_qd(j, 0)) / v_max(j));
+    factor = std::max(factor, sqrt(fabs(grid_qdd(j, 0)) / a_max(j)));
+  }
+  for (int i = 1 ; i < m ; ++i)
+  {
+    const double segment_duration = times[i] - times[i - 1];
+    if (segment_duration <= EPSILON)
+      continue;
+    const double dt = segment_duration / SAMPLES_PER_SEGMENT;
+    const double length = law.arc_length_[i] - law.arc_length_[i - 1];
+    for (int k = 1 ; k <= SAMPLES_PER_SEGMENT ; ++k)
+    {
+      if (k == SAMPLES_PER_SEGMENT)
+      {
+        sample_qd = grid_qd.col(i);
+        sample_qdd = grid_qdd.col(i);
+      }
+      else
+      {
+        double s, v, a;
+        time_law.evaluateFiltered(times[i - 1] + k * dt, window, s, v, a);
+        const double alpha = length > EPSILON ? std::max(0.0, std::min(1.0, (s - law.arc_length_[i - 1]) / length)) : 1.0;
+        const Eigen::VectorXd dq = (1.0 - alpha) * law.first_derivatives_.col(i - 1) + alpha * law.first_derivatives_.col(i);
+        const Eigen::VectorXd ddq = (1.0 - alpha) * law.second_derivatives_.col(i - 1) + alpha * law.second_derivatives_.col(i);
+        sample_qd = dq * v;
+        sample_qdd = dq * a + ddq * (v * v);
+      }
+      for (int j = 0 ; j < num_joints ; ++j)
+      {
+        factor = std::max(factor, fabs(sample_qd(j)) / v_max(j));
+        factor = std::max(factor, sqrt(fabs(sample_qdd(j)) / a_max(j)));
+        factor = std::max(factor, cbrt(fabs(sample_qdd(j) - previous_qdd(j)) / (dt * j_max(j))));
+      }
+      previous_qdd = sample_qdd;
+    }
+  }
+  if (factor > 1.0)
+    logDebug("Slowing down the jerk-limited trajectory by a factor of %lf to satisfy the joint limits", factor);
+
+  // waypoints that are not on the grid coincide with the previous grid point and get its values
+  for (int i = 0 ; i < m ; ++i)
+  {
+    durations[law.waypoints_[i]] = i > 0 ? (times[i] - times[i - 1]) * factor : 0.0;
+    const int end = i + 1 < m ? law.waypoints_[i + 1] : num_points;
+    for (int k = law.waypoints_[i] ; k < end ; ++k)
+    {
+      qd.col(k) = grid_qd.col(i) / factor;
+      qdd.col(k) = grid_qdd.col(i) / (factor * factor);
+    }
+  }
+  writeTimeStamps(trajectory, durations, qd, qdd);
+  return true;
+}
+
+}
@@ -0,0 +1,438 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/reachability_time_parameterization.h>
+#include <console_bridge/console.h>
+#include <Eigen/Core>
+#include <limits>
+#include <cmath>
+
+namespace trajectory_processing
+{
+
+static const double DEFAULT_VEL_MAX = 1.0;
+static const double DEFAULT_ACCEL_MAX = 1.0;
+static const double EPSILON = 1e-9;
+
+namespace
+{
+
+// A linear constraint a * u + b * x <= c on the path acceleration u and the squared path velocity x
+struct Constraint
+{
+  double a;
+  double b;
+  double c;
+};
+
+// Maximize cu * u + cx * x subject to the constraints. Since there are only two variables
+// and few constraints, the optimum is found by enumerating the vertices of the feasible polygon.
+// The constraints must describe a bounded set. Return false if the set is empty.
+bool maximize(const std::vector<Constraint> &constraints, double cu, double cx, double &u, double &x)
+{
+  bool found = false;
+  double best = -std::numeric_limits<double>::infinity();
+  const std::size_t count = constraints.size();
+  for (std::size_t k = 0 ; k < count ; ++k)
+    for (std::size_t l = k + 1 ; l < count ; ++l)
+    {
+      const Constraint &ck = constraints[k];
+      const Constraint &cl = constraints[l];
+      const double det = ck.a * cl.b - cl.a * ck.b;
+      if (fabs(det) < EPSILON * EPSILON)
+        continue;
+      const double vu = (ck.c * cl.b - cl.c * ck.b) / det;
+      const double vx = (ck.a * cl.c - cl.a * ck.c) / det;
+      const double value = cu * vu + cx * vx;
+      if (found && value <= best)
+        continue;
+      bool feasible = true;
+      for (std::size_t m = 0 ; m < count && feasible ; ++m)
+        if (constraints[m].a * vu + constraints[m].b * vx > constraints[m].c + EPSILON * (1.0 + fabs(constraints[m].c)))
+          feasible = false;
+      if (feasible)
+      {
+        found = true;
+        best = value;
+        u = vu;
+        x = vx;
+      }
+    }
+  return found;
+}
+
+// Bounds on the path acceleration u at squared path velocity x, given the joint acceleration limits
+void getAccelerationBounds(const Eigen::VectorXd &dq, const Eigen::VectorXd &ddq, const Eigen::VectorXd &a_max,
+                           double x, double &lower, double &upper)
+{
+  lower = -std::numeric_limits<double>::infinity();
+  upper = std::numeric_limits<double>::infinity();
+  for (int j = 0 ; j < dq.size() ; ++j)
+  {
+    if (fabs(dq(j)) < EPSILON)
+      continue;
+    const double b1 = (a_max(j) - ddq(j) * x) / dq(j);
+    const double b2 = (-a_max(j) - ddq(j) * x) / dq(j);
+    lower = std::max(lower, std::min(b1, b2));
+    upper = std::min(upper, std::max(b1, b2));
+  }
+}
+
+// A motion over a segment of length h that starts and ends with the squared path velocities x0 and x1: the
+// path accelerates at \e accel, moves at constant velocity once its squared velocity reaches x_top_max, and
+// decelerates at \e accel to arrive at x1. Return its duration and the path accelerations when leaving the start
+// and when arriving at the end of the segment.
+double getTrapezoidalMotion(double h, double x0, double x1, double accel, double x_top_max,
+                            double &leaving_acceleration, double &arriving_acceleration)
+{
+  const double x_top = std::max(std::max(x0, x1), std::min(0.5 * (x0 + x1) + accel * h, x_top_max));
+  const double s_top = sqrt(x_top);
+  if (s_top < EPSILON)
+    return std::numeric_limits<double>::infinity();
+  const double cruise = std::max(0.0, h - (2.0 * x_top - x0 - x1) / (2.0 * accel));
+  leaving_acceleration = x_top > x0 ? accel : (cruise > 0.0 ? 0.0 : -accel);
+  arriving_acceleration = x_top > x1 ? -accel : (cruise > 0.0 ? 0.0 : accel);
+  return (2.0 * s_top - sqrt(x0) - sqrt(x1)) / accel + cruise / s_top;
+}
+
+double checkScalingFactor(const double factor, const char *name)
+{
+  if (factor > 0.0 && factor <= 1.0)
+    return factor;
+  if (factor == 0.0)
+    logDebug("A %s of 0.0 was specified, defaulting to 1.0 instead.", name);
+  else
+    logWarn("Invalid %s %f specified, defaulting to 1.0 instead.", name, factor);
+  return 1.0;
+}
+
+}
+
+ReachabilityTimeParameterization::ReachabilityTimeParameterization()
+{
+}
+
+ReachabilityTimeParameterization::~ReachabilityTimeParameterization()
+{
+}
+
+bool ReachabilityTimeParameterization::computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                                         const double max_velocity_scaling_factor) const
+{
+  return computeTimeStamps(trajectory, max_velocity_scaling_factor, 1.0);
+}
+
+bool ReachabilityTimeParameterization::computeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                                         const double max_velocity_scaling_factor,
+                                                         const double max_acceleration_scaling_factor) const
+{
+  if (trajectory.empty())
+    return true;
+
+  Eigen::MatrixXd q;
+  Eigen::VectorXd v_max, a_max;
+  if (!extractPath(trajectory, max_velocity_scaling_factor, max_acceleration_scaling_factor, q, v_max, a_max))
+    return false;
+
+  PathTimeLaw law;
+  if (!computeTimeLaw(q, v_max, a_max, law))
+    return false;
+
+  // waypoints that are not on the grid coincide with the previous grid point and get its values
+  const int num_points = q.cols();
+  const int m = law.waypoints_.size();
+  std::vector<double> durations(num_points, 0.0);
+  Eigen::MatrixXd qd(q.rows(), num_points), qdd(q.rows(), num_points);
+  for (int i = 0 ; i < m ; ++i)
+  {
+    durations[law.waypoints_[i]] = law.durations_[i];
+    const double x = law.path_velocity_[i] * law.path_velocity_[i];
+    const double u = law.path_acceleration_[i];
+    const int end = i + 1 < m ? law.waypoints_[i + 1] : num_points;
+    for (int k = law.waypoints_[i] ; k < end ; ++k)
+    {
+      qd.col(k) = law.first_derivatives_.col(i) * law.path_velocity_[i];
+      qdd.col(k) = law.first_derivatives_.col(i) * u + law.second_derivatives_.col(i) * x;
+    }
+  }
+  writeTimeStamps(trajectory, durations, qd, qdd);
+  return true;
+}
+
+bool ReachabilityTimeParameterization::extractPath(robot_trajectory::RobotTrajectory& trajectory,
+                                                   const double max_velocity_scaling_factor,
+                                                   const double max_acceleration_scaling_factor,
+                                                   Eigen::MatrixXd &q,
+                                                   Eigen::VectorXd &v_max,
+                                                   Eigen::VectorXd &a_max) const
+{
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  if (!group)
+  {
+    logError("It looks like the planner did not set the group the plan was computed for");
+    return false;
+  }
+
+  const double velocity_scaling_factor = checkScalingFactor(max_velocity_scaling_factor, "max_velocity_scaling_factor");
+  const double acceleration_scaling_factor = checkScalingFactor(max_acceleration_scaling_factor, "max_acceleration_scaling_factor");
+
+  // angles that wrap around would appear as jumps in the path
+  trajectory.unwind();
+
+  const std::vector<std::string> &vars = group->getVariableNames();
+  const std::vector<int> &idx = group->getVariableIndexList();
+  const robot_model::RobotModel &rmodel = group->getParentModel();
+  const int num_joints = vars.size();
+  const int num_points = trajectory.getWayPointCount();
+
+  v_max.resize(num_joints);
+  a_max.resize(num_joints);
+  for (int j = 0 ; j < num_joints ; ++j)
+  {
+    const robot_model::VariableBounds &b = rmodel.getVariableBounds(vars[j]);
+    v_max(j) = DEFAULT_VEL_MAX;
+    if (b.velocity_bounded_)
+      v_max(j) = std::min(fabs(b.max_velocity_), fabs(b.min_velocity_));
+    v_max(j) *= velocity_scaling_factor;
+    a_max(j) = DEFAULT_ACCEL_MAX;
+    if (b.acceleration_bounded_)
+      a_max(j) = std::min(fabs(b.max_acceleration_), fabs(b.min_acceleration_));
+    a_max(j) *= acceleration_scaling_factor;
+  }
+
+  q.resize(num_joints, num_points);
+  for (int i = 0 ; i < num_points ; ++i)
+  {
+    const double *positions = trajectory.getWayPoint(i).getVariablePositions();
+    for (int j = 0 ; j < num_joints ; ++j)
+      q(j, i) = positions[idx[j]];
+  }
+  return true;
+}
+
+void ReachabilityTimeParameterization::writeTimeStamps(robot_trajectory::RobotTrajectory& trajectory,
+                                                       const std::vector<double> &durations,
+                                                       const Eigen::MatrixXd &qd,
+                                                       const Eigen::MatrixXd &qdd) const
+{
+  const std::vector<int> &idx = trajectory.getGroup()->getVariableIndexList();
+  const int num_joints = idx.size();
+  const int num_points = trajectory.getWayPointCount();
+  for (int i = 0 ; i < num_points ; ++i)
+  {
+    robot_state::RobotState &waypoint = *trajectory.getWayPointPtr(i);
+    double *velocities = waypoint.getVariableVelocities();
+    double *accelerations = waypoint.getVariableAccelerations();
+    for (int j = 0 ; j < num_joints ; ++j)
+    {
+      velocities[idx[j]] = qd(j, i);
+      accelerations[idx[j]] = qdd(j, i);
+    }
+    trajectory.setWayPointDurationFromPrevious(i, durations[i]);
+  }
+}
+
+bool ReachabilityTimeParameterization::computeTimeLaw(const Eigen::MatrixXd &q,
+                                                      const Eigen::VectorXd &v_max,
+                                                      const Eigen::VectorXd &a_max,
+                                                      PathTimeLaw &law)
+{
+  const int num_joints = q.rows();
+  const int num_points = q.cols();
+  law.waypoints_.clear();
+  law.arc_length_.clear();
+  law.path_velocity_.clear();
+  law.path_acceleration_.clear();
+  law.durations_.clear();
+  if (num_points == 0)
+  {
+    law.first_derivatives_.resize(num_joints, 0);
+    law.second_derivatives_.resize(num_joints, 0);
+    return true;
+  }
+
+  // waypoints that coincide with the previous one are not part of the grid; they get the values of that one
+  std::vector<int> grid;
+  std::vector<double> h;
+  grid.reserve(num_points);
+  h.reserve(num_points);
+  grid.push_back(0);
+  for (int k = 1 ; k < num_points ; ++k)
+  {
+    const double d = (q.col(k) - q.col(grid.back())).norm();
+    if (d > EPSILON)
+    {
+      h.push_back(d);
+      grid.push_back(k);
+    }
+  }
+  const int m = grid.size();
+  law.waypoints_ = grid;
+  law.arc_length_.resize(m);
+  law.arc_length_[0] = 0.0;
+  for (int i = 1 ; i < m ; ++i)
+    law.arc_length_[i] = law.arc_length_[i - 1] + h[i - 1];
+  law.path_velocity_.assign(m, 0.0);
+  law.path_acceleration_.assign(m, 0.0);
+  law.durations_.assign(m, 0.0);
+  Eigen::MatrixXd &dq = law.first_derivatives_;
+  Eigen::MatrixXd &ddq = law.second_derivatives_;
+  dq.setZero(num_joints, m);
+  ddq.setZero(num_joints, m);
+  if (m < 2)
+    return true;
+
+  // path derivatives with respect to arc length, by finite differences
+  Eigen::VectorXd d_prev = (q.col(grid[1]) - q.col(grid[0])) / h[0];
+  dq.col(0) = d_prev;
+  ddq.col(0).setZero();
+  for (int i = 1 ; i < m - 1 ; ++i)
+  {
+    Eigen::VectorXd d_next = (q.col(grid[i + 1]) - q.col(grid[i])) / h[i];
+    dq.col(i) = (h[i] * d_prev + h[i - 1] * d_next) / (h[i - 1] + h[i]);
+    ddq.col(i) = 2.0 * (d_next - d_prev) / (h[i - 1] + h[i]);
+    d_prev = d_next;
+  }
+  dq.col(m - 1) = d_prev;
+  ddq.col(m - 1).setZero();
+
+  // largest squared path velocity allowed by the joint velocity limits
+  std::vector<double> x_max(m, std::numeric_limits<double>::max());
+  for (int i = 0 ; i < m ; ++i)
+    for (int j = 0 ; j < num_joints ; ++j)
+      if (fabs(dq(j, i)) > EPSILON)
+      {
+        const double r = v_max(j) / fabs(dq(j, i));
+        x_max[i] = std::min(x_max[i], r * r);
+      }
+
+  // backward pass: intervals of squared path velocities from which the end can be reached at rest
+  std::vector<double> k_lower(m, 0.0), k_upper(m, 0.0);
+  std::vector<Constraint> constraints(2 * num_joints + 6);
+  const double u_bound = 1e6 * (1.0 + a_max.maxCoeff());
+  for (int i = m - 2 ; i >= 0 ; --i)
+  {
+    for (int j = 0 ; j < num_joints ; ++j)
+    {
+      Constraint &c1 = constraints[2 * j];
+      c1.a = dq(j, i);
+      c1.b = ddq(j, i);
+      c1.c = a_max(j);
+      Constraint &c2 = constraints[2 * j + 1];
+      c2.a = -dq(j, i);
+      c2.b = -ddq(j, i);
+      c2.c = a_max(j);
+    }
+    Constraint *c = &constraints[2 * num_joints];
+    c[0].a = 0.0; c[0].b = 1.0; c[0].c = std::min(x_max[i], 1e12);
+    c[1].a = 0.0; c[1].b = -1.0; c[1].c = 0.0;
+    c[2].a = 2.0 * h[i]; c[2].b = 1.0; c[2].c = k_upper[i + 1];
+    c[3].a = -2.0 * h[i]; c[3].b = -1.0; c[3].c = -k_lower[i + 1];
+    c[4].a = 1.0; c[4].b = 0.0; c[4].c = u_bound;
+    c[5].a = -1.0; c[5].b = 0.0; c[5].c = u_bound;
+
+    double u, x;
+    if (!maximize(constraints, 0.0, 1.0, u, x))
+    {
+      logError("Time parameterization failed: the end of the path cannot be reached from waypoint %d", grid[i]);
+      return false;
+    }
+    k_upper[i] = std::max(0.0, x);
+    maximize(constraints, 0.0, -1.0, u, x);
+    k_lower[i] = std::max(0.0, std::min(x, k_upper[i]));
+  }
+
+  // forward pass: greedily pick the largest controllable path velocity
+  std::vector<double> x(m, 0.0);
+  std::vector<double> &u = law.path_acceleration_;
+  x[0] = k_lower[0];
+  for (int i = 0 ; i < m - 1 ; ++i)
+  {
+    double lower, upper;
+    getAccelerationBounds(dq.col(i), ddq.col(i), a_max, x[i], lower, upper);
+    upper = std::min(upper, (k_upper[i + 1] - x[i]) / (2.0 * h[i]));
+    lower = std::max(lower, (k_lower[i + 1] - x[i]) / (2.0 * h[i]));
+    u[i] = upper >= lower ? upper : lower;
+    x[i + 1] = std::max(k_lower[i + 1], std::min(k_upper[i + 1], x[i] + 2.0 * h[i] * u[i]));
+  }
+  u[m - 1] = u[m - 2];
+
+  for (int i = 0 ; i < m - 1 ; ++i)
+  {
+    const double speed = sqrt(x[i]) + sqrt(x[i + 1]);
+    double dt = speed > EPSILON ? 2.0 * h[i] / speed : std::numeric_limits<double>::infinity();
+    if (speed < 1e-3)
+    {
+      // with a constant path acceleration, a segment that starts and ends (almost) at rest takes very long; it is
+      // faster to accelerate at its start and decelerate at its end. The velocities at both ends are unchanged
+      // and the accelerations written for them are those of this motion. The acceleration bounds are evaluated
+      // at the slowest and the fastest velocity of the motion, which bounds them over the whole segment.
+      double lower, upper;
+      getAccelerationBounds(dq.col(i), ddq.col(i), a_max, std::min(x[i], x[i + 1]), lower, upper);
+      double accel = std::min(upper, -lower);
+      const double x_top_max = std::min(x_max[i], x_max[i + 1]);
+      if (accel > EPSILON)
+      {
+        getAccelerationBounds(dq.col(i), ddq.col(i), a_max,
+                              std::min(0.5 * (x[i] + x[i + 1]) + accel * h[i], x_top_max), lower, upper);
+        accel = std::min(accel, std::min(upper, -lower));
+      }
+      double leaving, arriving;
+      const double duration = accel > EPSILON ?
+        getTrapezoidalMotion(h[i], x[i], x[i + 1], accel, x_top_max, leaving, arriving) :
+        std::numeric_limits<double>::infinity();
+      if (duration < dt)
+      {
+        dt = duration;
+        u[i] = leaving;
+        if (i == m - 2)
+          u[m - 1] = arriving;
+      }
+    }
+    if (!(dt <= std::numeric_limits<double>::max()))
+    {
+      // a joint that needs to move has no usable acceleration, or the path derivatives are degenerate
+      logError("Time parameterization failed: the path cannot be traversed from waypoint %d to waypoint %d in finite time",
+               grid[i], grid[i + 1]);
+      return false;
+    }
+    law.durations_[i + 1] = dt;
+  }
+
+  for (int i = 0 ; i < m ; ++i)
+    law.path_velocity_[i] = sqrt(x[i]);
+  return true;
+}
+
+}
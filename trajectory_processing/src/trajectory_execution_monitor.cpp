@@ -0,0 +1,278 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_execution_monitor.h>
+#include <console_bridge/console.h>
+#include <algorithm>
+#include <cmath>
+
+namespace trajectory_processing
+{
+
+TrajectoryExecutionMonitor::TrajectoryExecutionMonitor(const planning_scene::PlanningSceneConstPtr &scene)
+  : scene_(scene)
+  , group_(NULL)
+  , variable_count_(0)
+  , default_position_tolerance_(0.1)
+  , velocity_tolerance_(0.0)
+  , collision_horizon_(0.5)
+  , collision_samples_(5)
+  , segment_(0)
+{
+  reset();
+}
+
+void TrajectoryExecutionMonitor::setPlanningScene(const planning_scene::PlanningSceneConstPtr &scene)
+{
+  scene_ = scene;
+}
+
+void TrajectoryExecutionMonitor::setPositionTolerance(double tolerance)
+{
+  default_position_tolerance_ = tolerance;
+  std::fill(position_tolerances_.begin(), position_tolerances_.end(), tolerance);
+}
+
+bool TrajectoryExecutionMonitor::setPositionTolerances(const std::vector<double> &tolerances)
+{
+  if (tolerances.size() != variable_count_)
+  {
+    logError("Expected %u position tolerances for the execution monitor", (unsigned int)variable_count_);
+    return false;
+  }
+  position_tolerances_ = tolerances;
+  return true;
+}
+
+void TrajectoryExecutionMonitor::setVelocityTolerance(double tolerance)
+{
+  velocity_tolerance_ = tolerance;
+}
+
+void TrajectoryExecutionMonitor::setCollisionHorizon(double horizon, unsigned int samples)
+{
+  collision_horizon_ = horizon;
+  collision_samples_ = samples;
+}
+
+bool TrajectoryExecutionMonitor::setTrajectory(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  group_ = trajectory.getGroup();
+  if (!group_ || trajectory.empty())
+  {
+    logError("The execution monitor needs a non-empty trajectory for a group");
+    group_ = NULL;
+    variable_count_ = 0;
+    times_.clear();
+    return false;
+  }
+
+  const std::vector<int> &index = group_->getVariableIndexList();
+  const std::size_t n = index.size();
+  const std::size_t m = trajectory.getWayPointCount();
+  variable_count_ = n;
+  times_.resize(m);
+  positions_.resize(m * n);
+  velocities_.resize(m * n);
+  double time = 0.0;
+  for (std::size_t i = 0 ; i < m ; ++i)
+  {
+    if (i > 0)
+      time += trajectory.getWayPointDurationFromPrevious(i);
+    times_[i] = time;
+    const robot_state::RobotState &waypoint = trajectory.getWayPoint(i);
+    const double *positions = waypoint.getVariablePositions();
+    const double *velocities = waypoint.hasVelocities() ? waypoint.getVariableVelocities() : NULL;
+    for (std::size_t j = 0 ; j < n ; ++j)
+    {
+      positions_[i * n + j] = positions[index[j]];
+      velocities_[i * n + j] = velocities ? velocities[index[j]] : 0.0;
+    }
+  }
+
+  // waypoints without velocities get the slope of the path around them
+  for (std::size_t i = 0 ; i < m ; ++i)
+    if (!trajectory.getWayPoint(i).hasVelocities() && m > 1)
+    {
+      const std::size_t a = i > 0 ? i - 1 : 0;
+      const std::size_t b = i + 1 < m ? i + 1 : m - 1;
+      const double dt = times_[b] - times_[a];
+      for (std::size_t j = 0 ; j < n ; ++j)
+        velocities_[i * n + j] = dt > 0.0 ? (positions_[b * n + j] - positions_[a * n + j]) / dt : 0.0;
+    }
+
+  position_tolerances_.assign(n, default_position_tolerance_);
+  measured_positions_.resize(n);
+  measured_velocities_.resize(n);
+  reference_positions_.resize(n);
+  position_errors_.resize(n);
+  predicted_positions_.resize(n);
+
+  predicted_state_.reset(new robot_state::RobotState(trajectory.getFirstWayPoint()));
+  collision_request_.group_name = group_->getName();
+  reset();
+  return true;
+}
+
+void TrajectoryExecutionMonitor::reset()
+{
+  segment_ = 0;
+  status_.flags_ = 0;
+  status_.time_from_start_ = 0.0;
+  status_.waypoint_ = 0;
+  status_.max_position_error_ = 0.0;
+  status_.max_position_error_variable_ = -1;
+  status_.max_velocity_error_ = 0.0;
+  status_.collision_time_ = 0.0;
+}
+
+void TrajectoryExecutionMonitor::findSegment(double time, std::size_t &segment) const
+{
+  if (segment >= times_.size() || time < times_[segment])
+  {
+    // time went back; search from scratch
+    segment = std::upper_bound(times_.begin(), times_.end(), time) - times_.begin();
+    segment = segment > 0 ? segment - 1 : 0;
+    return;
+  }
+  while (segment + 1 < times_.size() && times_[segment + 1] <= time)
+    ++segment;
+}
+
+void TrajectoryExecutionMonitor::interpolatePositions(double time, std::size_t segment, double *positions) const
+{
+  const double *a = &positions_[segment * variable_count_];
+  if (segment + 1 >= times_.size() || times_[segment + 1] <= times_[segment])
+  {
+    std::copy(a, a + variable_count_, positions);
+    return;
+  }
+  const double *b = a + variable_count_;
+  const double alpha = std::min(1.0, std::max(0.0, (time - times_[segment]) / (times_[segment + 1] - times_[segment])));
+  for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+    positions[j] = a[j] + alpha * (b[j] - a[j]);
+}
+
+const TrajectoryExecutionMonitor::Status& TrajectoryExecutionMonitor::update(const robot_state::RobotState &state, double time_from_start)
+{
+  if (!group_)
+    return status_;
+  const std::vector<int> &index = group_->getVariableIndexList();
+  const double *positions = state.getVariablePositions();
+  for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+    measured_positions_[j] = positions[index[j]];
+  if (!state.hasVelocities())
+    return update(&measured_positions_[0], NULL, time_from_start);
+  const double *velocities = state.getVariableVelocities();
+  for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+    measured_velocities_[j] = velocities[index[j]];
+  return update(&measured_positions_[0], &measured_velocities_[0], time_from_start);
+}
+
+const TrajectoryExecutionMonitor::Status& TrajectoryExecutionMonitor::update(const double *positions, const double *velocities,
+                                                                             double time_from_start)
+{
+  if (!group_)
+    return status_;
+
+  findSegment(time_from_start, segment_);
+  interpolatePositions(time_from_start, segment_, &reference_positions_[0]);
+  status_.flags_ = time_from_start >= times_.back() ? TRAJECTORY_COMPLETE : 0;
+  status_.time_from_start_ = time_from_start;
+  status_.waypoint_ = segment_;
+
+  status_.max_position_error_ = 0.0;
+  status_.max_position_error_variable_ = -1;
+  for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+  {
+    position_errors_[j] = positions[j] - reference_positions_[j];
+    const double error = fabs(position_errors_[j]);
+    if (error > status_.max_position_error_)
+    {
+      status_.max_position_error_ = error;
+      status_.max_position_error_variable_ = j;
+    }
+    if (error > position_tolerances_[j])
+      status_.flags_ |= POSITION_TOLERANCE_VIOLATED;
+  }
+
+  status_.max_velocity_error_ = 0.0;
+  if (velocities)
+  {
+    // the reference velocity is interpolated like the positions
+    const double *a = &velocities_[segment_ * variable_count_];
+    const bool last = segment_ + 1 >= times_.size() || times_[segment_ + 1] <= times_[segment_];
+    const double alpha = last ? 0.0 :
+      std::min(1.0, std::max(0.0, (time_from_start - times_[segment_]) / (times_[segment_ + 1] - times_[segment_])));
+    for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+    {
+      const double reference = last ? a[j] : a[j] + alpha * (a[j + variable_count_] - a[j]);
+      status_.max_velocity_error_ = std::max(status_.max_velocity_error_, fabs(velocities[j] - reference));
+    }
+    if (velocity_tolerance_ > 0.0 && status_.max_velocity_error_ > velocity_tolerance_)
+      status_.flags_ |= VELOCITY_TOLERANCE_VIOLATED;
+  }
+
+  if (scene_ && collision_samples_ > 0 && collision_horizon_ > 0.0)
+    predictCollisions(time_from_start);
+  return status_;
+}
+
+void TrajectoryExecutionMonitor::predictCollisions(double time_from_start)
+{
+  // assume the current tracking error persists over the horizon
+  std::size_t segment = segment_;
+  for (unsigned int k = 1 ; k <= collision_samples_ ; ++k)
+  {
+    const double time = std::min(time_from_start + collision_horizon_ * k / collision_samples_, times_.back());
+    findSegment(time, segment);
+    interpolatePositions(time, segment, &predicted_positions_[0]);
+    for (std::size_t j = 0 ; j < variable_count_ ; ++j)
+      predicted_positions_[j] += position_errors_[j];
+    predicted_state_->setJointGroupPositions(group_, &predicted_positions_[0]);
+    predicted_state_->update();
+    collision_result_.clear();
+    scene_->checkCollision(collision_request_, collision_result_, *predicted_state_);
+    if (collision_result_.collision)
+    {
+      status_.flags_ |= COLLISION_PREDICTED;
+      status_.collision_time_ = time;
+      return;
+    }
+    if (time >= times_.back())
+      return;
+  }
+}
+
+}
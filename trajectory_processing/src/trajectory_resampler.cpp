@@ -0,0 +1,299 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_resampler.h>
+#include <console_bridge/console.h>
+#include <algorithm>
+#include <cmath>
+
+namespace trajectory_processing
+{
+
+static const double TIME_EPSILON = 1e-9;
+
+TrajectoryResampler::TrajectoryResampler(double period, Interpolation interpolation)
+  : period_(0.01)
+  , interpolation_(interpolation)
+  , effective_interpolation_(interpolation)
+  , variable_count_(0)
+  , waypoint_count_(0)
+  , sample_count_(0)
+  , next_sample_(0)
+  , segment_(0)
+  , time_(0.0)
+{
+  setPeriod(period);
+}
+
+void TrajectoryResampler::setPeriod(double period)
+{
+  if (period > 0.0)
+    period_ = period;
+  else
+    logError("Resampling period must be positive; keeping %f", period_);
+}
+
+void TrajectoryResampler::allocate(std::size_t waypoint_count, std::size_t variable_count)
+{
+  waypoint_count_ = waypoint_count;
+  variable_count_ = variable_count;
+  const std::size_t size = waypoint_count * variable_count;
+  positions_.resize(size);
+  velocities_.resize(size);
+  accelerations_.resize(size);
+  times_.resize(waypoint_count);
+  sample_positions_.resize(std::max<std::size_t>(variable_count, 1));
+  sample_velocities_.resize(std::max<std::size_t>(variable_count, 1));
+  sample_accelerations_.resize(std::max<std::size_t>(variable_count, 1));
+}
+
+bool TrajectoryResampler::start(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  sample_count_ = 0;
+  if (trajectory.empty())
+    return false;
+
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  const std::size_t waypoint_count = trajectory.getWayPointCount();
+  const std::size_t variable_count = group ? group->getVariableCount() : trajectory.getRobotModel()->getVariableCount();
+  allocate(waypoint_count, variable_count);
+
+  bool has_velocities = true;
+  bool has_accelerations = true;
+  double time = 0.0;
+  for (std::size_t i = 0 ; i < waypoint_count ; ++i)
+  {
+    const robot_state::RobotState &waypoint = trajectory.getWayPoint(i);
+    if (i > 0)
+      time += trajectory.getWayPointDurationFromPrevious(i);
+    times_[i] = time;
+    has_velocities = has_velocities && waypoint.hasVelocities();
+    has_accelerations = has_accelerations && waypoint.hasAccelerations();
+
+    double *positions = &positions_[i * variable_count];
+    double *velocities = &velocities_[i * variable_count];
+    double *accelerations = &accelerations_[i * variable_count];
+    if (group)
+    {
+      const std::vector<int> &idx = group->getVariableIndexList();
+      for (std::size_t j = 0 ; j < variable_count ; ++j)
+      {
+        positions[j] = waypoint.getVariablePosition(idx[j]);
+        velocities[j] = has_velocities ? waypoint.getVariableVelocity(idx[j]) : 0.0;
+        accelerations[j] = has_accelerations ? waypoint.getVariableAcceleration(idx[j]) : 0.0;
+      }
+    }
+    else
+    {
+      std::copy(waypoint.getVariablePositions(), waypoint.getVariablePositions() + variable_count, positions);
+      if (has_velocities)
+        std::copy(waypoint.getVariableVelocities(), waypoint.getVariableVelocities() + variable_count, velocities);
+      if (has_accelerations)
+        std::copy(waypoint.getVariableAccelerations(), waypoint.getVariableAccelerations() + variable_count, accelerations);
+    }
+  }
+  initializeSampling(has_velocities, has_accelerations);
+  return true;
+}
+
+bool TrajectoryResampler::start(const robot_trajectory::CompactRobotTrajectory &trajectory)
+{
+  sample_count_ = 0;
+  if (trajectory.empty())
+    return false;
+
+  const std::size_t waypoint_count = trajectory.getWayPointCount();
+  const std::size_t variable_count = trajectory.getVariableCount();
+  allocate(waypoint_count, variable_count);
+
+  const std::vector<double> &durations = trajectory.getWayPointDurations();
+  double time = 0.0;
+  for (std::size_t i = 0 ; i < waypoint_count ; ++i)
+  {
+    if (i > 0)
+      time += durations[i];
+    times_[i] = time;
+  }
+  std::copy(trajectory.getPositions().begin(), trajectory.getPositions().end(), positions_.begin());
+  if (trajectory.hasVelocities())
+    std::copy(trajectory.getWayPointVelocities(0), trajectory.getWayPointVelocities(0) + positions_.size(), velocities_.begin());
+  if (trajectory.hasAccelerations())
+    std::copy(trajectory.getWayPointAccelerations(0), trajectory.getWayPointAccelerations(0) + positions_.size(), accelerations_.begin());
+  initializeSampling(trajectory.hasVelocities(), trajectory.hasAccelerations());
+  return true;
+}
+
+void TrajectoryResampler::initializeSampling(bool has_velocities, bool has_accelerations)
+{
+  effective_interpolation_ = interpolation_;
+  if (effective_interpolation_ == QUINTIC && !has_accelerations)
+    effective_interpolation_ = CUBIC;
+  if (effective_interpolation_ == CUBIC && !has_velocities)
+    effective_interpolation_ = LINEAR;
+  if (effective_interpolation_ != interpolation_)
+    logDebug("Trajectory does not specify the derivatives needed for the requested interpolation; using a lower order");
+
+  const double duration = times_.back();
+  sample_count_ = (std::size_t)floor(duration / period_ + TIME_EPSILON) + 1;
+  if ((sample_count_ - 1) * period_ < duration - TIME_EPSILON)
+    ++sample_count_;
+  next_sample_ = 0;
+  segment_ = 0;
+  time_ = 0.0;
+}
+
+bool TrajectoryResampler::next()
+{
+  if (next_sample_ >= sample_count_)
+    return false;
+  time_ = next_sample_ * period_;
+  ++next_sample_;
+
+  const double t = std::min(time_, times_.back());
+  const std::size_t last = waypoint_count_ - 1;
+
+  // samples are produced in increasing order of time, so the segment only moves forward
+  while (segment_ + 1 < last && times_[segment_ + 1] <= t)
+    ++segment_;
+
+  const std::size_t n = variable_count_;
+  const double T = last > 0 ? times_[segment_ + 1] - times_[segment_] : 0.0;
+  if (T <= TIME_EPSILON)
+  {
+    // a single waypoint, or the end of the trajectory reached through segments of zero duration
+    const std::size_t i = last > 0 ? segment_ + 1 : 0;
+    std::copy(&positions_[i * n], &positions_[i * n] + n, sample_positions_.begin());
+    if (effective_interpolation_ == LINEAR)
+    {
+      std::fill(sample_velocities_.begin(), sample_velocities_.end(), 0.0);
+      std::fill(sample_accelerations_.begin(), sample_accelerations_.end(), 0.0);
+    }
+    else
+    {
+      std::copy(&velocities_[i * n], &velocities_[i * n] + n, sample_velocities_.begin());
+      std::copy(&accelerations_[i * n], &accelerations_[i * n] + n, sample_accelerations_.begin());
+    }
+    return true;
+  }
+
+  const double s = std::max(0.0, std::min(t - times_[segment_], T));
+  const double *p0 = &positions_[segment_ * n];
+  const double *p1 = p0 + n;
+  const double *v0 = &velocities_[segment_ * n];
+  const double *v1 = v0 + n;
+  const double *a0 = &accelerations_[segment_ * n];
+  const double *a1 = a0 + n;
+
+  switch (effective_interpolation_)
+  {
+    case LINEAR:
+      for (std::size_t j = 0 ; j < n ; ++j)
+      {
+        const double v = (p1[j] - p0[j]) / T;
+        sample_positions_[j] = p0[j] + v * s;
+        sample_velocities_[j] = v;
+        sample_accelerations_[j] = 0.0;
+      }
+      break;
+    case CUBIC:
+      for (std::size_t j = 0 ; j < n ; ++j)
+      {
+        const double h = p1[j] - p0[j];
+        const double c2 = (3.0 * h / T - 2.0 * v0[j] - v1[j]) / T;
+        const double c3 = (-2.0 * h / T + v0[j] + v1[j]) / (T * T);
+        sample_positions_[j] = p0[j] + s * (v0[j] + s * (c2 + s * c3));
+        sample_velocities_[j] = v0[j] + s * (2.0 * c2 + 3.0 * c3 * s);
+        sample_accelerations_[j] = 2.0 * c2 + 6.0 * c3 * s;
+      }
+      break;
+    case QUINTIC:
+    {
+      const double T2 = T * T;
+      const double T3 = T2 * T;
+      for (std::size_t j = 0 ; j < n ; ++j)
+      {
+        const double h = p1[j] - p0[j];
+        const double c2 = 0.5 * a0[j];
+        const double c3 = (20.0 * h - (8.0 * v1[j] + 12.0 * v0[j]) * T - (3.0 * a0[j] - a1[j]) * T2) / (2.0 * T3);
+        const double c4 = (-30.0 * h + (14.0 * v1[j] + 16.0 * v0[j]) * T + (3.0 * a0[j] - 2.0 * a1[j]) * T2) / (2.0 * T3 * T);
+        const double c5 = (12.0 * h - 6.0 * (v1[j] + v0[j]) * T + (a1[j] - a0[j]) * T2) / (2.0 * T3 * T2);
+        sample_positions_[j] = p0[j] + s * (v0[j] + s * (c2 + s * (c3 + s * (c4 + s * c5))));
+        sample_velocities_[j] = v0[j] + s * (2.0 * c2 + s * (3.0 * c3 + s * (4.0 * c4 + s * 5.0 * c5)));
+        sample_accelerations_[j] = 2.0 * c2 + s * (6.0 * c3 + s * (12.0 * c4 + s * 20.0 * c5));
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+bool TrajectoryResampler::resample(const robot_trajectory::RobotTrajectory &trajectory, const SampleCallback &callback)
+{
+  if (!start(trajectory))
+    return false;
+  while (next())
+    if (!callback(time_, getPositions(), getVelocities(), getAccelerations()))
+      return false;
+  return true;
+}
+
+std::size_t TrajectoryResampler::resample(const robot_trajectory::RobotTrajectory &trajectory,
+                                          std::vector<double> &positions, std::vector<double> &velocities, std::vector<double> &accelerations)
+{
+  if (!start(trajectory))
+  {
+    positions.clear();
+    velocities.clear();
+    accelerations.clear();
+    return 0;
+  }
+  collectSamples(positions, velocities, accelerations);
+  return sample_count_;
+}
+
+void TrajectoryResampler::collectSamples(std::vector<double> &positions, std::vector<double> &velocities, std::vector<double> &accelerations)
+{
+  const std::size_t n = variable_count_;
+  positions.resize(sample_count_ * n);
+  velocities.resize(sample_count_ * n);
+  accelerations.resize(sample_count_ * n);
+  for (std::size_t k = 0 ; next() ; ++k)
+  {
+    std::copy(sample_positions_.begin(), sample_positions_.begin() + n, positions.begin() + k * n);
+    std::copy(sample_velocities_.begin(), sample_velocities_.begin() + n, velocities.begin() + k * n);
+    std::copy(sample_accelerations_.begin(), sample_accelerations_.begin() + n, accelerations.begin() + k * n);
+  }
+}
+
+}
@@ -0,0 +1,324 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_shortcutter.h>
+#include <random_numbers/random_numbers.h>
+#include <console_bridge/console.h>
+#include <moveit/background_processing/task_scheduler.h>
+#include <ros/time.h>
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace trajectory_processing
+{
+
+static const double EPSILON = 1e-9;
+
+namespace
+{
+
+struct LargerGain
+{
+  template<typename T>
+  bool operator()(const T &a, const T &b) const
+  {
+    return a.gain_ > b.gain_;
+  }
+};
+
+}
+
+TrajectoryShortcutter::TrajectoryShortcutter(const planning_scene::PlanningSceneConstPtr &scene)
+  : scene_(scene)
+  , seed_(0)
+  , thread_count_(0)
+  , candidates_per_round_(32)
+  , max_rounds_(100)
+  , resolution_(0.01)
+{
+}
+
+bool TrajectoryShortcutter::setPathConstraints(const moveit_msgs::Constraints &constraints)
+{
+  kinematic_constraints::KinematicConstraintSetPtr constraint_set(new kinematic_constraints::KinematicConstraintSet(scene_->getRobotModel()));
+  if (!constraint_set->add(constraints, scene_->getTransforms()))
+  {
+    logError("Unable to use the path constraints for shortcutting");
+    return false;
+  }
+  path_constraints_ = constraint_set;
+  return true;
+}
+
+void TrajectoryShortcutter::clearPathConstraints()
+{
+  path_constraints_.reset();
+}
+
+void TrajectoryShortcutter::setResolution(double resolution)
+{
+  if (resolution > 0.0)
+    resolution_ = resolution;
+  else
+    logError("The shortcutting resolution must be positive (not %lf)", resolution);
+}
+
+bool TrajectoryShortcutter::isStateValid(robot_state::RobotState &state, const robot_model::JointModelGroup *group) const
+{
+  state.update();
+  if (path_constraints_)
+    return scene_->isStateValid(state, *path_constraints_, group->getName());
+  return scene_->isStateValid(state, group->getName());
+}
+
+bool TrajectoryShortcutter::isSegmentValid(const robot_state::RobotState &from, const robot_state::RobotState &to,
+                                           const robot_model::JointModelGroup *group, robot_state::RobotState &state) const
+{
+  const std::size_t steps = (std::size_t)ceil(from.distance(to, group) / resolution_);
+  if (steps < 2)
+    return true;
+  state = from;
+  for (std::size_t k = 1 ; k < steps ; ++k)
+  {
+    from.interpolate(to, (double)k / (double)steps, state, group);
+    if (!isStateValid(state, group))
+      return false;
+  }
+  return true;
+}
+
+double TrajectoryShortcutter::getPathLength(const robot_trajectory::RobotTrajectory &trajectory)
+{
+  double length = 0.0;
+  for (std::size_t k = 1 ; k < trajectory.getWayPointCount() ; ++k)
+    length += trajectory.getWayPoint(k - 1).distance(trajectory.getWayPoint(k), trajectory.getGroup());
+  return length;
+}
+
+void TrajectoryShortcutter::runInParallel(std::size_t count, const boost::function<void(std::size_t, std::size_t)> &function) const
+{
+  moveit::tools::TaskScheduler &scheduler = moveit::tools::TaskScheduler::Instance();
+  unsigned int thread_count = thread_count_;
+  if (thread_count == 0)
+    thread_count = scheduler.getThreadCount();
+  if (thread_count > count)
+    thread_count = count;
+  if (thread_count == 0)
+    return;
+
+  scheduler.parallelFor(0, count, function, (count + thread_count - 1) / thread_count);
+}
+
+void TrajectoryShortcutter::validateShortcuts(const std::vector<robot_state::RobotStatePtr> *waypoints,
+                                              const robot_model::JointModelGroup *group,
+                                              std::vector<Candidate> *candidates, ros::WallTime end_time,
+                                              std::size_t begin, std::size_t end) const
+{
+  robot_state::RobotState state(*waypoints->front());
+  for (std::size_t c = begin ; c < end ; ++c)
+  {
+    Candidate &candidate = (*candidates)[c];
+    if (candidate.gain_ > EPSILON && ros::WallTime::now() < end_time)
+      candidate.valid_ = isSegmentValid(*(*waypoints)[candidate.start_], *(*waypoints)[candidate.end_], group, state);
+  }
+}
+
+bool TrajectoryShortcutter::shortcut(robot_trajectory::RobotTrajectory &trajectory, double allowed_time) const
+{
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  if (!group)
+  {
+    logError("It looks like the planner did not set the group the plan was computed for");
+    return false;
+  }
+  if (trajectory.getWayPointCount() < 3)
+    return true;
+
+  const ros::WallTime end_time = ros::WallTime::now() + ros::WallDuration(allowed_time);
+  random_numbers::RandomNumberGenerator rng(seed_);
+
+  std::vector<robot_state::RobotStatePtr> waypoints(trajectory.getWayPointCount());
+  for (std::size_t k = 0 ; k < waypoints.size() ; ++k)
+    waypoints[k] = trajectory.getWayPointPtr(k);
+  const double initial_length = getPathLength(trajectory);
+
+  std::vector<double> length;
+  std::vector<Candidate> candidates;
+  std::vector<bool> used;
+  std::vector<bool> removed;
+  for (unsigned int round = 0 ; round < max_rounds_ && waypoints.size() > 2 && ros::WallTime::now() < end_time ; ++round)
+  {
+    // length of the path up to each waypoint
+    const std::size_t n = waypoints.size();
+    length.resize(n);
+    length[0] = 0.0;
+    for (std::size_t k = 1 ; k < n ; ++k)
+      length[k] = length[k - 1] + waypoints[k - 1]->distance(*waypoints[k], group);
+
+    // the candidates only depend on the random number generator, not on the number of threads
+    candidates.resize(candidates_per_round_);
+    for (std::size_t c = 0 ; c < candidates.size() ; ++c)
+    {
+      Candidate &candidate = candidates[c];
+      candidate.start_ = rng.uniformInteger(0, (int)n - 3);
+      candidate.end_ = rng.uniformInteger((int)candidate.start_ + 2, (int)n - 1);
+      candidate.gain_ = length[candidate.end_] - length[candidate.start_] -
+        waypoints[candidate.start_]->distance(*waypoints[candidate.end_], group);
+      candidate.valid_ = false;
+    }
+    runInParallel(candidates.size(), boost::bind(&TrajectoryShortcutter::validateShortcuts, this, &waypoints, group, &candidates, end_time, _1, _2));
+
+    // apply the valid shortcuts that do not overlap, largest gain first
+    std::stable_sort(candidates.begin(), candidates.end(), LargerGain());
+    used.assign(n, false);
+    removed.assign(n, false);
+    bool changed = false;
+    for (std::size_t c = 0 ; c < candidates.size() ; ++c)
+    {
+      const Candidate &candidate = candidates[c];
+      if (!candidate.valid_)
+        continue;
+      bool overlaps = false;
+      for (std::size_t k = candidate.start_ ; k < candidate.end_ && !overlaps ; ++k)
+        overlaps = used[k];
+      if (overlaps)
+        continue;
+      for (std::size_t k = candidate.start_ ; k < candidate.end_ ; ++k)
+        used[k] = true;
+      for (std::size_t k = candidate.start_ + 1 ; k < candidate.end_ ; ++k)
+        removed[k] = true;
+      changed = true;
+    }
+    if (changed)
+    {
+      std::size_t kept = 0;
+      for (std::size_t k = 0 ; k < n ; ++k)
+        if (!removed[k])
+          waypoints[kept++] = waypoints[k];
+      waypoints.resize(kept);
+    }
+  }
+
+  setWayPoints(trajectory, waypoints);
+  logDebug("Shortcutting reduced the path length from %lf to %lf", initial_length, getPathLength(trajectory));
+  return true;
+}
+
+void TrajectoryShortcutter::smoothWayPoints(const std::vector<robot_state::RobotStatePtr> *waypoints,
+                                            const robot_model::JointModelGroup *group,
+                                            const std::vector<std::size_t> *indices, std::vector<robot_state::RobotStatePtr> *moved,
+                                            std::size_t begin, std::size_t end) const
+{
+  robot_state::RobotState midpoint(*waypoints->front());
+  robot_state::RobotState state(*waypoints->front());
+  for (std::size_t i = begin ; i < end ; ++i)
+  {
+    const std::size_t k = (*indices)[i];
+    const robot_state::RobotState &previous = *(*waypoints)[k - 1];
+    const robot_state::RobotState &current = *(*waypoints)[k];
+    const robot_state::RobotState &next = *(*waypoints)[k + 1];
+
+    robot_state::RobotStatePtr candidate(new robot_state::RobotState(current));
+    midpoint = current;
+    previous.interpolate(next, 0.5, midpoint, group);
+    current.interpolate(midpoint, 0.5, *candidate, group);
+
+    const double old_length = previous.distance(current, group) + current.distance(next, group);
+    const double new_length = previous.distance(*candidate, group) + candidate->distance(next, group);
+    if (new_length < old_length - EPSILON && isStateValid(*candidate, group) &&
+        isSegmentValid(previous, *candidate, group, state) && isSegmentValid(*candidate, next, group, state))
+      (*moved)[i] = candidate;
+  }
+}
+
+bool TrajectoryShortcutter::smooth(robot_trajectory::RobotTrajectory &trajectory, unsigned int iterations) const
+{
+  const robot_model::JointModelGroup *group = trajectory.getGroup();
+  if (!group)
+  {
+    logError("It looks like the planner did not set the group the plan was computed for");
+    return false;
+  }
+  const std::size_t n = trajectory.getWayPointCount();
+  if (n < 3)
+    return true;
+
+  std::vector<robot_state::RobotStatePtr> waypoints(n);
+  for (std::size_t k = 0 ; k < n ; ++k)
+    waypoints[k] = trajectory.getWayPointPtr(k);
+
+  // waypoints of the same parity are not neighbors, so they can be moved at the same time
+  std::vector<std::size_t> indices;
+  std::vector<robot_state::RobotStatePtr> moved;
+  for (unsigned int iteration = 0 ; iteration < iterations ; ++iteration)
+    for (std::size_t parity = 1 ; parity <= 2 ; ++parity)
+    {
+      indices.clear();
+      for (std::size_t k = parity ; k + 1 < n ; k += 2)
+        indices.push_back(k);
+      moved.assign(indices.size(), robot_state::RobotStatePtr());
+      runInParallel(indices.size(), boost::bind(&TrajectoryShortcutter::smoothWayPoints, this, &waypoints, group, &indices, &moved, _1, _2));
+      for (std::size_t i = 0 ; i < indices.size() ; ++i)
+        if (moved[i])
+          waypoints[indices[i]] = moved[i];
+    }
+
+  setWayPoints(trajectory, waypoints);
+  return true;
+}
+
+void TrajectoryShortcutter::setWayPoints(robot_trajectory::RobotTrajectory &trajectory, const std::vector<robot_state::RobotStatePtr> &waypoints)
+{
+  const std::vector<int> &idx = trajectory.getGroup()->getVariableIndexList();
+  trajectory.clear();
+  for (std::size_t k = 0 ; k < waypoints.size() ; ++k)
+  {
+    robot_state::RobotStatePtr waypoint = waypoints[k];
+    if (waypoint->hasVelocities() || waypoint->hasAccelerations())
+    {
+      waypoint.reset(new robot_state::RobotState(*waypoint));
+      for (std::size_t j = 0 ; j < idx.size() ; ++j)
+      {
+        if (waypoint->hasVelocities())
+          waypoint->setVariableVelocity(idx[j], 0.0);
+        if (waypoint->hasAccelerations())
+          waypoint->setVariableAcceleration(idx[j], 0.0);
+      }
+    }
+    trajectory.addSuffixWayPoint(waypoint, 0.0);
+  }
+}
+
+}
@@ -0,0 +1,283 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/iterative_time_parameterization.h>
+#include <moveit/trajectory_processing/reachability_time_parameterization.h>
+#include <moveit/trajectory_processing/jerk_limited_time_parameterization.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using trajectory_processing::PathTimeLaw;
+using trajectory_processing::ReachabilityTimeParameterization;
+
+// a curved path through two joints, one waypoint per column
+static Eigen::MatrixXd makePath(int num_points)
+{
+  Eigen::MatrixXd positions(2, num_points);
+  for (int k = 0 ; k < num_points ; ++k)
+  {
+    const double s = k / (double)(num_points - 1);
+    positions(0, k) = sin(3.0 * s);
+    positions(1, k) = cos(2.0 * s);
+  }
+  return positions;
+}
+
+TEST(ReachabilityTimeParameterization, LimitsAreMet)
+{
+  Eigen::VectorXd max_velocities(2), max_accelerations(2);
+  max_velocities << 1.0, 0.5;
+  max_accelerations << 2.0, 1.0;
+  const int sizes[] = { 3, 20, 200 };
+  for (int n = 0 ; n < 3 ; ++n)
+  {
+    PathTimeLaw law;
+    ASSERT_TRUE(ReachabilityTimeParameterization::computeTimeLaw(makePath(sizes[n]), max_velocities, max_accelerations, law));
+    const int m = law.waypoints_.size();
+    ASSERT_EQ(sizes[n], m);
+
+    // the motion starts and ends at rest
+    EXPECT_NEAR(0.0, law.path_velocity_[0], 1e-9);
+    EXPECT_NEAR(0.0, law.path_velocity_[m - 1], 1e-9);
+    for (int i = 0 ; i < m ; ++i)
+    {
+      if (i > 0)
+      {
+        EXPECT_GT(law.durations_[i], 0.0);
+        EXPECT_TRUE(law.durations_[i] < std::numeric_limits<double>::infinity());
+      }
+      const double x = law.path_velocity_[i] * law.path_velocity_[i];
+      const Eigen::VectorXd velocity = law.first_derivatives_.col(i) * law.path_velocity_[i];
+      const Eigen::VectorXd acceleration = law.first_derivatives_.col(i) * law.path_acceleration_[i] +
+        law.second_derivatives_.col(i) * x;
+      for (int j = 0 ; j < 2 ; ++j)
+      {
+        EXPECT_LE(fabs(velocity(j)), max_velocities(j) * (1.0 + 1e-6));
+        EXPECT_LE(fabs(acceleration(j)), max_accelerations(j) * (1.0 + 1e-6));
+      }
+    }
+  }
+}
+
+TEST(ReachabilityTimeParameterization, RepeatedWaypointsAreSkipped)
+{
+  Eigen::MatrixXd positions = makePath(10);
+  Eigen::MatrixXd repeated(2, 11);
+  repeated << positions.leftCols(5), positions.col(4), positions.rightCols(5);
+  Eigen::VectorXd max_velocities = Eigen::VectorXd::Ones(2), max_accelerations = Eigen::VectorXd::Ones(2);
+  PathTimeLaw law;
+  ASSERT_TRUE(ReachabilityTimeParameterization::computeTimeLaw(repeated, max_velocities, max_accelerations, law));
+  ASSERT_EQ(10u, law.waypoints_.size());
+  EXPECT_EQ(4, law.waypoints_[4]);
+  EXPECT_EQ(6, law.waypoints_[5]);
+}
+
+TEST(ReachabilityTimeParameterization, ZeroAccelerationFails)
+{
+  // the first joint moves but cannot accelerate: no finite duration exists
+  Eigen::MatrixXd positions(2, 5);
+  for (int k = 0 ; k < 5 ; ++k)
+  {
+    positions(0, k) = 0.1 * k;
+    positions(1, k) = 0.0;
+  }
+  Eigen::VectorXd max_velocities = Eigen::VectorXd::Ones(2), max_accelerations = Eigen::VectorXd::Ones(2);
+  max_accelerations(0) = 0.0;
+  PathTimeLaw law;
+  EXPECT_FALSE(ReachabilityTimeParameterization::computeTimeLaw(positions, max_velocities, max_accelerations, law));
+}
+
+TEST(ReachabilityTimeParameterization, RestToRestSegment)
+{
+  // a single segment starts and ends at rest: it accelerates at the acceleration limit, moves at the velocity
+  // limit if it reaches it, and decelerates at the acceleration limit
+  Eigen::MatrixXd positions(1, 2);
+  positions << 0.0, 1.0;
+  Eigen::VectorXd max_velocities(1), max_accelerations(1);
+  max_accelerations << 1.0;
+  const double velocity_limits[] = { 10.0, 0.5 };
+  const double expected_durations[] = { 2.0, 2.5 };
+  for (int n = 0 ; n < 2 ; ++n)
+  {
+    max_velocities << velocity_limits[n];
+    PathTimeLaw law;
+    ASSERT_TRUE(ReachabilityTimeParameterization::computeTimeLaw(positions, max_velocities, max_accelerations, law));
+    ASSERT_EQ(2u, law.waypoints_.size());
+    EXPECT_NEAR(expected_durations[n], law.durations_[1], 1e-9);
+    EXPECT_NEAR(0.0, law.path_velocity_[0], 1e-9);
+    EXPECT_NEAR(0.0, law.path_velocity_[1], 1e-9);
+    EXPECT_NEAR(1.0, law.path_acceleration_[0], 1e-9);
+    EXPECT_NEAR(-1.0, law.path_acceleration_[1], 1e-9);
+  }
+}
+
+TEST(IterativeParabolicTimeParameterization, MatchesReferenceTimestamps)
+{
+  robot_model::RobotModelConstPtr robot_model = moveit::core::loadTestingRobotModel("planar_arm");
+  ASSERT_TRUE(robot_model);
+  const std::vector<int> &idx = robot_model->getJointModelGroup("arm")->getVariableIndexList();
+
+  // a fixed path that is limited by velocity on some segments and by acceleration on others
+  // (velocity limits 1 and 0.5 from the URDF, acceleration limits default to 1)
+  const double path[8][2] = { { 0.0, 0.0 }, { 0.1, -0.2 }, { 0.4, -0.3 }, { 0.9, 0.1 },
+                              { 1.0, 0.4 }, { 0.6, 0.4 }, { 0.5, 0.2 }, { 0.5, 0.0 } };
+  // the timestamps computed by the implementation that read the positions from the waypoints,
+  // without and with a start velocity of (0.2, -0.1)
+  const double expected_times[2][8] = { { 0.0, 0.63, 1.08, 1.97, 2.75, 3.42, 3.9, 4.53 },
+                                        { 0.0, 0.47, 0.93, 1.81, 2.59, 3.26, 3.74, 4.37 } };
+  const double start_velocity[2] = { 0.2, -0.1 };
+
+  trajectory_processing::IterativeParabolicTimeParameterization parameterization;
+  for (int n = 0 ; n < 2 ; ++n)
+  {
+    robot_trajectory::RobotTrajectory trajectory(robot_model, "arm");
+    for (int k = 0 ; k < 8 ; ++k)
+    {
+      robot_state::RobotState state(robot_model);
+      state.setToDefaultValues();
+      state.setVariablePosition(idx[0], path[k][0]);
+      state.setVariablePosition(idx[1], path[k][1]);
+      if (k == 0 && n == 1)
+      {
+        state.setVariableVelocity(idx[0], start_velocity[0]);
+        state.setVariableVelocity(idx[1], start_velocity[1]);
+      }
+      trajectory.addSuffixWayPoint(state, 0.0);
+    }
+    ASSERT_TRUE(parameterization.computeTimeStamps(trajectory));
+
+    for (int k = 0 ; k < 8 ; ++k)
+      EXPECT_NEAR(expected_times[n][k], trajectory.getWaypointDurationFromStart(k), 1e-9);
+
+    // the velocities of the middle waypoints average the neighbouring segments
+    for (int k = 1 ; k < 7 ; ++k)
+      for (int j = 0 ; j < 2 ; ++j)
+      {
+        const double dt1 = trajectory.getWayPointDurationFromPrevious(k);
+        const double dt2 = trajectory.getWayPointDurationFromPrevious(k + 1);
+        const double v1 = (path[k][j] - path[k - 1][j]) / dt1;
+        const double v2 = (path[k + 1][j] - path[k][j]) / dt2;
+        EXPECT_NEAR((v1 + v2) / 2.0, trajectory.getWayPoint(k).getVariableVelocity(idx[j]), 1e-9);
+        EXPECT_NEAR(2.0 * (v2 - v1) / (dt1 + dt2), trajectory.getWayPoint(k).getVariableAcceleration(idx[j]), 1e-9);
+      }
+
+    // the first waypoint keeps the start velocity if there is one; otherwise it is at rest and
+    // accelerates towards the second waypoint, for all joints (the reference implementation only
+    // did this for the first joint and left the acceleration of the others at zero)
+    const double dt = trajectory.getWayPointDurationFromPrevious(1);
+    for (int j = 0 ; j < 2 ; ++j)
+    {
+      const robot_state::RobotState &first = trajectory.getFirstWayPoint();
+      if (n == 0)
+      {
+        EXPECT_NEAR(0.0, first.getVariableVelocity(idx[j]), 1e-9);
+        EXPECT_NEAR(2.0 * (path[1][j] - path[0][j]) / (dt * dt), first.getVariableAcceleration(idx[j]), 1e-9);
+      }
+      else
+      {
+        EXPECT_NEAR(start_velocity[j], first.getVariableVelocity(idx[j]), 1e-9);
+        EXPECT_NEAR(0.0, first.getVariableAcceleration(idx[j]), 1e-9);
+      }
+    }
+  }
+}
+
+TEST(JerkLimitedTimeParameterization, LimitsAreMet)
+{
+  robot_model::RobotModelConstPtr robot_model = moveit::core::loadTestingRobotModel("planar_arm");
+  ASSERT_TRUE(robot_model);
+  const robot_model::JointModelGroup *group = robot_model->getJointModelGroup("arm");
+  const std::vector<int> &idx = group->getVariableIndexList();
+
+  // velocity limits come from the URDF, acceleration limits default to 1
+  const double max_velocities[] = { 1.0, 0.5 };
+  const double max_acceleration = 1.0;
+  const double max_jerks[] = { 5.0, 2.0 };
+  trajectory_processing::JerkLimitedTimeParameterization parameterization(5.0);
+  parameterization.setJerkLimit("joint2", 2.0);
+
+  // the jerk is checked from the accelerations at consecutive waypoints, so it is averaged over whole segments.
+  // Each path is also parameterized with 16 points per segment (the resolution the parameterization checks
+  // its limits at): the waypoints of that trajectory sample the motion along the same curve within the segments
+  // of the coarser one. Positions between waypoints are interpolated linearly, so sampling a trajectory with
+  // getStateAtDurationFromStart() would not reveal the accelerations within a segment
+  const int sizes[] = { 4, 40, 400 };
+  for (int n = 0 ; n < 6 ; ++n)
+  {
+    const int num_points = n < 3 ? sizes[n] : 16 * (sizes[n - 3] - 1) + 1;
+    const Eigen::MatrixXd positions = makePath(num_points);
+    robot_trajectory::RobotTrajectory trajectory(robot_model, "arm");
+    for (int k = 0 ; k < num_points ; ++k)
+    {
+      robot_state::RobotState state(robot_model);
+      state.setToDefaultValues();
+      state.setVariablePosition(idx[0], positions(0, k));
+      state.setVariablePosition(idx[1], positions(1, k));
+      trajectory.addSuffixWayPoint(state, 0.0);
+    }
+    ASSERT_TRUE(parameterization.computeTimeStamps(trajectory));
+
+    for (int k = 0 ; k < num_points ; ++k)
+    {
+      const robot_state::RobotState &waypoint = trajectory.getWayPoint(k);
+      if (k > 0)
+        EXPECT_GT(trajectory.getWayPointDurationFromPrevious(k), 0.0);
+      for (int j = 0 ; j < 2 ; ++j)
+      {
+        EXPECT_LE(fabs(waypoint.getVariableVelocity(idx[j])), max_velocities[j] * (1.0 + 1e-6));
+        EXPECT_LE(fabs(waypoint.getVariableAcceleration(idx[j])), max_acceleration * (1.0 + 1e-6));
+        if (k > 0)
+        {
+          const double jerk = (waypoint.getVariableAcceleration(idx[j]) -
+                               trajectory.getWayPoint(k - 1).getVariableAcceleration(idx[j])) /
+            trajectory.getWayPointDurationFromPrevious(k);
+          EXPECT_LE(fabs(jerk), max_jerks[j] * (1.0 + 1e-6));
+        }
+      }
+    }
+    // the motion still starts and ends at rest
+    for (int j = 0 ; j < 2 ; ++j)
+    {
+      EXPECT_NEAR(0.0, trajectory.getFirstWayPoint().getVariableVelocity(idx[j]), 1e-9);
+      EXPECT_NEAR(0.0, trajectory.getLastWayPoint().getVariableVelocity(idx[j]), 1e-9);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
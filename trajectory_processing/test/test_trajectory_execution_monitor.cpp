@@ -0,0 +1,310 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_execution_monitor.h>
+#include <moveit/controller_manager/simulated_controller_handle.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <geometric_shapes/shapes.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+// count the allocations made while counting is enabled, to check that the hot path does not allocate
+static bool count_allocations = false;
+static unsigned int allocation_count = 0;
+
+void* operator new(std::size_t size)
+{
+  if (count_allocations)
+    ++allocation_count;
+  void *p = std::malloc(size > 0 ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) throw()
+{
+  std::free(p);
+}
+
+static const double PERIOD = 0.01;
+
+class TrajectoryExecutionMonitorTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("planar_arm");
+    ASSERT_TRUE(robot_model_);
+
+    // 5 waypoints, 0.5s apart, without velocities
+    trajectory_.reset(new robot_trajectory::RobotTrajectory(robot_model_, "arm"));
+    for (std::size_t i = 0 ; i < 5 ; ++i)
+    {
+      robot_state::RobotStatePtr state(new robot_state::RobotState(robot_model_));
+      state->setToDefaultValues();
+      state->setVariablePosition("joint1", 0.25 * i);
+      state->setVariablePosition("joint2", i % 2 == 0 ? 0.0 : 0.3);
+      trajectory_->addSuffixWayPoint(state, i == 0 ? 0.0 : 0.5);
+    }
+    moveit_msgs::RobotTrajectory msg;
+    trajectory_->getRobotTrajectoryMsg(msg);
+    points_ = msg.joint_trajectory;
+
+    joints_.push_back("joint1");
+    joints_.push_back("joint2");
+    handle_.reset(new moveit_controller_manager::SimulatedControllerHandle("arm_controller", joints_));
+    std::vector<double> start(2, 0.0);
+    handle_->setJointPositions(start);
+    positions_.resize(2);
+    velocities_.resize(2);
+  }
+
+  // stream the first 3 points of the trajectory; the others are appended by streamRest()
+  void openStream()
+  {
+    ASSERT_TRUE(handle_->openStream(joints_));
+    trajectory_msgs::JointTrajectory segment = points_;
+    segment.points.resize(3);
+    ASSERT_TRUE(handle_->appendToStream(segment));
+  }
+
+  void streamRest()
+  {
+    trajectory_msgs::JointTrajectory segment = points_;
+    segment.points.erase(segment.points.begin(), segment.points.begin() + 3);
+    ASSERT_TRUE(handle_->appendToStream(segment));
+    ASSERT_TRUE(handle_->closeStream());
+  }
+
+  moveit_controller_manager::ExecutionStatus::Value executionStatus()
+  {
+    return handle_->getLastExecutionStatus();
+  }
+
+  // advance the controller by one period and pass its joint states to the monitor
+  const trajectory_processing::TrajectoryExecutionMonitor::Status& step(trajectory_processing::TrajectoryExecutionMonitor &monitor)
+  {
+    handle_->advance(PERIOD);
+    handle_->getJointPositions(positions_);
+    handle_->getJointVelocities(velocities_);
+    return monitor.update(&positions_[0], &velocities_[0], handle_->getTimeFromStart());
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+  robot_trajectory::RobotTrajectoryPtr trajectory_;
+  trajectory_msgs::JointTrajectory points_;
+  std::vector<std::string> joints_;
+  moveit_controller_manager::SimulatedControllerHandlePtr handle_;
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+};
+
+TEST_F(TrajectoryExecutionMonitorTest, NominalTracking)
+{
+  trajectory_processing::TrajectoryExecutionMonitor monitor;
+  ASSERT_TRUE(monitor.setTrajectory(*trajectory_));
+  monitor.setPositionTolerance(0.01);
+  EXPECT_NEAR(2.0, monitor.getDuration(), 1e-12);
+
+  openStream();
+  unsigned int steps = 0;
+  while (executionStatus() == moveit_controller_manager::ExecutionStatus::RUNNING && steps < 300)
+  {
+    if (++steps == 50)
+      streamRest();
+    const trajectory_processing::TrajectoryExecutionMonitor::Status &status = step(monitor);
+    // the controller interpolates the same waypoints as the monitor
+    EXPECT_EQ(0u, status.flags_ & ~(unsigned int)trajectory_processing::TrajectoryExecutionMonitor::TRAJECTORY_COMPLETE);
+    EXPECT_LT(status.max_position_error_, 1e-9);
+    EXPECT_LE(status.waypoint_, 4u);
+  }
+  EXPECT_EQ(moveit_controller_manager::ExecutionStatus::SUCCEEDED, executionStatus());
+  EXPECT_NEAR(2.0 / PERIOD, steps, 1.0);
+  EXPECT_TRUE(monitor.getStatus().flags_ & trajectory_processing::TrajectoryExecutionMonitor::TRAJECTORY_COMPLETE);
+  EXPECT_NEAR(1.0, monitor.getReferencePositions()[0], 1e-9);
+  EXPECT_NEAR(1.0, positions_[0], 1e-9);
+}
+
+TEST_F(TrajectoryExecutionMonitorTest, DeviationStopsExecution)
+{
+  trajectory_processing::TrajectoryExecutionMonitor monitor;
+  ASSERT_TRUE(monitor.setTrajectory(*trajectory_));
+  monitor.setPositionTolerance(0.1);
+
+  openStream();
+  streamRest();
+  unsigned int steps = 0, stop_step = 0;
+  while (executionStatus() == moveit_controller_manager::ExecutionStatus::RUNNING && steps < 300)
+  {
+    if (++steps == 100)
+    {
+      // the second joint is pushed away from the trajectory
+      std::vector<double> offsets(2, 0.0);
+      offsets[1] = 0.2;
+      handle_->setPositionOffsets(offsets);
+    }
+    const trajectory_processing::TrajectoryExecutionMonitor::Status &status = step(monitor);
+    if (status.flags_ & trajectory_processing::TrajectoryExecutionMonitor::POSITION_TOLERANCE_VIOLATED)
+    {
+      stop_step = steps;
+      EXPECT_EQ(1, status.max_position_error_variable_);
+      EXPECT_NEAR(0.2, status.max_position_error_, 1e-9);
+      EXPECT_NEAR(0.2, monitor.getPositionErrors()[1], 1e-9);
+      ASSERT_TRUE(handle_->cancelExecution());
+    }
+  }
+  // the deviation is detected by the first update after it happened, and the execution stops there
+  EXPECT_EQ(100u, stop_step);
+  EXPECT_EQ(moveit_controller_manager::ExecutionStatus::PREEMPTED, executionStatus());
+
+  const std::vector<double> stopped = positions_;
+  handle_->advance(0.5);
+  handle_->getJointPositions(positions_);
+  handle_->getJointVelocities(velocities_);
+  for (std::size_t j = 0 ; j < 2 ; ++j)
+  {
+    EXPECT_EQ(stopped[j], positions_[j]);
+    EXPECT_EQ(0.0, velocities_[j]);
+  }
+}
+
+TEST_F(TrajectoryExecutionMonitorTest, VelocityDeviation)
+{
+  trajectory_processing::TrajectoryExecutionMonitor monitor;
+  ASSERT_TRUE(monitor.setTrajectory(*trajectory_));
+  monitor.setPositionTolerance(1.0);
+  monitor.setVelocityTolerance(0.2);
+
+  // a joint that does not move has a velocity error of the full reference velocity (0.5 rad/s for the first joint)
+  std::vector<double> still(2, 0.0);
+  const trajectory_processing::TrajectoryExecutionMonitor::Status &status = monitor.update(&still[0], &still[0], 0.75);
+  EXPECT_TRUE(status.flags_ & trajectory_processing::TrajectoryExecutionMonitor::VELOCITY_TOLERANCE_VIOLATED);
+  EXPECT_NEAR(0.5, status.max_velocity_error_, 1e-9);
+  EXPECT_FALSE(status.flags_ & trajectory_processing::TrajectoryExecutionMonitor::POSITION_TOLERANCE_VIOLATED);
+}
+
+TEST_F(TrajectoryExecutionMonitorTest, UpdatesDoNotAllocate)
+{
+  trajectory_processing::TrajectoryExecutionMonitor monitor;
+  ASSERT_TRUE(monitor.setTrajectory(*trajectory_));
+  // the updates back in time are far from the measured positions
+  monitor.setPositionTolerance(10.0);
+  robot_state::RobotState state(trajectory_->getFirstWayPoint());
+  state.setVariableVelocity(0, 0.0);
+
+  openStream();
+  streamRest();
+  unsigned int steps = 0, flags = 0;
+  count_allocations = true;
+  allocation_count = 0;
+  while (executionStatus() == moveit_controller_manager::ExecutionStatus::RUNNING && steps < 300)
+  {
+    ++steps;
+    flags |= step(monitor).flags_;
+    state.setVariablePosition(0, positions_[0]);
+    state.setVariablePosition(1, positions_[1]);
+    flags |= monitor.update(state, handle_->getTimeFromStart()).flags_;
+    // going back in time takes the binary search
+    flags |= monitor.update(&positions_[0], NULL, 0.5 * handle_->getTimeFromStart()).flags_;
+  }
+  count_allocations = false;
+  EXPECT_EQ(0u, allocation_count);
+  EXPECT_GT(steps, 100u);
+  EXPECT_EQ((unsigned int)trajectory_processing::TrajectoryExecutionMonitor::TRAJECTORY_COMPLETE, flags);
+}
+
+TEST_F(TrajectoryExecutionMonitorTest, ObstacleOnRemainingPath)
+{
+  // a small box that the first link sweeps into as the first joint passes 0.75 rad (at about 1.5s)
+  planning_scene::PlanningScenePtr scene(new planning_scene::PlanningScene(robot_model_));
+  Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+  pose.translation() = Eigen::Vector3d(0.3 * cos(0.75), 0.3 * sin(0.75), 0.0);
+  scene->getWorldNonConst()->addToObject("box", shapes::ShapeConstPtr(new shapes::Box(0.05, 0.05, 0.05)), pose);
+
+  // the first time the planned motion collides, found by brute force
+  robot_state::RobotStatePtr state(new robot_state::RobotState(trajectory_->getFirstWayPoint()));
+  double collision_time = -1.0;
+  for (unsigned int k = 0 ; k <= 200 && collision_time < 0.0 ; ++k)
+  {
+    ASSERT_TRUE(trajectory_->getStateAtDurationFromStart(k * PERIOD, state));
+    state->update();
+    if (scene->isStateColliding(*state, "arm"))
+      collision_time = k * PERIOD;
+  }
+  ASSERT_GT(collision_time, 0.5);
+  ASSERT_LT(collision_time, 1.9);
+
+  const double horizon = 0.5;
+  const unsigned int samples = 10;
+  trajectory_processing::TrajectoryExecutionMonitor monitor(scene);
+  monitor.setCollisionHorizon(horizon, samples);
+  ASSERT_TRUE(monitor.setTrajectory(*trajectory_));
+  monitor.setPositionTolerance(0.01);
+
+  // the robot follows the plan exactly; the collision is predicted before the robot gets there
+  double predicted_at = -1.0;
+  for (unsigned int k = 0 ; k <= 200 && predicted_at < 0.0 ; ++k)
+  {
+    const double time = k * PERIOD;
+    ASSERT_TRUE(trajectory_->getStateAtDurationFromStart(time, state));
+    const trajectory_processing::TrajectoryExecutionMonitor::Status &status = monitor.update(*state, time);
+    EXPECT_FALSE(status.flags_ & trajectory_processing::TrajectoryExecutionMonitor::POSITION_TOLERANCE_VIOLATED);
+    if (status.flags_ & trajectory_processing::TrajectoryExecutionMonitor::COLLISION_PREDICTED)
+    {
+      predicted_at = time;
+      EXPECT_GT(status.collision_time_, time);
+      EXPECT_LE(status.collision_time_, time + horizon + 1e-9);
+      // the predicted collision is no earlier than the actual one, up to the spacing of the samples
+      EXPECT_GE(status.collision_time_, collision_time - horizon / samples - 1e-9);
+    }
+  }
+  EXPECT_GT(predicted_at, 0.0);
+  EXPECT_LT(predicted_at, collision_time);
+  EXPECT_GE(predicted_at, collision_time - horizon - PERIOD - 1e-9);
+
+  // without a planning scene, no collisions are predicted
+  monitor.setPlanningScene(planning_scene::PlanningSceneConstPtr());
+  ASSERT_TRUE(trajectory_->getStateAtDurationFromStart(predicted_at, state));
+  EXPECT_FALSE(monitor.update(*state, predicted_at).flags_ & trajectory_processing::TrajectoryExecutionMonitor::COLLISION_PREDICTED);
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,180 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_resampler.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using trajectory_processing::TrajectoryResampler;
+
+// the motion the waypoints are taken from, with its derivatives
+static void evaluate(double t, double *positions, double *velocities, double *accelerations)
+{
+  positions[0] = sin(t);
+  velocities[0] = cos(t);
+  accelerations[0] = -sin(t);
+  positions[1] = 0.5 * t * t;
+  velocities[1] = t;
+  accelerations[1] = 1.0;
+}
+
+class TrajectoryResamplerTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("two_dof_arm");
+    ASSERT_TRUE(robot_model_);
+  }
+
+  // waypoints every 0.2s over 0.8s; velocities and accelerations are set only if requested
+  robot_trajectory::RobotTrajectoryPtr makeTrajectory(bool velocities, bool accelerations) const
+  {
+    robot_trajectory::RobotTrajectoryPtr trajectory(new robot_trajectory::RobotTrajectory(robot_model_, "arm"));
+    const robot_model::JointModelGroup *group = robot_model_->getJointModelGroup("arm");
+    const std::vector<int> &idx = group->getVariableIndexList();
+    for (int i = 0 ; i < 5 ; ++i)
+    {
+      double p[2], v[2], a[2];
+      evaluate(0.2 * i, p, v, a);
+      robot_state::RobotState state(robot_model_);
+      state.setToDefaultValues();
+      for (int j = 0 ; j < 2 ; ++j)
+      {
+        state.setVariablePosition(idx[j], p[j]);
+        if (velocities)
+          state.setVariableVelocity(idx[j], v[j]);
+        if (accelerations)
+          state.setVariableAcceleration(idx[j], a[j]);
+      }
+      trajectory->addSuffixWayPoint(state, i == 0 ? 0.0 : 0.2);
+    }
+    return trajectory;
+  }
+
+  moveit::core::RobotModelConstPtr robot_model_;
+};
+
+TEST_F(TrajectoryResamplerTest, Endpoints)
+{
+  robot_trajectory::RobotTrajectoryPtr trajectory = makeTrajectory(true, true);
+  TrajectoryResampler resampler(0.03, TrajectoryResampler::QUINTIC);
+  std::vector<double> positions, velocities, accelerations;
+
+  // 0.8s is not a multiple of the period: samples at 0, 0.03, ..., 0.78 and one more at 0.81
+  const std::size_t count = resampler.resample(*trajectory, positions, velocities, accelerations);
+  ASSERT_EQ(28u, count);
+  ASSERT_EQ(2u, resampler.getVariableCount());
+  ASSERT_EQ(count * 2, positions.size());
+  EXPECT_EQ(TrajectoryResampler::QUINTIC, resampler.getEffectiveInterpolation());
+
+  double p[2], v[2], a[2];
+  evaluate(0.0, p, v, a);
+  for (int j = 0 ; j < 2 ; ++j)
+  {
+    EXPECT_NEAR(p[j], positions[j], 1e-12);
+    EXPECT_NEAR(v[j], velocities[j], 1e-12);
+    EXPECT_NEAR(a[j], accelerations[j], 1e-12);
+  }
+  evaluate(0.8, p, v, a);
+  for (int j = 0 ; j < 2 ; ++j)
+  {
+    EXPECT_NEAR(p[j], positions[(count - 1) * 2 + j], 1e-9);
+    EXPECT_NEAR(v[j], velocities[(count - 1) * 2 + j], 1e-9);
+    EXPECT_NEAR(a[j], accelerations[(count - 1) * 2 + j], 1e-9);
+  }
+
+  // a period that divides the duration does not add a sample
+  resampler.setPeriod(0.1);
+  EXPECT_EQ(9u, resampler.resample(*trajectory, positions, velocities, accelerations));
+}
+
+TEST_F(TrajectoryResamplerTest, Interpolation)
+{
+  // lower orders are used when the waypoints do not have the derivatives needed
+  TrajectoryResampler resampler(0.005, TrajectoryResampler::QUINTIC);
+  ASSERT_TRUE(resampler.start(*makeTrajectory(true, false)));
+  EXPECT_EQ(TrajectoryResampler::CUBIC, resampler.getEffectiveInterpolation());
+  ASSERT_TRUE(resampler.start(*makeTrajectory(false, false)));
+  EXPECT_EQ(TrajectoryResampler::LINEAR, resampler.getEffectiveInterpolation());
+
+  // the samples follow the motion the waypoints come from
+  ASSERT_TRUE(resampler.start(*makeTrajectory(true, true)));
+  std::size_t count = 0;
+  while (resampler.next())
+  {
+    double p[2], v[2], a[2];
+    evaluate(resampler.getTime(), p, v, a);
+    for (int j = 0 ; j < 2 ; ++j)
+    {
+      EXPECT_NEAR(p[j], resampler.getPositions()[j], 1e-6);
+      EXPECT_NEAR(v[j], resampler.getVelocities()[j], 1e-4);
+      EXPECT_NEAR(a[j], resampler.getAccelerations()[j], 1e-2);
+    }
+    ++count;
+  }
+  EXPECT_EQ(resampler.getSampleCount(), count);
+}
+
+TEST_F(TrajectoryResamplerTest, Continuity)
+{
+  // cubic interpolation keeps velocities continuous across waypoints, quintic also accelerations
+  const double period = 0.001;
+  for (int k = 0 ; k < 2 ; ++k)
+  {
+    const bool quintic = k == 1;
+    TrajectoryResampler resampler(period, quintic ? TrajectoryResampler::QUINTIC : TrajectoryResampler::CUBIC);
+    std::vector<double> positions, velocities, accelerations;
+    const std::size_t count = resampler.resample(*makeTrajectory(true, quintic), positions, velocities, accelerations);
+    ASSERT_EQ(801u, count);
+    for (std::size_t i = 1 ; i < count ; ++i)
+      for (int j = 0 ; j < 2 ; ++j)
+      {
+        const std::size_t c = i * 2 + j;
+        const std::size_t p = c - 2;
+        EXPECT_NEAR(positions[p] + 0.5 * (velocities[p] + velocities[c]) * period, positions[c], 1e-6);
+        EXPECT_LT(fabs(velocities[c] - velocities[p]), 2.0 * period);
+        if (quintic)
+          EXPECT_LT(fabs(accelerations[c] - accelerations[p]), 2.0 * period);
+      }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,220 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/trajectory_processing/trajectory_shortcutter.h>
+#include <moveit/utils/robot_model_test_utils.h>
+#include <geometric_shapes/shapes.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+class TrajectoryShortcutterTest : public testing::Test
+{
+protected:
+
+  virtual void SetUp()
+  {
+    robot_model_ = moveit::core::loadTestingRobotModel("planar_arm");
+    ASSERT_TRUE(robot_model_);
+    scene_.reset(new planning_scene::PlanningScene(robot_model_));
+  }
+
+  // add a waypoint with the given positions for joint1 and joint2
+  void addWayPoint(robot_trajectory::RobotTrajectory &trajectory, double joint1, double joint2) const
+  {
+    robot_state::RobotState state(robot_model_);
+    state.setToDefaultValues();
+    state.setVariablePosition("joint1", joint1);
+    state.setVariablePosition("joint2", joint2);
+    trajectory.addSuffixWayPoint(state, 0.0);
+  }
+
+  // a path that folds the second link onto the first one, turns the arm from 0 to 2.8 rad and (optionally)
+  // unfolds it again, with detours along the way
+  robot_trajectory::RobotTrajectory makeFoldingPath(double folded, double wiggle, bool unfold) const
+  {
+    robot_trajectory::RobotTrajectory trajectory(robot_model_, "arm");
+    for (int k = 0 ; k <= 10 ; ++k)
+      addWayPoint(trajectory, 0.2 * sin((double)k), folded * k / 10.0);
+    for (int k = 1 ; k <= 30 ; ++k)
+      addWayPoint(trajectory, 2.8 * k / 30.0, folded + wiggle * sin(3.0 * k));
+    if (unfold)
+      for (int k = 1 ; k <= 10 ; ++k)
+        addWayPoint(trajectory, 2.8 - 0.15 * sin((double)k), folded * (10 - k) / 10.0);
+    return trajectory;
+  }
+
+  // check every waypoint and the states the shortcutter samples along every segment against the scene
+  bool isPathValid(const robot_trajectory::RobotTrajectory &trajectory, const moveit_msgs::Constraints &constraints,
+                   double resolution) const
+  {
+    const robot_model::JointModelGroup *group = trajectory.getGroup();
+    robot_state::RobotState state(trajectory.getFirstWayPoint());
+    for (std::size_t k = 0 ; k < trajectory.getWayPointCount() ; ++k)
+    {
+      state = trajectory.getWayPoint(k);
+      state.update();
+      if (!scene_->isStateValid(state, constraints, "arm"))
+        return false;
+      if (k == 0)
+        continue;
+      const robot_state::RobotState &from = trajectory.getWayPoint(k - 1);
+      const std::size_t steps = (std::size_t)ceil(from.distance(trajectory.getWayPoint(k), group) / resolution);
+      for (std::size_t step = 1 ; step < steps ; ++step)
+      {
+        from.interpolate(trajectory.getWayPoint(k), (double)step / (double)steps, state, group);
+        state.update();
+        if (!scene_->isStateValid(state, constraints, "arm"))
+          return false;
+      }
+    }
+    return true;
+  }
+
+  robot_model::RobotModelConstPtr robot_model_;
+  planning_scene::PlanningScenePtr scene_;
+};
+
+TEST_F(TrajectoryShortcutterTest, ShortcutsAvoidCollisions)
+{
+  // a box that the arm hits when it is unfolded at pi/2, but not when it is folded
+  Eigen::Affine3d pose = Eigen::Affine3d::Identity();
+  pose.translation() = Eigen::Vector3d(0.0, 0.7, 0.0);
+  scene_->getWorldNonConst()->addToObject("box", shapes::ShapeConstPtr(new shapes::Box(0.15, 0.15, 0.15)), pose);
+
+  robot_trajectory::RobotTrajectory trajectory = makeFoldingPath(-2.5, 0.3, true);
+  trajectory_processing::TrajectoryShortcutter shortcutter(scene_);
+  shortcutter.setMaxRounds(50);
+  const moveit_msgs::Constraints no_constraints;
+  ASSERT_TRUE(isPathValid(trajectory, no_constraints, shortcutter.getResolution()));
+
+  // the straight path from the start to the end is in collision
+  robot_state::RobotState state(trajectory.getFirstWayPoint());
+  ASSERT_FALSE(shortcutter.isSegmentValid(trajectory.getFirstWayPoint(), trajectory.getLastWayPoint(), trajectory.getGroup(), state));
+
+  const robot_state::RobotState first = trajectory.getFirstWayPoint();
+  const robot_state::RobotState last = trajectory.getLastWayPoint();
+  const double initial_length = trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory);
+  ASSERT_TRUE(shortcutter.shortcut(trajectory, 10.0));
+
+  EXPECT_LT(trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory), 0.8 * initial_length);
+  EXPECT_GE(trajectory.getWayPointCount(), 3u);
+  EXPECT_NEAR(0.0, first.distance(trajectory.getFirstWayPoint()), 1e-12);
+  EXPECT_NEAR(0.0, last.distance(trajectory.getLastWayPoint()), 1e-12);
+  EXPECT_TRUE(isPathValid(trajectory, no_constraints, shortcutter.getResolution()));
+
+  // smoothing keeps the path valid and does not make it longer
+  const double shortcut_length = trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory);
+  ASSERT_TRUE(shortcutter.smooth(trajectory, 5));
+  EXPECT_LE(trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory), shortcut_length + 1e-9);
+  EXPECT_TRUE(isPathValid(trajectory, no_constraints, shortcutter.getResolution()));
+}
+
+TEST_F(TrajectoryShortcutterTest, ShortcutsRespectPathConstraints)
+{
+  // the tip of the arm has to stay below y = 0.3; the arm can only turn past pi/2 when it is folded
+  moveit_msgs::Constraints constraints;
+  constraints.position_constraints.resize(1);
+  moveit_msgs::PositionConstraint &position = constraints.position_constraints[0];
+  position.header.frame_id = robot_model_->getModelFrame();
+  position.link_name = "link2";
+  position.target_point_offset.x = 0.4;
+  position.constraint_region.primitives.resize(1);
+  position.constraint_region.primitives[0].type = shape_msgs::SolidPrimitive::BOX;
+  position.constraint_region.primitives[0].dimensions.resize(3);
+  position.constraint_region.primitives[0].dimensions[shape_msgs::SolidPrimitive::BOX_X] = 2.0;
+  position.constraint_region.primitives[0].dimensions[shape_msgs::SolidPrimitive::BOX_Y] = 1.3;
+  position.constraint_region.primitives[0].dimensions[shape_msgs::SolidPrimitive::BOX_Z] = 1.0;
+  position.constraint_region.primitive_poses.resize(1);
+  position.constraint_region.primitive_poses[0].position.y = -0.35;
+  position.constraint_region.primitive_poses[0].orientation.w = 1.0;
+  position.weight = 1.0;
+
+  robot_trajectory::RobotTrajectory trajectory = makeFoldingPath(-2.9, 0.08, false);
+  trajectory_processing::TrajectoryShortcutter shortcutter(scene_);
+  shortcutter.setMaxRounds(50);
+  ASSERT_TRUE(shortcutter.setPathConstraints(constraints));
+  ASSERT_TRUE(isPathValid(trajectory, constraints, shortcutter.getResolution()));
+
+  // without the constraints, the start and the end could be connected directly
+  const moveit_msgs::Constraints no_constraints;
+  robot_trajectory::RobotTrajectory direct(robot_model_, "arm");
+  direct.addSuffixWayPoint(trajectory.getFirstWayPoint(), 0.0);
+  direct.addSuffixWayPoint(trajectory.getLastWayPoint(), 0.0);
+  ASSERT_TRUE(isPathValid(direct, no_constraints, shortcutter.getResolution()));
+  ASSERT_FALSE(isPathValid(direct, constraints, shortcutter.getResolution()));
+
+  const double initial_length = trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory);
+  ASSERT_TRUE(shortcutter.shortcut(trajectory, 10.0));
+  EXPECT_LT(trajectory_processing::TrajectoryShortcutter::getPathLength(trajectory), initial_length);
+  EXPECT_GE(trajectory.getWayPointCount(), 3u);
+  EXPECT_TRUE(isPathValid(trajectory, constraints, shortcutter.getResolution()));
+
+  ASSERT_TRUE(shortcutter.smooth(trajectory, 5));
+  EXPECT_TRUE(isPathValid(trajectory, constraints, shortcutter.getResolution()));
+}
+
+TEST_F(TrajectoryShortcutterTest, ShortcutResetsTiming)
+{
+  robot_trajectory::RobotTrajectory trajectory = makeFoldingPath(-2.5, 0.3, true);
+  for (std::size_t k = 1 ; k < trajectory.getWayPointCount() ; ++k)
+  {
+    trajectory.setWayPointDurationFromPrevious(k, 0.1);
+    trajectory.getWayPointPtr(k)->setVariableVelocity("joint1", 1.0);
+  }
+  trajectory_processing::TrajectoryShortcutter shortcutter(scene_);
+  shortcutter.setMaxRounds(10);
+  ASSERT_TRUE(shortcutter.shortcut(trajectory, 10.0));
+  for (std::size_t k = 0 ; k < trajectory.getWayPointCount() ; ++k)
+  {
+    EXPECT_EQ(0.0, trajectory.getWayPointDurationFromPrevious(k));
+    EXPECT_EQ(0.0, trajectory.getWayPoint(k).getVariableVelocity("joint1"));
+  }
+}
+
+TEST_F(TrajectoryShortcutterTest, NonPositiveResolutionIsRejected)
+{
+  trajectory_processing::TrajectoryShortcutter shortcutter(scene_);
+  shortcutter.setResolution(0.05);
+  EXPECT_EQ(0.05, shortcutter.getResolution());
+  shortcutter.setResolution(0.0);
+  EXPECT_EQ(0.05, shortcutter.getResolution());
+  shortcutter.setResolution(-0.1);
+  EXPECT_EQ(0.05, shortcutter.getResolution());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -40,6 +40,8 @@
 #include <geometry_msgs/TransformStamped.h>
 #include <geometry_msgs/Pose.h>
 #include <Eigen/Geometry>
+#include <map>
+#include <set>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
 #include <moveit/macros/class_forward.h>
@@ -51,13 +53,28 @@ namespace core
 
 MOVEIT_CLASS_FORWARD(Transforms);
 
+/// @brief Order frame names as if they all started with a '/', so "frame" and "/frame" are the same key and
+/// lookups do not need to construct the prefixed name
+struct FrameNameLess
+{
+  bool operator()(const std::string &a, const std::string &b) const
+  {
+    const std::size_t ia = (!a.empty() && a[0] == '/') ? 1 : 0;
+    const std::size_t ib = (!b.empty() && b[0] == '/') ? 1 : 0;
+    return a.compare(ia, std::string::npos, b, ib, std::string::npos) < 0;
+  }
+};
+
 /// @brief Map frame names to the transformation matrix that can transform objects from the frame name to the planning frame
-typedef std::map<std::string, Eigen::Affine3d, std::less<std::string>,
+typedef std::map<std::string, Eigen::Affine3d, FrameNameLess,
                  Eigen::aligned_allocator<std::pair<const std::string, Eigen::Affine3d> > > FixedTransformsMap;
 
 /** @brief Provides an implementation of a snapshot of a transform tree that can be easily queried for
-    transforming different quantities. Transforms are maintained as a list of transforms to a particular frame.
-    All stored transforms are considered fixed. */
+    transforms of different quantities. Every frame is attached to a parent frame: either the target frame
+    or another frame maintained by this class (e.g., a fixture mounted on a table that stands in the world).
+    The transform of each frame to the target frame is cached; when a frame is set, only the cached
+    transforms of that frame and of the frames attached below it are recomputed. All stored transforms
+    are considered fixed. */
 class Transforms : private boost::noncopyable
 {
 public:
@@ -117,10 +134,41 @@ public:
   void setTransforms(const std::vector<geometry_msgs::TransformStamped> &transforms);
 
   /**
-   * @brief Set all the transforms: a map from string names of frames to corresponding Eigen::Affine3d (w.r.t the planning frame)
+   * @brief Set a transform in the transform tree (adding it if necessary), relative to another frame
+   * @param t The transform of \e from_frame w.r.t. \e parent_frame
+   * @param from_frame The frame for which the input transform is specified
+   * @param parent_frame The frame \e from_frame is attached to: the target frame or a frame already maintained by this class
+   * @return False if \e parent_frame is unknown, or if it is attached (directly or not) to \e from_frame
+   */
+  bool setTransform(const Eigen::Affine3d &t, const std::string &from_frame, const std::string &parent_frame);
+
+  /**
+   * @brief Remove a frame and all the frames attached to it (directly or not)
+   * @return False if the frame is not known or is the target frame
+   */
+  bool removeTransform(const std::string &frame);
+
+  /**
+   * @brief Get the frame \e frame is attached to (the empty string if \e frame is unknown or is the target frame)
+   */
+  const std::string& getParentFrame(const std::string &frame) const;
+
+  /**
+   * @brief Get the transform of \e frame w.r.t. the frame it is attached to (identity if \e frame is unknown)
+   */
+  const Eigen::Affine3d& getRelativeTransform(const std::string &frame) const;
+
+  /**
+   * @brief Set all the transforms: a map from string names of frames to corresponding Eigen::Affine3d (w.r.t the planning frame).
+   * All the frames are attached to the target frame.
    */
   void setAllTransforms(const FixedTransformsMap &transforms);
 
+  /**
+   * @brief Set all the transforms to the ones of \e other, including the frames they are attached to
+   */
+  void setAllTransforms(const Transforms &other);
+
   /**@}*/
 
   /**
@@ -195,8 +243,26 @@ public:
 protected:
 
   std::string        target_frame_;
+
+  /** \brief The transforms of all frames w.r.t. the target frame (the cache of the composite transforms) */
   FixedTransformsMap transforms_;
 
+private:
+
+  typedef std::set<std::string, FrameNameLess> FrameSet;
+
+  /** \brief Recompute the cached transform of \e frame and of the frames attached below it */
+  void updateTransforms(const std::string &frame);
+
+  /** \brief The transforms of frames w.r.t. the frame they are attached to */
+  FixedTransformsMap relative_transforms_;
+
+  /** \brief The frame each frame is attached to */
+  std::map<std::string, std::string, FrameNameLess> parent_frames_;
+
+  /** \brief The frames attached to each frame */
+  std::map<std::string, FrameSet, FrameNameLess> child_frames_;
+
 };
 
 }
@@ -59,11 +59,9 @@ bool moveit::core::Transforms::sameFrame(const std::string &frame1, const std::s
 {
   if (frame1.empty() || frame2.empty())
     return false;
-  if (frame1[0] != '/')
-    return sameFrame('/' + frame1, frame2);
-  if (frame2[0] != '/')
-    return sameFrame(frame1, '/' + frame2);
-  return frame1 == frame2;
+  const std::size_t i1 = frame1[0] == '/' ? 1 : 0;
+  const std::size_t i2 = frame2[0] == '/' ? 1 : 0;
+  return frame1.compare(i1, std::string::npos, frame2, i2, std::string::npos) == 0;
 }
 
 moveit::core::Transforms::~Transforms()
@@ -83,6 +81,24 @@ const moveit::core::FixedTransformsMap& moveit::core::Transforms::getAllTransfor
 void moveit::core::Transforms::setAllTransforms(const FixedTransformsMap &transforms)
 {
   transforms_ = transforms;
+  relative_transforms_.clear();
+  parent_frames_.clear();
+  child_frames_.clear();
+  for (FixedTransformsMap::const_iterator it = transforms_.begin() ; it != transforms_.end() ; ++it)
+    if (!sameFrame(it->first, target_frame_))
+    {
+      relative_transforms_.insert(relative_transforms_.end(), *it);
+      parent_frames_.insert(parent_frames_.end(), std::make_pair(it->first, target_frame_));
+      child_frames_[target_frame_].insert(it->first);
+    }
+}
+
+void moveit::core::Transforms::setAllTransforms(const Transforms &other)
+{
+  transforms_ = other.transforms_;
+  relative_transforms_ = other.relative_transforms_;
+  parent_frames_ = other.parent_frames_;
+  child_frames_ = other.child_frames_;
 }
 
 bool moveit::core::Transforms::isFixedFrame(const std::string &frame) const
@@ -90,14 +106,14 @@ bool moveit::core::Transforms::isFixedFrame(const std::string &frame) const
   if (frame.empty())
     return false;
   else
-    return (frame[0] == '/' ? transforms_.find(frame) : transforms_.find('/' + frame)) != transforms_.end();
+    return transforms_.find(frame) != transforms_.end();
 }
 
 const Eigen::Affine3d& moveit::core::Transforms::getTransform(const std::string &from_frame) const
 {
   if (!from_frame.empty())
   {
-    FixedTransformsMap::const_iterator it = (from_frame[0] == '/' ? transforms_.find(from_frame) : transforms_.find('/' + from_frame));
+    FixedTransformsMap::const_iterator it = transforms_.find(from_frame);
     if (it != transforms_.end())
       return it->second;
   }
@@ -114,25 +130,136 @@ bool moveit::core::Transforms::canTransform(const std::string &from_frame) const
   if (from_frame.empty())
     return false;
   else
-    return (from_frame[0] == '/' ? transforms_.find(from_frame) : transforms_.find('/' + from_frame)) != transforms_.end();
+    return transforms_.find(from_frame) != transforms_.end();
 }
 
 void moveit::core::Transforms::setTransform(const Eigen::Affine3d &t, const std::string &from_frame)
+{
+  if (sameFrame(from_frame, target_frame_))
+    transforms_[target_frame_] = t;
+  else
+    setTransform(t, from_frame, target_frame_);
+}
+
+bool moveit::core::Transforms::setTransform(const Eigen::Affine3d &t, const std::string &from_frame, const std::string &parent_frame)
 {
   if (from_frame.empty())
+  {
     logError("Cannot record transform with empty name");
-  else
+    return false;
+  }
+  if (sameFrame(from_frame, target_frame_))
+  {
+    logError("Cannot attach the target frame '%s' to frame '%s'", target_frame_.c_str(), parent_frame.c_str());
+    return false;
+  }
+  if (!sameFrame(parent_frame, target_frame_))
   {
-    if (from_frame[0] != '/')
+    // the parent must be known and must not be attached below the frame being set
+    std::map<std::string, std::string, FrameNameLess>::const_iterator p = parent_frames_.find(parent_frame);
+    if (p == parent_frames_.end())
+    {
+      logError("Cannot attach frame '%s' to unknown frame '%s'", from_frame.c_str(), parent_frame.c_str());
+      return false;
+    }
+    if (sameFrame(parent_frame, from_frame))
     {
-      logWarn("Transform specified for frame '%s'. Assuming '/%s' instead", from_frame.c_str(), from_frame.c_str());
-      transforms_['/' + from_frame] = t;
+      logError("Cannot attach frame '%s' to itself", from_frame.c_str());
+      return false;
     }
+    for ( ; p != parent_frames_.end() ; p = parent_frames_.find(p->second))
+      if (sameFrame(p->second, from_frame))
+      {
+        logError("Cannot attach frame '%s' to frame '%s' because the latter is attached to the former",
+                 from_frame.c_str(), parent_frame.c_str());
+        return false;
+      }
+  }
+
+  std::string frame = from_frame;
+  if (frame[0] != '/')
+  {
+    logWarn("Transform specified for frame '%s'. Assuming '/%s' instead", from_frame.c_str(), from_frame.c_str());
+    frame = '/' + frame;
+  }
+  const std::string &parent = sameFrame(parent_frame, target_frame_) ? target_frame_ : parent_frames_.find(parent_frame)->first;
+
+  std::map<std::string, std::string, FrameNameLess>::iterator it = parent_frames_.find(frame);
+  if (it == parent_frames_.end())
+    parent_frames_[frame] = parent;
+  else if (it->second != parent)
+  {
+    child_frames_[it->second].erase(frame);
+    it->second = parent;
+  }
+  child_frames_[parent].insert(frame);
+  relative_transforms_[frame] = t;
+  updateTransforms(frame);
+  return true;
+}
+
+void moveit::core::Transforms::updateTransforms(const std::string &frame)
+{
+  std::vector<std::string> pending(1, frame);
+  while (!pending.empty())
+  {
+    const std::string f = pending.back();
+    pending.pop_back();
+    const std::string &parent = parent_frames_[f];
+    if (parent == target_frame_)
+      transforms_[f] = relative_transforms_[f];
     else
-      transforms_[from_frame] = t;
+      transforms_[f] = transforms_[parent] * relative_transforms_[f];
+
+    std::map<std::string, FrameSet, FrameNameLess>::const_iterator c = child_frames_.find(f);
+    if (c != child_frames_.end())
+      pending.insert(pending.end(), c->second.begin(), c->second.end());
   }
 }
 
+bool moveit::core::Transforms::removeTransform(const std::string &frame)
+{
+  std::map<std::string, std::string, FrameNameLess>::iterator it = parent_frames_.find(frame);
+  if (it == parent_frames_.end())
+    return false;
+  child_frames_[it->second].erase(frame);
+
+  std::vector<std::string> pending(1, it->first);
+  while (!pending.empty())
+  {
+    const std::string f = pending.back();
+    pending.pop_back();
+    std::map<std::string, FrameSet, FrameNameLess>::iterator c = child_frames_.find(f);
+    if (c != child_frames_.end())
+    {
+      pending.insert(pending.end(), c->second.begin(), c->second.end());
+      child_frames_.erase(c);
+    }
+    parent_frames_.erase(f);
+    relative_transforms_.erase(f);
+    transforms_.erase(f);
+  }
+  return true;
+}
+
+const std::string& moveit::core::Transforms::getParentFrame(const std::string &frame) const
+{
+  std::map<std::string, std::string, FrameNameLess>::const_iterator it = parent_frames_.find(frame);
+  if (it != parent_frames_.end())
+    return it->second;
+  static const std::string empty;
+  return empty;
+}
+
+const Eigen::Affine3d& moveit::core::Transforms::getRelativeTransform(const std::string &frame) const
+{
+  FixedTransformsMap::const_iterator it = relative_transforms_.find(frame);
+  if (it != relative_transforms_.end())
+    return it->second;
+  static const Eigen::Affine3d identity = Eigen::Affine3d::Identity();
+  return identity;
+}
+
 void moveit::core::Transforms::setTransform(const geometry_msgs::TransformStamped &transform)
 {
   if (sameFrame(transform.child_frame_id, target_frame_))
@@ -62,6 +62,57 @@ TEST(Transforms, Simple)
   EXPECT_TRUE(tf.isFixedFrame("global"));
 }
 
+TEST(Transforms, FrameGraph)
+{
+  moveit::core::Transforms tf("world");
+
+  Eigen::Affine3d table(Eigen::Translation3d(1.0, 0.0, 0.5));
+  EXPECT_TRUE(tf.setTransform(table, "/table", "world"));
+
+  Eigen::Affine3d fixture(Eigen::Translation3d(0.0, 0.2, 0.1) * Eigen::AngleAxisd(0.5, Eigen::Vector3d::UnitZ()));
+  EXPECT_TRUE(tf.setTransform(fixture, "/fixture", "/table"));
+
+  Eigen::Affine3d part(Eigen::Translation3d(0.0, 0.0, 0.3));
+  EXPECT_TRUE(tf.setTransform(part, "part", "fixture"));
+
+  EXPECT_TRUE(tf.getTransform("/fixture").isApprox(table * fixture));
+  EXPECT_TRUE(tf.getTransform("part").isApprox(table * fixture * part));
+  EXPECT_TRUE(tf.getTransform("/part").isApprox(tf.getTransform("part")));
+  EXPECT_TRUE(tf.getRelativeTransform("fixture").isApprox(fixture));
+  EXPECT_EQ("/table", tf.getParentFrame("fixture"));
+  EXPECT_EQ("/world", tf.getParentFrame("/table"));
+  EXPECT_TRUE(tf.getParentFrame("world").empty());
+
+  // moving the table moves everything mounted on it
+  table = Eigen::Translation3d(2.0, 1.0, 0.5);
+  EXPECT_TRUE(tf.setTransform(table, "table", "world"));
+  EXPECT_TRUE(tf.getTransform("fixture").isApprox(table * fixture));
+  EXPECT_TRUE(tf.getTransform("part").isApprox(table * fixture * part));
+
+  // frames cannot be attached below themselves or to unknown frames
+  EXPECT_FALSE(tf.setTransform(table, "table", "part"));
+  EXPECT_FALSE(tf.setTransform(table, "table", "table"));
+  EXPECT_FALSE(tf.setTransform(table, "shelf", "unknown"));
+  EXPECT_FALSE(tf.setTransform(table, "world", "table"));
+  EXPECT_EQ("/world", tf.getParentFrame("table"));
+
+  // reattaching a frame keeps its own children attached to it
+  EXPECT_TRUE(tf.setTransform(fixture, "fixture", "world"));
+  EXPECT_TRUE(tf.getTransform("part").isApprox(fixture * part));
+
+  moveit::core::Transforms copy("world");
+  copy.setAllTransforms(tf);
+  EXPECT_EQ("/fixture", copy.getParentFrame("part"));
+
+  // removing a frame removes the frames attached to it
+  EXPECT_TRUE(tf.removeTransform("fixture"));
+  EXPECT_FALSE(tf.isFixedFrame("fixture"));
+  EXPECT_FALSE(tf.isFixedFrame("part"));
+  EXPECT_TRUE(tf.isFixedFrame("table"));
+  EXPECT_FALSE(tf.removeTransform("world"));
+  EXPECT_TRUE(copy.isFixedFrame("part"));
+}
+
 
 int main(int argc, char **argv)
 {
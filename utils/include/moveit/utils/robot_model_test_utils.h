@@ -0,0 +1,73 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#ifndef MOVEIT_UTILS_ROBOT_MODEL_TEST_UTILS_
+#define MOVEIT_UTILS_ROBOT_MODEL_TEST_UTILS_
+
+#include <moveit/robot_model/robot_model.h>
+
+namespace moveit
+{
+namespace core
+{
+
+/** \brief Parse the URDF of the test robot \e robot_name, from
+    utils/test_models/<robot_name>.urdf. Return an empty pointer on failure. */
+boost::shared_ptr<urdf::ModelInterface> loadTestingURDF(const std::string &robot_name);
+
+/** \brief Parse the SRDF of the test robot \e robot_name, from
+    utils/test_models/<robot_name>.srdf. Return an empty pointer on failure. */
+boost::shared_ptr<srdf::Model> loadTestingSRDF(const std::string &robot_name, const urdf::ModelInterface &urdf_model);
+
+/** \brief Construct the kinematic model of the test robot \e robot_name. Return an empty pointer on failure.
+
+    The test models are:
+    - one_dof_arm: a single revolute joint.
+    - two_dof_arm: a revolute joint followed by a prismatic joint with a range of [0, 1].
+    - planar_arm: two revolute joints about the z axis, 0.5 apart, with box shaped links
+      of length 0.5 and 0.4 along their x axis; joint2 has a velocity limit of 0.5.
+    - dynamics_arm: two revolute joints and a prismatic joint, with links that have offset and rotated inertial frames.
+    - payload_arm: two revolute joints about the y axis, 0.5 apart, with effort limits of 20 and 5; point masses of
+      2 kg and 1 kg at 0.25 and 0.2 along the x axis of their links, and a fixed tool frame 0.4 past the second joint.
+    - branched_arm: a revolute joint to a trunk that splits into a revolute branch, whose left_finger_joint mimics
+      left_joint with a multiplier of -0.5 and an offset of 0.1, and a prismatic branch.
+
+    All of them have a group named "arm" that contains all their joints; two_dof_arm also has a group named
+    "first_joint" that contains only its revolute joint. */
+RobotModelPtr loadTestingRobotModel(const std::string &robot_name);
+
+}
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*********************************************************************
+ * Software License Agreement (BSD License)
+ *
+ *  Copyright (c) 2014, Willow Garage, Inc.
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of Willow Garage nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ *  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ *  COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ *  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ *  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *********************************************************************/
+
+#include <moveit/utils/robot_model_test_utils.h>
+#include <urdf_parser/urdf_parser.h>
+#include <fstream>
+#include <sstream>
+
+namespace moveit
+{
+namespace core
+{
+
+namespace
+{
+std::string getTestingModelPath(const std::string &robot_name, const std::string &extension)
+{
+  return std::string(MOVEIT_TEST_MODELS_DIR) + "/" + robot_name + extension;
+}
+}
+
+boost::shared_ptr<urdf::ModelInterface> loadTestingURDF(const std::string &robot_name)
+{
+  const std::string path = getTestingModelPath(robot_name, ".urdf");
+  std::ifstream file(path.c_str());
+  if (!file.good())
+  {
+    logError("Unable to open test robot model '%s'", path.c_str());
+    return boost::shared_ptr<urdf::ModelInterface>();
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  boost::shared_ptr<urdf::ModelInterface> urdf_model = urdf::parseURDF(contents.str());
+  if (!urdf_model)
+    logError("Unable to parse test robot model '%s'", path.c_str());
+  return urdf_model;
+}
+
+boost::shared_ptr<srdf::Model> loadTestingSRDF(const std::string &robot_name, const urdf::ModelInterface &urdf_model)
+{
+  const std::string path = getTestingModelPath(robot_name, ".srdf");
+  boost::shared_ptr<srdf::Model> srdf_model(new srdf::Model());
+  if (!srdf_model->initFile(urdf_model, path))
+  {
+    logError("Unable to parse test robot semantic description '%s'", path.c_str());
+    srdf_model.reset();
+  }
+  return srdf_model;
+}
+
+RobotModelPtr loadTestingRobotModel(const std::string &robot_name)
+{
+  boost::shared_ptr<urdf::ModelInterface> urdf_model = loadTestingURDF(robot_name);
+  if (!urdf_model)
+    return RobotModelPtr();
+  boost::shared_ptr<srdf::Model> srdf_model = loadTestingSRDF(robot_name, *urdf_model);
+  if (!srdf_model)
+    return RobotModelPtr();
+  return RobotModelPtr(new RobotModel(urdf_model, srdf_model));
+}
+
+}
+}